@@ -0,0 +1,646 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+/* core_c のヘッダー */
+#include "contrast_c/game_state.h"
+#include "contrast_c/rules.h"
+#include "contrast_c/move.h"
+#include "contrast_c/types.h"
+#include "contrast_c/wire.h"
+#include "contrast_c/search.h"
+
+/* 対局の一括解析
+ * サーバーのジャーナルを先頭から流し読みし、部屋ごとに指し手を集め、終局した対局から
+ * スレッドプールに渡す。スレッドはそれぞれ自分で探索し、置換表だけを全スレッドで共有する
+ * (別の対局で読んだ同じ局面も使える)。1手ごとに最善手との評価差 (損失) を出して悪手に印を付け、
+ * 対局者ごとの最善手一致率と平均損失からエンジン使用の疑いを判定する。
+ * 結果は1局1行の JSON (JSON Lines) で、解析が終わった順に書き出す。
+ * 読み込みは固定長のバッファ、スレッドへのキューは有限なので、メモリはアーカイブの大きさによらず
+ * 同時に進行中だった対局の数だけで決まる。 */
+
+/* ジャーナルの形式 (server/journal.c と同じ) */
+#define JOURNAL_MAGIC "CTJ1"
+#define JOURNAL_MAGIC_LEN 4
+#define JREC_ROOM_OPEN 1
+#define JREC_MOVE 2
+#define JREC_RESULT 3
+#define JREC_MAX_PAYLOAD 64
+
+/* 終局理由 (server/server.h の RESULT_*) */
+static const char *REASON_NAMES[] = {"goal", "no_moves", "disconnect", "resign", "timeout", "abandoned"};
+
+#define READ_BUF 65536
+#define ROOM_HASH 4096
+#define EVAL_CLAMP 2000 /* 勝ち負けが読めた評価値はここで頭打ちにする */
+
+/* 悪手の基準 (手番側から見た損失) */
+#define LOSS_INACCURACY 40
+#define LOSS_MISTAKE 100
+#define LOSS_BLUNDER 300
+/* 損失がこれ以下なら最善手と一致したとみなす (タイルの置き場所違いなど、
+ * 同じ評価の手がいくつもあるので手そのものの一致では数えない) */
+#define MATCH_TOLERANCE 5
+
+typedef struct Game
+{
+    int room_id;
+    int ai_level;
+    Player ai_color;
+    uint32_t *moves; /* パック済みの指し手 */
+    int nmoves;
+    int cap;
+    GameState state; /* 読み込み時の合法手チェック用 */
+    int finished;
+    Player winner;
+    int reason;
+    struct Game *next; /* 部屋表のチェイン / キュー */
+} Game;
+
+/* 解析の設定 */
+static int depth = 5;
+static int think_ms = 0;
+static int hash_bits = 22;
+static int nthreads = 0;
+static int include_unfinished = 0;
+static int min_moves = 12;         /* 疑いを判定するのに要る (強制手を除いた) 手数 */
+static double flag_match = 0.9;    /* この一致率以上で */
+static int flag_acpl = 15;         /* かつ平均損失がこれ以下なら疑い */
+static TransTable *shared_tt = NULL;
+
+/* 読み手 -> 解析スレッドのキュー (有限) */
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t queue_not_full = PTHREAD_COND_INITIALIZER;
+static Game *queue_head = NULL;
+static Game *queue_tail = NULL;
+static int queue_len = 0;
+static int queue_cap = 0;
+static int queue_closed = 0;
+
+/* 出力 (1局分をまとめて書くときだけ取る) */
+static pthread_mutex_t out_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE *out = NULL;
+static unsigned long games_done = 0;
+static unsigned long moves_done = 0;
+static unsigned long games_suspect = 0;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t journal_checksum(const uint8_t *p, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* ---- キュー ---- */
+
+static void queue_push(Game *g)
+{
+    pthread_mutex_lock(&queue_lock);
+    while (queue_len >= queue_cap)
+        pthread_cond_wait(&queue_not_full, &queue_lock);
+    g->next = NULL;
+    if (queue_tail)
+        queue_tail->next = g;
+    else
+        queue_head = g;
+    queue_tail = g;
+    queue_len++;
+    pthread_cond_signal(&queue_not_empty);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+/* 閉じられて空なら NULL */
+static Game *queue_pop(void)
+{
+    pthread_mutex_lock(&queue_lock);
+    while (!queue_head && !queue_closed)
+        pthread_cond_wait(&queue_not_empty, &queue_lock);
+    Game *g = queue_head;
+    if (g)
+    {
+        queue_head = g->next;
+        if (!queue_head)
+            queue_tail = NULL;
+        queue_len--;
+        pthread_cond_signal(&queue_not_full);
+    }
+    pthread_mutex_unlock(&queue_lock);
+    return g;
+}
+
+static void queue_close(void)
+{
+    pthread_mutex_lock(&queue_lock);
+    queue_closed = 1;
+    pthread_cond_broadcast(&queue_not_empty);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+static void game_free(Game *g)
+{
+    free(g->moves);
+    free(g);
+}
+
+/* ---- 解析 (スレッドごと) ---- */
+
+/* 1局分の出力を組み立てるバッファ */
+typedef struct
+{
+    char *p;
+    size_t len;
+    size_t cap;
+} StrBuf;
+
+static void sb_printf(StrBuf *sb, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void sb_printf(StrBuf *sb, const char *fmt, ...)
+{
+    for (;;)
+    {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(sb->p + sb->len, sb->cap - sb->len, fmt, ap);
+        va_end(ap);
+        if (n < 0)
+            return;
+        if (sb->len + (size_t)n < sb->cap)
+        {
+            sb->len += (size_t)n;
+            return;
+        }
+        size_t cap = sb->cap ? sb->cap * 2 : 4096;
+        while (cap <= sb->len + (size_t)n)
+            cap *= 2;
+        char *p = realloc(sb->p, cap);
+        if (!p)
+            return;
+        sb->p = p;
+        sb->cap = cap;
+    }
+}
+
+/* 対局者ごとの集計 */
+typedef struct
+{
+    int moves;    /* 強制手を除いた手数 */
+    int matched;  /* 最善手と同等 (MATCH_TOLERANCE 以内) だった数 */
+    long loss;    /* 損失の合計 */
+    int inaccuracies;
+    int mistakes;
+    int blunders;
+} SideStats;
+
+static int clamp_eval(int score)
+{
+    if (score > EVAL_CLAMP)
+        return EVAL_CLAMP;
+    if (score < -EVAL_CLAMP)
+        return -EVAL_CLAMP;
+    return score;
+}
+
+/* 指した手の評価 (手番側から見た値): 指した後の局面を1手浅く読んで符号を反転する */
+static int played_eval(const GameState *s, const Move *m, int best_eval, const Move *best)
+{
+    if (move_pack(m) == move_pack(best))
+        return best_eval;
+    GameState child = *s;
+    Player mover = child.to_move;
+    game_state_apply_move(&child, m);
+    if (rules_is_win(&child, mover))
+        return EVAL_CLAMP;
+    SearchLimits limits = {depth - 1, think_ms, NULL, shared_tt, NULL, NULL};
+    SearchResult r;
+    search_best_move(&child, &limits, &r);
+    if (!r.has_move)
+        return EVAL_CLAMP; /* 相手に合法手がない */
+    return -clamp_eval(r.score);
+}
+
+static void side_json(StrBuf *sb, const char *name, const SideStats *st, int suspect)
+{
+    sb_printf(sb,
+              "\"%s\":{\"moves\":%d,\"matched\":%d,\"match_rate\":%.3f,\"acpl\":%.1f,"
+              "\"inaccuracies\":%d,\"mistakes\":%d,\"blunders\":%d,\"suspect\":%s}",
+              name, st->moves, st->matched, st->moves ? (double)st->matched / st->moves : 0.0,
+              st->moves ? (double)st->loss / st->moves : 0.0, st->inaccuracies, st->mistakes, st->blunders,
+              suspect ? "true" : "false");
+}
+
+static int is_suspect(const SideStats *st)
+{
+    return st->moves >= min_moves && (double)st->matched / st->moves >= flag_match &&
+           st->loss <= (long)flag_acpl * st->moves;
+}
+
+static void analyze_game(const Game *g, StrBuf *sb)
+{
+    SideStats stats[3];
+    memset(stats, 0, sizeof(stats));
+    sb->len = 0;
+
+    const char *result = !g->finished                  ? "unfinished"
+                         : (g->winner == PLAYER_BLACK) ? "BLACK"
+                         : (g->winner == PLAYER_WHITE) ? "WHITE"
+                                                       : "none";
+    int nreasons = (int)(sizeof(REASON_NAMES) / sizeof(REASON_NAMES[0]));
+    const char *reason = (g->finished && g->reason >= 0 && g->reason < nreasons) ? REASON_NAMES[g->reason] : "";
+    sb_printf(sb, "{\"room\":%d,\"result\":\"%s\",\"reason\":\"%s\",\"plies\":%d,", g->room_id, result, reason,
+              g->nmoves);
+    if (g->ai_level > 0)
+        sb_printf(sb, "\"ai\":{\"level\":%d,\"color\":\"%s\"},", g->ai_level,
+                  g->ai_color == PLAYER_BLACK ? "BLACK" : "WHITE");
+    sb_printf(sb, "\"moves\":[");
+
+    GameState s;
+    game_state_reset(&s);
+    for (int i = 0; i < g->nmoves; i++)
+    {
+        Move played, best;
+        move_unpack(g->moves[i], &played);
+        Player mover = s.to_move;
+
+        LegalSet legal;
+        rules_legal_set(&s, &legal);
+        int forced = legal_set_size(&legal) == 1;
+
+        SearchLimits limits = {depth, think_ms, NULL, shared_tt, NULL, NULL};
+        SearchResult r;
+        search_best_move(&s, &limits, &r);
+        best = r.best_move;
+        int before = clamp_eval(r.score);
+        int after = played_eval(&s, &played, before, &best);
+        int loss = before - after;
+        if (loss < 0)
+            loss = 0; /* 浅く読んだ分のぶれ */
+
+        const char *tag = "";
+        SideStats *st = &stats[mover];
+        if (!forced)
+        {
+            st->moves++;
+            st->loss += loss;
+            if (loss <= MATCH_TOLERANCE)
+                st->matched++;
+            if (loss >= LOSS_BLUNDER)
+            {
+                tag = "blunder";
+                st->blunders++;
+            }
+            else if (loss >= LOSS_MISTAKE)
+            {
+                tag = "mistake";
+                st->mistakes++;
+            }
+            else if (loss >= LOSS_INACCURACY)
+            {
+                tag = "inaccuracy";
+                st->inaccuracies++;
+            }
+        }
+
+        /* 評価値は黒から見た値で出す (手ごとの振れ幅 = eval_after - eval_before) */
+        int sign = (mover == PLAYER_BLACK) ? 1 : -1;
+        char mtext[16], btext[16];
+        move_format(&played, mtext, sizeof(mtext));
+        move_format(&best, btext, sizeof(btext));
+        sb_printf(sb,
+                  "%s{\"ply\":%d,\"side\":\"%s\",\"move\":\"%s\",\"best\":\"%s\",\"forced\":%s,"
+                  "\"eval_before\":%d,\"eval_after\":%d,\"loss\":%d,\"tag\":\"%s\"}",
+                  i ? "," : "", i, mover == PLAYER_BLACK ? "BLACK" : "WHITE", mtext, btext,
+                  forced ? "true" : "false", sign * before, sign * after, loss, tag);
+
+        game_state_apply_move(&s, &played);
+    }
+
+    int sus_b = is_suspect(&stats[PLAYER_BLACK]);
+    int sus_w = is_suspect(&stats[PLAYER_WHITE]);
+    sb_printf(sb, "],");
+    side_json(sb, "black", &stats[PLAYER_BLACK], sus_b);
+    sb_printf(sb, ",");
+    side_json(sb, "white", &stats[PLAYER_WHITE], sus_w);
+    sb_printf(sb, "}\n");
+
+    pthread_mutex_lock(&out_lock);
+    fwrite(sb->p, 1, sb->len, out);
+    games_done++;
+    moves_done += (unsigned long)g->nmoves;
+    if (sus_b || sus_w)
+        games_suspect++;
+    pthread_mutex_unlock(&out_lock);
+}
+
+static void *worker_main(void *arg)
+{
+    (void)arg;
+    StrBuf sb = {NULL, 0, 0};
+    Game *g;
+    while ((g = queue_pop()) != NULL)
+    {
+        analyze_game(g, &sb);
+        game_free(g);
+    }
+    free(sb.p);
+    return NULL;
+}
+
+/* ---- ジャーナルの読み込み (読み手のスレッドだけが触る) ---- */
+
+static Game *room_table[ROOM_HASH];
+static unsigned long games_invalid = 0;
+static unsigned long games_unfinished = 0;
+
+static Game **room_slot(int room_id)
+{
+    Game **pp = &room_table[(unsigned)room_id % ROOM_HASH];
+    while (*pp && (*pp)->room_id != room_id)
+        pp = &(*pp)->next;
+    return pp;
+}
+
+/* 部屋表から外して解析に回す (終局していなければ指定がない限り捨てる) */
+static void dispatch(Game **pp)
+{
+    Game *g = *pp;
+    *pp = g->next;
+    if (!g->finished)
+    {
+        games_unfinished++;
+        if (!include_unfinished)
+        {
+            game_free(g);
+            return;
+        }
+    }
+    queue_push(g);
+}
+
+static void on_room_open(const uint8_t *p, size_t len)
+{
+    if (len < 30)
+        return;
+    int room_id = (int32_t)get_u32(p);
+    Game **pp = room_slot(room_id);
+    if (*pp)
+        dispatch(pp); /* 結果のないまま同じ番号の部屋が開いた */
+    if (len >= 39 && p[38] != BOARD_W)
+        return; /* 5x5 以外の盤の対局は扱わない (手は部屋が見つからないので読み飛ばされる) */
+    Game *g = calloc(1, sizeof(Game));
+    if (!g)
+        return;
+    g->room_id = room_id;
+    g->ai_level = p[4];
+    g->ai_color = (Player)p[5];
+    game_state_reset(&g->state);
+    g->next = room_table[(unsigned)room_id % ROOM_HASH];
+    room_table[(unsigned)room_id % ROOM_HASH] = g;
+}
+
+static void on_move(const uint8_t *p, size_t len)
+{
+    if (len < 8 + MOVE_PACKED_SIZE)
+        return;
+    Game *g = *room_slot((int32_t)get_u32(p));
+    Move m;
+    if (!g || g->finished < 0)
+        return;
+    LegalSet legal;
+    rules_legal_set(&g->state, &legal);
+    if (get_u32(p + 4) != g->state.ply || !wire_decode_move(p + 8, MOVE_PACKED_SIZE, &m) ||
+        !legal_set_contains(&legal, &m))
+    {
+        g->finished = -1; /* 記録が壊れている: 結果が来たら捨てる */
+        return;
+    }
+    if (g->nmoves == g->cap)
+    {
+        int cap = g->cap ? g->cap * 2 : 64;
+        uint32_t *moves = realloc(g->moves, sizeof(uint32_t) * (size_t)cap);
+        if (!moves)
+        {
+            g->finished = -1;
+            return;
+        }
+        g->moves = moves;
+        g->cap = cap;
+    }
+    g->moves[g->nmoves++] = move_pack(&m);
+    game_state_apply_move(&g->state, &m);
+}
+
+static void on_result(const uint8_t *p, size_t len)
+{
+    if (len < 6)
+        return;
+    Game **pp = room_slot((int32_t)get_u32(p));
+    Game *g = *pp;
+    if (!g)
+        return;
+    if (g->finished < 0)
+    {
+        *pp = g->next;
+        games_invalid++;
+        game_free(g);
+        return;
+    }
+    g->finished = 1;
+    g->winner = (Player)p[4];
+    g->reason = p[5];
+    dispatch(pp);
+}
+
+/* レコードを1つずつ読む (固定長バッファに読み足しながら) */
+static int read_journal(FILE *fp, const char *path)
+{
+    static uint8_t buf[READ_BUF];
+    size_t len = fread(buf, 1, READ_BUF, fp);
+    if (len < JOURNAL_MAGIC_LEN || memcmp(buf, JOURNAL_MAGIC, JOURNAL_MAGIC_LEN) != 0)
+    {
+        fprintf(stderr, "%s is not a game journal.\n", path);
+        return -1;
+    }
+    size_t off = JOURNAL_MAGIC_LEN;
+    int eof = 0;
+    for (;;)
+    {
+        /* 最大長のレコード1つ分が残っていなければ詰めて読み足す */
+        if (!eof && len - off < 2 + JREC_MAX_PAYLOAD + 4)
+        {
+            memmove(buf, buf + off, len - off);
+            len -= off;
+            off = 0;
+            size_t n = fread(buf + len, 1, READ_BUF - len, fp);
+            len += n;
+            if (n == 0)
+                eof = 1;
+        }
+        if (len - off < 2)
+            break;
+        uint8_t type = buf[off];
+        size_t plen = buf[off + 1];
+        if (plen > JREC_MAX_PAYLOAD || off + 2 + plen + 4 > len ||
+            get_u32(buf + off + 2 + plen) != journal_checksum(buf + off, 2 + plen))
+        {
+            fprintf(stderr, "%s: stopped at a torn or corrupt record.\n", path);
+            break;
+        }
+        const uint8_t *p = buf + off + 2;
+        if (type == JREC_ROOM_OPEN)
+            on_room_open(p, plen);
+        else if (type == JREC_MOVE)
+            on_move(p, plen);
+        else if (type == JREC_RESULT)
+            on_result(p, plen);
+        off += 2 + plen + 4;
+    }
+
+    /* 最後まで結果のなかった対局 */
+    for (int i = 0; i < ROOM_HASH; i++)
+    {
+        while (room_table[i])
+        {
+            if (room_table[i]->finished < 0)
+            {
+                Game *g = room_table[i];
+                room_table[i] = g->next;
+                games_invalid++;
+                game_free(g);
+            }
+            else
+            {
+                dispatch(&room_table[i]);
+            }
+        }
+    }
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [--threads=N] [--depth=N] [--think=MS] [--hash=BITS] [--out=PATH]\n"
+            "          [--include-unfinished] [--min-moves=N] [--flag-match=RATE] [--flag-acpl=N]\n"
+            "          <journal | ->\n",
+            prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = NULL;
+    const char *out_path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--threads=", 10) == 0)
+            nthreads = atoi(argv[i] + 10);
+        else if (strncmp(argv[i], "--depth=", 8) == 0)
+            depth = atoi(argv[i] + 8);
+        else if (strncmp(argv[i], "--think=", 8) == 0)
+            think_ms = atoi(argv[i] + 8);
+        else if (strncmp(argv[i], "--hash=", 7) == 0)
+            hash_bits = atoi(argv[i] + 7);
+        else if (strncmp(argv[i], "--out=", 6) == 0)
+            out_path = argv[i] + 6;
+        else if (strcmp(argv[i], "--include-unfinished") == 0)
+            include_unfinished = 1;
+        else if (strncmp(argv[i], "--min-moves=", 12) == 0)
+            min_moves = atoi(argv[i] + 12);
+        else if (strncmp(argv[i], "--flag-match=", 13) == 0)
+            flag_match = atof(argv[i] + 13);
+        else if (strncmp(argv[i], "--flag-acpl=", 12) == 0)
+            flag_acpl = atoi(argv[i] + 12);
+        else if (argv[i][0] == '-' && argv[i][1] == '-')
+            usage(argv[0]);
+        else
+            path = argv[i];
+    }
+    /* 指した手は1手浅く読むので深さは 2 以上 */
+    if (!path || depth < 2 || depth > 32 || think_ms < 0 || hash_bits < 10 || hash_bits > 30)
+        usage(argv[0]);
+    if (nthreads <= 0)
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = (n > 0) ? (int)n : 1;
+    }
+
+    FILE *fp = (strcmp(path, "-") == 0) ? stdin : fopen(path, "rb");
+    if (!fp)
+    {
+        perror(path);
+        return 1;
+    }
+    out = stdout;
+    if (out_path && !(out = fopen(out_path, "w")))
+    {
+        perror(out_path);
+        return 1;
+    }
+    shared_tt = tt_create(hash_bits);
+    if (!shared_tt)
+    {
+        fprintf(stderr, "Cannot allocate the hash table (2^%d entries).\n", hash_bits);
+        return 1;
+    }
+
+    queue_cap = nthreads * 2;
+    pthread_t *workers = calloc((size_t)nthreads, sizeof(pthread_t));
+    int started = 0;
+    for (int i = 0; i < nthreads; i++)
+    {
+        if (pthread_create(&workers[i], NULL, worker_main, NULL) != 0)
+            break;
+        started++;
+    }
+    if (started == 0)
+    {
+        fprintf(stderr, "Cannot start worker threads.\n");
+        return 1;
+    }
+
+    uint64_t t0 = now_ns();
+    int rc = read_journal(fp, path);
+    queue_close();
+    for (int i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+    double sec = (double)(now_ns() - t0) / 1e9;
+
+    if (fp != stdin)
+        fclose(fp);
+    if (out != stdout)
+        fclose(out);
+    else
+        fflush(out);
+
+    fprintf(stderr,
+            "Analyzed %lu games (%lu moves) in %.2f s with %d threads: %.1f games/s, %.0f moves/s\n"
+            "Suspected engine use: %lu games. Unfinished: %lu (%s). Invalid records: %lu.\n",
+            games_done, moves_done, sec, started, sec > 0 ? games_done / sec : 0.0,
+            sec > 0 ? moves_done / sec : 0.0, games_suspect, games_unfinished,
+            include_unfinished ? "analyzed" : "skipped", games_invalid);
+    tt_destroy(shared_tt);
+    free(workers);
+    return rc < 0 ? 1 : 0;
+}
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,24 +8,110 @@
 #include <sys/select.h>
 #include <netdb.h>
 #include <ctype.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 /* core_c のヘッダー */
 #include "contrast_c/game_state.h"
 #include "contrast_c/rules.h"
 #include "contrast_c/move.h"
 #include "contrast_c/types.h"
+#include "contrast_c/wire.h"
+#include "contrast_c/search.h"
+#include "contrast_c/variant.h"
 
 #define PORT 10000
 #define BUF_SIZE 1024
 
 int sock_fd = -1;
-GameState local_state;
+VariantGame local_state;
+int next_board_size = BOARD_W; /* 直前の BOARD 行で知らされた盤の一辺 (次の対局開始で使う) */
 int my_player_color = 0; // 0=Unknown, 1=Black, 2=White
 
+/* バイナリプロトコル: binary_mode=1 で要求し、サーバーの応答バイトで binary_ready=1 */
+int binary_mode = 0;
+int binary_ready = 0;
+
+/* ボットモード (--bot): 盤面を表示せず、自分の手番では探索で選んだ手を返す。
+ * 切断されたら再接続し、対局中だったなら RESUME で戻る (戻れなければ次の対局へ)。
+ * 1局ごとの結果と思考の統計をログファイルに1行ずつ追記する。 */
+int bot_mode = 0;
+int bot_think_ms = 500;          /* 1手の思考時間 */
+int bot_depth = 32;              /* 最大深さ (思考時間で打ち切る) */
+const char *bot_log_path = "bot.log";
+const char *bot_match_args = ""; /* QUICKMATCH の引数 */
+int bot_room = -1;               /* 指定があれば JOIN (なければ CREATE) で対局する */
+const char *bot_board = "";      /* CREATE に付ける盤の大きさ ("6x6" / "7x7") */
+int bot_games = 0;               /* この数だけ対局したら終了 (0 は無制限) */
+TransTable *bot_tt = NULL;       /* 置換表は対局をまたいで使い回す */
+EvalWeights bot_weights;         /* 評価の重み (--weights で読む。なければ既定値) */
+int bot_pending = 0;             /* 送った手の YOUR_MOVE 待ち */
+uint64_t bot_retry_at = 0;       /* マッチングをやり直す時刻 (ms、0 はなし) */
+int bot_played = 0;
+
+/* 対局中の統計と再接続用の情報 */
+typedef struct
+{
+    int room_id; /* -1 は対局していない */
+    unsigned long long token;
+    Player color;
+    uint64_t started_ms;
+    int moves;
+    uint64_t think_ms;
+    uint64_t max_think_ms;
+    long depth_sum;
+    uint64_t nodes;
+    int ponder_predictions; /* 先読みで相手の手を予想できた回数 */
+    int ponder_hits;        /* そのうち当たった回数 */
+    uint64_t ponder_us;     /* 先読みした時間の合計 */
+    uint64_t stop_us_max;   /* 先読みを止めるのにかかった最大時間 */
+} BotGame;
+
+BotGame bot_game = {-1, 0, PLAYER_NONE, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+/* 先読み (ponder): 相手の手番の間、別スレッドで相手の手を予想し、それに対する
+ * 自分の応手を読んでおく。予想が当たれば次の探索は応手を読み終えた深さの次から
+ * 始める (SearchLimits.resume)。読んだ結果は置換表 (局面のハッシュが鍵) にも残るので、
+ * 外れても置換表の内容はそのまま使う (捨てるのは予想と応手だけ)。
+ * 置換表は探索スレッド1本だけが触るよう、こちらで探索する前に必ず止めて join する。
+ * 停止は SearchLimits.stop で伝え、探索は 1024 ノードごとに見るので 1ms かからない。 */
+int bot_ponder = 1;
+typedef struct
+{
+    VariantGame root;   /* 先読みを始めた局面 (相手の手番) */
+    Move predicted;     /* 予想した相手の手 */
+    int has_prediction;
+    VariantGame next;   /* 予想手の後の局面 */
+    SearchResult reply; /* 予想手の後の自分の応手 (止めた時点で読み終えた深さまで) */
+    int hit;            /* 予想が当たった (次の探索は reply の続きから読む) */
+    atomic_int stop;
+} Ponder;
+
+Ponder ponder;
+pthread_t ponder_thread;
+int ponder_running = 0;
+uint64_t ponder_started_us = 0;
+
+/* 対局中に現れた局面のハッシュ (千日手のように同じ手を繰り返し続けないために使う) */
+#define BOT_HISTORY 512
+uint64_t bot_seen[BOT_HISTORY];
+int bot_seen_count = 0;
+
+void bot_maybe_move(void);
+void ponder_opponent_moved(const Move *m);
+void ponder_stop(void);
+void bot_remember_position(void);
+
+/* 受信バッファ (行/フレーム単位に切り出す) */
+char recv_buf[BUF_SIZE * 2];
+int recv_len = 0;
+
 /* 内部座標を文字列に変換: (0,0) -> "a1" */
 void format_coord(int x, int y, char *buf)
 {
-    if (x >= 0 && x < 5 && y >= 0 && y < 5)
+    if (x >= 0 && x < local_state.size && y >= 0 && y < local_state.size)
     {
         sprintf(buf, "%c%d", 'a' + x, y + 1);
     }
@@ -37,16 +124,26 @@ void format_coord(int x, int y, char *buf)
 /* 盤面表示関数 */
 void print_board()
 {
-    const Board *b = game_state_board_const(&local_state);
+    if (bot_mode)
+        return;
+    int n = local_state.size;
 
-    printf("\n    a  b  c  d  e\n");
-    printf("  +--+--+--+--+--+\n");
-    for (int y = 0; y < BOARD_H; y++)
+    printf("\n  ");
+    for (int x = 0; x < n; x++)
+        printf("  %c", 'a' + x);
+    printf("\n");
+    for (int y = 0; y <= n; y++)
     {
-        printf("%d |", y + 1); // 行番号 1-5
-        for (int x = 0; x < BOARD_W; x++)
+        printf("  +");
+        for (int x = 0; x < n; x++)
+            printf("--+");
+        printf("\n");
+        if (y == n)
+            break;
+        printf("%d |", y + 1); // 行番号 1-n
+        for (int x = 0; x < n; x++)
         {
-            const Cell *c = board_at_const(b, x, y);
+            const Cell *c = variant_cell(&local_state, x, y);
             char piece = ' ';
             if (c->occupant == PLAYER_BLACK)
                 piece = 'B';
@@ -62,17 +159,17 @@ void print_board()
             // 表示形式: [駒/タイル] 例: "B#" "W " " ."
             printf("%c%c|", piece, tile);
         }
-        printf("\n  +--+--+--+--+--+\n");
+        printf("\n");
     }
 
     // 在庫表示
-    TileInventory *inv_b = game_state_inventory(&local_state, PLAYER_BLACK);
-    TileInventory *inv_w = game_state_inventory(&local_state, PLAYER_WHITE);
+    const TileInventory *inv_b = variant_inventory(&local_state, PLAYER_BLACK);
+    const TileInventory *inv_w = variant_inventory(&local_state, PLAYER_WHITE);
     printf("Black(B) Inv: [#]%d [%%]%d\n", inv_b->black, inv_b->gray);
     printf("White(W) Inv: [#]%d [%%]%d\n", inv_w->black, inv_w->gray);
 
     // 手番表示
-    Player cur = game_state_current_player(&local_state);
+    Player cur = variant_to_move(&local_state);
     printf("Turn: %s", (cur == PLAYER_BLACK) ? "BLACK" : "WHITE");
     if (my_player_color != 0)
     {
@@ -122,17 +219,22 @@ void print_legal_moves(const MoveList *moves)
 
 void prompt_move()
 {
+    if (bot_mode)
+    {
+        bot_maybe_move();
+        return;
+    }
     if (my_player_color == 0)
         return;
 
-    if (game_state_current_player(&local_state) != my_player_color)
+    if (variant_to_move(&local_state) != (Player)my_player_color)
     {
         printf("Waiting for opponent...\n");
         return;
     }
 
     MoveList moves;
-    rules_legal_moves(&local_state, &moves);
+    variant_base_moves(&local_state, &moves);
     print_legal_moves(&moves);
 
     if (moves.size > 0)
@@ -142,11 +244,420 @@ void prompt_move()
     }
 }
 
+/* 受理された指し手を反映する (テキスト/バイナリ共通) */
+void apply_server_move(const Move *m, int opponent)
+{
+    if (opponent)
+        ponder_opponent_moved(m);
+    variant_apply_move(&local_state, m);
+
+    if (!opponent)
+        bot_pending = 0;
+    bot_remember_position();
+    if (!bot_mode)
+        printf(opponent ? "\nOpponent moved.\n" : "\nMove accepted.\n");
+    print_board();
+    prompt_move();
+}
+
+/* 観戦開始時・再接続時の局面を反映する (盤の大きさは長さで決まる) */
+void apply_snapshot(const uint8_t *packed, size_t len)
+{
+    next_board_size = BOARD_W;
+    if (!packed || !variant_unpack(packed, len, &local_state))
+    {
+        printf("Invalid snapshot.\n");
+        return;
+    }
+    my_player_color = 0;
+    print_board();
+}
+
+/* テキストコマンドを送る (バイナリでは TEXT フレームに包む) */
+void send_command(const char *cmd)
+{
+    if (binary_mode)
+    {
+        uint8_t frame[WIRE_MAX_FRAME];
+        size_t len = strlen(cmd);
+        if (len > WIRE_MAX_FRAME - WIRE_HEADER_SIZE)
+            len = WIRE_MAX_FRAME - WIRE_HEADER_SIZE;
+        len = wire_encode(frame, WIRE_OP_TEXT, cmd, len);
+        write(sock_fd, frame, len);
+        return;
+    }
+    char buf[BUF_SIZE];
+    snprintf(buf, sizeof(buf), "%s\n", cmd);
+    write(sock_fd, buf, strlen(buf));
+}
+
+/* 1手ごとの CHECK と手元の局面を突き合わせ、ずれていたら SYNC で取り直す */
+void verify_check(uint32_t ply, uint64_t hash)
+{
+    if (variant_ply(&local_state) == ply && variant_sync_hash(&local_state) == hash)
+        return;
+    printf("[sync] Out of sync at ply %u. Resyncing...\n", (unsigned)ply);
+    send_command("SYNC");
+}
+
+/* SYNC の応答で局面を置き換える */
+void apply_sync(const VariantGame *s)
+{
+    if (!s)
+    {
+        printf("Invalid sync.\n");
+        return;
+    }
+    ponder_stop();
+    local_state = *s;
+    bot_pending = 0; /* 送った手が受理されたかどうかも局面に反映されている */
+    bot_remember_position();
+    printf("\n[sync] State restored at ply %u.\n", (unsigned)variant_ply(s));
+    print_board();
+    prompt_move();
+}
+
+/* 観戦中の対局で指された手を反映する */
+void apply_watched_move(const Move *m)
+{
+    variant_apply_move(&local_state, m);
+    printf("\nMove played.\n");
+    print_board();
+}
+
+uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+uint64_t now_ms(void)
+{
+    return now_us() / 1000;
+}
+
+/* 次の対局を探す (--room なら JOIN、なければ QUICKMATCH) */
+void bot_matchmake(void)
+{
+    char cmd[128];
+    bot_retry_at = 0;
+    if (bot_games > 0 && bot_played >= bot_games)
+    {
+        fprintf(stderr, "[bot] %d games played. Exiting.\n", bot_played);
+        exit(0);
+    }
+    if (bot_room >= 0)
+        snprintf(cmd, sizeof(cmd), "JOIN %d", bot_room);
+    else
+        snprintf(cmd, sizeof(cmd), "QUICKMATCH %s", bot_match_args);
+    send_command(cmd);
+}
+
+void bot_game_start(Player color)
+{
+    bot_game.color = color;
+    bot_game.started_ms = now_ms();
+    bot_game.moves = 0;
+    bot_game.think_ms = 0;
+    bot_game.max_think_ms = 0;
+    bot_game.depth_sum = 0;
+    bot_game.nodes = 0;
+    bot_game.ponder_predictions = 0;
+    bot_game.ponder_hits = 0;
+    bot_game.ponder_us = 0;
+    bot_game.stop_us_max = 0;
+    bot_pending = 0;
+    bot_seen_count = 0;
+    bot_remember_position();
+}
+
+/* 手数を含まない局面の鍵 (パック済み状態の FNV-1a。どの大きさの盤でも使える) */
+uint64_t bot_position_key(const VariantGame *s)
+{
+    uint8_t packed[VARIANT_PACKED_MAX];
+    size_t n = variant_pack(s, packed);
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < n; i++)
+    {
+        h ^= packed[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+void bot_remember_position(void)
+{
+    if (!bot_mode)
+        return;
+    bot_seen[bot_seen_count % BOT_HISTORY] = bot_position_key(&local_state);
+    bot_seen_count++;
+}
+
+int bot_seen_before(const VariantGame *s)
+{
+    uint64_t h = bot_position_key(s);
+    int n = (bot_seen_count < BOT_HISTORY) ? bot_seen_count : BOT_HISTORY;
+    for (int i = 0; i < n; i++)
+    {
+        if (bot_seen[i] == h)
+            return 1;
+    }
+    return 0;
+}
+
+/* 探索の最善手が既に出た局面に戻るなら、戻らない手のうち静的評価が最もよいものに替える。
+ * 探索は決定的なので、互いに同じ局面を行き来し始めると終局しなくなる。 */
+void bot_avoid_repetition(Move *best)
+{
+    VariantGame next = local_state;
+    variant_apply_move(&next, best);
+    if (!bot_seen_before(&next))
+        return;
+
+    /* 大きい盤はタイル配置込みの全合法手が MoveList に入りきらないので、基本移動から選ぶ */
+    MoveList moves;
+    if (local_state.size == BOARD_W)
+        rules_legal_moves(&local_state.u.s5, &moves);
+    else
+        variant_base_moves(&local_state, &moves);
+    int best_score = -SCORE_INF - 1;
+    for (size_t i = 0; i < moves.size; i++)
+    {
+        next = local_state;
+        variant_apply_move(&next, &moves.moves[i]);
+        if (bot_seen_before(&next))
+            continue;
+        int score = -variant_eval(&next, &bot_weights);
+        if (score > best_score)
+        {
+            best_score = score;
+            *best = moves.moves[i];
+        }
+    }
+}
+
+/* 1局分の統計をログに追記して次の対局へ */
+void bot_game_over(const char *result, const char *reason)
+{
+    char stamp[32];
+    time_t t = time(NULL);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", localtime(&t));
+    ponder_stop();
+
+    char line[512];
+    snprintf(line, sizeof(line),
+             "%s room=%d color=%s result=%s reason=\"%s\" plies=%u moves=%d think_ms=%llu max_think_ms=%llu "
+             "avg_depth=%.1f nodes=%llu ponder_hits=%d/%d ponder_ms=%llu stop_us_max=%llu duration_ms=%llu\n",
+             stamp, bot_game.room_id, (bot_game.color == PLAYER_BLACK) ? "BLACK" : "WHITE", result, reason,
+             (unsigned)variant_ply(&local_state), bot_game.moves, (unsigned long long)bot_game.think_ms,
+             (unsigned long long)bot_game.max_think_ms,
+             bot_game.moves ? (double)bot_game.depth_sum / bot_game.moves : 0.0,
+             (unsigned long long)bot_game.nodes, bot_game.ponder_hits, bot_game.ponder_predictions,
+             (unsigned long long)(bot_game.ponder_us / 1000), (unsigned long long)bot_game.stop_us_max,
+             (unsigned long long)(now_ms() - bot_game.started_ms));
+    FILE *fp = fopen(bot_log_path, "a");
+    if (fp)
+    {
+        fputs(line, fp);
+        fclose(fp);
+    }
+    else
+    {
+        perror(bot_log_path);
+    }
+    fputs(line, stderr);
+
+    bot_played++;
+    bot_game.room_id = -1;
+    bot_game.token = 0;
+    my_player_color = 0;
+    bot_pending = 0;
+    bot_matchmake();
+}
+
+void *ponder_main(void *arg)
+{
+    (void)arg;
+    /* 相手の手を予想する (相手の持ち時間を食わないよう自分の思考時間の 1/4 まで) */
+    SearchLimits limits = {bot_depth, bot_think_ms / 4 + 1, &bot_weights, bot_tt, &ponder.stop, NULL};
+    SearchResult guess;
+    variant_search_best_move(&ponder.root, &limits, &guess);
+    if (!guess.has_move || atomic_load(&ponder.stop))
+        return NULL;
+    ponder.predicted = guess.best_move;
+    ponder.has_prediction = 1;
+
+    /* 予想手の後の局面を、止められるまで (読み切るまで) 深めていく */
+    ponder.next = ponder.root;
+    variant_apply_move(&ponder.next, &guess.best_move);
+    if (variant_is_win(&ponder.next, variant_to_move(&ponder.root)))
+        return NULL;
+    limits.time_ms = 0;
+    variant_search_best_move(&ponder.next, &limits, &ponder.reply);
+    return NULL;
+}
+
+void ponder_start(void)
+{
+    if (!bot_ponder || ponder_running)
+        return;
+    ponder.root = local_state;
+    ponder.has_prediction = 0;
+    ponder.hit = 0;
+    ponder.reply.has_move = 0;
+    ponder.reply.depth = 0;
+    atomic_store(&ponder.stop, 0);
+    if (pthread_create(&ponder_thread, NULL, ponder_main, NULL) != 0)
+        return;
+    ponder_running = 1;
+    ponder_started_us = now_us();
+}
+
+/* 先読みを止めて結果を確定させる (動いていなければ何もしない) */
+void ponder_stop(void)
+{
+    if (!ponder_running)
+        return;
+    uint64_t t0 = now_us();
+    atomic_store(&ponder.stop, 1);
+    pthread_join(ponder_thread, NULL);
+    ponder_running = 0;
+    uint64_t t1 = now_us();
+    if (t1 - t0 > bot_game.stop_us_max)
+        bot_game.stop_us_max = t1 - t0;
+    bot_game.ponder_us += t0 - ponder_started_us;
+}
+
+/* 相手の手が届いたら先読みを止め、予想が当たったかを数える */
+void ponder_opponent_moved(const Move *m)
+{
+    if (!ponder_running)
+        return;
+    ponder_stop();
+    if (!ponder.has_prediction)
+        return;
+    bot_game.ponder_predictions++;
+    if (move_pack(&ponder.predicted) == move_pack(m))
+    {
+        bot_game.ponder_hits++;
+        ponder.hit = ponder.reply.has_move;
+    }
+}
+
+/* 自分の手番なら探索して指す。相手の手番なら先読みを始める */
+void bot_maybe_move(void)
+{
+    ponder_stop();
+    if (my_player_color == 0 || bot_pending)
+        return;
+    if (variant_to_move(&local_state) != (Player)my_player_color)
+    {
+        ponder_start();
+        return;
+    }
+
+    /* 予想が当たっていれば先読みの応手の続きから読む (最大深さまで読めていればそのまま指す) */
+    SearchLimits limits = {bot_depth, bot_think_ms, &bot_weights, bot_tt, NULL, NULL};
+    if (ponder.hit && variant_sync_hash(&ponder.next) == variant_sync_hash(&local_state))
+        limits.resume = &ponder.reply;
+    ponder.hit = 0;
+    SearchResult r;
+    uint64_t t0 = now_ms();
+    variant_search_best_move(&local_state, &limits, &r);
+    uint64_t spent = now_ms() - t0;
+    if (!r.has_move)
+        return; /* 合法手なし: サーバーが負けを知らせてくる */
+
+    bot_game.moves++;
+    bot_game.think_ms += spent;
+    if (spent > bot_game.max_think_ms)
+        bot_game.max_think_ms = spent;
+    bot_game.depth_sum += r.depth;
+    bot_game.nodes += r.nodes;
+    if (r.score < SCORE_WIN / 2) /* 勝ちが見えているときはそのまま指す */
+        bot_avoid_repetition(&r.best_move);
+
+    if (binary_mode)
+    {
+        uint8_t frame[WIRE_HEADER_SIZE + MOVE_PACKED_SIZE];
+        size_t len = wire_encode_move(frame, WIRE_OP_MOVE, &r.best_move);
+        write(sock_fd, frame, len);
+    }
+    else
+    {
+        char text[16], cmd[32];
+        move_format(&r.best_move, text, sizeof(text));
+        snprintf(cmd, sizeof(cmd), "MOVE %s", text);
+        send_command(cmd);
+    }
+    bot_pending = 1;
+}
+
+/* ボットモードで特別に扱うサーバーメッセージ (処理したら 1) */
+int bot_handle_line(const char *line)
+{
+    if (strncmp(line, "RESUME_TOKEN ", 13) == 0)
+    {
+        sscanf(line + 13, "%d %llx", &bot_game.room_id, &bot_game.token);
+        return 1;
+    }
+    if (strncmp(line, "Error: No seat to resume.", 25) == 0)
+    {
+        /* 再接続したが対局はもう終わっていた */
+        fprintf(stderr, "[bot] Could not resume Room %d.\n", bot_game.room_id);
+        bot_game.room_id = -1;
+        bot_game.token = 0;
+        bot_matchmake();
+        return 1;
+    }
+    if (strncmp(line, "Error: Room not found.", 22) == 0 && bot_room >= 0)
+    {
+        char cmd[48];
+        snprintf(cmd, sizeof(cmd), "CREATE %d %s", bot_room, bot_board);
+        send_command(cmd);
+        return 1;
+    }
+    if (strncmp(line, "Error: Room exists.", 19) == 0 || strncmp(line, "Error: Server room capacity full.", 33) == 0 ||
+        strncmp(line, "Error: Queue is full.", 21) == 0)
+    {
+        /* 相手と同時に CREATE した / 満員: 少し待ってやり直す */
+        bot_retry_at = now_ms() + 1000;
+        return 1;
+    }
+    if (strncmp(line, "Error:", 6) == 0 && my_player_color != 0)
+    {
+        /* 手が通らなかった: 局面を取り直してから指し直す */
+        fprintf(stderr, "[bot] %s\n", line);
+        send_command("SYNC");
+        return 1;
+    }
+    return 0;
+}
+
+/* 16進の文字列をバイト列にする (バイト数を返す。空・奇数桁・max 超え・16進以外なら 0) */
+size_t parse_hex(const char *hex, uint8_t *out, size_t max)
+{
+    size_t len = strspn(hex, "0123456789abcdefABCDEF");
+    if (len == 0 || len % 2 != 0 || len / 2 > max || (hex[len] != '\0' && !isspace((unsigned char)hex[len])))
+        return 0;
+    for (size_t i = 0; i < len / 2; i++)
+    {
+        unsigned int v;
+        sscanf(hex + i * 2, "%2x", &v);
+        out[i] = (uint8_t)v;
+    }
+    return len / 2;
+}
+
 /* サーバーからの1行分のメッセージを処理する関数 */
 void process_server_line(char *line)
 {
     int sx, sy, dx, dy, place, tx, ty, tile;
 
+    if (bot_mode && bot_handle_line(line))
+        return;
+
     // 相手の手 (OPPONENT_MOVE) または 自分の受理された手 (YOUR_MOVE)
     if (strncmp(line, "OPPONENT_MOVE", 13) == 0 || strncmp(line, "YOUR_MOVE", 9) == 0)
     {
@@ -156,51 +667,124 @@ void process_server_line(char *line)
             sscanf(params, "%d %d %d %d %d %d %d %d",
                    &sx, &sy, &dx, &dy, &place, &tx, &ty, &tile);
             Move m = {sx, sy, dx, dy, place, tx, ty, (TileType)tile};
-            game_state_apply_move(&local_state, &m);
-
-            if (strncmp(line, "OPPONENT_MOVE", 13) == 0)
-            {
-                printf("\nOpponent moved.\n");
-            }
-            else
-            {
-                printf("\nMove accepted.\n");
-            }
-            print_board();
-            prompt_move();
+            apply_server_move(&m, strncmp(line, "OPPONENT_MOVE", 13) == 0);
         }
     }
-    else if (strstr(line, "You are BLACK"))
+    // 5x5 以外の部屋: 続く対局開始・スナップショットの盤の大きさ
+    else if (strncmp(line, "BOARD ", 6) == 0)
+    {
+        int w, h;
+        if (sscanf(line + 6, "%dx%d", &w, &h) == 2 && w == h && variant_size_valid(w))
+            next_board_size = w;
+        if (!bot_mode)
+            printf("%s\n", line);
+    }
+    // 観戦・再接続: 開始時の局面 (パック済み状態を16進で。5x5 は16バイト)
+    else if (strncmp(line, "SNAPSHOT ", 9) == 0)
+    {
+        uint8_t packed[VARIANT_PACKED_MAX];
+        size_t n = parse_hex(line + 9, packed, sizeof(packed));
+        apply_snapshot(n ? packed : NULL, n);
+    }
+    // 1手ごとの確認 (SYNC ON)
+    else if (strncmp(line, "CHECK ", 6) == 0)
+    {
+        unsigned ply;
+        unsigned long long hash;
+        if (sscanf(line + 6, "%u %llx", &ply, &hash) == 2)
+            verify_check(ply, hash);
+    }
+    // SYNC の応答: 手数 ハッシュ パック済み状態
+    else if (strncmp(line, "SYNC ", 5) == 0)
+    {
+        unsigned ply;
+        unsigned long long hash;
+        int pos = 0;
+        uint8_t packed[VARIANT_PACKED_MAX];
+        size_t n = 0;
+        VariantGame s;
+        if (sscanf(line + 5, "%u %llx %n", &ply, &hash, &pos) == 2 && pos > 0)
+            n = parse_hex(line + 5 + pos, packed, sizeof(packed));
+        int ok = n > 0 && variant_unpack(packed, n, &s);
+        if (ok)
+        {
+            variant_set_ply(&s, ply);
+            ok = variant_sync_hash(&s) == hash;
+        }
+        apply_sync(ok ? &s : NULL);
+    }
+    else if (strncmp(line, "Sync check", 10) == 0)
+    {
+        /* 接続時に自動で送る SYNC ON の応答は表示しない */
+    }
+    // 観戦: 対局者の手
+    else if (strncmp(line, "MOVED ", 6) == 0)
+    {
+        sscanf(line + 6, "%d %d %d %d %d %d %d %d",
+               &sx, &sy, &dx, &dy, &place, &tx, &ty, &tile);
+        Move m = {sx, sy, dx, dy, place, tx, ty, (TileType)tile};
+        apply_watched_move(&m);
+    }
+    else if (strncmp(line, "GAME_OVER", 9) == 0)
+    {
+        printf("\n%s\n", line);
+        printf("Returned to Lobby. (LIST, CREATE, JOIN, WATCH, EXIT)\n");
+    }
+    // 再接続: 直前の SNAPSHOT の局面に自分の色を重ねる
+    else if (strncmp(line, "Resumed Room", 12) == 0)
     {
         printf("%s\n", line);
+        my_player_color = strstr(line, "as BLACK") ? PLAYER_BLACK : PLAYER_WHITE;
+        /* スナップショットには手数がないので、CHECK と照合できるよう取り直す */
+        send_command("SYNC");
+    }
+    else if (strstr(line, "You are BLACK"))
+    {
+        if (!bot_mode)
+            printf("%s\n", line);
         my_player_color = PLAYER_BLACK;
-        game_state_reset(&local_state);
+        variant_reset(&local_state, next_board_size);
+        next_board_size = BOARD_W;
+        bot_game_start(PLAYER_BLACK);
         print_board();
         prompt_move();
     }
     else if (strstr(line, "You are WHITE"))
     {
-        printf("%s\n", line);
+        if (!bot_mode)
+            printf("%s\n", line);
         my_player_color = PLAYER_WHITE;
-        game_state_reset(&local_state);
+        variant_reset(&local_state, next_board_size);
+        next_board_size = BOARD_W;
+        bot_game_start(PLAYER_WHITE);
         print_board();
-        printf("Waiting for opponent...\n");
+        prompt_move();
     }
     // 勝利判定の修正: "WIN" または "You Win!" (相手切断時) を検知
     else if (strncmp(line, "WIN", 3) == 0 || strstr(line, "You Win!"))
     {
+        if (bot_mode)
+        {
+            bot_game_over("WIN", strncmp(line, "WIN", 3) == 0 ? line + 3 + strspn(line + 3, " ") : "(Opponent disconnected)");
+            return;
+        }
         printf("\n%s\n", line); // 受信メッセージを表示 ("Opponent disconnected. You Win!")
         printf("!!! YOU WIN !!!\n");
         my_player_color = 0; // ゲーム終了状態へリセット
-        printf("Returned to Lobby. (LIST, CREATE, JOIN, EXIT)\n");
+        printf("Returned to Lobby. (LIST, CREATE, JOIN, WATCH, EXIT)\n");
     }
     else if (strncmp(line, "LOSE", 4) == 0)
     {
+        if (bot_mode)
+        {
+            bot_game_over("LOSE", line + 4 + strspn(line + 4, " "));
+            return;
+        }
         printf("\n... You Lose ...\n");
         my_player_color = 0; // ゲーム終了状態へリセット
-        printf("Returned to Lobby. (LIST, CREATE, JOIN, EXIT)\n");
+        printf("Returned to Lobby. (LIST, CREATE, JOIN, WATCH, EXIT)\n");
     }
-    else
+    else if (!bot_mode)
     {
         // その他のメッセージ
         printf("%s\n", line);
@@ -211,31 +795,115 @@ void process_server_line(char *line)
     }
 }
 
-int main(int argc, char *argv[])
+/* バイナリフレーム1つを処理する */
+void process_server_frame(const uint8_t *frame, size_t size)
 {
-    struct sockaddr_in serv_addr;
-    struct hostent *server;
-    fd_set read_fds;
-    char buffer[BUF_SIZE];
+    uint8_t opcode = frame[2];
+    const uint8_t *payload = frame + WIRE_HEADER_SIZE;
+    size_t len = size - WIRE_HEADER_SIZE;
 
-    if (argc < 2)
+    if (opcode == WIRE_OP_OPPONENT_MOVE || opcode == WIRE_OP_YOUR_MOVE)
     {
-        fprintf(stderr, "Usage: %s <hostname>\n", argv[0]);
-        exit(0);
+        Move m;
+        if (wire_decode_move(payload, len, &m))
+            apply_server_move(&m, opcode == WIRE_OP_OPPONENT_MOVE);
+    }
+    else if (opcode == WIRE_OP_MOVED)
+    {
+        Move m;
+        if (wire_decode_move(payload, len, &m))
+            apply_watched_move(&m);
+    }
+    else if (opcode == WIRE_OP_SNAPSHOT)
+    {
+        apply_snapshot(payload, len);
+    }
+    else if (opcode == WIRE_OP_CHECK)
+    {
+        uint32_t ply;
+        uint64_t hash;
+        if (wire_decode_check(payload, len, &ply, &hash))
+            verify_check(ply, hash);
     }
+    else if (opcode == WIRE_OP_SYNC)
+    {
+        VariantGame s;
+        apply_sync(wire_decode_variant_sync(payload, len, &s) ? &s : NULL);
+    }
+    else if (opcode == WIRE_OP_TEXT)
+    {
+        /* 複数行のこともあるので行ごとに処理する */
+        char text[WIRE_MAX_FRAME];
+        memcpy(text, payload, len);
+        text[len] = '\0';
+        char *line = strtok(text, "\n");
+        while (line != NULL)
+        {
+            process_server_line(line);
+            line = strtok(NULL, "\n");
+        }
+    }
+}
 
-    sock_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock_fd < 0)
+/* 受信バッファから完結した行/フレームを取り出して処理する */
+void process_server_data()
+{
+    int pos = 0;
+    while (pos < recv_len)
     {
-        perror("socket");
-        exit(1);
+        if (binary_ready)
+        {
+            size_t size = wire_frame_size((uint8_t *)recv_buf + pos, recv_len - pos);
+            if (size == 0)
+                break;
+            if (size == (size_t)-1)
+            {
+                fprintf(stderr, "Bad frame from server.\n");
+                pos = recv_len;
+                break;
+            }
+            process_server_frame((uint8_t *)recv_buf + pos, size);
+            pos += (int)size;
+        }
+        else if (binary_mode && (uint8_t)recv_buf[pos] == WIRE_HANDSHAKE)
+        {
+            /* 行頭の応答バイト以降はフレーム */
+            binary_ready = 1;
+            pos++;
+        }
+        else
+        {
+            char *nl = memchr(recv_buf + pos, '\n', recv_len - pos);
+            if (!nl)
+                break;
+            *nl = '\0';
+            process_server_line(recv_buf + pos);
+            pos = (int)(nl - recv_buf) + 1;
+        }
     }
 
-    server = gethostbyname(argv[1]);
+    memmove(recv_buf, recv_buf + pos, recv_len - pos);
+    recv_len -= pos;
+    if (recv_len >= (int)sizeof(recv_buf) - 1)
+        recv_len = 0;
+}
+
+/* サーバーに接続する (バイナリならハンドシェイクも送る)。失敗なら -1 */
+int connect_server(const char *host)
+{
+    struct sockaddr_in serv_addr;
+    struct hostent *server = gethostbyname(host);
     if (server == NULL)
     {
         fprintf(stderr, "ERROR, no such host\n");
-        exit(0);
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return -1;
     }
 
     memset(&serv_addr, 0, sizeof(serv_addr));
@@ -243,42 +911,111 @@ int main(int argc, char *argv[])
     memcpy(&serv_addr.sin_addr.s_addr, server->h_addr_list[0], server->h_length);
     serv_addr.sin_port = htons(PORT);
 
-    if (connect(sock_fd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
+    if (connect(fd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
     {
         perror("connect");
-        exit(1);
+        close(fd);
+        return -1;
     }
 
-    printf("Connected. Commands: LIST, CREATE <id>, JOIN <id>, EXIT\n");
-    game_state_reset(&local_state);
+    if (binary_mode)
+    {
+        /* 最初の1バイトでバイナリプロトコルを要求する */
+        uint8_t hs = WIRE_HANDSHAKE;
+        write(fd, &hs, 1);
+    }
+    return fd;
+}
+
+/* キーボードからの1行を送る */
+void handle_stdin_line(char *buffer)
+{
+    buffer[strcspn(buffer, "\n")] = 0;
+
+    // EXITコマンド
+    if (strncmp(buffer, "EXIT", 4) == 0)
+    {
+        printf("Exiting...\n");
+        close(sock_fd);
+        exit(0);
+    }
+
+    // SYNC は手番中でもコマンドとして送る
+    if (strncmp(buffer, "SYNC", 4) == 0)
+    {
+        send_command(buffer);
+    }
+    // ゲーム中かつ自分の手番ならMOVEコマンドとして送信
+    else if (my_player_color != 0 && variant_to_move(&local_state) == (Player)my_player_color)
+    {
+        if (binary_ready)
+        {
+            // バイナリではローカルで解析してパック済みの手を送る
+            Move m;
+            if (!move_parse_size(buffer, local_state.size, &m))
+            {
+                printf("Invalid move format.\n");
+                prompt_move();
+                return;
+            }
+            uint8_t frame[WIRE_HEADER_SIZE + MOVE_PACKED_SIZE];
+            size_t len = wire_encode_move(frame, WIRE_OP_MOVE, &m);
+            write(sock_fd, frame, len);
+            return;
+        }
+
+        char send_buf[BUF_SIZE + 8];
+        sprintf(send_buf, "MOVE %s\n", buffer);
+        write(sock_fd, send_buf, strlen(send_buf));
+    }
+    else
+    {
+        // それ以外（ロビー）はそのまま送信
+        send_command(buffer);
+    }
+}
+
+/* 接続が切れるまでサーバーとキーボード (ボットでは再試行の時刻) を待つ */
+void run_session(void)
+{
+    fd_set read_fds;
+    char buffer[BUF_SIZE];
 
     while (1)
     {
         FD_ZERO(&read_fds);
-        FD_SET(0, &read_fds);
+        if (!bot_mode)
+            FD_SET(0, &read_fds);
         FD_SET(sock_fd, &read_fds);
 
-        if (select(sock_fd + 1, &read_fds, NULL, NULL, NULL) < 0)
+        struct timeval tv, *timeout = NULL;
+        if (bot_retry_at)
+        {
+            uint64_t now = now_ms();
+            uint64_t wait = (bot_retry_at > now) ? bot_retry_at - now : 0;
+            tv.tv_sec = (time_t)(wait / 1000);
+            tv.tv_usec = (suseconds_t)(wait % 1000) * 1000;
+            timeout = &tv;
+        }
+
+        if (select(sock_fd + 1, &read_fds, NULL, NULL, timeout) < 0)
         {
             perror("select");
             break;
         }
 
+        if (bot_retry_at && now_ms() >= bot_retry_at)
+            bot_matchmake();
+
         /* サーバーからの受信 */
         if (FD_ISSET(sock_fd, &read_fds))
         {
-            memset(buffer, 0, BUF_SIZE);
-            int n = read(sock_fd, buffer, BUF_SIZE - 1);
+            int n = read(sock_fd, recv_buf + recv_len, sizeof(recv_buf) - recv_len - 1);
             if (n <= 0)
                 break;
 
-            buffer[n] = '\0';
-            char *line = strtok(buffer, "\n");
-            while (line != NULL)
-            {
-                process_server_line(line);
-                line = strtok(NULL, "\n");
-            }
+            recv_len += n;
+            process_server_data();
         }
 
         /* キーボード入力 */
@@ -286,33 +1023,111 @@ int main(int argc, char *argv[])
         {
             memset(buffer, 0, BUF_SIZE);
             if (read(0, buffer, BUF_SIZE - 1) > 0)
+                handle_stdin_line(buffer);
+        }
+    }
+}
+
+void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s <hostname> [--binary] [--bot [--think=MS] [--depth=N] [--log=PATH]\n"
+            "       [--match=\"<min>+<sec> <rating>\"] [--room=ID [--board=NxN]] [--games=N] [--no-ponder]\n"
+            "       [--weights=PATH]]\n",
+            prog);
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+        usage(argv[0]);
+    const char *weights_path = NULL;
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--binary") == 0)
+            binary_mode = 1;
+        else if (strcmp(argv[i], "--bot") == 0)
+            bot_mode = 1;
+        else if (strncmp(argv[i], "--think=", 8) == 0)
+            bot_think_ms = atoi(argv[i] + 8);
+        else if (strncmp(argv[i], "--depth=", 8) == 0)
+            bot_depth = atoi(argv[i] + 8);
+        else if (strncmp(argv[i], "--log=", 6) == 0)
+            bot_log_path = argv[i] + 6;
+        else if (strncmp(argv[i], "--match=", 8) == 0)
+            bot_match_args = argv[i] + 8;
+        else if (strncmp(argv[i], "--room=", 7) == 0)
+            bot_room = atoi(argv[i] + 7);
+        else if (strncmp(argv[i], "--board=", 8) == 0)
+            bot_board = argv[i] + 8;
+        else if (strncmp(argv[i], "--games=", 8) == 0)
+            bot_games = atoi(argv[i] + 8);
+        else if (strcmp(argv[i], "--no-ponder") == 0)
+            bot_ponder = 0;
+        else if (strncmp(argv[i], "--weights=", 10) == 0)
+            weights_path = argv[i] + 10;
+        else
+            usage(argv[0]);
+    }
+    if (bot_think_ms <= 0 || bot_depth <= 0)
+        usage(argv[0]);
+    bot_weights = *eval_default_weights();
+    if (weights_path && !eval_load_weights(weights_path, &bot_weights))
+    {
+        fprintf(stderr, "Cannot load evaluation weights from %s.\n", weights_path);
+        exit(1);
+    }
+
+    if (!bot_mode)
+    {
+        sock_fd = connect_server(argv[1]);
+        if (sock_fd < 0)
+            exit(1);
+        printf("Connected. Commands: LIST, CREATE <id>, JOIN <id>, WATCH <id>, SYNC, EXIT\n");
+        variant_reset(&local_state, BOARD_W);
+        /* 1手ごとにサーバーの局面ハッシュと照合する */
+        send_command("SYNC ON");
+        run_session();
+        close(sock_fd);
+        return 0;
+    }
+
+    /* ボット: 切断されたら間隔を広げながら (最大30秒) つなぎ直す */
+    signal(SIGPIPE, SIG_IGN);
+    bot_tt = tt_create(20);
+    int backoff = 1;
+    for (;;)
+    {
+        sock_fd = connect_server(argv[1]);
+        if (sock_fd >= 0)
+        {
+            backoff = 1;
+            recv_len = 0;
+            binary_ready = 0;
+            my_player_color = 0;
+            bot_pending = 0;
+            bot_retry_at = 0;
+            fprintf(stderr, "[bot] Connected to %s.\n", argv[1]);
+            send_command("SYNC ON");
+            if (bot_game.room_id >= 0 && bot_game.token)
             {
-                buffer[strcspn(buffer, "\n")] = 0;
-
-                // EXITコマンド
-                if (strncmp(buffer, "EXIT", 4) == 0)
-                {
-                    printf("Exiting...\n");
-                    close(sock_fd);
-                    exit(0);
-                }
-
-                // ゲーム中かつ自分の手番ならMOVEコマンドとして送信
-                if (my_player_color != 0 && game_state_current_player(&local_state) == my_player_color)
-                {
-                    char send_buf[BUF_SIZE];
-                    sprintf(send_buf, "MOVE %s\n", buffer);
-                    write(sock_fd, send_buf, strlen(send_buf));
-                }
-                else
-                {
-                    // それ以外（ロビー）はそのまま送信
-                    strcat(buffer, "\n");
-                    write(sock_fd, buffer, strlen(buffer));
-                }
+                char cmd[64];
+                snprintf(cmd, sizeof(cmd), "RESUME %d %016llx", bot_game.room_id, bot_game.token);
+                send_command(cmd);
             }
+            else
+            {
+                bot_matchmake();
+            }
+            run_session();
+            ponder_stop();
+            close(sock_fd);
+            fprintf(stderr, "[bot] Disconnected.\n");
         }
+        fprintf(stderr, "[bot] Reconnecting in %d s.\n", backoff);
+        sleep((unsigned)backoff);
+        if (backoff < 30)
+            backoff *= 2;
     }
-    close(sock_fd);
-    return 0;
-}
\ No newline at end of file
+}
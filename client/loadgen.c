@@ -0,0 +1,737 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+/* core_c のヘッダー */
+#include "contrast_c/game_state.h"
+#include "contrast_c/rules.h"
+#include "contrast_c/move.h"
+#include "contrast_c/types.h"
+#include "contrast_c/wire.h"
+
+/* 負荷生成クライアント
+ * 1プロセスから多数の接続を epoll で張り、偶数番が CREATE・奇数番が JOIN して
+ * ランダムな合法手で対局を繰り返す。指し手はバイナリプロトコルで送り、
+ * YOUR_MOVE が返るまでを往復時間として測る。 */
+
+#define PORT 10000
+#define MAX_EVENTS 256
+#define IN_SIZE 4096
+#define OUT_SIZE 1024
+#define ROOM_ID_BASE 500000
+
+/* 接続の状態 */
+#define CONN_IDLE 0       /* 接続開始待ち (ランプアップ) */
+#define CONN_CONNECTING 1
+#define CONN_HANDSHAKE 2  /* 0xB1 の応答待ち */
+#define CONN_LOBBY 3
+#define CONN_WAITING 4    /* CREATE 済みで相手待ち */
+#define CONN_PLAYING 5
+#define CONN_CLOSED 6
+
+/* 往復時間のヒストグラム (2 の冪ごとに 16 分割) */
+#define LAT_SUB_BITS 4
+#define LAT_SUB (1 << LAT_SUB_BITS)
+#define LAT_MAX_BITS 40
+#define LAT_BUCKETS ((LAT_MAX_BITS - LAT_SUB_BITS + 1) * LAT_SUB)
+
+typedef struct
+{
+    int fd;
+    int state;
+    int room_id;
+    Player color;
+    GameState gs;
+    int awaiting_ack;  /* 指し手を送って YOUR_MOVE 待ち */
+    uint64_t sent_at;  /* 指し手を送った時刻 (ns) */
+    uint64_t due;      /* タイマーの期限 (ns) */
+    int heap_pos;      /* タイマーのヒープ上の位置 (未登録は -1) */
+    uint8_t in[IN_SIZE];
+    int inlen;
+    uint8_t out[OUT_SIZE];
+    int outlen;
+    int want_out;      /* EPOLLOUT を監視中 */
+} Conn;
+
+static Conn *conns;
+static int nconns = 1000;
+static int *heap;
+static int heap_len = 0;
+static int epfd = -1;
+static struct sockaddr_storage server_addr;
+static socklen_t server_addrlen;
+
+/* 設定 */
+static int ramp_ms = 5000;
+static int duration_ms = 30000;
+static int think_min_ms = 0;
+static int think_max_ms = 0;
+
+/* 集計 */
+static unsigned long conn_ok = 0;
+static unsigned long conn_failed = 0;
+static unsigned long conn_dropped = 0;
+static unsigned long moves = 0;
+static unsigned long moves_window = 0; /* ランプアップ後の手数 */
+static unsigned long games = 0;
+static unsigned long errors = 0;
+static unsigned long latency[LAT_BUCKETS];
+static uint64_t latency_max = 0;
+static int next_room_id = ROOM_ID_BASE;
+static uint64_t rng_state = 88172645463325252ULL;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t rng_next(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static void latency_record(uint64_t ns)
+{
+    int idx;
+    if (ns < LAT_SUB)
+    {
+        idx = (int)ns;
+    }
+    else
+    {
+        int msb = 63 - __builtin_clzll(ns);
+        int shift = msb - LAT_SUB_BITS;
+        idx = (msb >= LAT_MAX_BITS) ? LAT_BUCKETS - 1
+                                    : (shift + 1) * LAT_SUB + (int)((ns >> shift) & (LAT_SUB - 1));
+    }
+    latency[idx]++;
+    if (ns > latency_max)
+        latency_max = ns;
+}
+
+/* パーセンタイル (バケットの上端、最大値を超えない) */
+static double latency_percentile_us(double q)
+{
+    unsigned long total = 0;
+    for (int i = 0; i < LAT_BUCKETS; i++)
+        total += latency[i];
+    if (total == 0)
+        return 0.0;
+    unsigned long rank = (unsigned long)(q * (double)total);
+    if (rank >= total)
+        rank = total - 1;
+    unsigned long seen = 0;
+    for (int i = 0; i < LAT_BUCKETS; i++)
+    {
+        seen += latency[i];
+        if (seen > rank)
+        {
+            uint64_t upper = (uint64_t)i;
+            if (i >= LAT_SUB)
+            {
+                int shift = i / LAT_SUB - 1;
+                upper = ((uint64_t)(LAT_SUB + i % LAT_SUB) << shift) + ((uint64_t)1 << shift) - 1;
+            }
+            if (upper > latency_max)
+                upper = latency_max;
+            return upper / 1000.0;
+        }
+    }
+    return latency_max / 1000.0;
+}
+
+/* ---- タイマー (期限順の二分ヒープ。接続ごとに高々1つ) ---- */
+
+static void heap_swap(int a, int b)
+{
+    int t = heap[a];
+    heap[a] = heap[b];
+    heap[b] = t;
+    conns[heap[a]].heap_pos = a;
+    conns[heap[b]].heap_pos = b;
+}
+
+static void heap_up(int pos)
+{
+    while (pos > 0)
+    {
+        int parent = (pos - 1) / 2;
+        if (conns[heap[parent]].due <= conns[heap[pos]].due)
+            break;
+        heap_swap(pos, parent);
+        pos = parent;
+    }
+}
+
+static void heap_down(int pos)
+{
+    for (;;)
+    {
+        int l = pos * 2 + 1, r = l + 1, m = pos;
+        if (l < heap_len && conns[heap[l]].due < conns[heap[m]].due)
+            m = l;
+        if (r < heap_len && conns[heap[r]].due < conns[heap[m]].due)
+            m = r;
+        if (m == pos)
+            break;
+        heap_swap(pos, m);
+        pos = m;
+    }
+}
+
+static void timer_cancel(int idx)
+{
+    int pos = conns[idx].heap_pos;
+    if (pos < 0)
+        return;
+    heap_len--;
+    if (pos != heap_len)
+    {
+        heap[pos] = heap[heap_len];
+        conns[heap[pos]].heap_pos = pos;
+        heap_down(pos);
+        heap_up(pos);
+    }
+    conns[idx].heap_pos = -1;
+}
+
+static void timer_set(int idx, uint64_t due)
+{
+    timer_cancel(idx);
+    conns[idx].due = due;
+    conns[idx].heap_pos = heap_len;
+    heap[heap_len++] = idx;
+    heap_up(heap_len - 1);
+}
+
+/* ---- 送信 ---- */
+
+static void update_events(Conn *c)
+{
+    int want = (c->outlen > 0 || c->state == CONN_CONNECTING);
+    if (want == c->want_out)
+        return;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | (want ? EPOLLOUT : 0);
+    ev.data.u32 = (uint32_t)(c - conns);
+    epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->want_out = want;
+}
+
+static void close_conn(int idx, int dropped)
+{
+    Conn *c = &conns[idx];
+    if (c->fd >= 0)
+        close(c->fd); /* epoll からは close で外れる */
+    if (dropped && c->state != CONN_CLOSED)
+        conn_dropped++;
+    c->fd = -1;
+    c->state = CONN_CLOSED;
+    timer_cancel(idx);
+}
+
+static void flush_out(int idx)
+{
+    Conn *c = &conns[idx];
+    while (c->outlen > 0)
+    {
+        ssize_t n = write(c->fd, c->out, (size_t)c->outlen);
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            close_conn(idx, 1);
+            return;
+        }
+        memmove(c->out, c->out + n, (size_t)(c->outlen - n));
+        c->outlen -= (int)n;
+    }
+    update_events(c);
+}
+
+static void send_bytes(int idx, const void *data, size_t len)
+{
+    Conn *c = &conns[idx];
+    if (c->fd < 0 || c->outlen + (int)len > OUT_SIZE)
+        return;
+    memcpy(c->out + c->outlen, data, len);
+    c->outlen += (int)len;
+    flush_out(idx);
+}
+
+static void send_text(int idx, const char *line)
+{
+    uint8_t frame[WIRE_MAX_FRAME];
+    size_t n = wire_encode(frame, WIRE_OP_TEXT, line, strlen(line));
+    send_bytes(idx, frame, n);
+}
+
+/* ---- 対局 ---- */
+
+static void create_room(int idx)
+{
+    char line[32];
+    conns[idx].room_id = next_room_id++;
+    snprintf(line, sizeof(line), "CREATE %d", conns[idx].room_id);
+    send_text(idx, line);
+}
+
+/* 部屋を作った相手がいてこちらがロビーにいれば JOIN する */
+static void try_join(int idx)
+{
+    Conn *c = &conns[idx];
+    Conn *creator = &conns[idx ^ 1];
+    if (c->state != CONN_LOBBY || creator->state != CONN_WAITING)
+        return;
+    char line[32];
+    snprintf(line, sizeof(line), "JOIN %d", creator->room_id);
+    send_text(idx, line);
+}
+
+static void schedule_move(int idx)
+{
+    uint64_t delay = 0;
+    if (think_max_ms > 0)
+    {
+        int span = think_max_ms - think_min_ms + 1;
+        delay = (uint64_t)(think_min_ms + (int)(rng_next() % (uint64_t)span)) * 1000000ULL;
+    }
+    timer_set(idx, now_ns() + delay);
+}
+
+static void send_random_move(int idx)
+{
+    Conn *c = &conns[idx];
+    if (c->state != CONN_PLAYING || c->awaiting_ack ||
+        game_state_current_player(&c->gs) != c->color)
+        return;
+
+    MoveList list;
+    rules_legal_moves(&c->gs, &list);
+    if (list.size == 0)
+        return; /* サーバーが終局を知らせてくる */
+
+    const Move *m = &list.moves[rng_next() % list.size];
+    uint8_t frame[WIRE_HEADER_SIZE + MOVE_PACKED_SIZE];
+    size_t n = wire_encode_move(frame, WIRE_OP_MOVE, m);
+    c->awaiting_ack = 1;
+    c->sent_at = now_ns();
+    send_bytes(idx, frame, n);
+}
+
+static void start_game(int idx, Player color)
+{
+    Conn *c = &conns[idx];
+    c->state = CONN_PLAYING;
+    c->color = color;
+    c->awaiting_ack = 0;
+    game_state_reset(&c->gs);
+    if (color == PLAYER_BLACK)
+        schedule_move(idx);
+}
+
+static void end_game(int idx)
+{
+    Conn *c = &conns[idx];
+    c->state = CONN_LOBBY;
+    c->awaiting_ack = 0;
+    timer_cancel(idx);
+    /* 偶数番 (部屋を作る側) が次の部屋を作る。奇数番は相手の終局通知より
+     * "Room created." が先に届いていることがあるので、ここでも JOIN を試す */
+    if ((idx & 1) == 0)
+    {
+        games++;
+        create_room(idx);
+    }
+    else
+    {
+        try_join(idx);
+    }
+}
+
+static void handle_text(int idx, const char *msg)
+{
+    Conn *c = &conns[idx];
+    if (strncmp(msg, "Room created.", 13) == 0)
+    {
+        c->state = CONN_WAITING;
+        try_join(idx ^ 1);
+    }
+    else if (strncmp(msg, "Matched!", 8) == 0)
+    {
+        start_game(idx, PLAYER_WHITE);
+    }
+    else if (strncmp(msg, "Opponent found!", 15) == 0)
+    {
+        start_game(idx, PLAYER_BLACK);
+    }
+    else if (c->state == CONN_PLAYING &&
+             (strncmp(msg, "WIN", 3) == 0 || strncmp(msg, "LOSE", 4) == 0 ||
+              strncmp(msg, "Opponent disconnected", 21) == 0))
+    {
+        end_game(idx);
+    }
+    else if (strncmp(msg, "Error: Room exists.", 19) == 0)
+    {
+        create_room(idx);
+    }
+    else if (strncmp(msg, "Error:", 6) == 0)
+    {
+        errors++;
+        c->awaiting_ack = 0;
+        /* 拒否された手番は指し直す (止めると対局が進まなくなる) */
+        if (c->state == CONN_PLAYING)
+            schedule_move(idx);
+    }
+}
+
+static void handle_frame(int idx, const uint8_t *frame, size_t size, uint64_t window_start)
+{
+    Conn *c = &conns[idx];
+    uint8_t opcode = frame[2];
+    const uint8_t *payload = frame + WIRE_HEADER_SIZE;
+    size_t len = size - WIRE_HEADER_SIZE;
+
+    if (opcode == WIRE_OP_TEXT)
+    {
+        char msg[WIRE_MAX_FRAME + 1];
+        memcpy(msg, payload, len);
+        msg[len] = '\0';
+        handle_text(idx, msg);
+        return;
+    }
+
+    Move m;
+    if (c->state != CONN_PLAYING || !wire_decode_move(payload, len, &m))
+        return;
+    if (opcode == WIRE_OP_YOUR_MOVE)
+    {
+        uint64_t now = now_ns();
+        latency_record(now - c->sent_at);
+        c->awaiting_ack = 0;
+        moves++;
+        if (now >= window_start)
+            moves_window++;
+        game_state_apply_move(&c->gs, &m);
+    }
+    else if (opcode == WIRE_OP_OPPONENT_MOVE)
+    {
+        Player opponent = (c->color == PLAYER_BLACK) ? PLAYER_WHITE : PLAYER_BLACK;
+        game_state_apply_move(&c->gs, &m);
+        /* 終局の手なら WIN/LOSE を待つ (先に指すと "Not in game" になる) */
+        if (rules_is_win(&c->gs, opponent))
+            return;
+        if (game_state_current_player(&c->gs) == c->color)
+            schedule_move(idx);
+    }
+}
+
+static void handle_readable(int idx, uint64_t window_start)
+{
+    Conn *c = &conns[idx];
+    for (;;)
+    {
+        ssize_t n = read(c->fd, c->in + c->inlen, (size_t)(IN_SIZE - c->inlen));
+        if (n == 0)
+        {
+            close_conn(idx, 1);
+            return;
+        }
+        if (n < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                close_conn(idx, 1);
+            return;
+        }
+        c->inlen += (int)n;
+
+        int pos = 0;
+        if (c->state == CONN_HANDSHAKE)
+        {
+            /* 歓迎メッセージ (テキスト) を読み飛ばして 0xB1 を探す */
+            uint8_t *ack = memchr(c->in, WIRE_HANDSHAKE, (size_t)c->inlen);
+            if (!ack)
+            {
+                if (memmem(c->in, (size_t)c->inlen, "Server full.", 12))
+                {
+                    conn_failed++;
+                    close_conn(idx, 0);
+                    return;
+                }
+                if (c->inlen > IN_SIZE / 2)
+                    c->inlen = 0;
+                continue;
+            }
+            pos = (int)(ack - c->in) + 1;
+            c->state = CONN_LOBBY;
+            conn_ok++;
+            if ((idx & 1) == 0)
+                create_room(idx);
+            else
+                try_join(idx);
+        }
+
+        while (c->fd >= 0 && pos < c->inlen)
+        {
+            size_t size = wire_frame_size(c->in + pos, (size_t)(c->inlen - pos));
+            if (size == 0)
+                break;
+            if (size == (size_t)-1)
+            {
+                errors++;
+                close_conn(idx, 1);
+                return;
+            }
+            handle_frame(idx, c->in + pos, size, window_start);
+            pos += (int)size;
+        }
+        if (c->fd < 0)
+            return;
+        memmove(c->in, c->in + pos, (size_t)(c->inlen - pos));
+        c->inlen -= pos;
+    }
+}
+
+static void start_connect(int idx)
+{
+    Conn *c = &conns[idx];
+    c->fd = socket(server_addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c->fd < 0)
+    {
+        conn_failed++;
+        c->state = CONN_CLOSED;
+        return;
+    }
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(c->fd, (struct sockaddr *)&server_addr, server_addrlen) < 0 && errno != EINPROGRESS)
+    {
+        conn_failed++;
+        close(c->fd);
+        c->fd = -1;
+        c->state = CONN_CLOSED;
+        return;
+    }
+    c->state = CONN_CONNECTING;
+    c->want_out = 1;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.u32 = (uint32_t)idx;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+}
+
+static void handle_connected(int idx)
+{
+    Conn *c = &conns[idx];
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    if (err != 0)
+    {
+        conn_failed++;
+        close_conn(idx, 0);
+        return;
+    }
+    c->state = CONN_HANDSHAKE;
+    uint8_t hs = WIRE_HANDSHAKE;
+    send_bytes(idx, &hs, 1);
+}
+
+static void handle_timer(int idx)
+{
+    Conn *c = &conns[idx];
+    if (c->state == CONN_IDLE)
+        start_connect(idx);
+    else
+        send_random_move(idx);
+}
+
+static int resolve(const char *host, int port)
+{
+    struct addrinfo hints, *res;
+    char portstr[16];
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(portstr, sizeof(portstr), "%d", port);
+    if (getaddrinfo(host, portstr, &hints, &res) != 0)
+        return -1;
+    memcpy(&server_addr, res->ai_addr, res->ai_addrlen);
+    server_addrlen = res->ai_addrlen;
+    freeaddrinfo(res);
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [--host=HOST] [--port=N] [--conns=N] [--ramp=SEC] [--duration=SEC]\n"
+            "          [--think=MS|MIN-MAX] [--seed=N]\n",
+            prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *host = "127.0.0.1";
+    int port = PORT;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--host=", 7) == 0)
+            host = argv[i] + 7;
+        else if (strncmp(argv[i], "--port=", 7) == 0)
+            port = atoi(argv[i] + 7);
+        else if (strncmp(argv[i], "--conns=", 8) == 0)
+            nconns = atoi(argv[i] + 8);
+        else if (strncmp(argv[i], "--ramp=", 7) == 0)
+            ramp_ms = (int)(atof(argv[i] + 7) * 1000);
+        else if (strncmp(argv[i], "--duration=", 11) == 0)
+            duration_ms = (int)(atof(argv[i] + 11) * 1000);
+        else if (strncmp(argv[i], "--think=", 8) == 0)
+        {
+            if (sscanf(argv[i] + 8, "%d-%d", &think_min_ms, &think_max_ms) < 2)
+                think_max_ms = think_min_ms;
+        }
+        else if (strncmp(argv[i], "--seed=", 7) == 0)
+            rng_state = strtoull(argv[i] + 7, NULL, 10) | 1;
+        else
+            usage(argv[0]);
+    }
+    if (nconns < 2 || ramp_ms < 0 || duration_ms <= 0 || think_min_ms < 0 || think_max_ms < think_min_ms)
+        usage(argv[0]);
+    nconns &= ~1; /* 2本で1組 */
+
+    if (resolve(host, port) < 0)
+    {
+        fprintf(stderr, "Cannot resolve %s\n", host);
+        return 1;
+    }
+
+    /* 接続数ぶんの fd を使えるように上限を引き上げる */
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < (rlim_t)nconns + 64)
+    {
+        rl.rlim_cur = (rl.rlim_max < (rlim_t)nconns + 64) ? rl.rlim_max : (rlim_t)nconns + 64;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    conns = calloc((size_t)nconns, sizeof(Conn));
+    heap = calloc((size_t)nconns, sizeof(int));
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (!conns || !heap || epfd < 0)
+    {
+        perror("init");
+        return 1;
+    }
+
+    /* ランプアップ: 接続開始を均等にずらす */
+    uint64_t start = now_ns();
+    for (int i = 0; i < nconns; i++)
+    {
+        conns[i].fd = -1;
+        conns[i].heap_pos = -1;
+        conns[i].state = CONN_IDLE;
+        timer_set(i, start + (uint64_t)ramp_ms * 1000000ULL * (uint64_t)i / (uint64_t)nconns);
+    }
+    uint64_t window_start = start + (uint64_t)ramp_ms * 1000000ULL;
+    uint64_t end = window_start + (uint64_t)duration_ms * 1000000ULL;
+    uint64_t next_report = start + 1000000000ULL;
+    unsigned long last_moves = 0;
+
+    printf("loadgen: %d connections to %s:%d, ramp %d ms, duration %d ms, think %d-%d ms\n",
+           nconns, host, port, ramp_ms, duration_ms, think_min_ms, think_max_ms);
+
+    struct epoll_event events[MAX_EVENTS];
+    for (;;)
+    {
+        uint64_t now = now_ns();
+        if (now >= end)
+            break;
+
+        /* 期限の来たタイマーを処理する */
+        while (heap_len > 0 && conns[heap[0]].due <= now)
+        {
+            int idx = heap[0];
+            timer_cancel(idx);
+            handle_timer(idx);
+        }
+
+        if (now >= next_report)
+        {
+            printf("[%3lus] conns %lu ok / %lu failed, games %lu, moves %lu (%lu/s)\n",
+                   (unsigned long)((now - start) / 1000000000ULL), conn_ok, conn_failed, games, moves,
+                   moves - last_moves);
+            fflush(stdout);
+            last_moves = moves;
+            next_report += 1000000000ULL;
+        }
+
+        uint64_t wake = next_report < end ? next_report : end;
+        if (heap_len > 0 && conns[heap[0]].due < wake)
+            wake = conns[heap[0]].due;
+        int timeout = (wake > now) ? (int)((wake - now + 999999) / 1000000) : 0;
+
+        int n = epoll_wait(epfd, events, MAX_EVENTS, timeout);
+        if (n < 0 && errno != EINTR)
+        {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            int idx = (int)events[i].data.u32;
+            Conn *c = &conns[idx];
+            if (c->fd < 0)
+                continue;
+            if (c->state == CONN_CONNECTING)
+            {
+                if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+                    handle_connected(idx);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT)
+                flush_out(idx);
+            if (c->fd >= 0 && (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+                handle_readable(idx, window_start);
+        }
+    }
+
+    double elapsed = (double)(now_ns() - start) / 1e9;
+    unsigned long attempted = conn_ok + conn_failed;
+    printf("\n=== loadgen result ===\n");
+    printf("connections: %lu attempted, %lu ok, %lu failed (success %.1f%%), %lu dropped\n",
+           attempted, conn_ok, conn_failed, attempted ? 100.0 * (double)conn_ok / (double)attempted : 0.0,
+           conn_dropped);
+    printf("games: %lu, moves: %lu, errors: %lu, elapsed %.1f s\n", games, moves, errors, elapsed);
+    printf("accepted moves/s: %.0f (after ramp-up: %.0f)\n", (double)moves / elapsed,
+           (double)moves_window / ((double)duration_ms / 1000.0));
+    printf("move RTT: p50 %.1f us, p99 %.1f us, p999 %.1f us, max %.1f us\n",
+           latency_percentile_us(0.50), latency_percentile_us(0.99), latency_percentile_us(0.999),
+           latency_max / 1000.0);
+
+    for (int i = 0; i < nconns; i++)
+    {
+        if (conns[i].fd >= 0)
+            close(conns[i].fd);
+    }
+    close(epfd);
+    free(conns);
+    free(heap);
+    return 0;
+}
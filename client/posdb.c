@@ -0,0 +1,953 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+/* core_c のヘッダー */
+#include "contrast_c/game_state.h"
+#include "contrast_c/rules.h"
+#include "contrast_c/move.h"
+#include "contrast_c/types.h"
+#include "contrast_c/wire.h"
+#include "contrast_c/posdb.h"
+
+/* 局面統計データベースの作成と検索
+ *   build : ジャーナルの終局した対局を、局面 (正規化した鍵) ごとの勝ち負けと指し手の頻度に
+ *           まとめたファイルを作る。手ごとの記録 (鍵・指し手・結果) を --mem 分ためては
+ *           並べ替えて一時ファイル (ラン) に書き出し、最後にランを k-way マージしながら集計する
+ *           (外部マージソート)。メモリはアーカイブの大きさによらず --mem と進行中の対局だけで決まる。
+ *   query : 指し手の列をたどった局面の統計を表示する。
+ *   bench : ページキャッシュから追い出した状態 (cold) と温まった状態で、鍵の検索速度を測る。 */
+
+/* ジャーナルの形式 (server/journal.c と同じ) */
+#define JOURNAL_MAGIC "CTJ1"
+#define JOURNAL_MAGIC_LEN 4
+#define JREC_ROOM_OPEN 1
+#define JREC_MOVE 2
+#define JREC_RESULT 3
+#define JREC_MAX_PAYLOAD 64
+
+#define READ_BUF 65536
+#define ROOM_HASH 4096
+#define MERGE_FANIN 64           /* 1回のマージで開くランの数 (超えたら先にまとめる) */
+#define RUN_READ_RECORDS 4096    /* マージ中のランごとの読み込みバッファ */
+
+/* 手ごとの記録 (外部ソートの単位) */
+#define OUTCOME_NONE 0
+#define OUTCOME_WIN 1  /* 指した側が勝った */
+#define OUTCOME_LOSS 2
+
+typedef struct
+{
+    uint64_t key;
+    uint32_t move;    /* 正規化した向きのパック済み指し手 */
+    uint32_t outcome;
+} Record;
+
+typedef struct Game
+{
+    int room_id;
+    uint32_t *moves;
+    int nmoves;
+    int cap;
+    GameState state; /* 読み込み時の合法手チェック用 */
+    int invalid;
+    struct Game *next;
+} Game;
+
+/* 作成の設定と状態 */
+static size_t mem_bytes = 64u << 20;
+static const char *tmp_dir = NULL;
+static int max_ply = 0; /* 0 は全部 */
+
+static Record *run_buf = NULL;
+static size_t run_cap = 0;
+static size_t run_len = 0;
+static FILE **runs = NULL;
+static int nruns = 0;
+static int runs_cap = 0;
+
+static unsigned long games_used = 0;
+static unsigned long games_invalid = 0;
+static unsigned long games_unfinished = 0;
+static uint64_t records_total = 0;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t journal_checksum(const uint8_t *p, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* ---- ラン (並べ替えた記録の一時ファイル) ---- */
+
+static int record_cmp(const void *a, const void *b)
+{
+    const Record *x = a, *y = b;
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    if (x->move != y->move)
+        return x->move < y->move ? -1 : 1;
+    return 0;
+}
+
+/* 名前を消した一時ファイル (閉じれば消える) */
+static FILE *temp_file(void)
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/posdb-XXXXXX", tmp_dir);
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        perror(path);
+        return NULL;
+    }
+    unlink(path);
+    FILE *fp = fdopen(fd, "w+b");
+    if (!fp)
+        close(fd);
+    return fp;
+}
+
+static int add_run(FILE *fp)
+{
+    if (nruns == runs_cap)
+    {
+        int cap = runs_cap ? runs_cap * 2 : 16;
+        FILE **r = realloc(runs, sizeof(FILE *) * (size_t)cap);
+        if (!r)
+            return -1;
+        runs = r;
+        runs_cap = cap;
+    }
+    runs[nruns++] = fp;
+    return 0;
+}
+
+/* たまった記録を並べ替えてランに書き出す */
+static int spill_run(void)
+{
+    if (run_len == 0)
+        return 0;
+    qsort(run_buf, run_len, sizeof(Record), record_cmp);
+    FILE *fp = temp_file();
+    if (!fp || fwrite(run_buf, sizeof(Record), run_len, fp) != run_len || fflush(fp) != 0 ||
+        add_run(fp) < 0)
+    {
+        fprintf(stderr, "Cannot write a sort run to %s.\n", tmp_dir);
+        if (fp)
+            fclose(fp);
+        return -1;
+    }
+    rewind(fp);
+    run_len = 0;
+    return 0;
+}
+
+static int emit(uint64_t key, uint32_t move, uint32_t outcome)
+{
+    if (run_len == run_cap && spill_run() < 0)
+        return -1;
+    run_buf[run_len].key = key;
+    run_buf[run_len].move = move;
+    run_buf[run_len].outcome = outcome;
+    run_len++;
+    records_total++;
+    return 0;
+}
+
+/* マージの入力: ラン (fp) か、最後に残ったメモリ上の記録 (fp == NULL) */
+typedef struct
+{
+    FILE *fp;
+    Record *buf;
+    size_t len;
+    size_t pos;
+} Source;
+
+static int source_fill(Source *s)
+{
+    if (s->pos < s->len)
+        return 1;
+    if (!s->fp)
+        return 0;
+    s->len = fread(s->buf, sizeof(Record), RUN_READ_RECORDS, s->fp);
+    s->pos = 0;
+    return s->len > 0;
+}
+
+/* 先頭の記録が小さい順のヒープ */
+typedef struct
+{
+    Source *src;
+    int *heap;
+    int n;
+} Merger;
+
+static int merger_less(const Merger *m, int a, int b)
+{
+    return record_cmp(&m->src[a].buf[m->src[a].pos], &m->src[b].buf[m->src[b].pos]) < 0;
+}
+
+static void merger_sift_down(Merger *m, int i)
+{
+    for (;;)
+    {
+        int l = 2 * i + 1, r = l + 1, min = i;
+        if (l < m->n && merger_less(m, m->heap[l], m->heap[min]))
+            min = l;
+        if (r < m->n && merger_less(m, m->heap[r], m->heap[min]))
+            min = r;
+        if (min == i)
+            return;
+        int t = m->heap[i];
+        m->heap[i] = m->heap[min];
+        m->heap[min] = t;
+        i = min;
+    }
+}
+
+static int merger_init(Merger *m, Source *src, int n)
+{
+    m->src = src;
+    m->heap = malloc(sizeof(int) * (size_t)(n ? n : 1));
+    m->n = 0;
+    if (!m->heap)
+        return -1;
+    for (int i = 0; i < n; i++)
+    {
+        if (source_fill(&src[i]))
+            m->heap[m->n++] = i;
+    }
+    for (int i = m->n / 2 - 1; i >= 0; i--)
+        merger_sift_down(m, i);
+    return 0;
+}
+
+/* 次に小さい記録 (尽きたら 0) */
+static int merger_next(Merger *m, Record *out)
+{
+    if (m->n == 0)
+        return 0;
+    Source *s = &m->src[m->heap[0]];
+    *out = s->buf[s->pos++];
+    if (!source_fill(s))
+        m->heap[0] = m->heap[--m->n];
+    merger_sift_down(m, 0);
+    return 1;
+}
+
+/* n 本のランを開く (後ろに extra 個の空きを付ける) */
+static Source *open_sources(FILE **fps, int n, int extra)
+{
+    Source *src = calloc((size_t)(n + extra), sizeof(Source));
+    if (!src)
+        return NULL;
+    for (int i = 0; i < n; i++)
+    {
+        src[i].fp = fps[i];
+        src[i].buf = malloc(sizeof(Record) * RUN_READ_RECORDS);
+        if (!src[i].buf)
+            return NULL;
+    }
+    return src;
+}
+
+static void close_sources(Source *src, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        if (src[i].fp)
+        {
+            free(src[i].buf);
+            fclose(src[i].fp);
+        }
+    }
+    free(src);
+}
+
+/* ランが多すぎれば MERGE_FANIN 本ずつ1本にまとめる (何段でも) */
+static int reduce_runs(void)
+{
+    while (nruns > MERGE_FANIN)
+    {
+        int n = MERGE_FANIN;
+        Source *src = open_sources(runs, n, 0);
+        FILE *out = temp_file();
+        Merger m;
+        if (!src || !out || merger_init(&m, src, n) < 0)
+        {
+            fprintf(stderr, "Cannot merge sort runs.\n");
+            return -1;
+        }
+        Record r;
+        while (merger_next(&m, &r))
+        {
+            if (fwrite(&r, sizeof(r), 1, out) != 1)
+            {
+                fprintf(stderr, "Cannot write a sort run to %s.\n", tmp_dir);
+                return -1;
+            }
+        }
+        free(m.heap);
+        close_sources(src, n);
+        fflush(out);
+        rewind(out);
+        memmove(runs, runs + n, sizeof(FILE *) * (size_t)(nruns - n));
+        nruns -= n;
+        runs[nruns++] = out;
+    }
+    return 0;
+}
+
+/* ---- 集計してファイルに書く ---- */
+
+typedef struct
+{
+    FILE *out;        /* 鍵はそのまま書き、統計と指し手の表は後ろに置くので一時ファイルにためる */
+    FILE *entries_fp;
+    FILE *moves_fp;
+    uint64_t entries;
+    uint64_t moves;
+    uint32_t *index;
+    unsigned index_bits;
+    size_t next_bucket; /* 索引でまだ埋めていない最初の区間 */
+    PosDbMove *cur_moves;
+    size_t cur_len;
+    size_t cur_cap;
+    uint64_t cur_key;
+    PosDbEntry cur;
+    int have_cur;
+} Writer;
+
+static int move_cmp(const void *a, const void *b)
+{
+    const PosDbMove *x = a, *y = b;
+    if (x->count != y->count)
+        return x->count > y->count ? -1 : 1;
+    return x->move < y->move ? -1 : (x->move > y->move);
+}
+
+static int writer_flush(Writer *w)
+{
+    if (!w->have_cur)
+        return 0;
+    if (w->moves > UINT32_MAX - w->cur_len || w->entries >= UINT32_MAX)
+    {
+        fprintf(stderr, "Too many positions for one database.\n");
+        return -1;
+    }
+    /* 鍵の上位ビットがこの区間までの索引は、この局面から始まる */
+    size_t bucket = w->index_bits ? (size_t)(w->cur_key >> (64 - w->index_bits)) : 0;
+    while (w->next_bucket <= bucket)
+        w->index[w->next_bucket++] = (uint32_t)w->entries;
+    w->cur.move_first = (uint32_t)w->moves;
+    qsort(w->cur_moves, w->cur_len, sizeof(PosDbMove), move_cmp);
+    if (fwrite(&w->cur_key, sizeof(uint64_t), 1, w->out) != 1 ||
+        fwrite(&w->cur, sizeof(PosDbEntry), 1, w->entries_fp) != 1 ||
+        fwrite(w->cur_moves, sizeof(PosDbMove), w->cur_len, w->moves_fp) != w->cur_len)
+        return -1;
+    w->entries++;
+    w->moves += w->cur_len;
+    w->have_cur = 0;
+    return 0;
+}
+
+static int writer_add(Writer *w, const Record *r)
+{
+    if (w->have_cur && w->cur_key != r->key && writer_flush(w) < 0)
+        return -1;
+    if (!w->have_cur)
+    {
+        memset(&w->cur, 0, sizeof(w->cur));
+        w->cur_key = r->key;
+        w->cur_len = 0;
+        w->have_cur = 1;
+    }
+    w->cur.games++;
+    if (r->outcome == OUTCOME_WIN)
+        w->cur.wins++;
+    else if (r->outcome == OUTCOME_LOSS)
+        w->cur.losses++;
+
+    /* 同じ局面の中では指し手の順に来る */
+    if (w->cur_len == 0 || w->cur_moves[w->cur_len - 1].move != r->move)
+    {
+        if (w->cur_len == w->cur_cap)
+        {
+            size_t cap = w->cur_cap ? w->cur_cap * 2 : 64;
+            PosDbMove *p = realloc(w->cur_moves, sizeof(PosDbMove) * cap);
+            if (!p)
+                return -1;
+            w->cur_moves = p;
+            w->cur_cap = cap;
+        }
+        w->cur_moves[w->cur_len].move = r->move;
+        w->cur_moves[w->cur_len].count = 0;
+        w->cur_moves[w->cur_len].wins = 0;
+        w->cur_len++;
+    }
+    PosDbMove *m = &w->cur_moves[w->cur_len - 1];
+    m->count++;
+    if (r->outcome == OUTCOME_WIN)
+        m->wins++;
+    return 0;
+}
+
+static int write_padding(FILE *fp, long align)
+{
+    static const uint8_t zero[8] = {0};
+    long pos = ftell(fp);
+    long pad = (align - pos % align) % align;
+    return (pad == 0 || fwrite(zero, 1, (size_t)pad, fp) == (size_t)pad) ? 0 : -1;
+}
+
+static int copy_file(FILE *from, FILE *to)
+{
+    static uint8_t buf[READ_BUF];
+    rewind(from);
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), from)) > 0)
+    {
+        if (fwrite(buf, 1, n, to) != n)
+            return -1;
+    }
+    return ferror(from) ? -1 : 0;
+}
+
+/* 索引の区間数: 1区間に POSDB_BUCKET_TARGET 件前後 (局面数は記録数以下なので記録数で見積もる) */
+static unsigned choose_index_bits(uint64_t records)
+{
+    unsigned bits = 0;
+    while (bits < POSDB_INDEX_BITS_MAX && ((uint64_t)POSDB_BUCKET_TARGET << bits) < records)
+        bits++;
+    return bits;
+}
+
+/* ランとメモリ上の残りをマージしながら集計し、tmp_path に書く */
+static int write_database(const char *tmp_path, PosDbHeader *h)
+{
+    Writer w;
+    memset(&w, 0, sizeof(w));
+    w.index_bits = choose_index_bits(records_total);
+    w.index = malloc(sizeof(uint32_t) * (((size_t)1 << w.index_bits) + 1));
+    w.out = fopen(tmp_path, "wb");
+    w.entries_fp = temp_file();
+    w.moves_fp = temp_file();
+    if (!w.index || !w.out || !w.entries_fp || !w.moves_fp)
+    {
+        perror(tmp_path);
+        return -1;
+    }
+
+    qsort(run_buf, run_len, sizeof(Record), record_cmp);
+    Source *src = open_sources(runs, nruns, 1);
+    Merger m;
+    if (!src)
+        return -1;
+    src[nruns].fp = NULL; /* メモリ上の残り */
+    src[nruns].buf = run_buf;
+    src[nruns].len = run_len;
+    if (merger_init(&m, src, nruns + 1) < 0)
+        return -1;
+
+    memset(h, 0, sizeof(*h));
+    int rc = (fwrite(h, sizeof(*h), 1, w.out) == 1) ? 0 : -1; /* 最後に書き直す */
+    h->key_off = sizeof(*h);
+    Record r;
+    while (rc == 0 && merger_next(&m, &r))
+        rc = writer_add(&w, &r);
+    if (rc == 0)
+        rc = writer_flush(&w);
+    free(m.heap);
+    close_sources(src, nruns + 1);
+    nruns = 0;
+
+    if (rc == 0)
+    {
+        size_t nbuckets = (size_t)1 << w.index_bits;
+        while (w.next_bucket <= nbuckets)
+            w.index[w.next_bucket++] = (uint32_t)w.entries;
+        memcpy(h->magic, POSDB_MAGIC, 4);
+        h->version = POSDB_VERSION;
+        h->byte_order = POSDB_BYTE_ORDER;
+        h->index_bits = w.index_bits;
+        h->entries = w.entries;
+        h->moves = w.moves;
+        h->games = games_used;
+        h->entry_off = h->key_off + w.entries * sizeof(uint64_t);
+        h->move_off = h->entry_off + w.entries * sizeof(PosDbEntry);
+        rc = copy_file(w.entries_fp, w.out);
+        if (rc == 0)
+            rc = copy_file(w.moves_fp, w.out);
+        if (rc == 0)
+            rc = write_padding(w.out, 8);
+        h->index_off = (uint64_t)ftell(w.out);
+        if (rc == 0 && fwrite(w.index, sizeof(uint32_t), nbuckets + 1, w.out) != nbuckets + 1)
+            rc = -1;
+        if (rc == 0 && (fseek(w.out, 0, SEEK_SET) != 0 || fwrite(h, sizeof(*h), 1, w.out) != 1))
+            rc = -1;
+    }
+    if (fclose(w.out) != 0)
+        rc = -1;
+    fclose(w.entries_fp);
+    fclose(w.moves_fp);
+    free(w.index);
+    free(w.cur_moves);
+    if (rc < 0)
+        fprintf(stderr, "Cannot write %s.\n", tmp_path);
+    return rc;
+}
+
+/* ---- ジャーナルの読み込み ---- */
+
+static Game *room_table[ROOM_HASH];
+
+static Game **room_slot(int room_id)
+{
+    Game **pp = &room_table[(unsigned)room_id % ROOM_HASH];
+    while (*pp && (*pp)->room_id != room_id)
+        pp = &(*pp)->next;
+    return pp;
+}
+
+static void game_free(Game *g)
+{
+    free(g->moves);
+    free(g);
+}
+
+/* 終局した対局の各局面を記録にする */
+static int emit_game(const Game *g, Player winner)
+{
+    GameState s;
+    game_state_reset(&s);
+    for (int i = 0; i < g->nmoves && (max_ply == 0 || i < max_ply); i++)
+    {
+        Move m, cm;
+        move_unpack(g->moves[i], &m);
+        int sym;
+        uint64_t key = posdb_canonical_key(&s, &sym);
+        posdb_transform_move(&m, sym, &cm);
+        uint32_t packed = move_pack(&cm);
+        if (sym & POSDB_SYM_SELF)
+        {
+            /* 左右対称な局面では鏡像の手も同じ手として数える */
+            Move mirrored;
+            posdb_transform_move(&cm, POSDB_SYM_MIRROR, &mirrored);
+            if (move_pack(&mirrored) < packed)
+                packed = move_pack(&mirrored);
+        }
+        uint32_t outcome = (winner == PLAYER_NONE) ? OUTCOME_NONE
+                           : (winner == s.to_move) ? OUTCOME_WIN
+                                                   : OUTCOME_LOSS;
+        if (emit(key, packed, outcome) < 0)
+            return -1;
+        game_state_apply_move(&s, &m);
+    }
+    games_used++;
+    return 0;
+}
+
+static void on_room_open(const uint8_t *p, size_t len)
+{
+    if (len < 4)
+        return;
+    int room_id = (int32_t)get_u32(p);
+    Game **pp = room_slot(room_id);
+    if (*pp)
+    {
+        /* 結果のないまま同じ番号の部屋が開いた */
+        Game *old = *pp;
+        *pp = old->next;
+        games_unfinished++;
+        game_free(old);
+    }
+    if (len >= 39 && p[38] != BOARD_W)
+        return; /* 5x5 以外の盤の対局は扱わない (手は部屋が見つからないので読み飛ばされる) */
+    Game *g = calloc(1, sizeof(Game));
+    if (!g)
+        return;
+    g->room_id = room_id;
+    game_state_reset(&g->state);
+    g->next = room_table[(unsigned)room_id % ROOM_HASH];
+    room_table[(unsigned)room_id % ROOM_HASH] = g;
+}
+
+static void on_move(const uint8_t *p, size_t len)
+{
+    if (len < 8 + MOVE_PACKED_SIZE)
+        return;
+    Game *g = *room_slot((int32_t)get_u32(p));
+    Move m;
+    if (!g || g->invalid)
+        return;
+    LegalSet legal;
+    rules_legal_set(&g->state, &legal);
+    if (get_u32(p + 4) != g->state.ply || !wire_decode_move(p + 8, MOVE_PACKED_SIZE, &m) ||
+        !legal_set_contains(&legal, &m))
+    {
+        g->invalid = 1;
+        return;
+    }
+    if (g->nmoves == g->cap)
+    {
+        int cap = g->cap ? g->cap * 2 : 64;
+        uint32_t *moves = realloc(g->moves, sizeof(uint32_t) * (size_t)cap);
+        if (!moves)
+        {
+            g->invalid = 1;
+            return;
+        }
+        g->moves = moves;
+        g->cap = cap;
+    }
+    g->moves[g->nmoves++] = move_pack(&m);
+    game_state_apply_move(&g->state, &m);
+}
+
+static int on_result(const uint8_t *p, size_t len)
+{
+    if (len < 6)
+        return 0;
+    Game **pp = room_slot((int32_t)get_u32(p));
+    Game *g = *pp;
+    if (!g)
+        return 0;
+    *pp = g->next;
+    int rc = 0;
+    if (g->invalid)
+        games_invalid++;
+    else
+        rc = emit_game(g, (Player)p[4]);
+    game_free(g);
+    return rc;
+}
+
+static int read_journal(const char *path)
+{
+    static uint8_t buf[READ_BUF];
+    FILE *fp = (strcmp(path, "-") == 0) ? stdin : fopen(path, "rb");
+    if (!fp)
+    {
+        perror(path);
+        return -1;
+    }
+    size_t len = fread(buf, 1, READ_BUF, fp);
+    if (len < JOURNAL_MAGIC_LEN || memcmp(buf, JOURNAL_MAGIC, JOURNAL_MAGIC_LEN) != 0)
+    {
+        fprintf(stderr, "%s is not a game journal.\n", path);
+        if (fp != stdin)
+            fclose(fp);
+        return -1;
+    }
+    size_t off = JOURNAL_MAGIC_LEN;
+    int eof = 0, rc = 0;
+    while (rc == 0)
+    {
+        if (!eof && len - off < 2 + JREC_MAX_PAYLOAD + 4)
+        {
+            memmove(buf, buf + off, len - off);
+            len -= off;
+            off = 0;
+            size_t n = fread(buf + len, 1, READ_BUF - len, fp);
+            len += n;
+            if (n == 0)
+                eof = 1;
+        }
+        if (len - off < 2)
+            break;
+        uint8_t type = buf[off];
+        size_t plen = buf[off + 1];
+        if (plen > JREC_MAX_PAYLOAD || off + 2 + plen + 4 > len ||
+            get_u32(buf + off + 2 + plen) != journal_checksum(buf + off, 2 + plen))
+        {
+            fprintf(stderr, "%s: stopped at a torn or corrupt record.\n", path);
+            break;
+        }
+        const uint8_t *p = buf + off + 2;
+        if (type == JREC_ROOM_OPEN)
+            on_room_open(p, plen);
+        else if (type == JREC_MOVE)
+            on_move(p, plen);
+        else if (type == JREC_RESULT)
+            rc = on_result(p, plen);
+        off += 2 + plen + 4;
+    }
+    if (fp != stdin)
+        fclose(fp);
+
+    /* 結果のなかった対局は使わない (部屋番号はファイルごとに別物) */
+    for (int i = 0; i < ROOM_HASH; i++)
+    {
+        while (room_table[i])
+        {
+            Game *g = room_table[i];
+            room_table[i] = g->next;
+            if (g->invalid)
+                games_invalid++;
+            else
+                games_unfinished++;
+            game_free(g);
+        }
+    }
+    return rc;
+}
+
+static int cmd_build(int argc, char *argv[])
+{
+    const char *out_path = "positions.db";
+    int npaths = 0;
+    for (int i = 0; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--out=", 6) == 0)
+            out_path = argv[i] + 6;
+        else if (strncmp(argv[i], "--mem=", 6) == 0)
+            mem_bytes = (size_t)atol(argv[i] + 6) << 20;
+        else if (strncmp(argv[i], "--tmp=", 6) == 0)
+            tmp_dir = argv[i] + 6;
+        else if (strncmp(argv[i], "--max-ply=", 10) == 0)
+            max_ply = atoi(argv[i] + 10);
+        else if (argv[i][0] == '-' && argv[i][1] == '-')
+            return -1;
+        else
+            argv[npaths++] = argv[i];
+    }
+    if (npaths == 0 || mem_bytes == 0 || max_ply < 0)
+        return -1;
+    if (!tmp_dir)
+    {
+        tmp_dir = getenv("TMPDIR");
+        if (!tmp_dir || !*tmp_dir)
+            tmp_dir = "/tmp";
+    }
+
+    run_cap = mem_bytes / sizeof(Record);
+    run_buf = malloc(sizeof(Record) * run_cap);
+    if (!run_buf)
+    {
+        fprintf(stderr, "Cannot allocate %zu MB for sorting.\n", mem_bytes >> 20);
+        return 1;
+    }
+
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < npaths; i++)
+    {
+        if (read_journal(argv[i]) < 0)
+            return 1;
+    }
+    int spilled = nruns;
+    uint64_t t1 = now_ns();
+    if (reduce_runs() < 0)
+        return 1;
+
+    /* 途中で止まっても前のファイルを壊さないよう、別名で書いてから置き換える */
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", out_path);
+    PosDbHeader h;
+    if (write_database(tmp_path, &h) < 0 || rename(tmp_path, out_path) != 0)
+    {
+        unlink(tmp_path);
+        return 1;
+    }
+    uint64_t t2 = now_ns();
+    free(run_buf);
+    free(runs);
+
+    fprintf(stderr,
+            "Built %s from %lu games (%llu positions): %llu distinct positions, %llu moves, 2^%u index buckets.\n"
+            "Read+sort %.2f s (%d runs spilled), merge %.2f s. Unfinished: %lu, invalid: %lu (skipped).\n",
+            out_path, games_used, (unsigned long long)records_total, (unsigned long long)h.entries,
+            (unsigned long long)h.moves, h.index_bits, (double)(t1 - t0) / 1e9, spilled,
+            (double)(t2 - t1) / 1e9, games_unfinished, games_invalid);
+    return 0;
+}
+
+/* ---- 検索 ---- */
+
+static int cmd_query(int argc, char *argv[])
+{
+    if (argc < 1)
+        return -1;
+    PosDb *db = posdb_open(argv[0]);
+    if (!db)
+    {
+        fprintf(stderr, "%s is not a position database.\n", argv[0]);
+        return 1;
+    }
+
+    /* 初期局面から指し手をたどる */
+    GameState s;
+    game_state_reset(&s);
+    for (int i = 1; i < argc; i++)
+    {
+        Move m;
+        LegalSet legal;
+        rules_legal_set(&s, &legal);
+        if (!move_parse(argv[i], &m) || !legal_set_contains(&legal, &m))
+        {
+            fprintf(stderr, "Illegal move at ply %d: %s\n", i - 1, argv[i]);
+            posdb_close(db);
+            return 1;
+        }
+        game_state_apply_move(&s, &m);
+    }
+
+    PosDbResult r;
+    if (!posdb_lookup(db, &s, &r))
+    {
+        printf("Position not found (%s to move, ply %u).\n", s.to_move == PLAYER_BLACK ? "BLACK" : "WHITE",
+               s.ply);
+        posdb_close(db);
+        return 0;
+    }
+    const PosDbEntry *e = r.entry;
+    printf("%s to move, ply %u: seen %u times, win %u / loss %u / none %u (%.1f%%)\n",
+           s.to_move == PLAYER_BLACK ? "BLACK" : "WHITE", s.ply, e->games, e->wins, e->losses,
+           e->games - e->wins - e->losses, e->games ? 100.0 * e->wins / e->games : 0.0);
+    for (uint32_t i = 0; i < r.nmoves && i < 20; i++)
+    {
+        Move m;
+        char text[32];
+        posdb_result_move(&r, i, &m);
+        move_format(&m, text, sizeof(text));
+        printf("  %-14s %6u  win %5.1f%%\n", text, r.moves[i].count,
+               100.0 * r.moves[i].wins / r.moves[i].count);
+    }
+    posdb_close(db);
+    return 0;
+}
+
+static uint64_t xorshift64(uint64_t *s)
+{
+    uint64_t x = *s;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *s = x;
+}
+
+/* 鍵を引く速さ (半分は載っている鍵、半分は乱数で作った載っていない鍵) */
+static double bench_pass(const char *path, const uint64_t *keys, size_t n, int cold, size_t *hits)
+{
+    if (cold)
+    {
+        /* ページキャッシュから追い出す (汚れていないページだけなので読み取り専用なら全部落ちる) */
+        int fd = open(path, O_RDONLY);
+        if (fd >= 0)
+        {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+    PosDb *db = posdb_open(path);
+    if (!db)
+        return 0.0;
+    uint64_t t0 = now_ns();
+    size_t found = 0;
+    uint64_t seen = 0; /* 見つかった局面の統計まで読む */
+    for (size_t i = 0; i < n; i++)
+    {
+        const PosDbEntry *e = posdb_find(db, keys[i]);
+        if (e)
+        {
+            found++;
+            seen += e->games;
+        }
+    }
+    uint64_t t1 = now_ns();
+    posdb_close(db);
+    *hits = seen ? found : 0;
+    return (double)(t1 - t0) / 1e9;
+}
+
+static int cmd_bench(int argc, char *argv[])
+{
+    const char *path = NULL;
+    size_t nqueries = 4000000;
+    for (int i = 0; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--queries=", 10) == 0)
+            nqueries = (size_t)atol(argv[i] + 10);
+        else if (argv[i][0] == '-' && argv[i][1] == '-')
+            return -1;
+        else
+            path = argv[i];
+    }
+    if (!path || nqueries == 0)
+        return -1;
+    PosDb *db = posdb_open(path);
+    if (!db)
+    {
+        fprintf(stderr, "%s is not a position database.\n", path);
+        return 1;
+    }
+    const PosDbHeader *h = posdb_header(db);
+    uint64_t entries = h->entries;
+    uint64_t *keys = malloc(sizeof(uint64_t) * nqueries);
+    if (!keys || entries == 0)
+    {
+        posdb_close(db);
+        free(keys);
+        return 1;
+    }
+    const uint64_t *table = (const uint64_t *)((const uint8_t *)h + h->key_off);
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < nqueries; i++)
+        keys[i] = (i & 1) ? xorshift64(&rng) : table[xorshift64(&rng) % entries];
+    posdb_close(db);
+
+    size_t hits;
+    double cold = bench_pass(path, keys, nqueries, 1, &hits);
+    double warm = bench_pass(path, keys, nqueries, 0, &hits);
+    printf("%llu positions, %zu queries (%zu hits)\n", (unsigned long long)entries, nqueries, hits);
+    printf("cold: %.2f s, %.2f M queries/s, %.0f ns/query\n", cold, nqueries / cold / 1e6, cold * 1e9 / nqueries);
+    printf("warm: %.2f s, %.2f M queries/s, %.0f ns/query\n", warm, nqueries / warm / 1e6, warm * 1e9 / nqueries);
+    free(keys);
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s build [--out=PATH] [--mem=MB] [--tmp=DIR] [--max-ply=N] <journal | -> ...\n"
+            "       %s query <db> [move ...]\n"
+            "       %s bench [--queries=N] <db>\n",
+            prog, prog, prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+        usage(argv[0]);
+    int rc = -1;
+    if (strcmp(argv[1], "build") == 0)
+        rc = cmd_build(argc - 2, argv + 2);
+    else if (strcmp(argv[1], "query") == 0)
+        rc = cmd_query(argc - 2, argv + 2);
+    else if (strcmp(argv[1], "bench") == 0)
+        rc = cmd_bench(argc - 2, argv + 2);
+    if (rc < 0)
+        usage(argv[0]);
+    return rc;
+}
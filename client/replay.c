@@ -0,0 +1,810 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+/* core_c のヘッダー */
+#include "contrast_c/wire.h"
+
+/* キャプチャ再生ツール
+ * サーバーの --capture で記録したファイルを読み、接続ごとに同じ順序でコマンドを送り直す。
+ * 再生速度は記録どおり (1x)、N 倍速、最大速度 (待ちなし) から選ぶ。
+ * 終了後に接続ごとの応答を記録と突き合わせて食い違いを数え、
+ * 応答のあったコマンドの往復時間のパーセンタイルを表示する。 */
+
+#define PORT 10000
+#define MAX_EVENTS 256
+#define READ_SIZE 4096
+
+/* キャプチャのレコード種別 (server/capture.c と同じ) */
+#define CAPTURE_MAGIC "CTC1"
+#define CAPTURE_OPEN 1
+#define CAPTURE_CLOSE 2
+#define CAPTURE_IN 3
+#define CAPTURE_OUT 4
+
+/* 記録上、コマンドからこの時間内に同じ接続へ送信があれば「応答あり」とみなす */
+#define REPLY_WINDOW_US 1000
+
+/* 最大速度で応答が来ないまま止まったら、待つのをやめて先へ進む */
+#define STALL_MS 1000
+
+/* 接続の状態 */
+#define RC_PENDING 0    /* OPEN 前 */
+#define RC_CONNECTING 1
+#define RC_OPEN 2
+#define RC_SHUT 3       /* 書き込み側を閉じて EOF 待ち */
+#define RC_DONE 4
+
+/* 往復時間のヒストグラム (2 の冪ごとに 16 分割) */
+#define LAT_SUB_BITS 4
+#define LAT_SUB (1 << LAT_SUB_BITS)
+#define LAT_MAX_BITS 40
+#define LAT_BUCKETS ((LAT_MAX_BITS - LAT_SUB_BITS + 1) * LAT_SUB)
+
+typedef struct
+{
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} Buf;
+
+/* 再生する出来事 (受信コマンド・接続・切断) */
+typedef struct
+{
+    uint64_t t_us;
+    unsigned conn;
+    int type;
+    const uint8_t *data;
+    size_t len;
+    int expects_reply;
+    size_t reply_off; /* 記録された応答列の中で応答が始まる位置 */
+} Event;
+
+/* 応答待ちのコマンド */
+typedef struct
+{
+    uint64_t sent_at;
+    size_t reply_off;
+} Pending;
+
+typedef struct
+{
+    int fd;
+    int state;
+    int binary;       /* 最初に 0xB1 を送った接続 */
+    unsigned long ins; /* 記録された受信コマンド数 */
+    int close_after;  /* 送り終えたら書き込み側を閉じる */
+    int want_out;
+    Buf out;
+    Buf got;          /* 再生で受け取った応答 */
+    Buf expect;       /* 記録された応答 */
+    Pending *pending; /* 応答待ちのコマンド (FIFO) */
+    int phead;
+    int plen;
+    int pcap;
+} RConn;
+
+/* 比較の単位 (テキスト1行またはフレーム1つ) */
+typedef struct
+{
+    const uint8_t *p;
+    size_t n;
+} Msg;
+
+static Event *events;
+static size_t nevents = 0;
+static RConn *rconns;
+static unsigned nrconns = 0;
+static int epfd = -1;
+static struct sockaddr_storage server_addr;
+static socklen_t server_addrlen;
+
+static const char *ignore_prefix[16] = {"RESUME_TOKEN", "CLOCK"};
+static int nignore = 2;
+
+static unsigned long latency[LAT_BUCKETS];
+static uint64_t latency_max = 0;
+static unsigned long commands_sent = 0;
+static unsigned long conn_failed = 0;
+static unsigned long outstanding = 0; /* 全接続の応答待ちの合計 */
+static unsigned long reply_timeouts = 0;
+static uint64_t last_progress = 0;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void buf_append(Buf *b, const void *data, size_t len)
+{
+    if (b->len + len > b->cap)
+    {
+        size_t cap = b->cap ? b->cap : 256;
+        while (cap < b->len + len)
+            cap *= 2;
+        uint8_t *p = realloc(b->data, cap);
+        if (!p)
+        {
+            perror("realloc");
+            exit(1);
+        }
+        b->data = p;
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+}
+
+static void latency_record(uint64_t ns)
+{
+    int idx;
+    if (ns < LAT_SUB)
+    {
+        idx = (int)ns;
+    }
+    else
+    {
+        int msb = 63 - __builtin_clzll(ns);
+        int shift = msb - LAT_SUB_BITS;
+        idx = (msb >= LAT_MAX_BITS) ? LAT_BUCKETS - 1
+                                    : (shift + 1) * LAT_SUB + (int)((ns >> shift) & (LAT_SUB - 1));
+    }
+    latency[idx]++;
+    if (ns > latency_max)
+        latency_max = ns;
+}
+
+/* パーセンタイル (バケットの上端、最大値を超えない) */
+static double latency_percentile_us(double q, unsigned long *count)
+{
+    unsigned long total = 0;
+    for (int i = 0; i < LAT_BUCKETS; i++)
+        total += latency[i];
+    if (count)
+        *count = total;
+    if (total == 0)
+        return 0.0;
+    unsigned long rank = (unsigned long)(q * (double)total);
+    if (rank >= total)
+        rank = total - 1;
+    unsigned long seen = 0;
+    for (int i = 0; i < LAT_BUCKETS; i++)
+    {
+        seen += latency[i];
+        if (seen > rank)
+        {
+            uint64_t upper = (uint64_t)i;
+            if (i >= LAT_SUB)
+            {
+                int shift = i / LAT_SUB - 1;
+                upper = ((uint64_t)(LAT_SUB + i % LAT_SUB) << shift) + ((uint64_t)1 << shift) - 1;
+            }
+            if (upper > latency_max)
+                upper = latency_max;
+            return upper / 1000.0;
+        }
+    }
+    return latency_max / 1000.0;
+}
+
+/* ---- キャプチャの読み込み ---- */
+
+static int get_varint(const uint8_t **p, const uint8_t *end, uint64_t *out)
+{
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (*p >= end)
+            return 0;
+        uint8_t b = *(*p)++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+        {
+            *out = v;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static RConn *rconn(unsigned id)
+{
+    if (id >= nrconns)
+    {
+        unsigned n = nrconns ? nrconns : 64;
+        while (n <= id)
+            n *= 2;
+        RConn *p = realloc(rconns, n * sizeof(RConn));
+        if (!p)
+        {
+            perror("realloc");
+            exit(1);
+        }
+        memset(p + nrconns, 0, (n - nrconns) * sizeof(RConn));
+        for (unsigned i = nrconns; i < n; i++)
+            p[i].fd = -1;
+        rconns = p;
+        nrconns = n;
+    }
+    return &rconns[id];
+}
+
+/* ファイル全体を読み込み、受信コマンドを時系列に並べ、送信データは接続ごとにつなぐ */
+static int load_capture(const char *path, uint8_t **file_data)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+    {
+        perror(path);
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t *data = malloc((size_t)size + 1);
+    if (!data || fread(data, 1, (size_t)size, fp) != (size_t)size || size < 4 ||
+        memcmp(data, CAPTURE_MAGIC, 4) != 0)
+    {
+        fprintf(stderr, "%s: not a capture file\n", path);
+        fclose(fp);
+        free(data);
+        return -1;
+    }
+    fclose(fp);
+    *file_data = data;
+
+    size_t cap = 1024;
+    events = malloc(cap * sizeof(Event));
+    /* 接続ごとに最後の受信コマンド (応答ありの判定用) */
+    size_t *last_in = NULL;
+    unsigned last_in_cap = 0;
+
+    const uint8_t *p = data + 4, *end = data + size;
+    uint64_t t = 0;
+    while (p < end)
+    {
+        int type = *p++;
+        uint64_t dt, conn, len = 0;
+        if (!get_varint(&p, end, &dt) || !get_varint(&p, end, &conn))
+            break;
+        if (type == CAPTURE_IN || type == CAPTURE_OUT)
+        {
+            if (!get_varint(&p, end, &len) || (uint64_t)(end - p) < len)
+                break;
+        }
+        else if (type != CAPTURE_OPEN && type != CAPTURE_CLOSE)
+        {
+            break;
+        }
+        t += dt;
+        RConn *c = rconn((unsigned)conn);
+        if (conn >= last_in_cap)
+        {
+            unsigned n = last_in_cap ? last_in_cap : 64;
+            while (n <= conn)
+                n *= 2;
+            last_in = realloc(last_in, n * sizeof(size_t));
+            for (unsigned i = last_in_cap; i < n; i++)
+                last_in[i] = (size_t)-1;
+            last_in_cap = n;
+        }
+
+        if (type == CAPTURE_OUT)
+        {
+            size_t e = last_in[conn];
+            if (e != (size_t)-1 && t - events[e].t_us <= REPLY_WINDOW_US)
+            {
+                events[e].expects_reply = 1;
+                events[e].reply_off = c->expect.len;
+            }
+            last_in[conn] = (size_t)-1;
+            buf_append(&c->expect, p, len);
+        }
+        else
+        {
+            if (nevents == cap)
+            {
+                cap *= 2;
+                events = realloc(events, cap * sizeof(Event));
+            }
+            Event *ev = &events[nevents];
+            ev->t_us = t;
+            ev->conn = (unsigned)conn;
+            ev->type = type;
+            ev->data = p;
+            ev->len = (size_t)len;
+            ev->expects_reply = 0;
+            ev->reply_off = 0;
+            if (type == CAPTURE_IN)
+            {
+                if (c->ins++ == 0 && len == 1 && p[0] == WIRE_HANDSHAKE)
+                    c->binary = 1;
+                last_in[conn] = nevents;
+            }
+            nevents++;
+        }
+        p += len;
+    }
+    if (p < end)
+        fprintf(stderr, "warning: capture truncated after %zu events\n", nevents);
+    free(last_in);
+    return 0;
+}
+
+/* ---- 再生 ---- */
+
+static void update_events(RConn *c)
+{
+    int want = (c->out.len > 0 || c->state == RC_CONNECTING);
+    if (want == c->want_out)
+        return;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | (want ? EPOLLOUT : 0);
+    ev.data.u32 = (uint32_t)(c - rconns);
+    epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->want_out = want;
+}
+
+static void finish_conn(RConn *c)
+{
+    /* もう応答は来ない */
+    outstanding -= (unsigned long)c->plen;
+    c->plen = 0;
+    if (c->fd >= 0)
+        close(c->fd);
+    c->fd = -1;
+    c->state = RC_DONE;
+}
+
+static void flush_out(RConn *c)
+{
+    if (c->state != RC_OPEN)
+        return;
+    size_t off = 0;
+    while (off < c->out.len)
+    {
+        ssize_t n = write(c->fd, c->out.data + off, c->out.len - off);
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            finish_conn(c);
+            return;
+        }
+        off += (size_t)n;
+    }
+    memmove(c->out.data, c->out.data + off, c->out.len - off);
+    c->out.len -= off;
+    if (c->out.len == 0 && c->close_after)
+    {
+        shutdown(c->fd, SHUT_WR);
+        c->state = RC_SHUT;
+    }
+    update_events(c);
+}
+
+static void start_connect(RConn *c)
+{
+    c->fd = socket(server_addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c->fd < 0 ||
+        (connect(c->fd, (struct sockaddr *)&server_addr, server_addrlen) < 0 && errno != EINPROGRESS))
+    {
+        conn_failed++;
+        finish_conn(c);
+        return;
+    }
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    c->state = RC_CONNECTING;
+    c->want_out = 1;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.u32 = (uint32_t)(c - rconns);
+    epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+}
+
+static void dispatch_event(const Event *ev)
+{
+    RConn *c = &rconns[ev->conn];
+    if (ev->type == CAPTURE_OPEN)
+    {
+        start_connect(c);
+        return;
+    }
+    if (c->state == RC_DONE || c->state == RC_PENDING)
+        return;
+    if (ev->type == CAPTURE_CLOSE)
+    {
+        c->close_after = 1;
+        flush_out(c);
+        return;
+    }
+
+    buf_append(&c->out, ev->data, ev->len);
+    commands_sent++;
+    if (ev->expects_reply)
+    {
+        if (c->plen == c->pcap)
+        {
+            /* リングを広げるときは先頭から並べ直す */
+            int cap = c->pcap ? c->pcap * 2 : 16;
+            Pending *p = malloc((size_t)cap * sizeof(Pending));
+            for (int i = 0; i < c->plen; i++)
+                p[i] = c->pending[(c->phead + i) % c->pcap];
+            free(c->pending);
+            c->pending = p;
+            c->pcap = cap;
+            c->phead = 0;
+        }
+        Pending *pd = &c->pending[(c->phead + c->plen) % c->pcap];
+        pd->sent_at = now_ns();
+        pd->reply_off = ev->reply_off;
+        c->plen++;
+        outstanding++;
+    }
+    flush_out(c);
+}
+
+static void handle_readable(RConn *c)
+{
+    uint8_t buf[READ_SIZE];
+    for (;;)
+    {
+        ssize_t n = read(c->fd, buf, sizeof(buf));
+        if (n == 0)
+        {
+            finish_conn(c);
+            return;
+        }
+        if (n < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                finish_conn(c);
+            return;
+        }
+        /* 応答列が記録上の応答の開始位置を越えたら、そのコマンドへの応答が届いた
+         * (相手の手など頼んでいない送信も記録に含まれるので位置で合わせられる) */
+        buf_append(&c->got, buf, (size_t)n);
+        uint64_t now = now_ns();
+        while (c->plen > 0 && c->pending[c->phead].reply_off < c->got.len)
+        {
+            latency_record(now - c->pending[c->phead].sent_at);
+            c->phead = (c->phead + 1) % c->pcap;
+            c->plen--;
+            outstanding--;
+            last_progress = now;
+        }
+    }
+}
+
+/* 届かない応答を諦める (食い違いは後の比較で数える) */
+static void abandon_pending(void)
+{
+    for (unsigned id = 0; id < nrconns; id++)
+    {
+        reply_timeouts += (unsigned long)rconns[id].plen;
+        rconns[id].plen = 0;
+    }
+    outstanding = 0;
+}
+
+/* ---- 応答の比較 ---- */
+
+/* 応答をテキスト行 / フレームに切り分ける (ハンドシェイク前の歓迎メッセージは行単位) */
+static size_t split_messages(const Buf *b, int binary, Msg **out)
+{
+    size_t n = 0, cap = 16;
+    Msg *msgs = malloc(cap * sizeof(Msg));
+    size_t pos = 0;
+    int framed = 0;
+    while (pos < b->len)
+    {
+        Msg m;
+        if (binary && !framed && b->data[pos] == WIRE_HANDSHAKE)
+        {
+            m.p = b->data + pos;
+            m.n = 1;
+            framed = 1;
+            pos++;
+        }
+        else if (framed)
+        {
+            size_t size = wire_frame_size(b->data + pos, b->len - pos);
+            if (size == 0 || size == (size_t)-1)
+                break;
+            if (b->data[pos + 2] == WIRE_OP_TEXT)
+            {
+                m.p = b->data + pos + WIRE_HEADER_SIZE;
+                m.n = size - WIRE_HEADER_SIZE;
+            }
+            else
+            {
+                m.p = b->data + pos;
+                m.n = size;
+            }
+            pos += size;
+        }
+        else
+        {
+            const uint8_t *nl = memchr(b->data + pos, '\n', b->len - pos);
+            size_t len = nl ? (size_t)(nl - (b->data + pos)) : b->len - pos;
+            m.p = b->data + pos;
+            m.n = len;
+            pos += len + (nl ? 1 : 0);
+        }
+
+        int skip = 0;
+        for (int i = 0; i < nignore && !skip; i++)
+        {
+            size_t l = strlen(ignore_prefix[i]);
+            skip = (m.n >= l && memcmp(m.p, ignore_prefix[i], l) == 0);
+        }
+        if (skip)
+            continue;
+        if (n == cap)
+        {
+            cap *= 2;
+            msgs = realloc(msgs, cap * sizeof(Msg));
+        }
+        msgs[n++] = m;
+    }
+    *out = msgs;
+    return n;
+}
+
+static void print_msg(const char *label, const Msg *m)
+{
+    printf("    %s: \"", label);
+    if (!m)
+    {
+        printf("(none)\"\n");
+        return;
+    }
+    for (size_t i = 0; i < m->n && i < 80; i++)
+    {
+        uint8_t ch = m->p[i];
+        if (ch >= 0x20 && ch < 0x7F)
+            putchar(ch);
+        else
+            printf("\\x%02x", ch);
+    }
+    printf("\"\n");
+}
+
+static void report_divergence(void)
+{
+    unsigned long compared = 0, matched = 0;
+    unsigned diverged = 0, total_conns = 0;
+    int shown = 0;
+    for (unsigned id = 0; id < nrconns; id++)
+    {
+        RConn *c = &rconns[id];
+        if (c->expect.len == 0 && c->got.len == 0)
+            continue;
+        total_conns++;
+        Msg *exp, *got;
+        size_t ne = split_messages(&c->expect, c->binary, &exp);
+        size_t ng = split_messages(&c->got, c->binary, &got);
+        size_t n = ne > ng ? ne : ng;
+        int first = -1;
+        for (size_t i = 0; i < n; i++)
+        {
+            compared++;
+            if (i < ne && i < ng && exp[i].n == got[i].n && memcmp(exp[i].p, got[i].p, exp[i].n) == 0)
+                matched++;
+            else if (first < 0)
+                first = (int)i;
+        }
+        if (first >= 0)
+        {
+            diverged++;
+            if (shown < 5)
+            {
+                printf("  conn %u diverges at message %d:\n", id, first);
+                print_msg("expected", (size_t)first < ne ? &exp[first] : NULL);
+                print_msg("got     ", (size_t)first < ng ? &got[first] : NULL);
+                shown++;
+            }
+        }
+        free(exp);
+        free(got);
+    }
+    printf("responses: %lu/%lu messages match, %u of %u connections diverged\n",
+           matched, compared, diverged, total_conns);
+}
+
+static int resolve(const char *host, int port)
+{
+    struct addrinfo hints, *res;
+    char portstr[16];
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(portstr, sizeof(portstr), "%d", port);
+    if (getaddrinfo(host, portstr, &hints, &res) != 0)
+        return -1;
+    memcpy(&server_addr, res->ai_addr, res->ai_addrlen);
+    server_addrlen = res->ai_addrlen;
+    freeaddrinfo(res);
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s CAPTURE [--host=HOST] [--port=N] [--speed=N|max] [--drain=SEC] [--ignore=PREFIX]...\n",
+            prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = NULL;
+    const char *host = "127.0.0.1";
+    int port = PORT;
+    double speed = 1.0; /* 0 は最大速度 */
+    int drain_ms = 2000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--host=", 7) == 0)
+            host = argv[i] + 7;
+        else if (strncmp(argv[i], "--port=", 7) == 0)
+            port = atoi(argv[i] + 7);
+        else if (strncmp(argv[i], "--speed=", 8) == 0)
+            speed = (strcmp(argv[i] + 8, "max") == 0) ? 0.0 : atof(argv[i] + 8);
+        else if (strncmp(argv[i], "--drain=", 8) == 0)
+            drain_ms = (int)(atof(argv[i] + 8) * 1000);
+        else if (strncmp(argv[i], "--ignore=", 9) == 0 && nignore < 16)
+            ignore_prefix[nignore++] = argv[i] + 9;
+        else if (argv[i][0] != '-' && !path)
+            path = argv[i];
+        else
+            usage(argv[0]);
+    }
+    if (!path || speed < 0.0)
+        usage(argv[0]);
+
+    uint8_t *file_data;
+    if (load_capture(path, &file_data) < 0)
+        return 1;
+    if (resolve(host, port) < 0)
+    {
+        fprintf(stderr, "Cannot resolve %s\n", host);
+        return 1;
+    }
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max)
+    {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+
+    uint64_t span_us = nevents ? events[nevents - 1].t_us : 0;
+    char speed_str[32] = "max";
+    if (speed > 0.0)
+        snprintf(speed_str, sizeof(speed_str), "%gx", speed);
+    printf("replay: %zu events, %.1f s recorded, speed %s\n", nevents, span_us / 1e6, speed_str);
+
+    uint64_t start = now_ns();
+    uint64_t last_dispatch = start;
+    last_progress = start;
+    size_t next = 0;
+    struct epoll_event evs[MAX_EVENTS];
+    for (;;)
+    {
+        uint64_t now = now_ns();
+
+        /* 期限の来た出来事を記録順に送る (接続内の順序はそのまま保たれる)。
+         * 最大速度では待ち時間を詰めるかわりに、記録で応答のあったコマンドが
+         * すべて返るまで次を送らない (別の接続の CREATE より先に JOIN が届かないように) */
+        while (next < nevents)
+        {
+            if (speed > 0.0)
+            {
+                uint64_t due = start + (uint64_t)((double)events[next].t_us * 1000.0 / speed);
+                if (due > now)
+                    break;
+            }
+            else if (outstanding > 0)
+            {
+                break;
+            }
+            dispatch_event(&events[next++]);
+            last_dispatch = now;
+            last_progress = now;
+        }
+        if (speed == 0.0 && outstanding > 0 && now - last_progress >= (uint64_t)STALL_MS * 1000000ULL)
+        {
+            abandon_pending();
+            last_progress = now;
+        }
+
+        int open = 0;
+        for (unsigned id = 0; id < nrconns && !open; id++)
+            open = (rconns[id].state == RC_CONNECTING || rconns[id].state == RC_OPEN ||
+                    rconns[id].state == RC_SHUT);
+        if (next == nevents && (!open || now - last_dispatch >= (uint64_t)drain_ms * 1000000ULL))
+            break;
+
+        int timeout = 100;
+        if (next < nevents && speed > 0.0)
+        {
+            uint64_t due = start + (uint64_t)((double)events[next].t_us * 1000.0 / speed);
+            timeout = (due > now) ? (int)((due - now + 999999) / 1000000) : 0;
+            if (timeout > 100)
+                timeout = 100;
+        }
+        else if (next < nevents && outstanding == 0)
+        {
+            timeout = 0;
+        }
+        int n = epoll_wait(epfd, evs, MAX_EVENTS, timeout);
+        if (n < 0 && errno != EINTR)
+        {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            RConn *c = &rconns[evs[i].data.u32];
+            if (c->fd < 0)
+                continue;
+            if (c->state == RC_CONNECTING)
+            {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err != 0)
+                {
+                    conn_failed++;
+                    finish_conn(c);
+                    continue;
+                }
+                c->state = RC_OPEN;
+            }
+            if (evs[i].events & EPOLLOUT)
+                flush_out(c);
+            if (c->fd >= 0 && (evs[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+                handle_readable(c);
+        }
+    }
+    double elapsed = (double)(now_ns() - start) / 1e9;
+
+    printf("\n=== replay result ===\n");
+    printf("commands: %lu in %.2f s (%.0f/s), connection failures: %lu, reply timeouts: %lu\n",
+           commands_sent, elapsed, (double)commands_sent / elapsed, conn_failed, reply_timeouts);
+    unsigned long answered;
+    double p50 = latency_percentile_us(0.50, &answered);
+    printf("command RTT (%lu answered): p50 %.1f us, p99 %.1f us, p999 %.1f us, max %.1f us\n",
+           answered, p50, latency_percentile_us(0.99, NULL), latency_percentile_us(0.999, NULL),
+           latency_max / 1000.0);
+    report_divergence();
+
+    for (unsigned id = 0; id < nrconns; id++)
+    {
+        if (rconns[id].fd >= 0)
+            close(rconns[id].fd);
+        free(rconns[id].out.data);
+        free(rconns[id].got.data);
+        free(rconns[id].expect.data);
+        free(rconns[id].pending);
+    }
+    free(rconns);
+    free(events);
+    free(file_data);
+    close(epfd);
+    return 0;
+}
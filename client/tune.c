@@ -0,0 +1,706 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+/* core_c のヘッダー */
+#include "contrast_c/game_state.h"
+#include "contrast_c/rules.h"
+#include "contrast_c/move.h"
+#include "contrast_c/types.h"
+#include "contrast_c/wire.h"
+#include "contrast_c/search.h"
+
+/* 評価の重みの調整 (Texel 法)
+ * ジャーナルの終局した対局の局面に対局結果 (手番側から見た 勝ち 1 / 勝敗なし 0.5 / 負け 0) を付け、
+ * 静的評価をシグモイドに通した予想勝率との二乗誤差が最小になる重みを勾配法 (Adam) で探す。
+ * 局面は特徴量 (eval_features) だけを特徴量ごとの int8 配列 (SoA) で持つので 1局面 7 バイト。
+ * 誤差と勾配は全コアで分担し、各スレッドは TUNE_LANES 局面ずつベクトル演算で計算する
+ * (GCC のベクトル拡張。SSE2 / NEON などその環境の SIMD 命令になる)。
+ * 結果は重みファイルに書き、サーバーとボットは --weights で読む。 */
+
+/* ジャーナルの形式 (server/journal.c と同じ) */
+#define JOURNAL_MAGIC "CTJ1"
+#define JOURNAL_MAGIC_LEN 4
+#define JREC_ROOM_OPEN 1
+#define JREC_MOVE 2
+#define JREC_RESULT 3
+#define JREC_MAX_PAYLOAD 64
+
+/* 終局理由 (server/server.h の RESULT_*)。勝負がついたものだけ使う */
+#define RESULT_GOAL 0
+#define RESULT_NO_MOVES 1
+#define RESULT_TIMEOUT 4
+
+#define READ_BUF 65536
+#define ROOM_HASH 4096
+
+#define TUNE_LANES 4     /* 1回に計算する局面数 (ベクトルの幅。128bit なら SSE2 / NEON でそのまま扱える) */
+#define TUNE_BLOCK 4096  /* float で足し込む局面数 (超えたら double に移す) */
+
+typedef float vf __attribute__((vector_size(TUNE_LANES * sizeof(float))));
+typedef int32_t vi __attribute__((vector_size(TUNE_LANES * sizeof(int32_t))));
+typedef int8_t vb __attribute__((vector_size(TUNE_LANES)));
+
+/* 学習データ (SoA)。件数は TUNE_LANES の倍数に詰め、詰め物は特徴量 0・結果 0.5 (誤差も勾配も 0) */
+typedef struct
+{
+    int8_t *feat[EVAL_FEATURES];
+    uint8_t *label; /* 手番側から見た結果 x2 (負け 0 / なし 1 / 勝ち 2) */
+    size_t n;       /* 実際の局面数 */
+    size_t padded;
+    size_t cap;
+} Dataset;
+
+typedef struct Game
+{
+    int room_id;
+    uint32_t *moves;
+    int nmoves;
+    int cap;
+    GameState state; /* 読み込み時の合法手チェック用 */
+    int invalid;
+    struct Game *next;
+} Game;
+
+/* 設定 */
+static int nthreads = 0;
+static int iterations = 1000;
+static double learning_rate = 0.1;
+static int min_ply = 4;
+static double fixed_k = 0.0; /* 0 なら既定の重みに合わせて求める */
+
+static Dataset data;
+static unsigned long games_used = 0;
+static unsigned long games_skipped = 0;
+static unsigned long positions_noisy = 0;
+
+/* スレッドへの指示 (メインスレッドが書き、バリアの後に全員が読む) */
+static pthread_barrier_t start_barrier;
+static pthread_barrier_t done_barrier;
+static float job_w[EVAL_FEATURES];
+static float job_k;
+static int job_grad; /* 0 なら誤差だけ */
+static int job_quit;
+
+typedef struct
+{
+    size_t lo, hi;
+    double loss;
+    double grad[EVAL_FEATURES];
+    pthread_t tid;
+} Worker;
+
+static Worker *workers;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t journal_checksum(const uint8_t *p, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* ---- 学習データ ---- */
+
+static int dataset_reserve(Dataset *d, size_t need)
+{
+    if (need <= d->cap)
+        return 0;
+    size_t cap = d->cap ? d->cap : 1 << 16;
+    while (cap < need)
+        cap *= 2;
+    for (int j = 0; j < EVAL_FEATURES; j++)
+    {
+        int8_t *p = realloc(d->feat[j], cap);
+        if (!p)
+            return -1;
+        d->feat[j] = p;
+    }
+    uint8_t *l = realloc(d->label, cap);
+    if (!l)
+        return -1;
+    d->label = l;
+    d->cap = cap;
+    return 0;
+}
+
+static int8_t clamp8(int v)
+{
+    return (int8_t)(v > 127 ? 127 : v < -128 ? -128 : v);
+}
+
+/* 手番側が次の1手でゴールできる局面は静的評価では測れないので使わない */
+static int is_noisy(const GameState *s)
+{
+    MoveList base;
+    rules_base_moves(s, &base);
+    int goal = (s->to_move == PLAYER_BLACK) ? BOARD_H - 1 : 0;
+    for (size_t i = 0; i < base.size; i++)
+    {
+        if (base.moves[i].dy == goal)
+            return 1;
+    }
+    return 0;
+}
+
+static int add_game(const Game *g, Player winner)
+{
+    GameState s;
+    game_state_reset(&s);
+    for (int i = 0; i < g->nmoves; i++)
+    {
+        if (i >= min_ply)
+        {
+            if (is_noisy(&s))
+            {
+                positions_noisy++;
+            }
+            else
+            {
+                if (dataset_reserve(&data, data.n + 1) < 0)
+                    return -1;
+                int f[EVAL_FEATURES];
+                eval_features(&s, f);
+                for (int j = 0; j < EVAL_FEATURES; j++)
+                    data.feat[j][data.n] = clamp8(f[j]);
+                data.label[data.n] = (winner == PLAYER_NONE) ? 1 : (winner == s.to_move) ? 2 : 0;
+                data.n++;
+            }
+        }
+        Move m;
+        move_unpack(g->moves[i], &m);
+        game_state_apply_move(&s, &m);
+    }
+    games_used++;
+    return 0;
+}
+
+/* 末尾を TUNE_LANES の倍数まで詰め物で埋める */
+static int dataset_finish(Dataset *d)
+{
+    d->padded = (d->n + TUNE_LANES - 1) / TUNE_LANES * TUNE_LANES;
+    if (dataset_reserve(d, d->padded) < 0)
+        return -1;
+    for (size_t i = d->n; i < d->padded; i++)
+    {
+        for (int j = 0; j < EVAL_FEATURES; j++)
+            d->feat[j][i] = 0;
+        d->label[i] = 1;
+    }
+    return 0;
+}
+
+/* ---- ジャーナルの読み込み ---- */
+
+static Game *room_table[ROOM_HASH];
+
+static Game **room_slot(int room_id)
+{
+    Game **pp = &room_table[(unsigned)room_id % ROOM_HASH];
+    while (*pp && (*pp)->room_id != room_id)
+        pp = &(*pp)->next;
+    return pp;
+}
+
+static void game_free(Game *g)
+{
+    free(g->moves);
+    free(g);
+}
+
+static void on_room_open(const uint8_t *p, size_t len)
+{
+    if (len < 4)
+        return;
+    int room_id = (int32_t)get_u32(p);
+    Game **pp = room_slot(room_id);
+    if (*pp)
+    {
+        /* 結果のないまま同じ番号の部屋が開いた */
+        Game *old = *pp;
+        *pp = old->next;
+        games_skipped++;
+        game_free(old);
+    }
+    if (len >= 39 && p[38] != BOARD_W)
+        return; /* 5x5 以外の盤の対局は扱わない (手は部屋が見つからないので読み飛ばされる) */
+    Game *g = calloc(1, sizeof(Game));
+    if (!g)
+        return;
+    g->room_id = room_id;
+    game_state_reset(&g->state);
+    g->next = room_table[(unsigned)room_id % ROOM_HASH];
+    room_table[(unsigned)room_id % ROOM_HASH] = g;
+}
+
+static void on_move(const uint8_t *p, size_t len)
+{
+    if (len < 8 + MOVE_PACKED_SIZE)
+        return;
+    Game *g = *room_slot((int32_t)get_u32(p));
+    Move m;
+    if (!g || g->invalid)
+        return;
+    LegalSet legal;
+    rules_legal_set(&g->state, &legal);
+    if (get_u32(p + 4) != g->state.ply || !wire_decode_move(p + 8, MOVE_PACKED_SIZE, &m) ||
+        !legal_set_contains(&legal, &m))
+    {
+        g->invalid = 1;
+        return;
+    }
+    if (g->nmoves == g->cap)
+    {
+        int cap = g->cap ? g->cap * 2 : 64;
+        uint32_t *moves = realloc(g->moves, sizeof(uint32_t) * (size_t)cap);
+        if (!moves)
+        {
+            g->invalid = 1;
+            return;
+        }
+        g->moves = moves;
+        g->cap = cap;
+    }
+    g->moves[g->nmoves++] = move_pack(&m);
+    game_state_apply_move(&g->state, &m);
+}
+
+static int on_result(const uint8_t *p, size_t len)
+{
+    if (len < 6)
+        return 0;
+    Game **pp = room_slot((int32_t)get_u32(p));
+    Game *g = *pp;
+    if (!g)
+        return 0;
+    *pp = g->next;
+    int reason = p[5];
+    int rc = 0;
+    /* 切断・放棄で終わった対局は盤上の結果ではないので使わない */
+    if (g->invalid || (reason != RESULT_GOAL && reason != RESULT_NO_MOVES && reason != RESULT_TIMEOUT))
+        games_skipped++;
+    else
+        rc = add_game(g, (Player)p[4]);
+    game_free(g);
+    return rc;
+}
+
+static int read_journal(const char *path)
+{
+    static uint8_t buf[READ_BUF];
+    FILE *fp = (strcmp(path, "-") == 0) ? stdin : fopen(path, "rb");
+    if (!fp)
+    {
+        perror(path);
+        return -1;
+    }
+    size_t len = fread(buf, 1, READ_BUF, fp);
+    if (len < JOURNAL_MAGIC_LEN || memcmp(buf, JOURNAL_MAGIC, JOURNAL_MAGIC_LEN) != 0)
+    {
+        fprintf(stderr, "%s is not a game journal.\n", path);
+        if (fp != stdin)
+            fclose(fp);
+        return -1;
+    }
+    size_t off = JOURNAL_MAGIC_LEN;
+    int eof = 0, rc = 0;
+    while (rc == 0)
+    {
+        if (!eof && len - off < 2 + JREC_MAX_PAYLOAD + 4)
+        {
+            memmove(buf, buf + off, len - off);
+            len -= off;
+            off = 0;
+            size_t n = fread(buf + len, 1, READ_BUF - len, fp);
+            len += n;
+            if (n == 0)
+                eof = 1;
+        }
+        if (len - off < 2)
+            break;
+        uint8_t type = buf[off];
+        size_t plen = buf[off + 1];
+        if (plen > JREC_MAX_PAYLOAD || off + 2 + plen + 4 > len ||
+            get_u32(buf + off + 2 + plen) != journal_checksum(buf + off, 2 + plen))
+        {
+            fprintf(stderr, "%s: stopped at a torn or corrupt record.\n", path);
+            break;
+        }
+        const uint8_t *p = buf + off + 2;
+        if (type == JREC_ROOM_OPEN)
+            on_room_open(p, plen);
+        else if (type == JREC_MOVE)
+            on_move(p, plen);
+        else if (type == JREC_RESULT)
+            rc = on_result(p, plen);
+        off += 2 + plen + 4;
+    }
+    if (fp != stdin)
+        fclose(fp);
+
+    for (int i = 0; i < ROOM_HASH; i++)
+    {
+        while (room_table[i])
+        {
+            Game *g = room_table[i];
+            room_table[i] = g->next;
+            games_skipped++;
+            game_free(g);
+        }
+    }
+    return rc;
+}
+
+/* ---- 誤差と勾配 (ベクトル演算) ---- */
+
+static inline vf vf_splat(float x)
+{
+    vf v;
+    for (int i = 0; i < TUNE_LANES; i++)
+        v[i] = x;
+    return v;
+}
+
+/* a < b の要素だけ b に置き換える */
+static inline vf vf_max(vf a, vf b)
+{
+    vi lt = a < b;
+    return (vf)(((vi)b & lt) | ((vi)a & ~lt));
+}
+
+static inline vf vf_min(vf a, vf b)
+{
+    vi gt = a > b;
+    return (vf)(((vi)b & gt) | ((vi)a & ~gt));
+}
+
+/* exp(x): 2^n * exp(r) (|r| <= ln2/2) に分けて exp(r) を多項式で近似 (相対誤差 1e-7 程度) */
+static inline vf vf_exp(vf x)
+{
+    x = vf_min(vf_max(x, vf_splat(-87.0f)), vf_splat(87.0f));
+    const vf magic = vf_splat(12582912.0f); /* 1.5 * 2^23: 足して引くと最も近い整数に丸まる */
+    vf t = x * vf_splat(1.44269504f);
+    vf n = (t + magic) - magic;
+    vf r = x - n * vf_splat(0.693145752f) - n * vf_splat(1.42860677e-6f);
+    vf p = vf_splat(1.0f / 720.0f);
+    p = p * r + vf_splat(1.0f / 120.0f);
+    p = p * r + vf_splat(1.0f / 24.0f);
+    p = p * r + vf_splat(1.0f / 6.0f);
+    p = p * r + vf_splat(0.5f);
+    p = p * r + vf_splat(1.0f);
+    p = p * r + vf_splat(1.0f);
+    vi e = __builtin_convertvector(n, vi) << 23;
+    return (vf)((vi)p + e);
+}
+
+static inline vf load_feature(const int8_t *p)
+{
+    vb b;
+    memcpy(&b, p, sizeof(b));
+    return __builtin_convertvector(b, vf);
+}
+
+static inline vf load_label(const uint8_t *p)
+{
+    vb b;
+    memcpy(&b, p, sizeof(b));
+    return __builtin_convertvector(b, vf) * vf_splat(0.5f);
+}
+
+static inline float vf_sum(vf v)
+{
+    float s = 0.0f;
+    for (int i = 0; i < TUNE_LANES; i++)
+        s += v[i];
+    return s;
+}
+
+/* [lo, hi) の誤差の合計と、勾配 (の定数倍を除いた部分) の合計 */
+static void eval_range(Worker *w)
+{
+    vf wv[EVAL_FEATURES];
+    for (int j = 0; j < EVAL_FEATURES; j++)
+        wv[j] = vf_splat(job_w[j]);
+    const vf neg_k = vf_splat(-job_k);
+    const vf one = vf_splat(1.0f);
+    double loss = 0.0, grad[EVAL_FEATURES] = {0};
+
+    for (size_t base = w->lo; base < w->hi; base += TUNE_BLOCK)
+    {
+        size_t end = base + TUNE_BLOCK < w->hi ? base + TUNE_BLOCK : w->hi;
+        vf acc_loss = vf_splat(0.0f);
+        vf acc_grad[EVAL_FEATURES];
+        for (int j = 0; j < EVAL_FEATURES; j++)
+            acc_grad[j] = vf_splat(0.0f);
+
+        for (size_t i = base; i < end; i += TUNE_LANES)
+        {
+            vf f[EVAL_FEATURES];
+            vf e = vf_splat(0.0f);
+            for (int j = 0; j < EVAL_FEATURES; j++)
+            {
+                f[j] = load_feature(data.feat[j] + i);
+                e += wv[j] * f[j];
+            }
+            vf s = one / (one + vf_exp(neg_k * e)); /* 予想勝率 */
+            vf diff = s - load_label(data.label + i);
+            acc_loss += diff * diff;
+            if (job_grad)
+            {
+                vf d = diff * s * (one - s);
+                for (int j = 0; j < EVAL_FEATURES; j++)
+                    acc_grad[j] += d * f[j];
+            }
+        }
+        loss += vf_sum(acc_loss);
+        for (int j = 0; j < EVAL_FEATURES; j++)
+            grad[j] += vf_sum(acc_grad[j]);
+    }
+    w->loss = loss;
+    for (int j = 0; j < EVAL_FEATURES; j++)
+        w->grad[j] = grad[j];
+}
+
+static void *worker_main(void *arg)
+{
+    Worker *w = arg;
+    for (;;)
+    {
+        pthread_barrier_wait(&start_barrier);
+        if (job_quit)
+            return NULL;
+        eval_range(w);
+        pthread_barrier_wait(&done_barrier);
+    }
+}
+
+/* 全スレッドで平均二乗誤差 (grad があれば重みでの偏微分も) を求める。メインスレッドは workers[0] を受け持つ */
+static double run_job(const double *w, double k, double *grad)
+{
+    for (int j = 0; j < EVAL_FEATURES; j++)
+        job_w[j] = (float)w[j];
+    job_k = (float)k;
+    job_grad = grad != NULL;
+    pthread_barrier_wait(&start_barrier);
+    eval_range(&workers[0]);
+    pthread_barrier_wait(&done_barrier);
+
+    double loss = 0.0;
+    double g[EVAL_FEATURES] = {0};
+    for (int t = 0; t < nthreads; t++)
+    {
+        loss += workers[t].loss;
+        for (int j = 0; j < EVAL_FEATURES; j++)
+            g[j] += workers[t].grad[j];
+    }
+    /* d/dw (s - r)^2 = 2 (s - r) s (1 - s) K f */
+    if (grad)
+    {
+        for (int j = 0; j < EVAL_FEATURES; j++)
+            grad[j] = 2.0 * k * g[j] / (double)data.n;
+    }
+    return loss / (double)data.n;
+}
+
+/* 既定の重みで誤差が最小になる K (評価値 -> 勝率の尺度) を黄金分割で探す */
+static double fit_k(const double *w)
+{
+    double lo = 1e-4, hi = 1.0;
+    const double gr = 0.6180339887498949;
+    double a = hi - gr * (hi - lo), b = lo + gr * (hi - lo);
+    double fa = run_job(w, a, NULL), fb = run_job(w, b, NULL);
+    for (int i = 0; i < 40; i++)
+    {
+        if (fa < fb)
+        {
+            hi = b;
+            b = a;
+            fb = fa;
+            a = hi - gr * (hi - lo);
+            fa = run_job(w, a, NULL);
+        }
+        else
+        {
+            lo = a;
+            a = b;
+            fa = fb;
+            b = lo + gr * (hi - lo);
+            fb = run_job(w, b, NULL);
+        }
+    }
+    return (lo + hi) / 2.0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [--out=PATH] [--weights=PATH] [--threads=N] [--iters=N] [--lr=X] [--min-ply=N] [--k=X]\n"
+            "          <journal | -> ...\n",
+            prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *out_path = "contrast.weights";
+    const char *init_path = NULL;
+    int npaths = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--out=", 6) == 0)
+            out_path = argv[i] + 6;
+        else if (strncmp(argv[i], "--weights=", 10) == 0)
+            init_path = argv[i] + 10;
+        else if (strncmp(argv[i], "--threads=", 10) == 0)
+            nthreads = atoi(argv[i] + 10);
+        else if (strncmp(argv[i], "--iters=", 8) == 0)
+            iterations = atoi(argv[i] + 8);
+        else if (strncmp(argv[i], "--lr=", 5) == 0)
+            learning_rate = atof(argv[i] + 5);
+        else if (strncmp(argv[i], "--min-ply=", 10) == 0)
+            min_ply = atoi(argv[i] + 10);
+        else if (strncmp(argv[i], "--k=", 4) == 0)
+            fixed_k = atof(argv[i] + 4);
+        else if (argv[i][0] == '-' && argv[i][1] == '-')
+            usage(argv[0]);
+        else
+            argv[++npaths] = argv[i];
+    }
+    if (npaths == 0 || iterations < 0 || learning_rate <= 0.0 || min_ply < 0 || fixed_k < 0.0)
+        usage(argv[0]);
+    if (nthreads <= 0)
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = (n > 0) ? (int)n : 1;
+    }
+
+    EvalWeights start = *eval_default_weights();
+    if (init_path && !eval_load_weights(init_path, &start))
+    {
+        fprintf(stderr, "Cannot load evaluation weights from %s.\n", init_path);
+        return 1;
+    }
+
+    uint64_t t0 = now_ns();
+    for (int i = 1; i <= npaths; i++)
+    {
+        if (read_journal(argv[i]) < 0)
+            return 1;
+    }
+    if (data.n == 0 || dataset_finish(&data) < 0)
+    {
+        fprintf(stderr, "No positions to tune on.\n");
+        return 1;
+    }
+    uint64_t t1 = now_ns();
+    fprintf(stderr, "Loaded %zu positions from %lu games in %.2f s (%lu games skipped, %lu noisy positions dropped, %.1f MB).\n",
+            data.n, games_used, (double)(t1 - t0) / 1e9, games_skipped, positions_noisy,
+            (double)data.padded * (EVAL_FEATURES + 1) / 1e6);
+
+    /* 局面を TUNE_LANES の倍数ずつスレッドに分ける */
+    workers = calloc((size_t)nthreads, sizeof(Worker));
+    size_t per = (data.padded / TUNE_LANES + (size_t)nthreads - 1) / (size_t)nthreads * TUNE_LANES;
+    for (int t = 0; t < nthreads; t++)
+    {
+        size_t lo = (size_t)t * per;
+        workers[t].lo = lo < data.padded ? lo : data.padded;
+        workers[t].hi = lo + per < data.padded ? lo + per : data.padded;
+    }
+    pthread_barrier_init(&start_barrier, NULL, (unsigned)nthreads);
+    pthread_barrier_init(&done_barrier, NULL, (unsigned)nthreads);
+    for (int t = 1; t < nthreads; t++)
+    {
+        if (pthread_create(&workers[t].tid, NULL, worker_main, &workers[t]) != 0)
+        {
+            fprintf(stderr, "Cannot start worker threads.\n");
+            return 1;
+        }
+    }
+
+    int iv[EVAL_FEATURES];
+    double w[EVAL_FEATURES];
+    eval_weights_to_array(&start, iv);
+    for (int j = 0; j < EVAL_FEATURES; j++)
+        w[j] = iv[j];
+    double k = fixed_k > 0.0 ? fixed_k : fit_k(w);
+    double loss0 = run_job(w, k, NULL);
+    fprintf(stderr, "K = %.5f, initial loss %.6f\n", k, loss0);
+
+    /* Adam */
+    double m[EVAL_FEATURES] = {0}, v[EVAL_FEATURES] = {0};
+    const double b1 = 0.9, b2 = 0.999, eps = 1e-12;
+    double b1t = 1.0, b2t = 1.0, loss = loss0;
+    uint64_t t2 = now_ns();
+    for (int it = 1; it <= iterations; it++)
+    {
+        double g[EVAL_FEATURES];
+        loss = run_job(w, k, g);
+        b1t *= b1;
+        b2t *= b2;
+        for (int j = 0; j < EVAL_FEATURES; j++)
+        {
+            m[j] = b1 * m[j] + (1.0 - b1) * g[j];
+            v[j] = b2 * v[j] + (1.0 - b2) * g[j] * g[j];
+            w[j] -= learning_rate * (m[j] / (1.0 - b1t)) / (sqrt(v[j] / (1.0 - b2t)) + eps);
+        }
+        if (it % 100 == 0 || it == iterations)
+        {
+            fprintf(stderr, "iter %5d  loss %.6f ", it, loss);
+            for (int j = 0; j < EVAL_FEATURES; j++)
+                fprintf(stderr, " %s=%.2f", eval_feature_name(j), w[j]);
+            fprintf(stderr, "\n");
+        }
+    }
+    uint64_t t3 = now_ns();
+
+    /* 重みは整数なので丸めてから測り直す */
+    double rounded[EVAL_FEATURES];
+    for (int j = 0; j < EVAL_FEATURES; j++)
+    {
+        iv[j] = (int)lround(w[j]);
+        rounded[j] = iv[j];
+    }
+    double loss_final = run_job(rounded, k, NULL);
+    job_quit = 1;
+    pthread_barrier_wait(&start_barrier);
+    for (int t = 1; t < nthreads; t++)
+        pthread_join(workers[t].tid, NULL);
+
+    EvalWeights tuned;
+    eval_weights_from_array(iv, &tuned);
+    if (!eval_save_weights(out_path, &tuned))
+    {
+        perror(out_path);
+        return 1;
+    }
+    int sv[EVAL_FEATURES];
+    eval_weights_to_array(&start, sv);
+    for (int j = 0; j < EVAL_FEATURES; j++)
+        fprintf(stderr, "  %-10s %4d -> %4d\n", eval_feature_name(j), sv[j], iv[j]);
+    double sec = (double)(t3 - t2) / 1e9;
+    fprintf(stderr,
+            "Loss %.6f -> %.6f (rounded). %d iterations in %.2f s with %d threads (%.0f M positions/s). Wrote %s\n",
+            loss0, loss_final, iterations, sec, nthreads,
+            sec > 0 ? (double)data.n * iterations / sec / 1e6 : 0.0, out_path);
+    return 0;
+}
@@ -0,0 +1,422 @@
+#define _GNU_SOURCE
+#include "../src/include/contrast_c/game_state.h"
+#include "../src/include/contrast_c/rules.h"
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/* core_c の基本関数のマイクロベンチマーク
+ * 序盤・中盤・終盤の局面集 (固定の種で作るので毎回同じ) に対して関数ごとに
+ * 1回あたりの時間を測る。ウォームアップで1計測が数 ms になる回数を決め、
+ * 計測を繰り返して中央値と MAD (中央値からの偏差の中央値) を出す。
+ * perf_event_open が使えればサイクル数・命令数・分岐予測ミス・キャッシュミスも
+ * 1回あたりで出す。結果は JSON (コミット間で diff する用)、要約は標準エラーへ。
+ * --baseline に以前の JSON を渡すと要約に比 (以前 / 今回) を並べる。 */
+
+#define CORPUS_PER_PHASE 64
+#define CORPUS_SEED 0x5eedc0de2024ULL
+#define MAX_REPS 1001
+#define TARGET_REP_NS 2000000ULL /* 1計測の目安 (2ms) */
+
+/* 局面の区分 (手数で分ける) */
+enum { PHASE_OPENING, PHASE_MIDDLE, PHASE_LATE, PHASE_COUNT };
+static const char* PHASE_NAMES[PHASE_COUNT] = {"opening", "middlegame", "late"};
+static const uint32_t PHASE_MIN_PLY[PHASE_COUNT] = {0, 8, 24};
+
+typedef struct {
+    GameState pos[CORPUS_PER_PHASE];
+    Move move[CORPUS_PER_PHASE]; /* game_state_apply_move 用 (局面ごとに1つの合法手) */
+    int n;
+} Corpus;
+
+static Corpus corpus[PHASE_COUNT];
+
+/* 最適化で呼び出しや結果が消えないようにする */
+static volatile uint64_t sink;
+#define KEEP(p) __asm__ volatile("" : : "g"(p) : "memory")
+
+static uint64_t rng_state = CORPUS_SEED;
+
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ULL;
+}
+
+static int phase_of(uint32_t ply) {
+    for (int p = PHASE_COUNT - 1; p > 0; p--) {
+        if (ply >= PHASE_MIN_PLY[p]) return p;
+    }
+    return PHASE_OPENING;
+}
+
+/* ランダムな合法手で対局を進め、区分ごとに局面を集める。
+ * タイル配置の手は 1/4 に絞る (すべて均等に選ぶとタイルを使い切って単調になる) */
+static void build_corpus(void) {
+    static MoveList moves;
+    for (int game = 0; game < 100000; game++) {
+        int full = 1;
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            if (corpus[p].n < CORPUS_PER_PHASE) full = 0;
+        }
+        if (full) return;
+
+        GameState s;
+        game_state_reset(&s);
+        for (;;) {
+            rules_legal_moves(&s, &moves);
+            if (moves.size == 0) break;
+            size_t base = 0;
+            while (base < moves.size && !moves.moves[base].place_tile) base++;
+            size_t pick;
+            if (base > 0 && (base == moves.size || rng_next() % 4 != 0)) {
+                pick = rng_next() % base;
+            } else {
+                pick = rng_next() % moves.size;
+            }
+
+            /* 同じ対局から取りすぎないよう 1/3 だけ採る */
+            Corpus* c = &corpus[phase_of(s.ply)];
+            if (c->n < CORPUS_PER_PHASE && rng_next() % 3 == 0) {
+                c->pos[c->n] = s;
+                c->move[c->n] = moves.moves[pick];
+                c->n++;
+            }
+
+            Player mover = s.to_move;
+            game_state_apply_move(&s, &moves.moves[pick]);
+            if (rules_is_win(&s, mover)) break;
+        }
+    }
+}
+
+/* 測る関数 (局面集を inner 周して呼んだ回数を返す) */
+typedef uint64_t (*BenchFn)(const Corpus* c, int inner);
+
+static uint64_t bench_legal_moves(const Corpus* c, int inner) {
+    static MoveList out;
+    for (int k = 0; k < inner; k++) {
+        for (int i = 0; i < c->n; i++) {
+            rules_legal_moves(&c->pos[i], &out);
+            KEEP(&out);
+        }
+    }
+    return (uint64_t)inner * (uint64_t)c->n;
+}
+
+/* 局面のコピーも含む (差し引く目安として state_copy も測る) */
+static uint64_t bench_apply_move(const Corpus* c, int inner) {
+    for (int k = 0; k < inner; k++) {
+        for (int i = 0; i < c->n; i++) {
+            GameState s = c->pos[i];
+            game_state_apply_move(&s, &c->move[i]);
+            KEEP(&s);
+        }
+    }
+    return (uint64_t)inner * (uint64_t)c->n;
+}
+
+static uint64_t bench_state_copy(const Corpus* c, int inner) {
+    for (int k = 0; k < inner; k++) {
+        for (int i = 0; i < c->n; i++) {
+            GameState s = c->pos[i];
+            KEEP(&s);
+        }
+    }
+    return (uint64_t)inner * (uint64_t)c->n;
+}
+
+static uint64_t bench_compute_hash(const Corpus* c, int inner) {
+    uint64_t h = 0;
+    for (int k = 0; k < inner; k++) {
+        for (int i = 0; i < c->n; i++) {
+            h += game_state_compute_hash(&c->pos[i]);
+        }
+    }
+    sink = h;
+    return (uint64_t)inner * (uint64_t)c->n;
+}
+
+/* 直前に指した側が勝ったか (対局中に毎手行う判定) */
+static uint64_t bench_is_win(const Corpus* c, int inner) {
+    int w = 0;
+    for (int k = 0; k < inner; k++) {
+        for (int i = 0; i < c->n; i++) {
+            const GameState* s = &c->pos[i];
+            w += rules_is_win(s, s->to_move == PLAYER_BLACK ? PLAYER_WHITE : PLAYER_BLACK);
+        }
+    }
+    sink = (uint64_t)w;
+    return (uint64_t)inner * (uint64_t)c->n;
+}
+
+static uint64_t bench_is_loss(const Corpus* c, int inner) {
+    int l = 0;
+    for (int k = 0; k < inner; k++) {
+        for (int i = 0; i < c->n; i++) {
+            l += rules_is_loss(&c->pos[i], c->pos[i].to_move);
+        }
+    }
+    sink = (uint64_t)l;
+    return (uint64_t)inner * (uint64_t)c->n;
+}
+
+typedef struct {
+    const char* name;
+    BenchFn fn;
+} Bench;
+
+static const Bench BENCHES[] = {
+    {"rules_legal_moves", bench_legal_moves},
+    {"game_state_apply_move", bench_apply_move},
+    {"game_state_compute_hash", bench_compute_hash},
+    {"rules_is_win", bench_is_win},
+    {"rules_is_loss", bench_is_loss},
+    {"state_copy", bench_state_copy},
+};
+#define BENCH_COUNT (sizeof(BENCHES) / sizeof(BENCHES[0]))
+
+/* ハードウェアカウンタ (グループで開いて1回の read でまとめて読む) */
+enum { CTR_CYCLES, CTR_INSTRUCTIONS, CTR_BRANCH_MISSES, CTR_CACHE_MISSES, CTR_COUNT };
+static const char* CTR_NAMES[CTR_COUNT] = {"cycles", "instructions", "branch_misses", "cache_misses"};
+static const uint64_t CTR_CONFIG[CTR_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES,
+};
+
+static int perf_fd[CTR_COUNT] = {-1, -1, -1, -1};
+static int perf_ok = 0;
+static char perf_error[128] = "";
+
+static void perf_open(void) {
+    for (int i = 0; i < CTR_COUNT; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = CTR_CONFIG[i];
+        attr.disabled = (i == 0);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        perf_fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, (i == 0) ? -1 : perf_fd[0], 0);
+        if (perf_fd[i] < 0) {
+            snprintf(perf_error, sizeof(perf_error), "%s: %s", CTR_NAMES[i], strerror(errno));
+            for (int j = 0; j < i; j++) close(perf_fd[j]);
+            return;
+        }
+    }
+    perf_ok = 1;
+}
+
+static void perf_begin(void) {
+    if (!perf_ok) return;
+    ioctl(perf_fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(perf_fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+static void perf_end(uint64_t* out) {
+    if (!perf_ok) return;
+    ioctl(perf_fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    uint64_t buf[1 + CTR_COUNT];
+    if (read(perf_fd[0], buf, sizeof(buf)) != (ssize_t)sizeof(buf)) {
+        memset(out, 0, sizeof(uint64_t) * CTR_COUNT);
+        return;
+    }
+    memcpy(out, buf + 1, sizeof(uint64_t) * CTR_COUNT);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* 中央値と MAD (並べ替えるので v は壊れる) */
+static double median(double* v, int n) {
+    qsort(v, (size_t)n, sizeof(double), cmp_double);
+    return (n % 2) ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2.0;
+}
+
+static double mad(const double* v, int n, double med) {
+    double dev[MAX_REPS];
+    for (int i = 0; i < n; i++) dev[i] = (v[i] > med) ? v[i] - med : med - v[i];
+    return median(dev, n);
+}
+
+typedef struct {
+    double median_ns;
+    double mad_ns;
+    double counters[CTR_COUNT]; /* 1回あたりの中央値 */
+    uint64_t calls_per_rep;
+} BenchResult;
+
+static void run_bench(const Bench* b, const Corpus* c, int reps, int warmup, BenchResult* r) {
+    /* 1計測が TARGET_REP_NS 程度になる周回数を決める (これもウォームアップを兼ねる) */
+    int inner = 1;
+    for (;;) {
+        uint64_t t0 = now_ns();
+        b->fn(c, inner);
+        uint64_t dt = now_ns() - t0;
+        if (dt >= TARGET_REP_NS / 4 || inner >= (1 << 24)) {
+            if (dt > 0 && dt < TARGET_REP_NS) {
+                uint64_t scaled = (uint64_t)inner * TARGET_REP_NS / dt;
+                inner = (scaled > (1 << 24)) ? (1 << 24) : (int)scaled;
+            }
+            break;
+        }
+        inner *= 2;
+    }
+    for (int i = 0; i < warmup; i++) b->fn(c, inner);
+
+    static double ns[MAX_REPS];
+    static double ctr[CTR_COUNT][MAX_REPS];
+    uint64_t calls = 0;
+    for (int i = 0; i < reps; i++) {
+        uint64_t v[CTR_COUNT];
+        perf_begin();
+        uint64_t t0 = now_ns();
+        calls = b->fn(c, inner);
+        uint64_t dt = now_ns() - t0;
+        perf_end(v);
+        ns[i] = (double)dt / (double)calls;
+        for (int k = 0; k < CTR_COUNT && perf_ok; k++) ctr[k][i] = (double)v[k] / (double)calls;
+    }
+    r->median_ns = median(ns, reps);
+    r->mad_ns = mad(ns, reps, r->median_ns);
+    r->calls_per_rep = calls;
+    for (int k = 0; k < CTR_COUNT; k++) r->counters[k] = perf_ok ? median(ctr[k], reps) : 0.0;
+}
+
+/* 以前の結果 (このプログラムが書いた JSON、1結果1行) */
+#define BASELINE_MAX 64
+typedef struct {
+    char function[64];
+    char phase[16];
+    double median_ns;
+} BaselineEntry;
+
+static BaselineEntry baseline[BASELINE_MAX];
+static int baseline_count = 0;
+
+static int load_baseline(const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), fp) && baseline_count < BASELINE_MAX) {
+        BaselineEntry* e = &baseline[baseline_count];
+        if (sscanf(line, " {\"function\": \"%63[^\"]\", \"phase\": \"%15[^\"]\", \"median_ns\": %lf",
+                   e->function, e->phase, &e->median_ns) == 3) {
+            baseline_count++;
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+static double baseline_ns(const char* function, const char* phase) {
+    for (int i = 0; i < baseline_count; i++) {
+        if (strcmp(baseline[i].function, function) == 0 && strcmp(baseline[i].phase, phase) == 0) {
+            return baseline[i].median_ns;
+        }
+    }
+    return 0.0;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [--reps=N] [--warmup=N] [--filter=NAME] [--label=TEXT] [--out=PATH]\n"
+            "       [--baseline=PATH]\n",
+            prog);
+    exit(1);
+}
+
+int main(int argc, char* argv[]) {
+    int reps = 21;
+    int warmup = 3;
+    const char* filter = NULL;
+    const char* label = "";
+    const char* out_path = NULL;
+    const char* baseline_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--reps=", 7) == 0) reps = atoi(argv[i] + 7);
+        else if (strncmp(argv[i], "--warmup=", 9) == 0) warmup = atoi(argv[i] + 9);
+        else if (strncmp(argv[i], "--filter=", 9) == 0) filter = argv[i] + 9;
+        else if (strncmp(argv[i], "--label=", 8) == 0) label = argv[i] + 8;
+        else if (strncmp(argv[i], "--out=", 6) == 0) out_path = argv[i] + 6;
+        else if (strncmp(argv[i], "--baseline=", 11) == 0) baseline_path = argv[i] + 11;
+        else usage(argv[0]);
+    }
+    if (reps < 1 || reps > MAX_REPS || warmup < 0) usage(argv[0]);
+
+    if (baseline_path && load_baseline(baseline_path) < 0) return 1;
+
+    FILE* out = stdout;
+    if (out_path && !(out = fopen(out_path, "w"))) {
+        perror(out_path);
+        return 1;
+    }
+
+    build_corpus();
+    perf_open();
+    if (!perf_ok) fprintf(stderr, "perf_event_open unavailable (%s); timing only\n", perf_error);
+
+    fprintf(out, "{\n  \"label\": \"%s\",\n  \"reps\": %d,\n  \"warmup\": %d,\n", label, reps, warmup);
+    fprintf(out, "  \"corpus\": {");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        fprintf(out, "%s\"%s\": %d", p ? ", " : "", PHASE_NAMES[p], corpus[p].n);
+    }
+    fprintf(out, "},\n  \"counters\": %s,\n  \"results\": [", perf_ok ? "true" : "false");
+
+    fprintf(stderr, "%-24s %-11s %10s %8s", "function", "phase", "median_ns", "mad_ns");
+    if (perf_ok) fprintf(stderr, " %9s %9s %8s %8s", "cycles", "instr", "br_miss", "c_miss");
+    if (baseline_count) fprintf(stderr, " %10s %7s", "before_ns", "speedup");
+    fprintf(stderr, "\n");
+
+    int first = 1;
+    for (size_t b = 0; b < BENCH_COUNT; b++) {
+        if (filter && !strstr(BENCHES[b].name, filter)) continue;
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            if (corpus[p].n == 0) continue;
+            BenchResult r;
+            run_bench(&BENCHES[b], &corpus[p], reps, warmup, &r);
+
+            fprintf(out, "%s\n    {\"function\": \"%s\", \"phase\": \"%s\", \"median_ns\": %.3f, \"mad_ns\": %.3f, "
+                         "\"calls_per_rep\": %llu",
+                    first ? "" : ",", BENCHES[b].name, PHASE_NAMES[p], r.median_ns, r.mad_ns,
+                    (unsigned long long)r.calls_per_rep);
+            for (int k = 0; k < CTR_COUNT && perf_ok; k++) {
+                fprintf(out, ", \"%s\": %.3f", CTR_NAMES[k], r.counters[k]);
+            }
+            fprintf(out, "}");
+            first = 0;
+
+            fprintf(stderr, "%-24s %-11s %10.2f %8.2f", BENCHES[b].name, PHASE_NAMES[p], r.median_ns, r.mad_ns);
+            if (perf_ok) {
+                fprintf(stderr, " %9.1f %9.1f %8.2f %8.2f", r.counters[CTR_CYCLES], r.counters[CTR_INSTRUCTIONS],
+                        r.counters[CTR_BRANCH_MISSES], r.counters[CTR_CACHE_MISSES]);
+            }
+            double before = baseline_ns(BENCHES[b].name, PHASE_NAMES[p]);
+            if (before > 0.0) fprintf(stderr, " %10.2f %6.2fx", before, before / r.median_ns);
+            fprintf(stderr, "\n");
+        }
+    }
+    fprintf(out, "\n  ]\n}\n");
+    if (out != stdout) fclose(out);
+    return 0;
+}
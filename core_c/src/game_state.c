@@ -8,6 +8,7 @@ void game_state_reset(GameState* state) {
     state->inv_black.gray = 1;
     state->inv_white.black = 3;
     state->inv_white.gray = 1;
+    state->ply = 0;
 }
 
 Player game_state_current_player(const GameState* state) {
@@ -59,6 +60,7 @@ void game_state_apply_move(GameState* state, const Move* move) {
     
     /* 手番交代 */
     state->to_move = (state->to_move == PLAYER_BLACK) ? PLAYER_WHITE : PLAYER_BLACK;
+    state->ply++;
 }
 
 uint64_t game_state_compute_hash(const GameState* state) {
@@ -77,3 +79,57 @@ uint64_t game_state_compute_hash(const GameState* state) {
     
     return seed;
 }
+
+void game_state_pack(const GameState* state, uint8_t* out) {
+    memset(out, 0, GAME_STATE_PACKED_SIZE);
+
+    /* 1セル 4bit (occupant 2bit + tile 2bit)、2セルで1バイト */
+    for (int i = 0; i < BOARD_CELLS; i++) {
+        const Cell* c = &state->board.cells[i];
+        uint8_t nib = (uint8_t)((c->occupant & 3) | ((c->tile & 3) << 2));
+        out[i / 2] |= (uint8_t)(nib << ((i % 2) * 4));
+    }
+    out[13] = (uint8_t)state->to_move;
+    out[14] = (uint8_t)((state->inv_black.black << 4) | (state->inv_black.gray & 0x0F));
+    out[15] = (uint8_t)((state->inv_white.black << 4) | (state->inv_white.gray & 0x0F));
+}
+
+int game_state_unpack(const uint8_t* in, GameState* state) {
+    GameState s;
+
+    for (int i = 0; i < BOARD_CELLS; i++) {
+        uint8_t nib = (uint8_t)((in[i / 2] >> ((i % 2) * 4)) & 0x0F);
+        int occ = nib & 3;
+        int tile = (nib >> 2) & 3;
+        if (occ > PLAYER_WHITE || tile > TILE_GRAY) return 0;
+        s.board.cells[i].occupant = (Player)occ;
+        s.board.cells[i].tile = (TileType)tile;
+    }
+    if (in[13] != PLAYER_BLACK && in[13] != PLAYER_WHITE) return 0;
+    s.to_move = (Player)in[13];
+    s.inv_black.black = in[14] >> 4;
+    s.inv_black.gray = in[14] & 0x0F;
+    s.inv_white.black = in[15] >> 4;
+    s.inv_white.gray = in[15] & 0x0F;
+    s.ply = 0;
+
+    *state = s;
+    return 1;
+}
+
+uint64_t game_state_sync_hash(const GameState* state) {
+    uint8_t packed[GAME_STATE_PACKED_SIZE];
+    game_state_pack(state, packed);
+
+    /* パック済みの 16 バイトと手数を FNV-1a で混ぜる */
+    uint64_t h = 1469598103934665603ULL;
+    for (int i = 0; i < GAME_STATE_PACKED_SIZE; i++) {
+        h ^= packed[i];
+        h *= 1099511628211ULL;
+    }
+    for (int i = 0; i < 4; i++) {
+        h ^= (state->ply >> (i * 8)) & 0xFF;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
@@ -19,16 +19,16 @@ typedef struct {
 } Board;
 
 /* 盤面初期化 */
-void board_reset(Board* board);
+CONTRAST_API void board_reset(Board* board);
 
 /* 座標が範囲内か */
-int board_in_bounds(int x, int y);
+CONTRAST_API int board_in_bounds(int x, int y);
 
 /* セル取得 */
-Cell* board_at(Board* board, int x, int y);
+CONTRAST_API Cell* board_at(Board* board, int x, int y);
 
 /* セル取得（const版） */
-const Cell* board_at_const(const Board* board, int x, int y);
+CONTRAST_API const Cell* board_at_const(const Board* board, int x, int y);
 
 #ifdef __cplusplus
 }
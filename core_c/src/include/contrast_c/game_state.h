@@ -21,28 +21,41 @@ typedef struct {
     Player to_move;
     TileInventory inv_black;
     TileInventory inv_white;
+    uint32_t ply;   /* 適用済みの手数 (game_state_apply_move だけが進める) */
     /* 履歴用のハッシュテーブルは簡易版では省略 */
 } GameState;
 
 /* ゲーム状態初期化 */
-void game_state_reset(GameState* state);
+CONTRAST_API void game_state_reset(GameState* state);
 
 /* 現在のプレイヤー取得 */
-Player game_state_current_player(const GameState* state);
+CONTRAST_API Player game_state_current_player(const GameState* state);
 
 /* 盤面取得 */
-Board* game_state_board(GameState* state);
-const Board* game_state_board_const(const GameState* state);
+CONTRAST_API Board* game_state_board(GameState* state);
+CONTRAST_API const Board* game_state_board_const(const GameState* state);
 
 /* 在庫取得 */
-TileInventory* game_state_inventory(GameState* state, Player player);
-const TileInventory* game_state_inventory_const(const GameState* state, Player player);
+CONTRAST_API TileInventory* game_state_inventory(GameState* state, Player player);
+CONTRAST_API const TileInventory* game_state_inventory_const(const GameState* state, Player player);
 
 /* 指し手適用 */
-void game_state_apply_move(GameState* state, const Move* move);
+CONTRAST_API void game_state_apply_move(GameState* state, const Move* move);
 
 /* ハッシュ計算（簡易版） */
-uint64_t game_state_compute_hash(const GameState* state);
+CONTRAST_API uint64_t game_state_compute_hash(const GameState* state);
+
+/* パック済みゲーム状態のバイト数: セル 4bit x 25 + 手番 1 + 在庫 2 */
+#define GAME_STATE_PACKED_SIZE 16
+
+/* ゲーム状態をパック（観戦/同期用のスナップショット） */
+CONTRAST_API void game_state_pack(const GameState* state, uint8_t* out);
+
+/* パック済みゲーム状態を展開（不正な値なら 0、手数は 0 になる） */
+CONTRAST_API int game_state_unpack(const uint8_t* in, GameState* state);
+
+/* 同期確認用のハッシュ（盤面・手番・在庫・手数。サーバーとクライアントで同じ値になる） */
+CONTRAST_API uint64_t game_state_sync_hash(const GameState* state);
 
 #ifdef __cplusplus
 }
@@ -26,10 +26,28 @@ typedef struct {
 } MoveList;
 
 /* MoveList 初期化 */
-void move_list_clear(MoveList* list);
+CONTRAST_API void move_list_clear(MoveList* list);
 
 /* MoveList に追加 */
-void move_list_push(MoveList* list, const Move* move);
+CONTRAST_API void move_list_push(MoveList* list, const Move* move);
+
+/* パック済み指し手のバイト数 (通信・記録用) */
+#define MOVE_PACKED_SIZE 3
+
+/* 指し手を 21bit にパック: sx,sy,dx,dy,tx,ty 各3bit + 配置フラグ1bit + タイル2bit */
+CONTRAST_API uint32_t move_pack(const Move* move);
+
+/* パック済み指し手を展開（タイルなしなら tx,ty = -1） */
+CONTRAST_API void move_unpack(uint32_t packed, Move* move);
+
+/* 棋譜表記 "a1,a2" / "a1,a2 b1g" を解析（成功で 1） */
+CONTRAST_API int move_parse(const char* text, Move* out);
+
+/* 一辺 size の盤の棋譜表記を解析 (大きい盤の変種では a1 〜 g7 まで) */
+CONTRAST_API int move_parse_size(const char* text, int size, Move* out);
+
+/* 棋譜表記に変換（buf は 16 バイト以上） */
+CONTRAST_API void move_format(const Move* move, char* buf, size_t size);
 
 #ifdef __cplusplus
 }
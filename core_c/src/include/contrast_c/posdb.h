@@ -0,0 +1,102 @@
+#ifndef CONTRAST_C_POSDB_H
+#define CONTRAST_C_POSDB_H
+
+#include "game_state.h"
+#include "move.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 局面統計データベース
+ *  過去の対局に現れた局面ごとに、出現数・手番側の勝ち負けの数と、そこで指された手の
+ *  頻度を持つ読み取り専用のファイル。局面は正規化したハッシュ (posdb_canonical_key) を
+ *  鍵にして昇順に並べ、mmap したまま引く。作るのは client/posdb (外部マージソート)。
+ *
+ *  正規化: 盤面は左右反転と「上下反転 + 黒白の入れ替え」で同じ局面になるので、
+ *  手番が黒になる向きに揃え、左右はハッシュの小さい方を選ぶ。勝ち負けは手番側から数えるので
+ *  向きを変えても変わらない。指し手は正規化した向きで記録する (posdb_result_move で戻す)。
+ *
+ *  ファイル: [PosDbHeader][uint64_t 鍵 x entries][PosDbEntry x entries][PosDbMove x moves]
+ *            [uint32_t 索引 x (2^index_bits + 1)]
+ *  数値はホストのバイト順 (byte_order で確かめる)。鍵は統計と別の配列にして、探索で触る
+ *  キャッシュラインを減らす。索引は鍵の上位 index_bits ビットごとの先頭位置 (疎な索引) で、
+ *  鍵はハッシュなので各区間にはほぼ均等に POSDB_BUCKET_TARGET 件前後が入る。
+ *  引くときは索引で区間を決め、その中の鍵を二分探索する。
+ */
+
+#define POSDB_MAGIC "CTPD"
+#define POSDB_VERSION 1
+#define POSDB_BYTE_ORDER 0x01020304u
+#define POSDB_BUCKET_TARGET 32 /* 索引の1区間あたりの局面数の目安 */
+#define POSDB_INDEX_BITS_MAX 30
+
+/* 対称変換 (posdb_canonical_key が返す sym のビット) */
+#define POSDB_SYM_MIRROR 1  /* 左右反転 */
+#define POSDB_SYM_SWAP 2    /* 上下反転 + 黒白の入れ替え */
+#define POSDB_SYM_SELF 4    /* 左右対称な局面 (変換ではない印。作る側は指し手も左右の小さい方に揃える) */
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t index_bits;
+    uint64_t entries;      /* 局面数 */
+    uint64_t moves;        /* 指し手の総数 */
+    uint64_t games;        /* 元にした対局数 */
+    uint64_t key_off;      /* 各表のファイル先頭からの位置 */
+    uint64_t entry_off;
+    uint64_t move_off;
+    uint64_t index_off;
+} PosDbHeader;
+
+typedef struct {
+    uint32_t games;        /* この局面が現れた回数 */
+    uint32_t wins;         /* そのうち手番側が勝った数 */
+    uint32_t losses;       /* 負けた数 (残りは勝敗なし) */
+    uint32_t move_first;   /* 指し手の表での先頭 (件数は次の局面の move_first との差) */
+} PosDbEntry;
+
+typedef struct {
+    uint32_t move;         /* パック済みの指し手 (正規化した向き) */
+    uint32_t count;        /* 指された回数 (多い順に並ぶ) */
+    uint32_t wins;         /* そのうち指した側が勝った数 */
+} PosDbMove;
+
+typedef struct PosDb PosDb;
+
+/* 検索結果 (指すのは mmap した領域なので posdb_close まで有効) */
+typedef struct {
+    const PosDbEntry* entry;
+    const PosDbMove* moves;
+    uint32_t nmoves;
+    int sym;               /* 引いた局面を正規化した変換 */
+} PosDbResult;
+
+/* 局面の正規化した鍵 (盤面・手番・在庫。手数は含めない)。sym に使った変換を返す (NULL 可) */
+CONTRAST_API uint64_t posdb_canonical_key(const GameState* state, int* sym);
+
+/* 指し手に対称変換をかける (変換は自分自身が逆なので、戻すときも同じ sym を渡す) */
+CONTRAST_API void posdb_transform_move(const Move* in, int sym, Move* out);
+
+/* ファイルを開いて mmap する (形式が違えば NULL) */
+CONTRAST_API PosDb* posdb_open(const char* path);
+CONTRAST_API void posdb_close(PosDb* db);
+CONTRAST_API const PosDbHeader* posdb_header(const PosDb* db);
+
+/* 鍵で引く (なければ NULL)。読むだけなので複数スレッドから同時に呼んでよい */
+CONTRAST_API const PosDbEntry* posdb_find(const PosDb* db, uint64_t key);
+
+/* 局面で引く (見つかれば 1) */
+CONTRAST_API int posdb_lookup(const PosDb* db, const GameState* state, PosDbResult* out);
+
+/* 結果の i 番目の指し手を、引いた局面の向きに戻して返す */
+CONTRAST_API void posdb_result_move(const PosDbResult* result, uint32_t i, Move* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONTRAST_C_POSDB_H */
@@ -9,13 +9,36 @@ extern "C" {
 #endif
 
 /* 合法手生成 */
-void rules_legal_moves(const GameState* state, MoveList* out);
+CONTRAST_API void rules_legal_moves(const GameState* state, MoveList* out);
+
+/* タイル配置を含まない基本移動のみ生成（探索の内部ノード用） */
+CONTRAST_API void rules_base_moves(const GameState* state, MoveList* out);
+
+/* 合法手集合のコンパクト表現
+ * 合法手 = 基本移動 x (タイルなし | 置けるマス x 在庫のある色) なので、
+ * 基本移動を (移動元, 移動先) のビット集合で、タイル配置をマスのビットマスクで持つ。 */
+typedef struct {
+    uint64_t base[(BOARD_CELLS * BOARD_CELLS + 63) / 64]; /* bit = from * BOARD_CELLS + to */
+    uint32_t place_mask;  /* タイルを置けるマス (bit = y * BOARD_W + x) */
+    uint16_t base_count;  /* 基本移動の数 */
+    uint8_t place_black;  /* 黒タイルの在庫あり */
+    uint8_t place_gray;   /* 灰タイルの在庫あり */
+} LegalSet;
+
+/* 手番側の合法手集合を作る */
+CONTRAST_API void rules_legal_set(const GameState* state, LegalSet* out);
+
+/* 合法手集合に含まれるか (O(1)) */
+CONTRAST_API int legal_set_contains(const LegalSet* set, const Move* move);
+
+/* 合法手の総数 (rules_legal_moves の要素数と一致) */
+CONTRAST_API size_t legal_set_size(const LegalSet* set);
 
 /* 勝利判定 */
-int rules_is_win(const GameState* state, Player player);
+CONTRAST_API int rules_is_win(const GameState* state, Player player);
 
 /* 敗北判定（合法手なし） */
-int rules_is_loss(const GameState* state, Player player);
+CONTRAST_API int rules_is_loss(const GameState* state, Player player);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,90 @@
+#ifndef CONTRAST_C_SEARCH_H
+#define CONTRAST_C_SEARCH_H
+
+#include "game_state.h"
+#include "move.h"
+#include <stdatomic.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 評価値 */
+#define SCORE_INF 1000000
+#define SCORE_WIN 100000
+
+/* 評価の特徴量の数 (並びは EvalWeights のメンバーと同じ) */
+#define EVAL_FEATURES 6
+
+/* 評価関数の重み（手番側から見た差分に掛ける） */
+typedef struct {
+    int advance;      /* 駒の前進量の合計 */
+    int lead;         /* 最も進んだ駒の前進量 */
+    int inv_black;    /* 黒タイル在庫 */
+    int inv_gray;     /* 灰タイル在庫 */
+    int on_black;     /* 黒タイル上の駒 */
+    int on_gray;      /* 灰タイル上の駒 */
+} EvalWeights;
+
+/* 置換表
+ * 複数のスレッドの探索で同時に共有してよい (ロックなし。書き込みが混ざった
+ * エントリは読み捨てるので結果は正しいまま)。tt_clear / tt_destroy は使用中に呼ばない。 */
+typedef struct TransTable TransTable;
+
+/* 探索条件 */
+typedef struct {
+    int max_depth;              /* 最大深さ */
+    int time_ms;                /* 思考時間 (ms)、0 で無制限 */
+    const EvalWeights* weights; /* NULL なら既定値 */
+    TransTable* tt;             /* NULL なら探索ごとに一時確保 */
+    const atomic_int* stop;     /* 非 0 になったら打ち切る (NULL 可) */
+    const struct SearchResult* resume; /* 同じ局面を前に読んだ結果 (NULL 可)。その次の深さから読む */
+} SearchLimits;
+
+/* 探索結果 */
+typedef struct SearchResult {
+    Move best_move;
+    int has_move;    /* 合法手がなければ 0 */
+    int score;       /* 手番側から見た評価値 */
+    int depth;       /* 完了した深さ */
+    uint64_t nodes;
+} SearchResult;
+
+/* 既定の評価重み */
+CONTRAST_API const EvalWeights* eval_default_weights(void);
+
+/* 静的評価（手番側から見た値） */
+CONTRAST_API int eval_position(const GameState* state, const EvalWeights* weights);
+
+/* 静的評価の特徴量（手番側 - 相手側）。eval_position はこれと重みの内積 */
+CONTRAST_API void eval_features(const GameState* state, int out[EVAL_FEATURES]);
+
+/* 特徴量の名前 (重みファイルの項目名)。範囲外なら NULL */
+CONTRAST_API const char* eval_feature_name(int i);
+
+/* 重みと配列 (特徴量の並び) の変換 */
+CONTRAST_API void eval_weights_to_array(const EvalWeights* w, int out[EVAL_FEATURES]);
+CONTRAST_API void eval_weights_from_array(const int in[EVAL_FEATURES], EvalWeights* w);
+
+/* 重みファイル ("名前 値" の行、# で始まる行は注釈) を読む。
+ * 書いていない項目は既定値のまま。開けない・知らない項目があれば 0 で out は変えない */
+CONTRAST_API int eval_load_weights(const char* path, EvalWeights* out);
+
+/* 重みファイルを書く (成功で 1) */
+CONTRAST_API int eval_save_weights(const char* path, const EvalWeights* w);
+
+/* 置換表の生成・破棄（エントリ数は 2^bits） */
+CONTRAST_API TransTable* tt_create(int bits);
+CONTRAST_API void tt_destroy(TransTable* tt);
+CONTRAST_API void tt_clear(TransTable* tt);
+
+/* 反復深化 αβ 探索で最善手を求める
+ * state と weights は読むだけ。stop は別スレッドから立ててよい (1024 節点ごとに見る)。 */
+CONTRAST_API void search_best_move(const GameState* state, const SearchLimits* limits, SearchResult* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONTRAST_C_SEARCH_H */
@@ -8,6 +8,23 @@
 extern "C" {
 #endif
 
+/* 公開 API の印。libcontrast_c.so は -fvisibility=hidden でビルドするので、
+ * これを付けた関数だけが共有ライブラリから見える (静的ライブラリでは意味を持たない) */
+#if defined(__GNUC__)
+#define CONTRAST_API __attribute__((visibility("default")))
+#else
+#define CONTRAST_API
+#endif
+
+/*
+ * スレッド安全性
+ *  core_c はプロセス全体で書き換わる状態を持たない。関数は引数で渡されたものだけを
+ *  読み書きするので、別々のオブジェクト (GameState, MoveList, TransTable など) に対してなら
+ *  どのスレッドから同時に呼んでもよい。同じオブジェクトを複数のスレッドで共有するのは
+ *  全員が読むだけのときに限る (書き込みと同時に読む・書くなら呼び出し側で排他する)。
+ *  補足は zobrist.h (初回の表作成) と search.h (共有できる置換表) を参照。
+ */
+
 /* プレイヤー */
 typedef enum {
     PLAYER_NONE = 0,
@@ -0,0 +1,137 @@
+#ifndef CONTRAST_C_VARIANT_H
+#define CONTRAST_C_VARIANT_H
+
+#include "game_state.h"
+#include "move.h"
+#include "rules.h"
+#include "search.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 盤の大きさの変種 (6x6, 7x7)
+ *  標準の 5x5 は GameState / rules_* / search_best_move のまま変えない。変種は大きさごとに
+ *  別の型 (GameState6, GameState7) を持ち、手生成・勝敗判定・評価・探索は一辺を定数にして
+ *  大きさごとにコンパイルした関数 (src/variant_impl.h) を使う。
+ *  VariantGame はどの大きさの対局も入れられる入れ物で、variant_* は大きさで振り分けるだけ
+ *  (5x5 なら標準の関数をそのまま呼ぶので、5x5 の探索や手生成の速さは変わらない)。
+ *
+ *  ルールは 5x5 と同じ: 黒は y=0、白は y=N-1 の列に並んで始まり、相手側の端の列に着いたら勝ち。
+ *  タイル在庫も同じ (黒3・灰1)。座標は 5x5 と同じ表記 (a1 〜 g7) で、指し手のパック
+ *  (座標 3bit) もそのまま使える。
+ */
+
+#define VARIANT_MIN_SIZE 5
+#define VARIANT_MAX_SIZE 7
+#define VARIANT_MAX_CELLS (VARIANT_MAX_SIZE * VARIANT_MAX_SIZE)
+
+/* パック済み状態のバイト数 (セル 4bit + 手番 1 + 在庫 2)。5x5 は game_state_pack と同じ 16 バイト */
+#define VARIANT_PACKED_SIZE(n) (((n) * (n) + 1) / 2 + 3)
+#define VARIANT_PACKED_MAX VARIANT_PACKED_SIZE(VARIANT_MAX_SIZE)
+
+/* 大きい盤の盤面と状態 (メンバーは GameState と同じ並び) */
+typedef struct {
+    Cell cells[6 * 6];
+} Board6;
+
+typedef struct {
+    Cell cells[7 * 7];
+} Board7;
+
+typedef struct {
+    Board6 board;
+    Player to_move;
+    TileInventory inv_black;
+    TileInventory inv_white;
+    uint32_t ply;
+} GameState6;
+
+typedef struct {
+    Board7 board;
+    Player to_move;
+    TileInventory inv_black;
+    TileInventory inv_white;
+    uint32_t ply;
+} GameState7;
+
+/* 大きさを問わない対局状態 */
+typedef struct {
+    int size;              /* 一辺 (5, 6, 7) */
+    union {
+        GameState s5;
+        GameState6 s6;
+        GameState7 s7;
+    } u;
+} VariantGame;
+
+/* 大きい盤の合法手集合 (LegalSet と同じ表現で、ビット幅だけ広い) */
+typedef struct {
+    uint64_t base[(VARIANT_MAX_CELLS * VARIANT_MAX_CELLS + 63) / 64]; /* bit = from * N*N + to */
+    uint64_t place_mask;   /* タイルを置けるマス (bit = y * N + x) */
+    uint16_t base_count;
+    uint8_t place_black;
+    uint8_t place_gray;
+} LegalSetWide;
+
+typedef struct {
+    int size;
+    union {
+        LegalSet s5;
+        LegalSetWide wide;
+    } u;
+} VariantLegalSet;
+
+/* 対応している大きさか */
+CONTRAST_API int variant_size_valid(int size);
+
+/* 初期局面にする (対応していない大きさなら 0 で g は変えない) */
+CONTRAST_API int variant_reset(VariantGame* g, int size);
+
+/* 手番と適用済みの手数 */
+CONTRAST_API Player variant_to_move(const VariantGame* g);
+CONTRAST_API uint32_t variant_ply(const VariantGame* g);
+
+/* 手数を設定する (SYNC で受け取った局面に使う。variant_unpack は手数を 0 にする) */
+CONTRAST_API void variant_set_ply(VariantGame* g, uint32_t ply);
+
+/* マスと在庫 (盤外なら NULL) */
+CONTRAST_API const Cell* variant_cell(const VariantGame* g, int x, int y);
+CONTRAST_API const TileInventory* variant_inventory(const VariantGame* g, Player player);
+
+/* 指し手適用 (game_state_apply_move と同じく検証はしない) */
+CONTRAST_API void variant_apply_move(VariantGame* g, const Move* move);
+
+/* 勝利判定 */
+CONTRAST_API int variant_is_win(const VariantGame* g, Player player);
+
+/* タイル配置を含まない基本移動 (タイル配置の組み合わせは variant_legal_set で表す) */
+CONTRAST_API void variant_base_moves(const VariantGame* g, MoveList* out);
+
+/* 手番側の合法手集合 */
+CONTRAST_API void variant_legal_set(const VariantGame* g, VariantLegalSet* out);
+CONTRAST_API int variant_legal_contains(const VariantLegalSet* set, const Move* move);
+CONTRAST_API size_t variant_legal_size(const VariantLegalSet* set);
+
+/* 状態をパックする (返り値は VARIANT_PACKED_SIZE(size))。out は VARIANT_PACKED_MAX バイト以上 */
+CONTRAST_API size_t variant_pack(const VariantGame* g, uint8_t* out);
+
+/* パック済み状態を展開する (大きさは長さで決まる。不正なら 0、手数は 0 になる) */
+CONTRAST_API int variant_unpack(const uint8_t* in, size_t len, VariantGame* g);
+
+/* 同期確認用のハッシュ (5x5 は game_state_sync_hash と同じ値) */
+CONTRAST_API uint64_t variant_sync_hash(const VariantGame* g);
+
+/* 静的評価 (eval_position の大きさ別版。手番側から見た値) */
+CONTRAST_API int variant_eval(const VariantGame* g, const EvalWeights* weights);
+
+/* 探索 (search_best_move の大きさ別版。置換表は大きさの違う対局と共有してよい) */
+CONTRAST_API void variant_search_best_move(const VariantGame* g, const SearchLimits* limits, SearchResult* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONTRAST_C_VARIANT_H */
@@ -0,0 +1,70 @@
+#ifndef CONTRAST_C_WIRE_H
+#define CONTRAST_C_WIRE_H
+
+#include "game_state.h"
+#include "move.h"
+#include "variant.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * バイナリ通信プロトコル
+ *  接続後にクライアントが 1 バイト WIRE_HANDSHAKE を送るとバイナリモードになり、
+ *  サーバーは同じバイトを返してからフレームで応答する。
+ *  フレーム: [長さ u16 ビッグエンディアン (opcode + ペイロード)] [opcode u8] [ペイロード]
+ */
+#define WIRE_HANDSHAKE 0xB1
+#define WIRE_HEADER_SIZE 3
+#define WIRE_MAX_FRAME 1024
+
+/* opcode */
+#define WIRE_OP_TEXT 0x01           /* テキスト1行 (ロビーコマンド/サーバーメッセージ) */
+#define WIRE_OP_MOVE 0x02           /* C->S: 指し手 (パック済み 3 バイト) */
+#define WIRE_OP_OPPONENT_MOVE 0x03  /* S->C: 相手の指し手 */
+#define WIRE_OP_YOUR_MOVE 0x04      /* S->C: 受理された自分の指し手 */
+#define WIRE_OP_SNAPSHOT 0x05       /* S->C: パック済みゲーム状態 (観戦開始時) */
+#define WIRE_OP_MOVED 0x06          /* S->C: 観戦中の対局で指された手 */
+#define WIRE_OP_SYNC 0x07           /* S->C: SYNC の応答 [手数 u32][ハッシュ u64][パック済み状態] */
+#define WIRE_OP_CHECK 0x08          /* S->C: 1手ごとの確認 [手数 u32][ハッシュ u64] (SYNC ON のとき) */
+
+#define WIRE_CHECK_SIZE 12
+#define WIRE_SYNC_SIZE (WIRE_CHECK_SIZE + GAME_STATE_PACKED_SIZE)
+#define WIRE_VARIANT_SYNC_MAX (WIRE_CHECK_SIZE + VARIANT_PACKED_MAX) /* 大きい盤の SYNC (状態の長さは大きさで変わる) */
+
+/* フレームを組み立てる。out は WIRE_HEADER_SIZE + len 以上。フレーム長を返す */
+CONTRAST_API size_t wire_encode(uint8_t* out, uint8_t opcode, const void* payload, size_t len);
+
+/* 指し手フレームを組み立てる。out は WIRE_HEADER_SIZE + MOVE_PACKED_SIZE 以上 */
+CONTRAST_API size_t wire_encode_move(uint8_t* out, uint8_t opcode, const Move* move);
+
+/* 先頭フレームの全長。不完全なら 0、不正なら (size_t)-1 */
+CONTRAST_API size_t wire_frame_size(const uint8_t* buf, size_t len);
+
+/* パック済み指し手ペイロードを展開（成功で 1） */
+CONTRAST_API int wire_decode_move(const uint8_t* payload, size_t len, Move* out);
+
+/* SYNC / CHECK フレームを組み立てる (opcode で決まる)。out は WIRE_HEADER_SIZE + WIRE_SYNC_SIZE 以上 */
+CONTRAST_API size_t wire_encode_sync(uint8_t* out, uint8_t opcode, const GameState* state);
+
+/* 大きさを問わない SYNC / CHECK (5x5 なら wire_encode_sync と同じフレーム)。
+ * out は WIRE_HEADER_SIZE + WIRE_VARIANT_SYNC_MAX 以上 */
+CONTRAST_API size_t wire_encode_variant_sync(uint8_t* out, uint8_t opcode, const VariantGame* g);
+
+/* CHECK (と SYNC の先頭) の手数とハッシュを取り出す（成功で 1） */
+CONTRAST_API int wire_decode_check(const uint8_t* payload, size_t len, uint32_t* ply, uint64_t* hash);
+
+/* SYNC ペイロードを展開する。ハッシュが合わなければ 0 */
+CONTRAST_API int wire_decode_sync(const uint8_t* payload, size_t len, GameState* out);
+
+/* 大きさを問わない SYNC ペイロードを展開する (大きさは状態の長さで決まる)。ハッシュが合わなければ 0 */
+CONTRAST_API int wire_decode_variant_sync(const uint8_t* payload, size_t len, VariantGame* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONTRAST_C_WIRE_H */
@@ -1,17 +1,29 @@
 #ifndef CONTRAST_C_ZOBRIST_H
 #define CONTRAST_C_ZOBRIST_H
 
+#include "game_state.h"
 #include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/* Zobrist テーブル初期化 */
-void zobrist_init(void);
+/* Zobrist 乱数表 (セルごとの駒 x タイル、手番) */
+typedef struct {
+    uint64_t cell[BOARD_CELLS][3][3]; /* [セル][occupant][tile] */
+    uint64_t white_to_move;
+} ZobristTable;
 
-/* Zobrist ハッシュ取得 */
-uint64_t zobrist_hash(void);
+/* 表を作る。固定の種から作るので毎回同じ値になる。
+ * 何度・どのスレッドから呼んでもよく (1回だけ作られる)、作った後は読み取り専用。
+ * zobrist_table / zobrist_hash も初回に自分で呼ぶので、先に呼んでおく必要はない。 */
+CONTRAST_API void zobrist_init(void);
+
+/* 表を取得 */
+CONTRAST_API const ZobristTable* zobrist_table(void);
+
+/* 局面の Zobrist ハッシュ (盤面と手番) */
+CONTRAST_API uint64_t zobrist_hash(const GameState* state);
 
 #ifdef __cplusplus
 }
@@ -1,4 +1,6 @@
 #include "./include/contrast_c/move.h"
+#include <ctype.h>
+#include <stdio.h>
 
 void move_list_clear(MoveList* list) {
     list->size = 0;
@@ -9,3 +11,89 @@ void move_list_push(MoveList* list, const Move* move) {
         list->moves[list->size++] = *move;
     }
 }
+
+uint32_t move_pack(const Move* move) {
+    uint32_t p = 0;
+    p |= (uint32_t)(move->sx & 7);
+    p |= (uint32_t)(move->sy & 7) << 3;
+    p |= (uint32_t)(move->dx & 7) << 6;
+    p |= (uint32_t)(move->dy & 7) << 9;
+    if (move->place_tile) {
+        p |= 1u << 12;
+        p |= (uint32_t)(move->tx & 7) << 13;
+        p |= (uint32_t)(move->ty & 7) << 16;
+        p |= (uint32_t)(move->tile & 3) << 19;
+    }
+    return p;
+}
+
+void move_unpack(uint32_t packed, Move* move) {
+    move->sx = (int)(packed & 7);
+    move->sy = (int)((packed >> 3) & 7);
+    move->dx = (int)((packed >> 6) & 7);
+    move->dy = (int)((packed >> 9) & 7);
+    move->place_tile = (int)((packed >> 12) & 1);
+    if (move->place_tile) {
+        move->tx = (int)((packed >> 13) & 7);
+        move->ty = (int)((packed >> 16) & 7);
+        move->tile = (TileType)((packed >> 19) & 3);
+    } else {
+        move->tx = -1;
+        move->ty = -1;
+        move->tile = TILE_NONE;
+    }
+}
+
+/* "a1" 形式の座標を一辺 size の盤として解析 */
+static int parse_square(const char* s, int size, int* x, int* y) {
+    char col = (char)tolower((unsigned char)s[0]);
+    if (col < 'a' || col >= 'a' + size) return 0;
+    if (s[1] < '1' || s[1] >= '1' + size) return 0;
+    *x = col - 'a';
+    *y = s[1] - '1';
+    return 1;
+}
+
+int move_parse(const char* text, Move* out) {
+    return move_parse_size(text, BOARD_W, out);
+}
+
+int move_parse_size(const char* text, int size, Move* out) {
+    const char* p = text;
+    while (*p == ' ') p++;
+
+    Move m = {0, 0, 0, 0, 0, -1, -1, TILE_NONE};
+    if (!parse_square(p, size, &m.sx, &m.sy)) return 0;
+    p += 2;
+    if (*p != ',' && *p != ' ') return 0;
+    p++;
+    if (!parse_square(p, size, &m.dx, &m.dy)) return 0;
+    p += 2;
+
+    while (*p == ' ') p++;
+    if (*p && *p != '\n' && *p != '\r') {
+        if (!parse_square(p, size, &m.tx, &m.ty)) return 0;
+        char c = (char)tolower((unsigned char)p[2]);
+        if (c == 'b') {
+            m.tile = TILE_BLACK;
+        } else if (c == 'g') {
+            m.tile = TILE_GRAY;
+        } else {
+            return 0;
+        }
+        m.place_tile = 1;
+    }
+    *out = m;
+    return 1;
+}
+
+void move_format(const Move* move, char* buf, size_t size) {
+    if (move->place_tile) {
+        snprintf(buf, size, "%c%d,%c%d %c%d%c",
+                 'a' + move->sx, move->sy + 1, 'a' + move->dx, move->dy + 1,
+                 'a' + move->tx, move->ty + 1, (move->tile == TILE_BLACK) ? 'b' : 'g');
+    } else {
+        snprintf(buf, size, "%c%d,%c%d",
+                 'a' + move->sx, move->sy + 1, 'a' + move->dx, move->dy + 1);
+    }
+}
@@ -0,0 +1,170 @@
+#define _DEFAULT_SOURCE
+#include "./include/contrast_c/posdb.h"
+#include "./include/contrast_c/zobrist.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct PosDb {
+    const uint8_t* base;
+    size_t size;
+    const PosDbHeader* header;
+    const uint64_t* keys;
+    const PosDbEntry* entries;
+    const PosDbMove* moves;
+    const uint32_t* index;
+};
+
+/* 在庫を鍵に混ぜる (Zobrist 表は盤面と手番しか持たない) */
+static uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t inventory_key(const TileInventory* mover, const TileInventory* other) {
+    uint64_t v = (uint64_t)(uint8_t)mover->black | ((uint64_t)(uint8_t)mover->gray << 8) |
+                 ((uint64_t)(uint8_t)other->black << 16) | ((uint64_t)(uint8_t)other->gray << 24);
+    return mix64(v + 0x9E3779B97F4A7C15ULL);
+}
+
+uint64_t posdb_canonical_key(const GameState* state, int* sym) {
+    const ZobristTable* z = zobrist_table();
+    int swap = (state->to_move == PLAYER_WHITE);
+    /* 手番が黒になる向きにしたうえで、左右そのまま (k0) と反転 (k1) のハッシュを1回で求める */
+    uint64_t k0 = 0, k1 = 0;
+    for (int y = 0; y < BOARD_H; y++) {
+        int cy = swap ? BOARD_H - 1 - y : y;
+        for (int x = 0; x < BOARD_W; x++) {
+            const Cell* c = &state->board.cells[y * BOARD_W + x];
+            Player o = c->occupant;
+            if (swap && o != PLAYER_NONE) o = (o == PLAYER_BLACK) ? PLAYER_WHITE : PLAYER_BLACK;
+            k0 ^= z->cell[cy * BOARD_W + x][o][c->tile];
+            k1 ^= z->cell[cy * BOARD_W + (BOARD_W - 1 - x)][o][c->tile];
+        }
+    }
+    const TileInventory* mover = swap ? &state->inv_white : &state->inv_black;
+    const TileInventory* other = swap ? &state->inv_black : &state->inv_white;
+    uint64_t inv = inventory_key(mover, other);
+    k0 ^= inv;
+    k1 ^= inv;
+
+    int s = swap ? POSDB_SYM_SWAP : 0;
+    if (k1 < k0) {
+        k0 = k1;
+        s |= POSDB_SYM_MIRROR;
+    } else if (k1 == k0) {
+        s |= POSDB_SYM_SELF;
+    }
+    if (sym) *sym = s;
+    return k0;
+}
+
+void posdb_transform_move(const Move* in, int sym, Move* out) {
+    *out = *in;
+    if (sym & POSDB_SYM_MIRROR) {
+        out->sx = BOARD_W - 1 - in->sx;
+        out->dx = BOARD_W - 1 - in->dx;
+        if (in->place_tile) out->tx = BOARD_W - 1 - in->tx;
+    }
+    if (sym & POSDB_SYM_SWAP) {
+        out->sy = BOARD_H - 1 - in->sy;
+        out->dy = BOARD_H - 1 - in->dy;
+        if (in->place_tile) out->ty = BOARD_H - 1 - in->ty;
+    }
+}
+
+PosDb* posdb_open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(PosDbHeader)) {
+        close(fd);
+        return NULL;
+    }
+    size_t size = (size_t)st.st_size;
+    void* base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return NULL;
+
+    const PosDbHeader* h = base;
+    if (memcmp(h->magic, POSDB_MAGIC, 4) != 0 || h->version != POSDB_VERSION ||
+        h->byte_order != POSDB_BYTE_ORDER || h->index_bits > POSDB_INDEX_BITS_MAX ||
+        h->entries > UINT32_MAX || h->moves > UINT32_MAX ||
+        h->key_off + h->entries * sizeof(uint64_t) > size ||
+        h->entry_off + h->entries * sizeof(PosDbEntry) > size ||
+        h->move_off + h->moves * sizeof(PosDbMove) > size ||
+        h->index_off + (((uint64_t)1 << h->index_bits) + 1) * sizeof(uint32_t) > size) {
+        munmap(base, size);
+        return NULL;
+    }
+
+    const uint32_t* index = (const uint32_t*)((const uint8_t*)base + h->index_off);
+    if (index[(size_t)1 << h->index_bits] != h->entries) {
+        munmap(base, size);
+        return NULL;
+    }
+
+    PosDb* db = malloc(sizeof(PosDb));
+    if (!db) {
+        munmap(base, size);
+        return NULL;
+    }
+    db->base = base;
+    db->size = size;
+    db->header = h;
+    db->keys = (const uint64_t*)(db->base + h->key_off);
+    db->entries = (const PosDbEntry*)(db->base + h->entry_off);
+    db->moves = (const PosDbMove*)(db->base + h->move_off);
+    db->index = index;
+    /* 表は飛び飛びに触るので先読みさせない */
+    madvise((void*)db->base, db->size, MADV_RANDOM);
+    return db;
+}
+
+void posdb_close(PosDb* db) {
+    if (!db) return;
+    munmap((void*)db->base, db->size);
+    free(db);
+}
+
+const PosDbHeader* posdb_header(const PosDb* db) {
+    return db->header;
+}
+
+const PosDbEntry* posdb_find(const PosDb* db, uint64_t key) {
+    /* 索引で上位ビットの区間を決め、その中 (平均 POSDB_BUCKET_TARGET 件) の鍵を二分探索する */
+    unsigned bits = db->header->index_bits;
+    size_t bucket = bits ? (size_t)(key >> (64 - bits)) : 0;
+    size_t first = db->index[bucket];
+    size_t last = db->index[bucket + 1];
+    const uint64_t* keys = db->keys;
+    while (first < last) {
+        size_t mid = (first + last) / 2;
+        if (keys[mid] < key) first = mid + 1; else last = mid;
+    }
+    if (first < db->index[bucket + 1] && keys[first] == key) return &db->entries[first];
+    return NULL;
+}
+
+int posdb_lookup(const PosDb* db, const GameState* state, PosDbResult* out) {
+    int sym;
+    const PosDbEntry* e = posdb_find(db, posdb_canonical_key(state, &sym));
+    if (!e) return 0;
+    size_t i = (size_t)(e - db->entries);
+    uint32_t end = (i + 1 < db->header->entries) ? e[1].move_first : (uint32_t)db->header->moves;
+    out->entry = e;
+    out->moves = db->moves + e->move_first;
+    out->nmoves = end - e->move_first;
+    out->sym = sym;
+    return 1;
+}
+
+void posdb_result_move(const PosDbResult* result, uint32_t i, Move* out) {
+    Move m;
+    move_unpack(result->moves[i].move, &m);
+    posdb_transform_move(&m, result->sym, out);
+}
@@ -6,16 +6,12 @@ static const int ORTHO[4][2] = {{1,0},{-1,0},{0,1},{0,-1}};
 static const int DIAG[4][2] = {{1,1},{1,-1},{-1,1},{-1,-1}};
 static const int ALL_8[8][2] = {{1,0},{-1,0},{0,1},{0,-1},{1,1},{1,-1},{-1,1},{-1,-1}};
 
-void rules_legal_moves(const GameState* state, MoveList* out) {
-    move_list_clear(out);
+void rules_base_moves(const GameState* state, MoveList* base_moves) {
+    move_list_clear(base_moves);
     
     const Board* b = game_state_board_const(state);
     Player p = game_state_current_player(state);
     
-    /* 基本移動のみを格納する一時リスト */
-    MoveList base_moves;
-    move_list_clear(&base_moves);
-    
     for (int y = 0; y < BOARD_H; y++) {
         for (int x = 0; x < BOARD_W; x++) {
             const Cell* cell = board_at_const(b, x, y);
@@ -51,7 +47,7 @@ void rules_legal_moves(const GameState* state, MoveList* out) {
                 /* 空きマスへの単純移動 */
                 if (target->occupant == PLAYER_NONE) {
                     Move m = {x, y, tx, ty, 0, -1, -1, TILE_NONE};
-                    move_list_push(&base_moves, &m);
+                    move_list_push(base_moves, &m);
                 } else {
                     /* 自駒をジャンプ */
                     int jx = tx;
@@ -66,13 +62,24 @@ void rules_legal_moves(const GameState* state, MoveList* out) {
                         const Cell* land = board_at_const(b, jx, jy);
                         if (land->occupant == PLAYER_NONE) {
                             Move m = {x, y, jx, jy, 0, -1, -1, TILE_NONE};
-                            move_list_push(&base_moves, &m);
+                            move_list_push(base_moves, &m);
                         }
                     }
                 }
             }
         }
     }
+}
+
+void rules_legal_moves(const GameState* state, MoveList* out) {
+    move_list_clear(out);
+    
+    const Board* b = game_state_board_const(state);
+    Player p = game_state_current_player(state);
+    
+    /* 基本移動のみを格納する一時リスト */
+    MoveList base_moves;
+    rules_base_moves(state, &base_moves);
     
     /* タイル配置バリアント生成 */
     const TileInventory* inv = game_state_inventory_const(state, p);
@@ -119,6 +126,52 @@ void rules_legal_moves(const GameState* state, MoveList* out) {
     }
 }
 
+void rules_legal_set(const GameState* state, LegalSet* out) {
+    memset(out, 0, sizeof(*out));
+
+    MoveList base_moves;
+    rules_base_moves(state, &base_moves);
+    for (size_t i = 0; i < base_moves.size; i++) {
+        const Move* m = &base_moves.moves[i];
+        int bit = (m->sy * BOARD_W + m->sx) * BOARD_CELLS + (m->dy * BOARD_W + m->dx);
+        out->base[bit / 64] |= 1ULL << (bit % 64);
+    }
+    out->base_count = (uint16_t)base_moves.size;
+
+    const Board* b = game_state_board_const(state);
+    for (int i = 0; i < BOARD_CELLS; i++) {
+        if (b->cells[i].occupant == PLAYER_NONE && b->cells[i].tile == TILE_NONE) {
+            out->place_mask |= 1u << i;
+        }
+    }
+    const TileInventory* inv = game_state_inventory_const(state, game_state_current_player(state));
+    out->place_black = inv->black > 0;
+    out->place_gray = inv->gray > 0;
+}
+
+int legal_set_contains(const LegalSet* set, const Move* move) {
+    if (!board_in_bounds(move->sx, move->sy) || !board_in_bounds(move->dx, move->dy)) return 0;
+    int bit = (move->sy * BOARD_W + move->sx) * BOARD_CELLS + (move->dy * BOARD_W + move->dx);
+    if (!(set->base[bit / 64] & (1ULL << (bit % 64)))) return 0;
+    if (!move->place_tile) return 1;
+
+    if (move->tile == TILE_BLACK) {
+        if (!set->place_black) return 0;
+    } else if (move->tile == TILE_GRAY) {
+        if (!set->place_gray) return 0;
+    } else {
+        return 0;
+    }
+    if (!board_in_bounds(move->tx, move->ty)) return 0;
+    return (set->place_mask >> (move->ty * BOARD_W + move->tx)) & 1u;
+}
+
+size_t legal_set_size(const LegalSet* set) {
+    size_t places = (size_t)__builtin_popcount(set->place_mask);
+    size_t variants = 1 + (set->place_black ? places : 0) + (set->place_gray ? places : 0);
+    return (size_t)set->base_count * variants;
+}
+
 int rules_is_win(const GameState* state, Player player) {
     const Board* b = game_state_board_const(state);
     int target_row = (player == PLAYER_BLACK) ? (BOARD_H - 1) : 0;
@@ -134,7 +187,8 @@ int rules_is_win(const GameState* state, Player player) {
 
 int rules_is_loss(const GameState* state, Player player) {
     (void)player;
+    /* タイル配置は基本移動の変化形なので基本移動の有無だけで決まる */
     MoveList moves;
-    rules_legal_moves(state, &moves);
+    rules_base_moves(state, &moves);
     return (moves.size == 0) ? 1 : 0;
 }
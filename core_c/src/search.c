@@ -0,0 +1,324 @@
+#define _POSIX_C_SOURCE 200809L
+#include "./include/contrast_c/search.h"
+#include "./include/contrast_c/rules.h"
+#include "search_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const EvalWeights DEFAULT_WEIGHTS = {
+    10,   /* advance */
+    25,   /* lead */
+    6,    /* inv_black */
+    8,    /* inv_gray */
+    4,    /* on_black */
+    6,    /* on_gray */
+};
+
+const EvalWeights* eval_default_weights(void) {
+    return &DEFAULT_WEIGHTS;
+}
+
+static const char* const FEATURE_NAMES[EVAL_FEATURES] = {
+    "advance", "lead", "inv_black", "inv_gray", "on_black", "on_gray",
+};
+
+/* 特徴量 (手番側 - 相手側)。評価値はこれと重みの内積 */
+static inline void compute_features(const GameState* state, int f[EVAL_FEATURES]) {
+    int adv[3] = {0, 0, 0};
+    int lead[3] = {0, 0, 0};
+    int on_black[3] = {0, 0, 0};
+    int on_gray[3] = {0, 0, 0};
+
+    for (int y = 0; y < BOARD_H; y++) {
+        for (int x = 0; x < BOARD_W; x++) {
+            const Cell* c = &state->board.cells[y * BOARD_W + x];
+            if (c->occupant == PLAYER_NONE) continue;
+            /* 黒は y=BOARD_H-1 へ、白は y=0 へ進む */
+            int a = (c->occupant == PLAYER_BLACK) ? y : (BOARD_H - 1 - y);
+            adv[c->occupant] += a;
+            if (a > lead[c->occupant]) lead[c->occupant] = a;
+            if (c->tile == TILE_BLACK) on_black[c->occupant]++;
+            else if (c->tile == TILE_GRAY) on_gray[c->occupant]++;
+        }
+    }
+
+    Player me = state->to_move;
+    Player op = (me == PLAYER_BLACK) ? PLAYER_WHITE : PLAYER_BLACK;
+    const TileInventory* im = game_state_inventory_const(state, me);
+    const TileInventory* io = game_state_inventory_const(state, op);
+
+    f[0] = adv[me] - adv[op];
+    f[1] = lead[me] - lead[op];
+    f[2] = im->black - io->black;
+    f[3] = im->gray - io->gray;
+    f[4] = on_black[me] - on_black[op];
+    f[5] = on_gray[me] - on_gray[op];
+}
+
+void eval_features(const GameState* state, int out[EVAL_FEATURES]) {
+    compute_features(state, out);
+}
+
+int eval_position(const GameState* state, const EvalWeights* w) {
+    int f[EVAL_FEATURES];
+    compute_features(state, f);
+    return w->advance * f[0]
+         + w->lead * f[1]
+         + w->inv_black * f[2]
+         + w->inv_gray * f[3]
+         + w->on_black * f[4]
+         + w->on_gray * f[5];
+}
+
+const char* eval_feature_name(int i) {
+    return (i >= 0 && i < EVAL_FEATURES) ? FEATURE_NAMES[i] : NULL;
+}
+
+void eval_weights_to_array(const EvalWeights* w, int out[EVAL_FEATURES]) {
+    out[0] = w->advance;
+    out[1] = w->lead;
+    out[2] = w->inv_black;
+    out[3] = w->inv_gray;
+    out[4] = w->on_black;
+    out[5] = w->on_gray;
+}
+
+void eval_weights_from_array(const int in[EVAL_FEATURES], EvalWeights* w) {
+    w->advance = in[0];
+    w->lead = in[1];
+    w->inv_black = in[2];
+    w->inv_gray = in[3];
+    w->on_black = in[4];
+    w->on_gray = in[5];
+}
+
+int eval_load_weights(const char* path, EvalWeights* out) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return 0;
+    int v[EVAL_FEATURES];
+    eval_weights_to_array(&DEFAULT_WEIGHTS, v);
+    char line[256];
+    int ok = 1;
+    while (ok && fgets(line, sizeof(line), fp)) {
+        char name[64];
+        int value;
+        if (line[0] == '#' || sscanf(line, "%63s", name) != 1) continue;
+        ok = 0;
+        if (sscanf(line, "%63s %d", name, &value) != 2) break;
+        for (int i = 0; i < EVAL_FEATURES; i++) {
+            if (strcmp(name, FEATURE_NAMES[i]) == 0) {
+                v[i] = value;
+                ok = 1;
+                break;
+            }
+        }
+    }
+    fclose(fp);
+    if (!ok) return 0;
+    eval_weights_from_array(v, out);
+    return 1;
+}
+
+int eval_save_weights(const char* path, const EvalWeights* w) {
+    FILE* fp = fopen(path, "w");
+    if (!fp) return 0;
+    int v[EVAL_FEATURES];
+    eval_weights_to_array(w, v);
+    fprintf(fp, "# contrast eval weights (name value)\n");
+    for (int i = 0; i < EVAL_FEATURES; i++) fprintf(fp, "%s %d\n", FEATURE_NAMES[i], v[i]);
+    return fclose(fp) == 0;
+}
+
+TransTable* tt_create(int bits) {
+    TransTable* tt = malloc(sizeof(TransTable));
+    if (!tt) return NULL;
+    size_t n = (size_t)1 << bits;
+    tt->entries = malloc(n * sizeof(TTEntry));
+    if (!tt->entries) {
+        free(tt);
+        return NULL;
+    }
+    tt->mask = n - 1;
+    tt_clear(tt);
+    return tt;
+}
+
+void tt_destroy(TransTable* tt) {
+    if (!tt) return;
+    free(tt->entries);
+    free(tt);
+}
+
+void tt_clear(TransTable* tt) {
+    memset(tt->entries, 0, (tt->mask + 1) * sizeof(TTEntry));
+}
+
+/* game_state_compute_hash は在庫を含まないので混ぜ込む */
+static uint64_t search_key(const GameState* s) {
+    uint64_t inv = (uint64_t)(s->inv_black.black | (s->inv_black.gray << 4) |
+                              (s->inv_white.black << 8) | (s->inv_white.gray << 12));
+    return game_state_compute_hash(s) ^ (inv * 0x9E3779B97F4A7C15ULL);
+}
+
+static int negamax(SearchCtx* ctx, const GameState* s, int depth, int alpha, int beta, int ply) {
+    ctx->nodes++;
+    /* 末端も数えて確認する (内部節点だけだと 1024 の倍数に当たらず間隔が大きくぶれる) */
+    if ((ctx->nodes & 1023) == 0 && time_up(ctx)) {
+        ctx->aborted = 1;
+    }
+    if (ctx->aborted) return 0;
+    if (depth == 0) return eval_position(s, ctx->w);
+
+    int alpha_orig = alpha;
+    uint64_t key = search_key(s);
+    TTEntry* e = &ctx->tt->entries[key & ctx->tt->mask];
+    uint32_t tt_move = UINT32_MAX;
+    uint64_t data = atomic_load_explicit(&e->data, memory_order_relaxed);
+    if ((atomic_load_explicit(&e->check, memory_order_relaxed) ^ data) == key) {
+        int e_score = (int32_t)(uint32_t)(data >> 32);
+        uint32_t e_move = (uint32_t)(data >> 8) & TT_NO_MOVE;
+        int e_depth = (int)((data >> 2) & 63);
+        int e_flag = (int)(data & 3);
+        if (e_move != TT_NO_MOVE) tt_move = e_move;
+        if (e_depth >= depth) {
+            if (e_flag == TT_EXACT) return e_score;
+            if (e_flag == TT_LOWER && e_score > alpha) alpha = e_score;
+            else if (e_flag == TT_UPPER && e_score < beta) beta = e_score;
+            if (alpha >= beta) return e_score;
+        }
+    }
+
+    /* 内部ノードではタイル配置を省いた基本移動のみ読む */
+    MoveList* moves = &ctx->lists[ply];
+    rules_base_moves(s, moves);
+    if (moves->size == 0) {
+        /* 合法手なし = 手番側の負け */
+        return -SCORE_WIN + ply;
+    }
+    order_tt_move(moves, tt_move);
+
+    Player me = s->to_move;
+    int best = -SCORE_INF;
+    uint32_t best_move = UINT32_MAX;
+    for (size_t i = 0; i < moves->size; i++) {
+        GameState child = *s;
+        game_state_apply_move(&child, &moves->moves[i]);
+
+        int score;
+        if (rules_is_win(&child, me)) {
+            score = SCORE_WIN - ply - 1;
+        } else {
+            score = -negamax(ctx, &child, depth - 1, -beta, -alpha, ply + 1);
+        }
+        if (ctx->aborted) return 0;
+
+        if (score > best) {
+            best = score;
+            best_move = move_pack(&moves->moves[i]);
+        }
+        if (score > alpha) alpha = score;
+        if (alpha >= beta) break;
+    }
+
+    uint64_t flag = (best <= alpha_orig) ? TT_UPPER : (best >= beta) ? TT_LOWER : TT_EXACT;
+    data = ((uint64_t)(uint32_t)best << 32) | ((uint64_t)(best_move & TT_NO_MOVE) << 8) |
+           ((uint64_t)(depth & 63) << 2) | flag;
+    atomic_store_explicit(&e->check, key ^ data, memory_order_relaxed);
+    atomic_store_explicit(&e->data, data, memory_order_relaxed);
+    return best;
+}
+
+void search_best_move(const GameState* state, const SearchLimits* limits, SearchResult* out) {
+    memset(out, 0, sizeof(*out));
+
+    int max_depth = limits->max_depth;
+    if (max_depth <= 0 || max_depth > SEARCH_MAX_DEPTH) max_depth = SEARCH_MAX_DEPTH;
+
+    SearchCtx ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.w = limits->weights ? limits->weights : &DEFAULT_WEIGHTS;
+    ctx.stop = limits->stop;
+    ctx.tt = limits->tt;
+    TransTable* own_tt = NULL;
+    if (!ctx.tt) {
+        own_tt = tt_create(TT_DEFAULT_BITS);
+        ctx.tt = own_tt;
+    }
+    ctx.lists = malloc(sizeof(MoveList) * (size_t)(max_depth + 1));
+    if (!ctx.tt || !ctx.lists) {
+        tt_destroy(own_tt);
+        free(ctx.lists);
+        return;
+    }
+    if (limits->time_ms > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &ctx.deadline);
+        ctx.deadline.tv_sec += limits->time_ms / 1000;
+        ctx.deadline.tv_nsec += (long)(limits->time_ms % 1000) * 1000000L;
+        if (ctx.deadline.tv_nsec >= 1000000000L) {
+            ctx.deadline.tv_sec++;
+            ctx.deadline.tv_nsec -= 1000000000L;
+        }
+        ctx.timed = 1;
+    }
+
+    /* ルートはタイル配置込みの全合法手 */
+    MoveList* root = &ctx.lists[0];
+    rules_legal_moves(state, root);
+    if (root->size == 0) {
+        tt_destroy(own_tt);
+        free(ctx.lists);
+        return;
+    }
+    out->has_move = 1;
+    out->best_move = root->moves[0];
+    out->score = -SCORE_INF;
+
+    /* 前に読んだ結果があれば、その最善手を先頭にして次の深さから続ける */
+    int first_depth = search_resume(limits, root->moves, root->size, max_depth, out);
+
+    Player me = state->to_move;
+    for (int depth = first_depth; depth <= max_depth; depth++) {
+        int alpha = -SCORE_INF;
+        int best = -SCORE_INF;
+        size_t best_idx = 0;
+
+        for (size_t i = 0; i < root->size; i++) {
+            GameState child = *state;
+            game_state_apply_move(&child, &root->moves[i]);
+
+            int score;
+            if (rules_is_win(&child, me)) {
+                score = SCORE_WIN - 1;
+            } else {
+                score = -negamax(&ctx, &child, depth - 1, -SCORE_INF, -alpha, 1);
+            }
+            /* 深さ1は必ず読み切る */
+            if (ctx.aborted && depth > 1) break;
+            ctx.aborted = 0;
+
+            if (score > best) {
+                best = score;
+                best_idx = i;
+            }
+            if (score > alpha) alpha = score;
+        }
+        if (ctx.aborted) break;
+
+        /* 次の反復では最善手を先頭に読む */
+        Move tmp = root->moves[0];
+        root->moves[0] = root->moves[best_idx];
+        root->moves[best_idx] = tmp;
+
+        out->best_move = root->moves[0];
+        out->score = best;
+        out->depth = depth;
+        if (best >= SCORE_WIN - SEARCH_MAX_DEPTH || best <= -SCORE_WIN + SEARCH_MAX_DEPTH) break;
+        if (time_up(&ctx)) break;
+    }
+    out->nodes = ctx.nodes;
+
+    tt_destroy(own_tt);
+    free(ctx.lists);
+}
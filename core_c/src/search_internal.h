@@ -0,0 +1,91 @@
+#ifndef CONTRAST_C_SEARCH_INTERNAL_H
+#define CONTRAST_C_SEARCH_INTERNAL_H
+
+/* search.c と variant.c (大きい盤の探索) で共有する置換表と探索状態の定義、探索の下請け。公開しない */
+
+#include "./include/contrast_c/search.h"
+#include <time.h>
+
+#define SEARCH_MAX_DEPTH 32
+#define TT_DEFAULT_BITS 16
+
+/* 置換表エントリの種別 */
+#define TT_EXACT 0
+#define TT_LOWER 1
+#define TT_UPPER 2
+
+/* 置換表エントリ
+ * 複数の探索スレッドで1つの表を共有できるよう、ロックの代わりに
+ * check = key ^ data として2語を別々に書く (Hyatt の lockless hashing)。
+ * 別のスレッドの書き込みと混ざったエントリは check が合わないので読まなかったことになる。
+ * data: score 32bit | move 24bit (なしは TT_NO_MOVE) | depth 6bit | flag 2bit */
+typedef struct {
+    _Atomic uint64_t check;
+    _Atomic uint64_t data;
+} TTEntry;
+
+#define TT_NO_MOVE 0xFFFFFFu
+
+struct TransTable {
+    TTEntry* entries;
+    uint64_t mask;
+};
+
+/* 探索中の状態 */
+typedef struct {
+    const EvalWeights* w;
+    TransTable* tt;
+    const atomic_int* stop;
+    struct timespec deadline;
+    int timed;
+    int aborted;
+    uint64_t nodes;
+    MoveList* lists;  /* ply ごとの指し手バッファ */
+} SearchCtx;
+
+/* 停止フラグが立ったか、思考時間を使い切ったか */
+static inline int time_up(SearchCtx* ctx) {
+    if (ctx->stop && atomic_load_explicit(ctx->stop, memory_order_relaxed)) return 1;
+    if (!ctx->timed) return 0;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec > ctx->deadline.tv_sec) ||
+           (now.tv_sec == ctx->deadline.tv_sec && now.tv_nsec >= ctx->deadline.tv_nsec);
+}
+
+/* TT の最善手を先頭へ */
+static inline void order_tt_move(MoveList* list, uint32_t tt_move) {
+    if (tt_move == UINT32_MAX) return;
+    for (size_t i = 0; i < list->size; i++) {
+        if (move_pack(&list->moves[i]) == tt_move) {
+            Move tmp = list->moves[0];
+            list->moves[0] = list->moves[i];
+            list->moves[i] = tmp;
+            return;
+        }
+    }
+}
+
+/* limits->resume (同じ局面を前に読んだ結果) があれば、その最善手をルートの先頭にして
+ * out に写し、反復深化を始める深さを返す。なければ 1 */
+static inline int search_resume(const SearchLimits* limits, Move* root, size_t n, int max_depth,
+                                SearchResult* out) {
+    const SearchResult* prev = limits->resume;
+    if (!prev || !prev->has_move || prev->depth <= 0) return 1;
+    for (size_t i = 0; i < n; i++) {
+        if (move_pack(&root[i]) != move_pack(&prev->best_move)) continue;
+        Move tmp = root[0];
+        root[0] = root[i];
+        root[i] = tmp;
+        out->best_move = prev->best_move;
+        out->score = prev->score;
+        out->depth = prev->depth;
+        /* 勝ち負けまで読み切っていればそれ以上は読まない */
+        if (prev->score >= SCORE_WIN - SEARCH_MAX_DEPTH || prev->score <= -SCORE_WIN + SEARCH_MAX_DEPTH)
+            return max_depth + 1;
+        return prev->depth + 1;
+    }
+    return 1;
+}
+
+#endif /* CONTRAST_C_SEARCH_INTERNAL_H */
@@ -0,0 +1,224 @@
+#define _POSIX_C_SOURCE 200809L
+#include "./include/contrast_c/variant.h"
+#include "search_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* 方向: 0-3 が縦横、4-7 が斜め (rules.c の ORTHO / DIAG / ALL_8 と同じ順) */
+static const int DIR_DX[8] = {1, -1, 0, 0, 1, 1, -1, -1};
+static const int DIR_DY[8] = {0, 0, 1, -1, 1, -1, 1, -1};
+
+/* 探索状態を用意して最大深さを返す (確保に失敗したら 0) */
+static int variant_search_setup(SearchCtx* ctx, const SearchLimits* limits) {
+    int max_depth = limits->max_depth;
+    if (max_depth <= 0 || max_depth > SEARCH_MAX_DEPTH) max_depth = SEARCH_MAX_DEPTH;
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->w = limits->weights ? limits->weights : eval_default_weights();
+    ctx->stop = limits->stop;
+    ctx->tt = limits->tt ? limits->tt : tt_create(TT_DEFAULT_BITS);
+    ctx->lists = malloc(sizeof(MoveList) * (size_t)(max_depth + 1));
+    if (!ctx->tt || !ctx->lists) {
+        if (!limits->tt) tt_destroy(ctx->tt);
+        free(ctx->lists);
+        return 0;
+    }
+    if (limits->time_ms > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &ctx->deadline);
+        ctx->deadline.tv_sec += limits->time_ms / 1000;
+        ctx->deadline.tv_nsec += (long)(limits->time_ms % 1000) * 1000000L;
+        if (ctx->deadline.tv_nsec >= 1000000000L) {
+            ctx->deadline.tv_sec++;
+            ctx->deadline.tv_nsec -= 1000000000L;
+        }
+        ctx->timed = 1;
+    }
+    return max_depth;
+}
+
+/* 一辺ごとに別々の関数を作る (v6_*, v7_*) */
+#define VN 6
+#define VSTATE GameState6
+#define VF(name) v6_##name
+#include "variant_impl.h"
+#undef VN
+#undef VSTATE
+#undef VF
+
+#define VN 7
+#define VSTATE GameState7
+#define VF(name) v7_##name
+#include "variant_impl.h"
+#undef VN
+#undef VSTATE
+#undef VF
+
+int variant_size_valid(int size) {
+    return size >= VARIANT_MIN_SIZE && size <= VARIANT_MAX_SIZE;
+}
+
+int variant_reset(VariantGame* g, int size) {
+    switch (size) {
+    case 5: game_state_reset(&g->u.s5); break;
+    case 6: v6_reset(&g->u.s6); break;
+    case 7: v7_reset(&g->u.s7); break;
+    default: return 0;
+    }
+    g->size = size;
+    return 1;
+}
+
+Player variant_to_move(const VariantGame* g) {
+    switch (g->size) {
+    case 6: return g->u.s6.to_move;
+    case 7: return g->u.s7.to_move;
+    default: return g->u.s5.to_move;
+    }
+}
+
+uint32_t variant_ply(const VariantGame* g) {
+    switch (g->size) {
+    case 6: return g->u.s6.ply;
+    case 7: return g->u.s7.ply;
+    default: return g->u.s5.ply;
+    }
+}
+
+void variant_set_ply(VariantGame* g, uint32_t ply) {
+    switch (g->size) {
+    case 6: g->u.s6.ply = ply; break;
+    case 7: g->u.s7.ply = ply; break;
+    default: g->u.s5.ply = ply; break;
+    }
+}
+
+const Cell* variant_cell(const VariantGame* g, int x, int y) {
+    if (x < 0 || x >= g->size || y < 0 || y >= g->size) return NULL;
+    switch (g->size) {
+    case 6: return &g->u.s6.board.cells[y * 6 + x];
+    case 7: return &g->u.s7.board.cells[y * 7 + x];
+    default: return &g->u.s5.board.cells[y * BOARD_W + x];
+    }
+}
+
+const TileInventory* variant_inventory(const VariantGame* g, Player player) {
+    int black = (player == PLAYER_BLACK);
+    switch (g->size) {
+    case 6: return black ? &g->u.s6.inv_black : &g->u.s6.inv_white;
+    case 7: return black ? &g->u.s7.inv_black : &g->u.s7.inv_white;
+    default: return game_state_inventory_const(&g->u.s5, player);
+    }
+}
+
+void variant_apply_move(VariantGame* g, const Move* move) {
+    switch (g->size) {
+    case 6: v6_apply(&g->u.s6, move); break;
+    case 7: v7_apply(&g->u.s7, move); break;
+    default: game_state_apply_move(&g->u.s5, move); break;
+    }
+}
+
+int variant_is_win(const VariantGame* g, Player player) {
+    switch (g->size) {
+    case 6: return v6_is_win(&g->u.s6, player);
+    case 7: return v7_is_win(&g->u.s7, player);
+    default: return rules_is_win(&g->u.s5, player);
+    }
+}
+
+void variant_base_moves(const VariantGame* g, MoveList* out) {
+    switch (g->size) {
+    case 6: v6_base_moves(&g->u.s6, out); break;
+    case 7: v7_base_moves(&g->u.s7, out); break;
+    default: rules_base_moves(&g->u.s5, out); break;
+    }
+}
+
+void variant_legal_set(const VariantGame* g, VariantLegalSet* out) {
+    out->size = g->size;
+    switch (g->size) {
+    case 6: v6_legal_set(&g->u.s6, &out->u.wide); break;
+    case 7: v7_legal_set(&g->u.s7, &out->u.wide); break;
+    default: rules_legal_set(&g->u.s5, &out->u.s5); break;
+    }
+}
+
+int variant_legal_contains(const VariantLegalSet* set, const Move* move) {
+    switch (set->size) {
+    case 6: return v6_legal_contains(&set->u.wide, move);
+    case 7: return v7_legal_contains(&set->u.wide, move);
+    default: return legal_set_contains(&set->u.s5, move);
+    }
+}
+
+size_t variant_legal_size(const VariantLegalSet* set) {
+    if (set->size == 5) return legal_set_size(&set->u.s5);
+    const LegalSetWide* w = &set->u.wide;
+    size_t places = (size_t)__builtin_popcountll(w->place_mask);
+    size_t variants = 1 + (w->place_black ? places : 0) + (w->place_gray ? places : 0);
+    return (size_t)w->base_count * variants;
+}
+
+size_t variant_pack(const VariantGame* g, uint8_t* out) {
+    switch (g->size) {
+    case 6: return v6_pack(&g->u.s6, out);
+    case 7: return v7_pack(&g->u.s7, out);
+    default:
+        game_state_pack(&g->u.s5, out);
+        return GAME_STATE_PACKED_SIZE;
+    }
+}
+
+int variant_unpack(const uint8_t* in, size_t len, VariantGame* g) {
+    VariantGame tmp;
+    int ok;
+    if (len == VARIANT_PACKED_SIZE(5)) {
+        tmp.size = 5;
+        ok = game_state_unpack(in, &tmp.u.s5);
+    } else if (len == VARIANT_PACKED_SIZE(6)) {
+        tmp.size = 6;
+        ok = v6_unpack(in, &tmp.u.s6);
+    } else if (len == VARIANT_PACKED_SIZE(7)) {
+        tmp.size = 7;
+        ok = v7_unpack(in, &tmp.u.s7);
+    } else {
+        return 0;
+    }
+    if (ok) *g = tmp;
+    return ok;
+}
+
+uint64_t variant_sync_hash(const VariantGame* g) {
+    if (g->size == 5) return game_state_sync_hash(&g->u.s5);
+
+    /* game_state_sync_hash と同じく、パック済み状態と手数を FNV-1a で混ぜる */
+    uint8_t packed[VARIANT_PACKED_MAX];
+    size_t n = variant_pack(g, packed);
+    uint32_t ply = variant_ply(g);
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < n; i++) {
+        h ^= packed[i];
+        h *= 1099511628211ULL;
+    }
+    for (int i = 0; i < 4; i++) {
+        h ^= (ply >> (i * 8)) & 0xFF;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+int variant_eval(const VariantGame* g, const EvalWeights* weights) {
+    switch (g->size) {
+    case 6: return v6_eval(&g->u.s6, weights);
+    case 7: return v7_eval(&g->u.s7, weights);
+    default: return eval_position(&g->u.s5, weights);
+    }
+}
+
+void variant_search_best_move(const VariantGame* g, const SearchLimits* limits, SearchResult* out) {
+    switch (g->size) {
+    case 6: v6_search(&g->u.s6, limits, out); break;
+    case 7: v7_search(&g->u.s7, limits, out); break;
+    default: search_best_move(&g->u.s5, limits, out); break;
+    }
+}
@@ -0,0 +1,388 @@
+/* 大きい盤の対局処理のひな形 (variant.c が一辺ごとに取り込む。インクルードガードは付けない)
+ * 取り込む前に VN (一辺)、VSTATE (状態の型)、VF(name) (関数名に大きさの接頭辞を付けるマクロ) を定義する。
+ * 一辺がコンパイル時の定数なので、盤外判定・添字の計算・端の列の判定は定数に畳み込まれる。
+ * 処理の中身と指し手の並び順は 5x5 の rules.c / search.c と同じにしてある。 */
+
+#define VCELLS (VN * VN)
+
+static inline int VF(in_bounds)(int x, int y) {
+    return (unsigned)x < VN && (unsigned)y < VN;
+}
+
+static void VF(reset)(VSTATE* s) {
+    memset(s->board.cells, 0, sizeof(s->board.cells));
+    /* 初期配置: 上段(y=0)に黒、下段(y=VN-1)に白 */
+    for (int x = 0; x < VN; x++) {
+        s->board.cells[x].occupant = PLAYER_BLACK;
+        s->board.cells[(VN - 1) * VN + x].occupant = PLAYER_WHITE;
+    }
+    s->to_move = PLAYER_BLACK;
+    s->inv_black.black = 3;
+    s->inv_black.gray = 1;
+    s->inv_white.black = 3;
+    s->inv_white.gray = 1;
+    s->ply = 0;
+}
+
+static void VF(base_moves)(const VSTATE* s, MoveList* out) {
+    out->size = 0;
+    Player p = s->to_move;
+    const Cell* cells = s->board.cells;
+
+    for (int y = 0; y < VN; y++) {
+        for (int x = 0; x < VN; x++) {
+            const Cell* cell = &cells[y * VN + x];
+            if (cell->occupant != p) continue;
+
+            /* タイルなしは縦横、黒タイルは斜め、灰タイルは8方向 */
+            int first = (cell->tile == TILE_BLACK) ? 4 : 0;
+            int last = (cell->tile == TILE_NONE) ? 4 : 8;
+            for (int d = first; d < last; d++) {
+                int dx = DIR_DX[d];
+                int dy = DIR_DY[d];
+                int tx = x + dx;
+                int ty = y + dy;
+                if (!VF(in_bounds)(tx, ty)) continue;
+
+                Player o = cells[ty * VN + tx].occupant;
+                if (o == PLAYER_NONE) {
+                    Move m = {x, y, tx, ty, 0, -1, -1, TILE_NONE};
+                    out->moves[out->size++] = m;
+                } else if (o == p) {
+                    /* 自駒をジャンプ */
+                    while (VF(in_bounds)(tx, ty) && cells[ty * VN + tx].occupant == p) {
+                        tx += dx;
+                        ty += dy;
+                    }
+                    if (VF(in_bounds)(tx, ty) && cells[ty * VN + tx].occupant == PLAYER_NONE) {
+                        Move m = {x, y, tx, ty, 0, -1, -1, TILE_NONE};
+                        out->moves[out->size++] = m;
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void VF(apply)(VSTATE* s, const Move* move) {
+    if (!VF(in_bounds)(move->sx, move->sy) || !VF(in_bounds)(move->dx, move->dy)) return;
+
+    Cell* src = &s->board.cells[move->sy * VN + move->sx];
+    Cell* dst = &s->board.cells[move->dy * VN + move->dx];
+    dst->occupant = src->occupant;
+    src->occupant = PLAYER_NONE;
+
+    if (move->place_tile && VF(in_bounds)(move->tx, move->ty)) {
+        Cell* c = &s->board.cells[move->ty * VN + move->tx];
+        if (c->tile == TILE_NONE && c->occupant == PLAYER_NONE) {
+            c->tile = move->tile;
+            TileInventory* inv = (s->to_move == PLAYER_BLACK) ? &s->inv_black : &s->inv_white;
+            if (move->tile == TILE_BLACK && inv->black > 0) {
+                inv->black--;
+            } else if (move->tile == TILE_GRAY && inv->gray > 0) {
+                inv->gray--;
+            }
+        }
+    }
+
+    s->to_move = (s->to_move == PLAYER_BLACK) ? PLAYER_WHITE : PLAYER_BLACK;
+    s->ply++;
+}
+
+static int VF(is_win)(const VSTATE* s, Player player) {
+    const Cell* row = &s->board.cells[(player == PLAYER_BLACK) ? (VN - 1) * VN : 0];
+    for (int x = 0; x < VN; x++) {
+        if (row[x].occupant == player) return 1;
+    }
+    return 0;
+}
+
+static void VF(legal_set)(const VSTATE* s, LegalSetWide* out) {
+    memset(out, 0, sizeof(*out));
+
+    MoveList base;
+    VF(base_moves)(s, &base);
+    for (size_t i = 0; i < base.size; i++) {
+        const Move* m = &base.moves[i];
+        int bit = (m->sy * VN + m->sx) * VCELLS + (m->dy * VN + m->dx);
+        out->base[bit / 64] |= 1ULL << (bit % 64);
+    }
+    out->base_count = (uint16_t)base.size;
+
+    for (int i = 0; i < VCELLS; i++) {
+        if (s->board.cells[i].occupant == PLAYER_NONE && s->board.cells[i].tile == TILE_NONE) {
+            out->place_mask |= 1ULL << i;
+        }
+    }
+    const TileInventory* inv = (s->to_move == PLAYER_BLACK) ? &s->inv_black : &s->inv_white;
+    out->place_black = inv->black > 0;
+    out->place_gray = inv->gray > 0;
+}
+
+static int VF(legal_contains)(const LegalSetWide* set, const Move* move) {
+    if (!VF(in_bounds)(move->sx, move->sy) || !VF(in_bounds)(move->dx, move->dy)) return 0;
+    int bit = (move->sy * VN + move->sx) * VCELLS + (move->dy * VN + move->dx);
+    if (!(set->base[bit / 64] & (1ULL << (bit % 64)))) return 0;
+    if (!move->place_tile) return 1;
+
+    if (move->tile == TILE_BLACK) {
+        if (!set->place_black) return 0;
+    } else if (move->tile == TILE_GRAY) {
+        if (!set->place_gray) return 0;
+    } else {
+        return 0;
+    }
+    if (!VF(in_bounds)(move->tx, move->ty)) return 0;
+    return (int)((set->place_mask >> (move->ty * VN + move->tx)) & 1u);
+}
+
+static size_t VF(pack)(const VSTATE* s, uint8_t* out) {
+    size_t size = VARIANT_PACKED_SIZE(VN);
+    memset(out, 0, size);
+    for (int i = 0; i < VCELLS; i++) {
+        const Cell* c = &s->board.cells[i];
+        uint8_t nib = (uint8_t)((c->occupant & 3) | ((c->tile & 3) << 2));
+        out[i / 2] |= (uint8_t)(nib << ((i % 2) * 4));
+    }
+    out[size - 3] = (uint8_t)s->to_move;
+    out[size - 2] = (uint8_t)((s->inv_black.black << 4) | (s->inv_black.gray & 0x0F));
+    out[size - 1] = (uint8_t)((s->inv_white.black << 4) | (s->inv_white.gray & 0x0F));
+    return size;
+}
+
+static int VF(unpack)(const uint8_t* in, VSTATE* out) {
+    size_t size = VARIANT_PACKED_SIZE(VN);
+    VSTATE s;
+    for (int i = 0; i < VCELLS; i++) {
+        uint8_t nib = (uint8_t)((in[i / 2] >> ((i % 2) * 4)) & 0x0F);
+        int occ = nib & 3;
+        int tile = (nib >> 2) & 3;
+        if (occ > PLAYER_WHITE || tile > TILE_GRAY) return 0;
+        s.board.cells[i].occupant = (Player)occ;
+        s.board.cells[i].tile = (TileType)tile;
+    }
+    if (in[size - 3] != PLAYER_BLACK && in[size - 3] != PLAYER_WHITE) return 0;
+    s.to_move = (Player)in[size - 3];
+    s.inv_black.black = in[size - 2] >> 4;
+    s.inv_black.gray = in[size - 2] & 0x0F;
+    s.inv_white.black = in[size - 1] >> 4;
+    s.inv_white.gray = in[size - 1] & 0x0F;
+    s.ply = 0;
+    *out = s;
+    return 1;
+}
+
+/* 静的評価 (search.c の compute_features と同じ特徴量と重み) */
+static int VF(eval)(const VSTATE* s, const EvalWeights* w) {
+    int adv[3] = {0, 0, 0};
+    int lead[3] = {0, 0, 0};
+    int on_black[3] = {0, 0, 0};
+    int on_gray[3] = {0, 0, 0};
+
+    for (int y = 0; y < VN; y++) {
+        for (int x = 0; x < VN; x++) {
+            const Cell* c = &s->board.cells[y * VN + x];
+            if (c->occupant == PLAYER_NONE) continue;
+            int a = (c->occupant == PLAYER_BLACK) ? y : (VN - 1 - y);
+            adv[c->occupant] += a;
+            if (a > lead[c->occupant]) lead[c->occupant] = a;
+            if (c->tile == TILE_BLACK) on_black[c->occupant]++;
+            else if (c->tile == TILE_GRAY) on_gray[c->occupant]++;
+        }
+    }
+
+    Player me = s->to_move;
+    Player op = (me == PLAYER_BLACK) ? PLAYER_WHITE : PLAYER_BLACK;
+    const TileInventory* im = (me == PLAYER_BLACK) ? &s->inv_black : &s->inv_white;
+    const TileInventory* io = (me == PLAYER_BLACK) ? &s->inv_white : &s->inv_black;
+    return w->advance * (adv[me] - adv[op])
+         + w->lead * (lead[me] - lead[op])
+         + w->inv_black * (im->black - io->black)
+         + w->inv_gray * (im->gray - io->gray)
+         + w->on_black * (on_black[me] - on_black[op])
+         + w->on_gray * (on_gray[me] - on_gray[op]);
+}
+
+/* 置換表の鍵 (盤面・手番の FNV-1a に在庫を混ぜる。search.c の search_key と同じ作り) */
+static uint64_t VF(key)(const VSTATE* s) {
+    uint64_t h = 1469598103934665603ULL;
+    for (int i = 0; i < VCELLS; i++) {
+        h ^= (uint64_t)s->board.cells[i].occupant;
+        h *= 1099511628211ULL;
+        h ^= (uint64_t)s->board.cells[i].tile;
+        h *= 1099511628211ULL;
+    }
+    h ^= (uint64_t)s->to_move;
+    h *= 1099511628211ULL;
+    uint64_t inv = (uint64_t)(s->inv_black.black | (s->inv_black.gray << 4) |
+                              (s->inv_white.black << 8) | (s->inv_white.gray << 12));
+    return h ^ (inv * 0x9E3779B97F4A7C15ULL);
+}
+
+static int VF(negamax)(SearchCtx* ctx, const VSTATE* s, int depth, int alpha, int beta, int ply) {
+    ctx->nodes++;
+    if ((ctx->nodes & 1023) == 0 && time_up(ctx)) {
+        ctx->aborted = 1;
+    }
+    if (ctx->aborted) return 0;
+    if (depth == 0) return VF(eval)(s, ctx->w);
+
+    int alpha_orig = alpha;
+    uint64_t key = VF(key)(s);
+    TTEntry* e = &ctx->tt->entries[key & ctx->tt->mask];
+    uint32_t tt_move = UINT32_MAX;
+    uint64_t data = atomic_load_explicit(&e->data, memory_order_relaxed);
+    if ((atomic_load_explicit(&e->check, memory_order_relaxed) ^ data) == key) {
+        int e_score = (int32_t)(uint32_t)(data >> 32);
+        uint32_t e_move = (uint32_t)(data >> 8) & TT_NO_MOVE;
+        int e_depth = (int)((data >> 2) & 63);
+        int e_flag = (int)(data & 3);
+        if (e_move != TT_NO_MOVE) tt_move = e_move;
+        if (e_depth >= depth) {
+            if (e_flag == TT_EXACT) return e_score;
+            if (e_flag == TT_LOWER && e_score > alpha) alpha = e_score;
+            else if (e_flag == TT_UPPER && e_score < beta) beta = e_score;
+            if (alpha >= beta) return e_score;
+        }
+    }
+
+    /* 内部ノードではタイル配置を省いた基本移動のみ読む */
+    MoveList* moves = &ctx->lists[ply];
+    VF(base_moves)(s, moves);
+    if (moves->size == 0) {
+        return -SCORE_WIN + ply;
+    }
+    order_tt_move(moves, tt_move);
+
+    Player me = s->to_move;
+    int best = -SCORE_INF;
+    uint32_t best_move = UINT32_MAX;
+    for (size_t i = 0; i < moves->size; i++) {
+        VSTATE child = *s;
+        VF(apply)(&child, &moves->moves[i]);
+
+        int score;
+        if (VF(is_win)(&child, me)) {
+            score = SCORE_WIN - ply - 1;
+        } else {
+            score = -VF(negamax)(ctx, &child, depth - 1, -beta, -alpha, ply + 1);
+        }
+        if (ctx->aborted) return 0;
+
+        if (score > best) {
+            best = score;
+            best_move = move_pack(&moves->moves[i]);
+        }
+        if (score > alpha) alpha = score;
+        if (alpha >= beta) break;
+    }
+
+    uint64_t flag = (best <= alpha_orig) ? TT_UPPER : (best >= beta) ? TT_LOWER : TT_EXACT;
+    data = ((uint64_t)(uint32_t)best << 32) | ((uint64_t)(best_move & TT_NO_MOVE) << 8) |
+           ((uint64_t)(depth & 63) << 2) | flag;
+    atomic_store_explicit(&e->check, key ^ data, memory_order_relaxed);
+    atomic_store_explicit(&e->data, data, memory_order_relaxed);
+    return best;
+}
+
+/* ルートの全合法手 (タイル配置込み)。大きい盤では MAX_MOVES を超えうるので数えてから確保する */
+static Move* VF(root_moves)(const VSTATE* s, size_t* count) {
+    MoveList base;
+    VF(base_moves)(s, &base);
+    LegalSetWide set;
+    VF(legal_set)(s, &set);
+    size_t places = (size_t)__builtin_popcountll(set.place_mask);
+    size_t variants = 1 + (set.place_black ? places : 0) + (set.place_gray ? places : 0);
+    *count = base.size * variants;
+    if (*count == 0) return NULL;
+
+    Move* moves = malloc(*count * sizeof(Move));
+    if (!moves) {
+        *count = 0;
+        return NULL;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < base.size; i++) {
+        moves[n++] = base.moves[i];
+        for (int t = TILE_BLACK; t <= TILE_GRAY; t++) {
+            if (!(t == TILE_BLACK ? set.place_black : set.place_gray)) continue;
+            for (int c = 0; c < VCELLS; c++) {
+                if (!((set.place_mask >> c) & 1)) continue;
+                Move m = base.moves[i];
+                m.place_tile = 1;
+                m.tx = c % VN;
+                m.ty = c / VN;
+                m.tile = (TileType)t;
+                moves[n++] = m;
+            }
+        }
+    }
+    return moves;
+}
+
+static void VF(search)(const VSTATE* state, const SearchLimits* limits, SearchResult* out) {
+    memset(out, 0, sizeof(*out));
+
+    SearchCtx ctx;
+    int max_depth = variant_search_setup(&ctx, limits);
+    if (max_depth == 0) return;
+    TransTable* own_tt = (limits->tt == NULL) ? ctx.tt : NULL;
+
+    size_t nroot;
+    Move* root = VF(root_moves)(state, &nroot);
+    if (!root) {
+        tt_destroy(own_tt);
+        free(ctx.lists);
+        return;
+    }
+    out->has_move = 1;
+    out->best_move = root[0];
+    out->score = -SCORE_INF;
+    int first_depth = search_resume(limits, root, nroot, max_depth, out);
+
+    Player me = state->to_move;
+    for (int depth = first_depth; depth <= max_depth; depth++) {
+        int alpha = -SCORE_INF;
+        int best = -SCORE_INF;
+        size_t best_idx = 0;
+
+        for (size_t i = 0; i < nroot; i++) {
+            VSTATE child = *state;
+            VF(apply)(&child, &root[i]);
+
+            int score;
+            if (VF(is_win)(&child, me)) {
+                score = SCORE_WIN - 1;
+            } else {
+                score = -VF(negamax)(&ctx, &child, depth - 1, -SCORE_INF, -alpha, 1);
+            }
+            /* 深さ1は必ず読み切る */
+            if (ctx.aborted && depth > 1) break;
+            ctx.aborted = 0;
+
+            if (score > best) {
+                best = score;
+                best_idx = i;
+            }
+            if (score > alpha) alpha = score;
+        }
+        if (ctx.aborted) break;
+
+        Move tmp = root[0];
+        root[0] = root[best_idx];
+        root[best_idx] = tmp;
+
+        out->best_move = root[0];
+        out->score = best;
+        out->depth = depth;
+        if (best >= SCORE_WIN - SEARCH_MAX_DEPTH || best <= -SCORE_WIN + SEARCH_MAX_DEPTH) break;
+        if (time_up(&ctx)) break;
+    }
+    out->nodes = ctx.nodes;
+
+    free(root);
+    tt_destroy(own_tt);
+    free(ctx.lists);
+}
+
+#undef VCELLS
@@ -0,0 +1,92 @@
+#include "./include/contrast_c/wire.h"
+#include <string.h>
+
+size_t wire_encode(uint8_t* out, uint8_t opcode, const void* payload, size_t len) {
+    size_t body = len + 1;
+    out[0] = (uint8_t)(body >> 8);
+    out[1] = (uint8_t)(body & 0xFF);
+    out[2] = opcode;
+    if (len > 0) {
+        memcpy(out + WIRE_HEADER_SIZE, payload, len);
+    }
+    return WIRE_HEADER_SIZE + len;
+}
+
+size_t wire_encode_move(uint8_t* out, uint8_t opcode, const Move* move) {
+    uint32_t p = move_pack(move);
+    uint8_t payload[MOVE_PACKED_SIZE];
+    payload[0] = (uint8_t)(p >> 16);
+    payload[1] = (uint8_t)(p >> 8);
+    payload[2] = (uint8_t)p;
+    return wire_encode(out, opcode, payload, MOVE_PACKED_SIZE);
+}
+
+size_t wire_frame_size(const uint8_t* buf, size_t len) {
+    if (len < 2) return 0;
+    size_t body = ((size_t)buf[0] << 8) | buf[1];
+    if (body == 0 || body + 2 > WIRE_MAX_FRAME) return (size_t)-1;
+    if (len < body + 2) return 0;
+    return body + 2;
+}
+
+int wire_decode_move(const uint8_t* payload, size_t len, Move* out) {
+    if (len != MOVE_PACKED_SIZE) return 0;
+    uint32_t p = ((uint32_t)payload[0] << 16) | ((uint32_t)payload[1] << 8) | payload[2];
+    move_unpack(p, out);
+    return 1;
+}
+
+size_t wire_encode_sync(uint8_t* out, uint8_t opcode, const GameState* state) {
+    uint8_t payload[WIRE_SYNC_SIZE];
+    uint64_t hash = game_state_sync_hash(state);
+    for (int i = 0; i < 4; i++) payload[i] = (uint8_t)(state->ply >> (24 - i * 8));
+    for (int i = 0; i < 8; i++) payload[4 + i] = (uint8_t)(hash >> (56 - i * 8));
+    if (opcode != WIRE_OP_SYNC) return wire_encode(out, opcode, payload, WIRE_CHECK_SIZE);
+    game_state_pack(state, payload + WIRE_CHECK_SIZE);
+    return wire_encode(out, opcode, payload, WIRE_SYNC_SIZE);
+}
+
+size_t wire_encode_variant_sync(uint8_t* out, uint8_t opcode, const VariantGame* g) {
+    if (g->size == 5) return wire_encode_sync(out, opcode, &g->u.s5);
+    uint8_t payload[WIRE_VARIANT_SYNC_MAX];
+    uint64_t hash = variant_sync_hash(g);
+    uint32_t ply = variant_ply(g);
+    for (int i = 0; i < 4; i++) payload[i] = (uint8_t)(ply >> (24 - i * 8));
+    for (int i = 0; i < 8; i++) payload[4 + i] = (uint8_t)(hash >> (56 - i * 8));
+    if (opcode != WIRE_OP_SYNC) return wire_encode(out, opcode, payload, WIRE_CHECK_SIZE);
+    size_t n = variant_pack(g, payload + WIRE_CHECK_SIZE);
+    return wire_encode(out, opcode, payload, WIRE_CHECK_SIZE + n);
+}
+
+int wire_decode_check(const uint8_t* payload, size_t len, uint32_t* ply, uint64_t* hash) {
+    if (len < WIRE_CHECK_SIZE) return 0;
+    *ply = 0;
+    *hash = 0;
+    for (int i = 0; i < 4; i++) *ply = (*ply << 8) | payload[i];
+    for (int i = 0; i < 8; i++) *hash = (*hash << 8) | payload[4 + i];
+    return 1;
+}
+
+int wire_decode_sync(const uint8_t* payload, size_t len, GameState* out) {
+    uint32_t ply;
+    uint64_t hash;
+    GameState s;
+    if (len != WIRE_SYNC_SIZE || !wire_decode_check(payload, len, &ply, &hash)) return 0;
+    if (!game_state_unpack(payload + WIRE_CHECK_SIZE, &s)) return 0;
+    s.ply = ply;
+    if (game_state_sync_hash(&s) != hash) return 0;
+    *out = s;
+    return 1;
+}
+
+int wire_decode_variant_sync(const uint8_t* payload, size_t len, VariantGame* out) {
+    uint32_t ply;
+    uint64_t hash;
+    VariantGame g;
+    if (!wire_decode_check(payload, len, &ply, &hash)) return 0;
+    if (!variant_unpack(payload + WIRE_CHECK_SIZE, len - WIRE_CHECK_SIZE, &g)) return 0;
+    variant_set_ply(&g, ply);
+    if (variant_sync_hash(&g) != hash) return 0;
+    *out = g;
+    return 1;
+}
@@ -1,13 +1,47 @@
 #include "./include/contrast_c/zobrist.h"
-#include <stdlib.h>
+#include <pthread.h>
 
-static uint64_t g_zobrist_hash = 0;
+#define ZOBRIST_SEED 0x12345678ABCDEFULL
+
+/* 表は zobrist_init で1回だけ書き、以後は読むだけ (pthread_once が書き込みの完了を保証する) */
+static ZobristTable g_table;
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+
+static uint64_t splitmix64(uint64_t* x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static void build_table(void) {
+    uint64_t x = ZOBRIST_SEED;
+    for (int i = 0; i < BOARD_CELLS; i++) {
+        for (int o = 0; o < 3; o++) {
+            for (int t = 0; t < 3; t++) {
+                g_table.cell[i][o][t] = splitmix64(&x);
+            }
+        }
+    }
+    g_table.white_to_move = splitmix64(&x);
+}
 
 void zobrist_init(void) {
-    /* 簡易版: 固定シードで初期化 */
-    g_zobrist_hash = 0x12345678ABCDEFULL;
+    pthread_once(&g_once, build_table);
+}
+
+const ZobristTable* zobrist_table(void) {
+    zobrist_init();
+    return &g_table;
 }
 
-uint64_t zobrist_hash(void) {
-    return g_zobrist_hash;
+uint64_t zobrist_hash(const GameState* state) {
+    const ZobristTable* z = zobrist_table();
+    uint64_t h = 0;
+    for (int i = 0; i < BOARD_CELLS; i++) {
+        const Cell* c = &state->board.cells[i];
+        h ^= z->cell[i][c->occupant][c->tile];
+    }
+    if (state->to_move == PLAYER_WHITE) h ^= z->white_to_move;
+    return h;
 }
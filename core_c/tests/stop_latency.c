@@ -0,0 +1,86 @@
+#define _GNU_SOURCE
+#include "../src/include/contrast_c/game_state.h"
+#include "../src/include/contrast_c/rules.h"
+#include "../src/include/contrast_c/search.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* 探索の止まるまでの遅れを測る (make stop-latency)
+ * 別スレッドで深さ・時間とも無制限の探索を走らせ、1〜20ms 後に SearchLimits.stop を
+ * 立ててから search_best_move が戻るまでの時間を測る。局面は初期局面からランダムに
+ * 数手進めたものを試行ごとに作り直す。平均と最大を表示する。 */
+
+#define TRIALS 200
+#define ROOT_PLIES 6
+
+typedef struct {
+    GameState state;
+    TransTable* tt;
+    atomic_int stop;
+    SearchResult result;
+} Trial;
+
+static uint64_t rng_next(uint64_t* s) {
+    *s ^= *s >> 12;
+    *s ^= *s << 25;
+    *s ^= *s >> 27;
+    return *s * 2685821657736338717ULL;
+}
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void* search_main(void* arg) {
+    Trial* t = arg;
+    SearchLimits limits = {0, 0, NULL, t->tt, &t->stop, NULL};
+    search_best_move(&t->state, &limits, &t->result);
+    return NULL;
+}
+
+int main(void) {
+    Trial t;
+    t.tt = tt_create(20);
+    if (!t.tt) {
+        fprintf(stderr, "tt_create failed\n");
+        return 1;
+    }
+
+    uint64_t rng = 0x9e3779b97f4a7c15ULL;
+    long long sum = 0, max = 0;
+    for (int i = 0; i < TRIALS; i++) {
+        game_state_reset(&t.state);
+        MoveList moves;
+        for (int p = 0; p < ROOT_PLIES; p++) {
+            rules_legal_moves(&t.state, &moves);
+            if (moves.size == 0) break;
+            game_state_apply_move(&t.state, &moves.moves[rng_next(&rng) % moves.size]);
+        }
+        tt_clear(t.tt);
+        atomic_store(&t.stop, 0);
+
+        pthread_t th;
+        if (pthread_create(&th, NULL, search_main, &t) != 0) {
+            fprintf(stderr, "pthread_create failed\n");
+            return 1;
+        }
+        struct timespec wait = {0, (long)(1 + rng_next(&rng) % 20) * 1000000L};
+        nanosleep(&wait, NULL);
+
+        long long t0 = now_ns();
+        atomic_store(&t.stop, 1);
+        pthread_join(th, NULL);
+        long long us = (now_ns() - t0) / 1000;
+        sum += us;
+        if (us > max) max = us;
+    }
+    tt_destroy(t.tt);
+
+    printf("stop latency: %d trials, avg %lld us, max %lld us\n", TRIALS, sum / TRIALS, max);
+    return 0;
+}
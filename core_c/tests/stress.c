@@ -0,0 +1,185 @@
+#define _GNU_SOURCE
+#include "../src/include/contrast_c/game_state.h"
+#include "../src/include/contrast_c/rules.h"
+#include "../src/include/contrast_c/search.h"
+#include "../src/include/contrast_c/wire.h"
+#include "../src/include/contrast_c/zobrist.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* core_c の並行実行のストレステスト (make tsan-test で -fsanitize=thread 付きで動かす)
+ * 複数のスレッドが共有の読み取り専用の局面から同時にランダム対局を進め、局面ごとに
+ *  - rules_legal_moves と LegalSet (要素数と、各手が含まれるか)
+ *  - SYNC フレームの往復 (展開した局面のハッシュ・パック結果が元と同じか)
+ *  - zobrist_hash (展開した局面と同じ値か)
+ * を突き合わせる。zobrist_hash は全スレッドがバリアの直後に同時に呼ぶので、初回の表作成も
+ * 競合する。探索は置換表なし・スレッド専用・全スレッドで共有の3通りで回す。
+ * 食い違いがあれば 1 を返す (データ競合は TSan が報告して終了コードを変える)。 */
+
+#define NTHREADS 8
+#define GAMES_PER_THREAD 40
+#define MAX_PLIES 200
+#define SEARCH_EVERY 16 /* この手数ごとに探索する */
+#define SEARCH_DEPTH 3
+#define ROOT_PLIES 6
+
+typedef struct {
+    int id;
+    uint64_t rng;
+    uint64_t first_hash; /* 最初に呼んだ zobrist_hash(&root) */
+    unsigned long positions;
+    unsigned long searches;
+    unsigned long mismatches;
+} Worker;
+
+static GameState root;
+static TransTable* shared_tt;
+static pthread_barrier_t start_barrier;
+
+static uint64_t rng_next(uint64_t* s) {
+    *s ^= *s >> 12;
+    *s ^= *s << 25;
+    *s ^= *s >> 27;
+    return *s * 2685821657736338717ULL;
+}
+
+static void report(Worker* w, const GameState* gs, const char* what) {
+    w->mismatches++;
+    if (w->mismatches <= 5)
+        fprintf(stderr, "thread %d: %s mismatch at ply %u\n", w->id, what, (unsigned)gs->ply);
+}
+
+/* 合法手の列挙と LegalSet が一致するか */
+static void check_legal(Worker* w, const GameState* gs, const MoveList* list) {
+    LegalSet set;
+    rules_legal_set(gs, &set);
+    if (legal_set_size(&set) != list->size) {
+        report(w, gs, "LegalSet size");
+        return;
+    }
+    for (size_t i = 0; i < list->size; i++) {
+        if (!legal_set_contains(&set, &list->moves[i])) {
+            report(w, gs, "LegalSet contains");
+            return;
+        }
+    }
+}
+
+/* SYNC フレームを組み立てて読み戻す */
+static void check_sync(Worker* w, const GameState* gs) {
+    uint8_t frame[WIRE_HEADER_SIZE + WIRE_SYNC_SIZE];
+    size_t n = wire_encode_sync(frame, WIRE_OP_SYNC, gs);
+    if (wire_frame_size(frame, n) != n) {
+        report(w, gs, "SYNC frame size");
+        return;
+    }
+    GameState back;
+    if (!wire_decode_sync(frame + WIRE_HEADER_SIZE, n - WIRE_HEADER_SIZE, &back)) {
+        report(w, gs, "SYNC decode");
+        return;
+    }
+    uint8_t a[GAME_STATE_PACKED_SIZE], b[GAME_STATE_PACKED_SIZE];
+    game_state_pack(gs, a);
+    game_state_pack(&back, b);
+    if (back.ply != gs->ply || game_state_sync_hash(&back) != game_state_sync_hash(gs) ||
+        memcmp(a, b, sizeof(a)) != 0)
+        report(w, gs, "SYNC round trip");
+    else if (zobrist_hash(&back) != zobrist_hash(gs))
+        report(w, gs, "zobrist_hash");
+}
+
+/* 探索の結果が合法手か */
+static void check_search(Worker* w, const GameState* gs, TransTable* tt) {
+    SearchLimits limits = {SEARCH_DEPTH, 0, NULL, tt, NULL, NULL};
+    SearchResult result;
+    search_best_move(gs, &limits, &result);
+    w->searches++;
+    LegalSet set;
+    rules_legal_set(gs, &set);
+    if (!result.has_move || !legal_set_contains(&set, &result.best_move))
+        report(w, gs, "search move");
+}
+
+static void* worker_main(void* arg) {
+    Worker* w = arg;
+    TransTable* own_tt = tt_create(12);
+    if (!own_tt) {
+        w->mismatches++;
+        return NULL;
+    }
+
+    pthread_barrier_wait(&start_barrier);
+    w->first_hash = zobrist_hash(&root);
+
+    MoveList list;
+    for (int g = 0; g < GAMES_PER_THREAD; g++) {
+        GameState gs = root;
+        for (int ply = 0; ply < MAX_PLIES; ply++) {
+            rules_legal_moves(&gs, &list);
+            w->positions++;
+            check_legal(w, &gs, &list);
+            check_sync(w, &gs);
+            if (list.size == 0) break;
+            if (ply % SEARCH_EVERY == 0) {
+                TransTable* tts[3] = {NULL, own_tt, shared_tt};
+                check_search(w, &gs, tts[(g + ply / SEARCH_EVERY) % 3]);
+            }
+            Player mover = gs.to_move;
+            game_state_apply_move(&gs, &list.moves[rng_next(&w->rng) % list.size]);
+            if (rules_is_win(&gs, mover)) break;
+        }
+    }
+    tt_destroy(own_tt);
+    return NULL;
+}
+
+int main(void) {
+    /* 共有の開始局面 (以後は読むだけ) */
+    uint64_t seed = 0x57e55c0deULL;
+    MoveList list;
+    game_state_reset(&root);
+    for (int i = 0; i < ROOT_PLIES; i++) {
+        rules_legal_moves(&root, &list);
+        game_state_apply_move(&root, &list.moves[rng_next(&seed) % list.size]);
+    }
+
+    shared_tt = tt_create(14);
+    if (!shared_tt || pthread_barrier_init(&start_barrier, NULL, NTHREADS) != 0) {
+        fprintf(stderr, "stress: setup failed\n");
+        return 1;
+    }
+
+    pthread_t threads[NTHREADS];
+    Worker workers[NTHREADS];
+    for (int t = 0; t < NTHREADS; t++) {
+        memset(&workers[t], 0, sizeof(Worker));
+        workers[t].id = t;
+        workers[t].rng = seed + (uint64_t)t * 0x9e3779b97f4a7c15ULL;
+        if (pthread_create(&threads[t], NULL, worker_main, &workers[t]) != 0) {
+            fprintf(stderr, "stress: pthread_create failed\n");
+            return 1;
+        }
+    }
+
+    unsigned long positions = 0, searches = 0, mismatches = 0;
+    uint64_t expect = zobrist_hash(&root);
+    for (int t = 0; t < NTHREADS; t++) {
+        pthread_join(threads[t], NULL);
+        positions += workers[t].positions;
+        searches += workers[t].searches;
+        mismatches += workers[t].mismatches;
+        if (workers[t].first_hash != expect) {
+            fprintf(stderr, "thread %d: first zobrist_hash differs\n", t);
+            mismatches++;
+        }
+    }
+    tt_destroy(shared_tt);
+    pthread_barrier_destroy(&start_barrier);
+
+    printf("stress: %d threads, %lu positions, %lu searches, %lu mismatches\n", NTHREADS, positions,
+           searches, mismatches);
+    return mismatches ? 1 : 0;
+}
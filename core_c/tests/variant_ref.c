@@ -0,0 +1,280 @@
+#include "../src/include/contrast_c/variant.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* 盤の大きさの変種 (variant_*) を素朴な実装と突き合わせるテスト (make variant-test)
+ * 参照実装は一辺を実行時の値として持ち、rules.c をそのまま書き写したもの (速さは考えない)。
+ * 大きさごとにランダム対局を進め、局面ごとに
+ *  - 基本移動 (variant_base_moves と参照の列挙が同じ集合か)
+ *  - 合法手集合 (要素数、参照の全合法手が含まれるか、ランダムな手や合法手を1か所変えた手の判定)
+ *  - パック (参照のパック結果と同じバイト列か、variant_unpack で戻した局面が同じか)
+ *  - 勝利判定 (両者とも)
+ * を比べ、同じ手を両方に適用して進める。食い違いがあれば 1 を返す。 */
+
+#define GAMES_PER_SIZE 3000
+#define MAX_PLIES 200
+#define PROBES 16 /* 局面ごとに試すでたらめな手の数 */
+#define REF_MAX_MOVES 8192
+
+typedef struct {
+    int n;
+    Player occ[VARIANT_MAX_SIZE][VARIANT_MAX_SIZE]; /* [y][x] */
+    TileType tile[VARIANT_MAX_SIZE][VARIANT_MAX_SIZE];
+    Player to_move;
+    int inv[3][2]; /* [player][0=黒, 1=灰] */
+    uint32_t ply;
+} RefState;
+
+static Move ref_moves[REF_MAX_MOVES];
+static unsigned long mismatches;
+
+static uint64_t rng_next(uint64_t* s) {
+    *s ^= *s >> 12;
+    *s ^= *s << 25;
+    *s ^= *s >> 27;
+    return *s * 2685821657736338717ULL;
+}
+
+static int ref_in_bounds(const RefState* r, int x, int y) {
+    return x >= 0 && x < r->n && y >= 0 && y < r->n;
+}
+
+static void ref_reset(RefState* r, int n) {
+    memset(r, 0, sizeof(*r));
+    r->n = n;
+    for (int x = 0; x < n; x++) {
+        r->occ[0][x] = PLAYER_BLACK;
+        r->occ[n - 1][x] = PLAYER_WHITE;
+    }
+    r->to_move = PLAYER_BLACK;
+    for (int p = PLAYER_BLACK; p <= PLAYER_WHITE; p++) {
+        r->inv[p][0] = 3;
+        r->inv[p][1] = 1;
+    }
+}
+
+/* rules_base_moves と同じ手順 */
+static size_t ref_base_moves(const RefState* r, Move* out) {
+    static const int ORTHO[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    static const int DIAG[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+    static const int ALL_8[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+    size_t count = 0;
+    Player p = r->to_move;
+    for (int y = 0; y < r->n; y++) {
+        for (int x = 0; x < r->n; x++) {
+            if (r->occ[y][x] != p) continue;
+            const int(*dirs)[2] = ORTHO;
+            int num_dirs = 4;
+            if (r->tile[y][x] == TILE_BLACK) {
+                dirs = DIAG;
+            } else if (r->tile[y][x] == TILE_GRAY) {
+                dirs = ALL_8;
+                num_dirs = 8;
+            }
+            for (int i = 0; i < num_dirs; i++) {
+                int tx = x + dirs[i][0];
+                int ty = y + dirs[i][1];
+                if (!ref_in_bounds(r, tx, ty)) continue;
+                if (r->occ[ty][tx] != PLAYER_NONE && r->occ[ty][tx] != p) continue;
+                while (ref_in_bounds(r, tx, ty) && r->occ[ty][tx] == p) {
+                    tx += dirs[i][0];
+                    ty += dirs[i][1];
+                }
+                if (!ref_in_bounds(r, tx, ty) || r->occ[ty][tx] != PLAYER_NONE) continue;
+                Move m = {x, y, tx, ty, 0, -1, -1, TILE_NONE};
+                out[count++] = m;
+            }
+        }
+    }
+    return count;
+}
+
+/* rules_legal_moves と同じ手順 (基本移動ごとにタイルなし、黒タイル、灰タイルの順) */
+static size_t ref_legal_moves(const RefState* r, Move* out) {
+    Move base[VARIANT_MAX_CELLS * 8];
+    size_t nbase = ref_base_moves(r, base);
+    size_t count = 0;
+    for (size_t i = 0; i < nbase; i++) {
+        out[count++] = base[i];
+        for (int t = 0; t < 2; t++) {
+            if (r->inv[r->to_move][t] == 0) continue;
+            for (int y = 0; y < r->n; y++) {
+                for (int x = 0; x < r->n; x++) {
+                    if (r->occ[y][x] != PLAYER_NONE || r->tile[y][x] != TILE_NONE) continue;
+                    Move m = base[i];
+                    m.place_tile = 1;
+                    m.tx = x;
+                    m.ty = y;
+                    m.tile = t == 0 ? TILE_BLACK : TILE_GRAY;
+                    out[count++] = m;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+static int same_base(const Move* a, const Move* b) {
+    return a->sx == b->sx && a->sy == b->sy && a->dx == b->dx && a->dy == b->dy;
+}
+
+static int ref_contains(const Move* list, size_t n, const Move* m) {
+    for (size_t i = 0; i < n; i++) {
+        if (!same_base(&list[i], m) || list[i].place_tile != (m->place_tile != 0)) continue;
+        if (!m->place_tile) return 1;
+        if (list[i].tx == m->tx && list[i].ty == m->ty && list[i].tile == m->tile) return 1;
+    }
+    return 0;
+}
+
+/* game_state_apply_move と同じ (置けないタイルは黙って置かない) */
+static void ref_apply(RefState* r, const Move* m) {
+    r->occ[m->dy][m->dx] = r->occ[m->sy][m->sx];
+    r->occ[m->sy][m->sx] = PLAYER_NONE;
+    if (m->place_tile && ref_in_bounds(r, m->tx, m->ty) && r->tile[m->ty][m->tx] == TILE_NONE &&
+        r->occ[m->ty][m->tx] == PLAYER_NONE) {
+        int t = m->tile == TILE_BLACK ? 0 : 1;
+        r->tile[m->ty][m->tx] = m->tile;
+        if (r->inv[r->to_move][t] > 0) r->inv[r->to_move][t]--;
+    }
+    r->to_move = r->to_move == PLAYER_BLACK ? PLAYER_WHITE : PLAYER_BLACK;
+    r->ply++;
+}
+
+static int ref_is_win(const RefState* r, Player p) {
+    int row = p == PLAYER_BLACK ? r->n - 1 : 0;
+    for (int x = 0; x < r->n; x++) {
+        if (r->occ[row][x] == p) return 1;
+    }
+    return 0;
+}
+
+/* セル 4bit (占有 2bit + タイル 2bit) を行優先で詰め、手番と在庫を続ける */
+static size_t ref_pack(const RefState* r, uint8_t* out) {
+    size_t size = VARIANT_PACKED_SIZE(r->n);
+    memset(out, 0, size);
+    for (int i = 0; i < r->n * r->n; i++) {
+        int x = i % r->n, y = i / r->n;
+        uint8_t nib = (uint8_t)(r->occ[y][x] | (r->tile[y][x] << 2));
+        out[i / 2] |= (uint8_t)(nib << ((i % 2) * 4));
+    }
+    out[size - 3] = (uint8_t)r->to_move;
+    out[size - 2] = (uint8_t)((r->inv[PLAYER_BLACK][0] << 4) | r->inv[PLAYER_BLACK][1]);
+    out[size - 1] = (uint8_t)((r->inv[PLAYER_WHITE][0] << 4) | r->inv[PLAYER_WHITE][1]);
+    return size;
+}
+
+static void report(const RefState* r, const char* what) {
+    mismatches++;
+    if (mismatches <= 10) fprintf(stderr, "%dx%d ply %u: %s mismatch\n", r->n, r->n, (unsigned)r->ply, what);
+}
+
+/* 盤の内外を少しはみ出す座標 */
+static int rand_coord(const RefState* r, uint64_t* rng) {
+    return (int)(rng_next(rng) % (uint64_t)(r->n + 2)) - 1;
+}
+
+static void check_position(const RefState* r, const VariantGame* g, const Move* legal, size_t nlegal,
+                           uint64_t* rng) {
+    Move base[VARIANT_MAX_CELLS * 8];
+    size_t nbase = ref_base_moves(r, base);
+    MoveList list;
+    variant_base_moves(g, &list);
+    if (list.size != nbase) {
+        report(r, "base move count");
+    } else {
+        for (size_t i = 0; i < nbase; i++) {
+            size_t j = 0;
+            while (j < list.size && !same_base(&list.moves[j], &base[i])) j++;
+            if (j == list.size) {
+                report(r, "base move");
+                break;
+            }
+        }
+    }
+
+    VariantLegalSet set;
+    variant_legal_set(g, &set);
+    if (variant_legal_size(&set) != nlegal) report(r, "legal set size");
+    for (size_t i = 0; i < nlegal; i++) {
+        if (!variant_legal_contains(&set, &legal[i])) {
+            report(r, "legal set contains");
+            break;
+        }
+    }
+    for (int k = 0; k < PROBES; k++) {
+        Move m;
+        if (nlegal > 0 && k % 2 == 0) {
+            /* 合法手の1か所だけ変える */
+            m = legal[rng_next(rng) % nlegal];
+            switch (rng_next(rng) % 6) {
+            case 0: m.dx = rand_coord(r, rng); break;
+            case 1: m.sy = rand_coord(r, rng); break;
+            case 2: m.place_tile = !m.place_tile; m.tx = rand_coord(r, rng); m.ty = rand_coord(r, rng); break;
+            case 3: m.tx = rand_coord(r, rng); break;
+            case 4: m.tile = (TileType)(rng_next(rng) % 3); break;
+            default: break;
+            }
+        } else {
+            m.sx = rand_coord(r, rng);
+            m.sy = rand_coord(r, rng);
+            m.dx = rand_coord(r, rng);
+            m.dy = rand_coord(r, rng);
+            m.place_tile = (int)(rng_next(rng) % 2);
+            m.tx = rand_coord(r, rng);
+            m.ty = rand_coord(r, rng);
+            m.tile = (TileType)(rng_next(rng) % 3);
+        }
+        if (variant_legal_contains(&set, &m) != ref_contains(legal, nlegal, &m)) {
+            report(r, "legal set probe");
+            break;
+        }
+    }
+
+    uint8_t want[VARIANT_PACKED_MAX], got[VARIANT_PACKED_MAX], again[VARIANT_PACKED_MAX];
+    size_t n = ref_pack(r, want);
+    if (variant_pack(g, got) != n || memcmp(want, got, n) != 0) {
+        report(r, "pack");
+    } else {
+        VariantGame back;
+        if (!variant_unpack(got, n, &back) || back.size != r->n || variant_pack(&back, again) != n ||
+            memcmp(want, again, n) != 0)
+            report(r, "unpack");
+    }
+
+    for (int p = PLAYER_BLACK; p <= PLAYER_WHITE; p++) {
+        if (variant_is_win(g, (Player)p) != ref_is_win(r, (Player)p)) report(r, "win check");
+    }
+}
+
+int main(void) {
+    uint64_t rng = 0x5eed0f7a21ULL;
+    for (int size = VARIANT_MIN_SIZE; size <= VARIANT_MAX_SIZE; size++) {
+        unsigned long positions = 0, before = mismatches;
+        for (int game = 0; game < GAMES_PER_SIZE; game++) {
+            RefState r;
+            VariantGame g;
+            ref_reset(&r, size);
+            if (!variant_reset(&g, size)) {
+                report(&r, "reset");
+                break;
+            }
+            for (int ply = 0; ply < MAX_PLIES; ply++) {
+                size_t nlegal = ref_legal_moves(&r, ref_moves);
+                positions++;
+                check_position(&r, &g, ref_moves, nlegal, &rng);
+                if (nlegal == 0) break;
+                const Move* m = &ref_moves[rng_next(&rng) % nlegal];
+                Player mover = r.to_move;
+                ref_apply(&r, m);
+                variant_apply_move(&g, m);
+                if (variant_ply(&g) != r.ply || variant_to_move(&g) != r.to_move) report(&r, "apply");
+                if (ref_is_win(&r, mover)) break;
+            }
+        }
+        printf("variant_ref: %dx%d: %d games, %lu positions, %lu mismatches\n", size, size, GAMES_PER_SIZE,
+               positions, mismatches - before);
+    }
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,373 @@
+#include "server.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/eventfd.h>
+
+#include "contrast_c/search.h"
+
+#define AI_MAX_WORKERS 16
+#define AI_TT_BITS 16
+#define AI_MIN_TIME_MS 20
+#define AI_MAX_RETRIES 3 /* 手を返せなかった探索を依頼し直す回数 (超えたら投了) */
+#define AI_RETRY_MS 50   /* 依頼し直すまでの待ち (1回ごとに倍) */
+
+/* レベルごとの探索深さと思考時間 */
+static const struct
+{
+    int depth;
+    int time_ms;
+} AI_LEVELS[AI_MAX_LEVEL] = {
+    {1, 50},
+    {2, 100},
+    {4, 300},
+    {6, 700},
+    {10, 1500},
+};
+
+/* 思考依頼 1 件 (イベントループが確保し、結果を回収して解放する) */
+typedef struct AiJob
+{
+    struct AiJob *next;
+    int room_slot;
+    unsigned gen; /* 依頼時の Room.gen。回収時に一致しなければ捨てる */
+    VariantGame state;
+    int depth;
+    int time_ms;
+    atomic_int cancel;
+    SearchResult result;
+    struct timespec queued_at;
+    int elapsed_ms;
+} AiJob;
+
+int ai_event_fd = -1;
+
+static pthread_t workers[AI_MAX_WORKERS];
+static int worker_count = 0;
+
+/* 依頼キュー (ワーカーが待機するのでここだけ mutex/condvar) */
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static AiJob *queue_head = NULL;
+static AiJob *queue_tail = NULL;
+static int queue_len = 0;
+static int stopping = 0;
+
+/* 評価の重み (--weights で読んだもの。NULL なら既定値) */
+static EvalWeights weights;
+static const EvalWeights *weights_in_use = NULL;
+
+/* 思考中の数 (劣化制御用) */
+static atomic_int running = 0;
+
+/* 結果は lock-free スタックに積み、イベントループがまとめて回収する */
+static _Atomic(AiJob *) results = NULL;
+
+/* 部屋ごとの未回収の依頼 (close_room で中断させるため) */
+static AiJob *inflight[MAX_ROOMS];
+
+/* 部屋ごとの、手を返せなかった探索の続いた回数と、依頼し直しのタイマー */
+static unsigned char retries[MAX_ROOMS];
+static Timer retry_timers[MAX_ROOMS];
+
+static int elapsed_ms_since(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int)((now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000);
+}
+
+static void push_result(AiJob *job)
+{
+    AiJob *old = atomic_load_explicit(&results, memory_order_relaxed);
+    do
+    {
+        job->next = old;
+    } while (!atomic_compare_exchange_weak_explicit(&results, &old, job,
+                                                    memory_order_release, memory_order_relaxed));
+
+    /* 空のスタックに積んだときだけ起こせば十分 (回収側は eventfd を読んでから取り出す) */
+    if (old == NULL)
+    {
+        uint64_t one = 1;
+        if (write(ai_event_fd, &one, sizeof(one)) < 0)
+            perror("eventfd write");
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    (void)arg;
+    TransTable *tt = tt_create(AI_TT_BITS);
+    trace_thread_name("ai-worker");
+
+    for (;;)
+    {
+        pthread_mutex_lock(&queue_lock);
+        while (!queue_head && !stopping)
+            pthread_cond_wait(&queue_cond, &queue_lock);
+        if (stopping)
+        {
+            pthread_mutex_unlock(&queue_lock);
+            break;
+        }
+        AiJob *job = queue_head;
+        queue_head = job->next;
+        if (!queue_head)
+            queue_tail = NULL;
+        queue_len--;
+        atomic_fetch_add(&running, 1);
+        pthread_mutex_unlock(&queue_lock);
+
+        SearchLimits limits;
+        memset(&limits, 0, sizeof(limits));
+        limits.max_depth = job->depth;
+        limits.time_ms = job->time_ms;
+        limits.weights = weights_in_use;
+        limits.tt = tt;
+        limits.stop = &job->cancel;
+        TRACE_BEGIN(TR_AI_SEARCH);
+        variant_search_best_move(&job->state, &limits, &job->result);
+        TRACE_END(TR_AI_SEARCH);
+        job->elapsed_ms = elapsed_ms_since(&job->queued_at);
+        metrics_record(MET_HIST_AI_THINK, metrics_now() - ((uint64_t)job->queued_at.tv_sec * 1000000000ULL +
+                                                           (uint64_t)job->queued_at.tv_nsec));
+
+        atomic_fetch_sub(&running, 1);
+        push_result(job);
+    }
+
+    tt_destroy(tt);
+    return NULL;
+}
+
+/* 評価の重みをファイルから読む (ワーカーを起動する前に呼ぶ)。読めなければ -1 */
+int ai_load_weights(const char *path)
+{
+    if (!eval_load_weights(path, &weights))
+    {
+        fprintf(stderr, "Cannot load evaluation weights from %s.\n", path);
+        return -1;
+    }
+    weights_in_use = &weights;
+    printf("AI weights: %s\n", path);
+    return 0;
+}
+
+/* ワーカースレッドを起動する。失敗したら -1 (AI 対局は無効) */
+int ai_init(int nworkers)
+{
+    if (nworkers <= 0)
+    {
+        /* イベントループ用に1コア残す */
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        nworkers = (ncpu > 1) ? (int)ncpu - 1 : 1;
+    }
+    if (nworkers > AI_MAX_WORKERS)
+        nworkers = AI_MAX_WORKERS;
+
+    ai_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ai_event_fd < 0)
+    {
+        perror("eventfd");
+        return -1;
+    }
+
+    /* シグナルはイベントループのスレッドで受けるようにワーカーでは塞いでおく */
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    sigaddset(&block, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+    for (int i = 0; i < nworkers; i++)
+    {
+        if (pthread_create(&workers[i], NULL, worker_main, NULL) != 0)
+            break;
+        worker_count++;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (worker_count == 0)
+    {
+        close(ai_event_fd);
+        ai_event_fd = -1;
+        return -1;
+    }
+    printf("AI workers: %d\n", worker_count);
+    return 0;
+}
+
+void ai_shutdown(void)
+{
+    if (worker_count == 0)
+        return;
+
+    pthread_mutex_lock(&queue_lock);
+    stopping = 1;
+    for (int i = 0; i < MAX_ROOMS; i++)
+    {
+        if (inflight[i])
+            atomic_store(&inflight[i]->cancel, 1);
+    }
+    pthread_cond_broadcast(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+
+    for (int i = 0; i < worker_count; i++)
+        pthread_join(workers[i], NULL);
+    worker_count = 0;
+
+    /* 未着手と回収前の依頼を解放する */
+    while (queue_head)
+    {
+        AiJob *next = queue_head->next;
+        free(queue_head);
+        queue_head = next;
+    }
+    AiJob *job = atomic_exchange(&results, NULL);
+    while (job)
+    {
+        AiJob *next = job->next;
+        free(job);
+        job = next;
+    }
+    memset(inflight, 0, sizeof(inflight));
+
+    close(ai_event_fd);
+    ai_event_fd = -1;
+}
+
+int ai_available(void)
+{
+    return worker_count > 0;
+}
+
+int ai_level_valid(int level)
+{
+    return level >= 1 && level <= AI_MAX_LEVEL;
+}
+
+/* AI の手番になった部屋の思考をワーカーへ依頼する */
+void ai_request_move(Room *room)
+{
+    int slot = (int)(room - rooms);
+    AiJob *job = calloc(1, sizeof(AiJob));
+    if (!job)
+    {
+        perror("calloc");
+        return;
+    }
+    job->room_slot = slot;
+    job->gen = room->gen;
+    job->state = room->game;
+    job->depth = AI_LEVELS[room->ai_level - 1].depth;
+    clock_gettime(CLOCK_MONOTONIC, &job->queued_at);
+
+    pthread_mutex_lock(&queue_lock);
+    /* 混雑時はワーカー数を超えた分だけ思考時間を縮めて待ち行列を捌く */
+    int backlog = queue_len + atomic_load(&running) + 1;
+    int budget = AI_LEVELS[room->ai_level - 1].time_ms;
+    if (backlog > worker_count)
+        budget = budget * worker_count / backlog;
+    if (budget < AI_MIN_TIME_MS)
+        budget = AI_MIN_TIME_MS;
+    job->time_ms = budget;
+
+    if (queue_tail)
+        queue_tail->next = job;
+    else
+        queue_head = job;
+    queue_tail = job;
+    queue_len++;
+    inflight[slot] = job;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+/* 部屋を閉じるときに思考中の依頼を打ち切る (結果は gen の不一致で捨てられる) */
+void ai_cancel(Room *room)
+{
+    int slot = (int)(room - rooms);
+    retries[slot] = 0;
+    timer_cancel(&retry_timers[slot]);
+    if (inflight[slot])
+    {
+        atomic_store(&inflight[slot]->cancel, 1);
+        inflight[slot] = NULL;
+    }
+}
+
+/* 手を返せなかった探索の依頼し直し (タイマーホイールから呼ばれる) */
+static void ai_retry(void *arg)
+{
+    Room *room = arg;
+    if (room->active && room->ai_level > 0)
+        ai_request_move(room);
+}
+
+/* 完了した思考結果を盤面に反映する (イベントループのスレッドで呼ぶ) */
+void ai_drain_results(void)
+{
+    AiJob *list = atomic_exchange_explicit(&results, NULL, memory_order_acquire);
+    TRACE_BEGIN(TR_AI_DRAIN);
+
+    /* スタックは新しい順なので反転して完了順に処理する */
+    AiJob *job = NULL;
+    while (list)
+    {
+        AiJob *next = list->next;
+        list->next = job;
+        job = list;
+        list = next;
+    }
+
+    while (job)
+    {
+        AiJob *next = job->next;
+        Room *room = &rooms[job->room_slot];
+        if (inflight[job->room_slot] == job)
+            inflight[job->room_slot] = NULL;
+
+        if (room->active && room->gen == job->gen && room->ai_level > 0 &&
+            !atomic_load(&job->cancel))
+        {
+            if (job->result.has_move)
+            {
+                printf("AI room %d: depth %d, %lu nodes, %d ms (budget %d ms)\n",
+                       room->id, job->result.depth, (unsigned long)job->result.nodes,
+                       job->elapsed_ms, job->time_ms);
+                retries[job->room_slot] = 0;
+                commit_move(room, &job->result.best_move);
+            }
+            else if (retries[job->room_slot] < AI_MAX_RETRIES)
+            {
+                /* 合法手は依頼前に確かめてあるので、手がないのは探索の確保失敗。
+                 * 捨てると AI の手番が終わらないので、間を空けて何回かは依頼し直す */
+                uint64_t delay = (uint64_t)AI_RETRY_MS << retries[job->room_slot];
+                retries[job->room_slot]++;
+                fprintf(stderr, "AI room %d: search returned no move, retrying in %lu ms\n", room->id,
+                        (unsigned long)delay);
+                timer_schedule(&retry_timers[job->room_slot], delay, ai_retry, room);
+            }
+            else
+            {
+                fprintf(stderr, "AI room %d: search keeps failing, resigning\n", room->id);
+                retries[job->room_slot] = 0;
+                ai_resign(room);
+            }
+        }
+        free(job);
+        job = next;
+    }
+    TRACE_END(TR_AI_DRAIN);
+}
+
+/* select() 経路: eventfd を空にしてから回収する */
+void ai_handle_event(void)
+{
+    uint64_t count;
+    io_syscalls++;
+    if (read(ai_event_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        perror("eventfd read");
+    ai_drain_results();
+}
@@ -0,0 +1,137 @@
+#include "server.h"
+
+/* トラフィックキャプチャ (--capture=PATH)
+ * 受信したコマンド (テキスト1行 / バイナリ1フレーム / ハンドシェイク) と
+ * 送信したバイト列を、接続番号と時刻付きで記録する。client/replay で再生し、
+ * 応答の食い違いと遅延を測るのに使う。
+ *
+ * 形式: "CTC1" の後にレコードが続く
+ *   [種別 u8][前レコードからの経過 us (varint)][接続番号 (varint)]
+ *   IN/OUT のみ [長さ (varint)][データ]
+ * 接続番号は accept ごとに 1 から振る (fd は再利用されるので使わない)。 */
+#define CAPTURE_MAGIC "CTC1"
+#define CAPTURE_OPEN 1
+#define CAPTURE_CLOSE 2
+#define CAPTURE_IN 3
+#define CAPTURE_OUT 4
+
+#define CAPTURE_FLUSH_MS 1000
+
+static FILE *capture_fp = NULL;
+static uint64_t last_us = 0;
+static unsigned next_conn_id = 1;
+static Timer flush_timer;
+
+/* 送信は fd しか分からないので fd から接続番号を引く */
+static unsigned *fd_conn = NULL;
+static int fd_conn_cap = 0;
+
+static uint64_t now_us(void)
+{
+    return metrics_now() / 1000;
+}
+
+static void put_varint(uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        putc((int)(v & 0x7F) | 0x80, capture_fp);
+        v >>= 7;
+    }
+    putc((int)v, capture_fp);
+}
+
+static void put_record(int type, unsigned conn, const void *data, size_t len)
+{
+    uint64_t now = now_us();
+    putc(type, capture_fp);
+    put_varint(now - last_us);
+    put_varint(conn);
+    if (type == CAPTURE_IN || type == CAPTURE_OUT)
+    {
+        put_varint(len);
+        fwrite(data, 1, len, capture_fp);
+    }
+    last_us = now;
+}
+
+static void flush_timer_expired(void *arg)
+{
+    (void)arg;
+    fflush(capture_fp);
+    timer_schedule(&flush_timer, CAPTURE_FLUSH_MS, flush_timer_expired, NULL);
+}
+
+/* stdio のバッファにためて 1 秒ごとに書き出す (fsync はしない) */
+int capture_open(const char *path)
+{
+    capture_fp = fopen(path, "wb");
+    if (!capture_fp)
+    {
+        perror("capture open");
+        return -1;
+    }
+    setvbuf(capture_fp, NULL, _IOFBF, 1 << 20);
+    fwrite(CAPTURE_MAGIC, 1, 4, capture_fp);
+    last_us = now_us();
+    timer_schedule(&flush_timer, CAPTURE_FLUSH_MS, flush_timer_expired, NULL);
+    printf("Capture: %s\n", path);
+    return 0;
+}
+
+void capture_close(void)
+{
+    if (!capture_fp)
+        return;
+    timer_cancel(&flush_timer);
+    fclose(capture_fp);
+    capture_fp = NULL;
+    free(fd_conn);
+    fd_conn = NULL;
+    fd_conn_cap = 0;
+}
+
+void capture_conn_open(int client_idx)
+{
+    if (!capture_fp)
+        return;
+    int fd = clients[client_idx].fd;
+    if (fd >= fd_conn_cap)
+    {
+        int cap = fd_conn_cap ? fd_conn_cap : 1024;
+        while (cap <= fd)
+            cap *= 2;
+        unsigned *p = realloc(fd_conn, (size_t)cap * sizeof(unsigned));
+        if (!p)
+            return;
+        memset(p + fd_conn_cap, 0, (size_t)(cap - fd_conn_cap) * sizeof(unsigned));
+        fd_conn = p;
+        fd_conn_cap = cap;
+    }
+    fd_conn[fd] = next_conn_id++;
+    put_record(CAPTURE_OPEN, fd_conn[fd], NULL, 0);
+}
+
+void capture_conn_close(int client_idx)
+{
+    int fd = clients[client_idx].fd;
+    if (!capture_fp || fd < 0 || fd >= fd_conn_cap || fd_conn[fd] == 0)
+        return;
+    put_record(CAPTURE_CLOSE, fd_conn[fd], NULL, 0);
+    fd_conn[fd] = 0;
+}
+
+void capture_inbound(int client_idx, const void *data, size_t len)
+{
+    int fd = clients[client_idx].fd;
+    if (!capture_fp || fd < 0 || fd >= fd_conn_cap || fd_conn[fd] == 0)
+        return;
+    put_record(CAPTURE_IN, fd_conn[fd], data, len);
+}
+
+void capture_outbound(int fd, const void *data, size_t len)
+{
+    if (!capture_fp || fd < 0 || fd >= fd_conn_cap || fd_conn[fd] == 0)
+        return;
+    put_record(CAPTURE_OUT, fd_conn[fd], data, len);
+}
@@ -0,0 +1,306 @@
+#include "server.h"
+
+/* ロビーチャット
+ * ロビーにいる (対局・観戦していない) クライアントはどれか1つのチャンネルに属し、
+ * チャンネルごとの双方向リストで管理する (参加・離脱 O(1))。配信はメンバーだけを辿る。
+ * 発言はその場では送らず、チャンネルごとに 10ms 分をプロトコル別に1つの
+ * 共有バッファへ詰め、まとめて各メンバーの送信キューに積む
+ * (N 件の発言 × M 人でも送信は M 回)。自分の発言も同じバッファで届く。
+ * 発言数はクライアントごとのトークンバケットで制限する。 */
+#define CHAT_MAX_CHANNELS 32
+#define CHAT_NAME_MAX 15
+#define CHAT_FLUSH_MS 10
+#define CHAT_BATCH_BYTES 4096
+#define CHAT_MSG_MAX 200  /* 1発言の本文 (超えた分は切る) */
+#define CHAT_BURST 5      /* 続けて送れる発言数 */
+#define CHAT_REFILL_MS 500 /* 1発言分が回復する時間 */
+
+typedef struct
+{
+    char name[CHAT_NAME_MAX + 1]; /* 空なら未使用 */
+    int head;                     /* メンバーの先頭 (clients[] の添字、なしは -1) */
+    int count;
+    char text[CHAT_BATCH_BYTES]; /* 未送信の発言 (テキスト用) */
+    size_t text_len;
+    uint8_t bin[CHAT_BATCH_BYTES]; /* 同じ発言を TEXT フレームにしたもの */
+    size_t bin_len;
+    Timer flush_timer;
+} ChatChannel;
+
+static ChatChannel channels[CHAT_MAX_CHANNELS]; /* [0] は既定の "lobby" (消さない) */
+
+void chat_init(void)
+{
+    for (int i = 0; i < CHAT_MAX_CHANNELS; i++)
+    {
+        channels[i].name[0] = '\0';
+        channels[i].head = -1;
+        channels[i].count = 0;
+        channels[i].text_len = 0;
+        channels[i].bin_len = 0;
+    }
+    strcpy(channels[0].name, "lobby");
+}
+
+/* ためた発言をメンバー全員に送る */
+static void channel_flush(ChatChannel *ch)
+{
+    timer_cancel(&ch->flush_timer);
+    if (ch->text_len == 0)
+        return;
+
+    SharedBuf *text_buf = NULL;
+    SharedBuf *bin_buf = NULL;
+    for (int i = ch->head; i != -1; i = clients[i].chat_next)
+    {
+        if (clients[i].proto == PROTO_BINARY)
+        {
+            if (!bin_buf)
+                bin_buf = sbuf_new(ch->bin, ch->bin_len);
+            send_shared(clients[i].fd, bin_buf);
+        }
+        else
+        {
+            if (!text_buf)
+                text_buf = sbuf_new(ch->text, ch->text_len);
+            send_shared(clients[i].fd, text_buf);
+        }
+    }
+    sbuf_unref(text_buf);
+    sbuf_unref(bin_buf);
+    ch->text_len = 0;
+    ch->bin_len = 0;
+}
+
+static void flush_timer_expired(void *arg)
+{
+    channel_flush(arg);
+}
+
+static void channel_link(int ch_idx, int client_idx)
+{
+    ChatChannel *ch = &channels[ch_idx];
+    Client *c = &clients[client_idx];
+    c->chat_channel = ch_idx;
+    c->chat_prev = -1;
+    c->chat_next = ch->head;
+    if (ch->head != -1)
+        clients[ch->head].chat_prev = client_idx;
+    ch->head = client_idx;
+    ch->count++;
+}
+
+static void channel_unlink(int client_idx)
+{
+    Client *c = &clients[client_idx];
+    ChatChannel *ch = &channels[c->chat_channel];
+    if (c->chat_prev != -1)
+        clients[c->chat_prev].chat_next = c->chat_next;
+    else
+        ch->head = c->chat_next;
+    if (c->chat_next != -1)
+        clients[c->chat_next].chat_prev = c->chat_prev;
+    ch->count--;
+
+    /* 誰もいなくなったチャンネルは片付ける (送る相手がいないので未送信分も捨てる) */
+    if (ch->count == 0 && c->chat_channel != 0)
+    {
+        timer_cancel(&ch->flush_timer);
+        ch->name[0] = '\0';
+        ch->text_len = 0;
+        ch->bin_len = 0;
+    }
+    c->chat_channel = -1;
+    c->chat_prev = -1;
+    c->chat_next = -1;
+}
+
+static int channel_name_valid(const char *name)
+{
+    size_t len = strlen(name);
+    if (len == 0 || len > CHAT_NAME_MAX)
+        return 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '_' && name[i] != '-')
+            return 0;
+    }
+    return 1;
+}
+
+/* ロビーに入ったとき (接続・対局終了・観戦終了) は既定のチャンネルに入る */
+void chat_enter(int client_idx)
+{
+    if (clients[client_idx].chat_channel != -1)
+        return;
+    channel_link(0, client_idx);
+}
+
+void chat_leave(int client_idx)
+{
+    if (clients[client_idx].chat_channel == -1)
+        return;
+    channel_unlink(client_idx);
+}
+
+/* いるチャンネルの名前 (どこにもいなければ NULL) */
+const char *chat_channel_name(int client_idx)
+{
+    int ch = clients[client_idx].chat_channel;
+    return ch == -1 ? NULL : channels[ch].name;
+}
+
+/* 引き継いだクライアントを元のチャンネルに戻す (なければ作る。作れなければ既定のチャンネル) */
+void chat_restore(int client_idx, const char *name)
+{
+    int found = -1, free_slot = -1;
+    for (int i = 0; i < CHAT_MAX_CHANNELS; i++)
+    {
+        if (channels[i].name[0] && strcmp(channels[i].name, name) == 0)
+        {
+            found = i;
+            break;
+        }
+        if (!channels[i].name[0] && free_slot == -1)
+            free_slot = i;
+    }
+    if (found == -1 && free_slot != -1 && channel_name_valid(name))
+    {
+        found = free_slot;
+        strcpy(channels[found].name, name);
+    }
+    chat_leave(client_idx);
+    channel_link(found == -1 ? 0 : found, client_idx);
+}
+
+/* ためている発言をすべて送る (引き継ぎの前に流しきるため) */
+void chat_flush_all(void)
+{
+    for (int i = 0; i < CHAT_MAX_CHANNELS; i++)
+    {
+        if (channels[i].name[0])
+            channel_flush(&channels[i]);
+    }
+}
+
+/* 発言の頻度を抑える (トークンが足りなければ 0) */
+static int take_token(Client *c)
+{
+    uint64_t now = timer_now_ms();
+    if (c->chat_tokens < CHAT_BURST)
+    {
+        int refill = (int)((now - c->chat_refill_at) / CHAT_REFILL_MS);
+        if (refill > 0)
+        {
+            c->chat_tokens += refill;
+            if (c->chat_tokens > CHAT_BURST)
+                c->chat_tokens = CHAT_BURST;
+            c->chat_refill_at += (uint64_t)refill * CHAT_REFILL_MS;
+        }
+    }
+    else
+    {
+        c->chat_refill_at = now;
+    }
+    if (c->chat_tokens == 0)
+        return 0;
+    c->chat_tokens--;
+    return 1;
+}
+
+void chat_reset_rate(int client_idx)
+{
+    clients[client_idx].chat_tokens = CHAT_BURST;
+    clients[client_idx].chat_refill_at = timer_now_ms();
+}
+
+void chat_say(int client_idx, const char *msg)
+{
+    Client *c = &clients[client_idx];
+    if (c->chat_channel == -1)
+        return;
+    if (!take_token(c))
+    {
+        send_client(client_idx, "Error: Too many messages. Slow down.\n");
+        return;
+    }
+
+    ChatChannel *ch = &channels[c->chat_channel];
+    size_t body = strcspn(msg, "\r\n");
+    if (body > CHAT_MSG_MAX)
+        body = CHAT_MSG_MAX;
+    char line[CHAT_MSG_MAX + 64];
+    int n;
+    if (c->chat_channel == 0)
+        n = snprintf(line, sizeof(line), "Client %d says: %.*s\n", c->fd, (int)body, msg);
+    else
+        n = snprintf(line, sizeof(line), "[#%s] Client %d says: %.*s\n", ch->name, c->fd, (int)body, msg);
+
+    /* 入りきらなければ先にたまっている分を送る */
+    if (ch->text_len + (size_t)n > CHAT_BATCH_BYTES || ch->bin_len + WIRE_HEADER_SIZE + (size_t)n > CHAT_BATCH_BYTES)
+        channel_flush(ch);
+    memcpy(ch->text + ch->text_len, line, (size_t)n);
+    ch->text_len += (size_t)n;
+    ch->bin_len += wire_encode(ch->bin + ch->bin_len, WIRE_OP_TEXT, line, (size_t)n - 1);
+
+    if (!timer_pending(&ch->flush_timer))
+        timer_schedule(&ch->flush_timer, CHAT_FLUSH_MS, flush_timer_expired, ch);
+}
+
+/* CHANNEL          : 今いるチャンネルと一覧
+ * CHANNEL <name>   : チャンネルを移る (なければ作る) */
+void chat_command(int client_idx, const char *args)
+{
+    Client *c = &clients[client_idx];
+    char name[32] = {0};
+    char msg[BUF_SIZE];
+
+    if (c->chat_channel == -1)
+        return;
+    if (sscanf(args, "%31s", name) != 1)
+    {
+        int len = snprintf(msg, sizeof(msg), "Channel #%s.", channels[c->chat_channel].name);
+        for (int i = 0; i < CHAT_MAX_CHANNELS && len < (int)sizeof(msg) - 24; i++)
+        {
+            if (channels[i].name[0])
+                len += snprintf(msg + len, sizeof(msg) - len, " #%s(%d)", channels[i].name, channels[i].count);
+        }
+        snprintf(msg + len, sizeof(msg) - len, "\n");
+        send_client(client_idx, msg);
+        return;
+    }
+    if (!channel_name_valid(name))
+    {
+        send_client(client_idx, "Error: Channel name must be 1-15 of [A-Za-z0-9_-].\n");
+        return;
+    }
+
+    int found = -1, free_slot = -1;
+    for (int i = 0; i < CHAT_MAX_CHANNELS; i++)
+    {
+        if (channels[i].name[0] && strcmp(channels[i].name, name) == 0)
+        {
+            found = i;
+            break;
+        }
+        if (!channels[i].name[0] && free_slot == -1)
+            free_slot = i;
+    }
+    if (found == -1)
+    {
+        if (free_slot == -1)
+        {
+            send_client(client_idx, "Error: Too many channels.\n");
+            return;
+        }
+        found = free_slot;
+        strcpy(channels[found].name, name);
+    }
+    if (found != c->chat_channel)
+    {
+        channel_unlink(client_idx);
+        channel_link(found, client_idx);
+    }
+    snprintf(msg, sizeof(msg), "Joined #%s (%d members).\n", channels[found].name, channels[found].count);
+    send_client(client_idx, msg);
+}
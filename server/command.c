@@ -7,12 +7,13 @@ int parse_coord(const char *str, int *x, int *y)
     char col = tolower(str[0]);
     char row = str[1];
 
-    if (col >= 'a' && col <= 'e')
+    /* 一番大きい盤まで受け付ける (盤外かどうかは合法手の判定で弾く) */
+    if (col >= 'a' && col < 'a' + VARIANT_MAX_SIZE)
         *x = col - 'a';
     else
         return 0;
 
-    if (row >= '1' && row <= '5')
+    if (row >= '1' && row < '1' + VARIANT_MAX_SIZE)
         *y = row - '1';
     else
         return 0;
@@ -20,12 +21,79 @@ int parse_coord(const char *str, int *x, int *y)
     return 1;
 }
 
+/* 盤の大きさ "<n>x<n>" (対応している大きさのみ) */
+static int parse_board_size(const char *tok, int *size)
+{
+    int w, h;
+    char tail;
+    if (sscanf(tok, "%dx%d%c", &w, &h, &tail) != 2 || w != h || !variant_size_valid(w))
+        return 0;
+    *size = w;
+    return 1;
+}
+
+static void clock_setup(Room *room, int base_ms, int inc_ms);
+static void send_clock(Room *room);
+static int room_seats_filled(const Room *room);
+
+/* 2人の対局を始める (JOIN と QUICKMATCH の共通部分)。黒は待っていた側 */
+static void start_match(Room *room, int room_id, int black_idx, int white_idx, int tc_base_ms, int tc_inc_ms,
+                        int board_size)
+{
+    room_open(room, room_id, black_idx, white_idx, 0, PLAYER_NONE, board_size);
+    clock_setup(room, tc_base_ms, tc_inc_ms);
+
+    dir_remove_waiting(black_idx);
+    dir_remove_waiting(white_idx);
+    chat_leave(black_idx);
+    chat_leave(white_idx);
+    clients[black_idx].state = STATE_PLAYING;
+    clients[black_idx].room_id = room_id;
+    clients[black_idx].player_color = PLAYER_BLACK;
+    clients[white_idx].state = STATE_PLAYING;
+    clients[white_idx].room_id = room_id;
+    clients[white_idx].player_color = PLAYER_WHITE;
+
+    room_send_board(room, white_idx);
+    room_send_board(room, black_idx);
+    send_client(white_idx, "Matched! Start! (You are WHITE)\n");
+    send_client(black_idx, "Opponent found! Start! (You are BLACK)\n");
+    room_send_resume_token(room, black_idx);
+    room_send_resume_token(room, white_idx);
+    journal_room_open(room);
+    if (room->tc_base_ms > 0)
+    {
+        clock_start(room);
+        send_clock(room);
+    }
+    printf("Match: Room %d started.\n", room_id);
+}
+
+/* 自動採番の部屋番号 (人間が CREATE した部屋や他の自動採番と衝突しないもの) */
+static int next_auto_room_id(int *next, int base)
+{
+    for (;;)
+    {
+        int room_id = (*next)++;
+        if (*next < base)
+            *next = base;
+        int used = (get_room(room_id) != NULL);
+        for (int j = 0; j < MAX_CLIENTS && !used; j++)
+        {
+            if (clients[j].state == STATE_WAITING && clients[j].room_id == room_id)
+                used = 1;
+        }
+        if (!used)
+            return room_id;
+    }
+}
+
 void process_lobby_command(int client_idx, char *buffer)
 {
-    char cmd[10] = {0};
+    char cmd[16] = {0};
     int room_id = -1;
 
-    int parsed = sscanf(buffer, "%9s", cmd);
+    int parsed = sscanf(buffer, "%15s", cmd);
     if (parsed < 1)
         return;
 
@@ -33,51 +101,22 @@ void process_lobby_command(int client_idx, char *buffer)
     {
         char *msg_ptr = strstr(buffer, " ");
         if (msg_ptr)
-            broadcast_lobby(client_idx, msg_ptr + 1);
+            chat_say(client_idx, msg_ptr + 1);
+    }
+    else if (strcmp(cmd, "CHANNEL") == 0)
+    {
+        chat_command(client_idx, strstr(buffer, "CHANNEL") + 7);
     }
     else if (strcmp(cmd, "LIST") == 0)
     {
-        char list_buf[BUF_SIZE] = "Active Rooms:\n";
-        int found = 0;
-
-        for (int i = 0; i < MAX_CLIENTS; i++)
-        {
-            if (clients[i].state == STATE_WAITING)
-            {
-                char line[64];
-                sprintf(line, "- Room %d (Waiting)\n", clients[i].room_id);
-                if (strlen(list_buf) + strlen(line) < BUF_SIZE - 1)
-                {
-                    strcat(list_buf, line);
-                }
-                found = 1;
-            }
-        }
-        for (int i = 0; i < MAX_ROOMS; i++)
-        {
-            if (rooms[i].active)
-            {
-                char line[64];
-                sprintf(line, "- Room %d (Playing)\n", rooms[i].id);
-                if (strlen(list_buf) + strlen(line) < BUF_SIZE - 1)
-                {
-                    strcat(list_buf, line);
-                }
-                found = 1;
-            }
-        }
-        if (!found)
-        {
-            strcat(list_buf, "(None)\n");
-        }
-        send_msg(clients[client_idx].fd, list_buf);
+        dir_send_list(client_idx, strstr(buffer, "LIST") + 4);
     }
     else if (strcmp(cmd, "CREATE") == 0)
     {
         if (sscanf(buffer, "%*s %d", &room_id) == 1)
         {
-            int exists = 0;
-            for (int j = 0; j < MAX_CLIENTS; j++)
+            int exists = (get_room(room_id) != NULL); /* 復元された部屋も含む */
+            for (int j = 0; j < MAX_CLIENTS && !exists; j++)
             {
                 if (clients[j].state != STATE_NONE && clients[j].room_id == room_id)
                 {
@@ -87,14 +126,34 @@ void process_lobby_command(int client_idx, char *buffer)
             }
             if (exists)
             {
-                send_msg(clients[client_idx].fd, "Error: Room exists.\n");
+                send_client(client_idx, "Error: Room exists.\n");
             }
             else
             {
+                /* 任意で持ち時間 "<分>+<秒>" と盤の大きさ "<n>x<n>" (例: CREATE 7 5+3 7x7) */
+                int minutes = 0, inc_sec = 0, size = BOARD_W, bad = 0;
+                char *save = NULL;
+                strtok_r(buffer, " \t\r\n", &save); /* CREATE */
+                strtok_r(NULL, " \t\r\n", &save);   /* 部屋番号 */
+                for (char *tok; (tok = strtok_r(NULL, " \t\r\n", &save)) != NULL;)
+                {
+                    if (strchr(tok, 'x') ? !parse_board_size(tok, &size) : sscanf(tok, "%d+%d", &minutes, &inc_sec) < 1)
+                        bad = 1;
+                }
+                if (bad || minutes < 0 || inc_sec < 0 || minutes > 24 * 60 || inc_sec > 3600)
+                {
+                    send_client(client_idx, "Error: Use 'CREATE <id> [<min>+<inc_sec>] [6x6|7x7]'.\n");
+                    return;
+                }
+                qm_leave(client_idx);
+                clients[client_idx].tc_base_ms = minutes * 60 * 1000;
+                clients[client_idx].tc_inc_ms = (minutes > 0) ? inc_sec * 1000 : 0;
+                clients[client_idx].board_size = size;
                 clients[client_idx].state = STATE_WAITING;
                 clients[client_idx].room_id = room_id;
                 clients[client_idx].player_color = PLAYER_BLACK;
-                send_msg(clients[client_idx].fd, "Room created. Waiting... (You are BLACK)\n");
+                dir_add_waiting(client_idx);
+                send_client(client_idx, "Room created. Waiting... (You are BLACK)\n");
                 printf("Client %d created Room %d\n", clients[client_idx].fd, room_id);
             }
         }
@@ -119,53 +178,304 @@ void process_lobby_command(int client_idx, char *buffer)
                 Room *room = get_free_room();
                 if (room == NULL)
                 {
-                    send_msg(clients[client_idx].fd, "Error: Server room capacity full.\n");
+                    send_client(client_idx, "Error: Server room capacity full.\n");
                     return;
                 }
+                qm_leave(client_idx);
+                start_match(room, room_id, opponent_idx, client_idx,
+                            clients[opponent_idx].tc_base_ms, clients[opponent_idx].tc_inc_ms,
+                            clients[opponent_idx].board_size);
+            }
+            else
+            {
+                send_client(client_idx, "Error: Room not found.\n");
+            }
+        }
+    }
+    else if (strcmp(cmd, "PLAY_AI") == 0)
+    {
+        /* PLAY_AI <レベル> [WHITE] [<n>x<n>] */
+        int level = 0, size = BOARD_W, bad = 0;
+        char color[10] = {0};
+        char *save = NULL;
+        strtok_r(buffer, " \t\r\n", &save); /* PLAY_AI */
+        char *tok = strtok_r(NULL, " \t\r\n", &save);
+        if (!tok || sscanf(tok, "%d", &level) != 1)
+            bad = 1;
+        while ((tok = strtok_r(NULL, " \t\r\n", &save)) != NULL)
+        {
+            if (strchr(tok, 'x'))
+                bad |= !parse_board_size(tok, &size);
+            else
+                snprintf(color, sizeof(color), "%s", tok);
+        }
+        if (bad || !ai_level_valid(level))
+        {
+            send_client(client_idx, "Error: Use 'PLAY_AI <1-5> [WHITE] [6x6|7x7]'.\n");
+            return;
+        }
+        if (clients[client_idx].state != STATE_LOBBY)
+        {
+            send_client(client_idx, "Error: Leave your room first.\n");
+            return;
+        }
+        if (!ai_available())
+        {
+            send_client(client_idx, "Error: AI is not available.\n");
+            return;
+        }
 
-                room->id = room_id;
-                room->active = 1;
-                room->black_idx = opponent_idx;
-                room->white_idx = client_idx;
-                game_state_reset(&room->game_state);
+        int ai_games = 0;
+        for (int i = 0; i < MAX_ROOMS; i++)
+        {
+            if (rooms[i].active && rooms[i].ai_level > 0)
+                ai_games++;
+        }
+        Room *room = (ai_games < AI_MAX_GAMES) ? get_free_room() : NULL;
+        if (room == NULL)
+        {
+            send_client(client_idx, "Error: Server room capacity full.\n");
+            return;
+        }
 
-                clients[opponent_idx].state = STATE_PLAYING;
-                clients[client_idx].state = STATE_PLAYING;
-                clients[client_idx].room_id = room_id;
-                clients[client_idx].player_color = PLAYER_WHITE;
+        /* 部屋番号は人間同士の部屋と衝突しないものを採番する */
+        static int next_ai_room = AI_ROOM_ID_BASE;
+        room_id = next_auto_room_id(&next_ai_room, AI_ROOM_ID_BASE);
+
+        Player human = (tolower((unsigned char)color[0]) == 'w') ? PLAYER_WHITE : PLAYER_BLACK;
+        room_open(room, room_id,
+                  (human == PLAYER_BLACK) ? client_idx : -1,
+                  (human == PLAYER_WHITE) ? client_idx : -1,
+                  level, (human == PLAYER_BLACK) ? PLAYER_WHITE : PLAYER_BLACK, size);
+
+        chat_leave(client_idx);
+        clients[client_idx].state = STATE_PLAYING;
+        clients[client_idx].room_id = room_id;
+        clients[client_idx].player_color = human;
+
+        room_send_board(room, client_idx);
+        char msg[96];
+        sprintf(msg, "AI (level %d) game in Room %d. Start! (You are %s)\n",
+                level, room_id, (human == PLAYER_BLACK) ? "BLACK" : "WHITE");
+        send_client(client_idx, msg);
+        room_send_resume_token(room, client_idx);
+        journal_room_open(room);
+        printf("Match: Room %d started vs AI level %d.\n", room_id, level);
+
+        /* 黒 (先手) が AI ならすぐ思考させる */
+        if (variant_to_move(&room->game) == room->ai_color)
+            ai_request_move(room);
+    }
+    else if (strcmp(cmd, "RESUME") == 0)
+    {
+        unsigned long long token = 0;
+        if (sscanf(buffer, "%*s %d %llx", &room_id, &token) != 2)
+        {
+            send_client(client_idx, "Error: Use 'RESUME <room_id> <token>'.\n");
+            return;
+        }
+        if (clients[client_idx].state != STATE_LOBBY)
+        {
+            send_client(client_idx, "Error: Leave your room first.\n");
+            return;
+        }
+        Room *room = get_room(room_id);
+        Player seat = PLAYER_NONE;
+        if (room && token != 0)
+        {
+            if (room->black_idx == -1 && room->ai_color != PLAYER_BLACK && room->token[PLAYER_BLACK] == token)
+                seat = PLAYER_BLACK;
+            else if (room->white_idx == -1 && room->ai_color != PLAYER_WHITE && room->token[PLAYER_WHITE] == token)
+                seat = PLAYER_WHITE;
+        }
+        if (seat == PLAYER_NONE)
+        {
+            send_client(client_idx, "Error: No seat to resume.\n");
+            return;
+        }
 
-                send_msg(clients[client_idx].fd, "Matched! Start! (You are WHITE)\n");
-                send_msg(clients[opponent_idx].fd, "Opponent found! Start! (You are BLACK)\n");
-                printf("Match: Room %d started.\n", room_id);
+        if (seat == PLAYER_BLACK)
+            room->black_idx = client_idx;
+        else
+            room->white_idx = client_idx;
+        chat_leave(client_idx);
+        clients[client_idx].state = STATE_PLAYING;
+        clients[client_idx].room_id = room_id;
+        clients[client_idx].player_color = seat;
+
+        /* 局面を送ってから席を知らせる (クライアントはスナップショットに手番を重ねる) */
+        room_send_snapshot(room, client_idx);
+        char msg[64];
+        sprintf(msg, "Resumed Room %d as %s.\n", room_id, (seat == PLAYER_BLACK) ? "BLACK" : "WHITE");
+        send_client(client_idx, msg);
+        printf("Client %d resumed Room %d.\n", clients[client_idx].fd, room_id);
+
+        /* 全員そろったら RESUME 待ちをやめて時計を再開する */
+        if (room_seats_filled(room))
+        {
+            timer_cancel(&room->clock_timer);
+            if (room->tc_base_ms > 0)
+            {
+                clock_start(room);
+                send_clock(room);
+            }
+        }
+    }
+    else if (strcmp(cmd, "STATS") == 0)
+    {
+        if (!clients[client_idx].admin)
+        {
+            send_client(client_idx, "Error: STATS is for local admins only.\n");
+            return;
+        }
+        metrics_send_stats(client_idx);
+    }
+    else if (strcmp(cmd, "TRACE") == 0)
+    {
+        char arg[10] = {0};
+        sscanf(buffer, "%*s %9s", arg);
+        if (!clients[client_idx].admin)
+        {
+            send_client(client_idx, "Error: TRACE is for local admins only.\n");
+        }
+        else if (strcmp(arg, "ON") == 0 || strcmp(arg, "OFF") == 0)
+        {
+            trace_set_enabled(arg[1] == 'N');
+            send_client(client_idx, arg[1] == 'N' ? "Trace on.\n" : "Trace off.\n");
+        }
+        else if (strcmp(arg, "DUMP") == 0)
+        {
+            send_client(client_idx, trace_dump() == 0 ? "Trace dumped.\n" : "Error: Trace dump failed.\n");
+        }
+        else
+        {
+            send_client(client_idx, "Error: Use 'TRACE ON|OFF|DUMP'.\n");
+        }
+    }
+    else if (strcmp(cmd, "QUICKMATCH") == 0)
+    {
+        /* QUICKMATCH [<分>+<秒>] [<レーティング>] / QUICKMATCH CANCEL */
+        Client *c = &clients[client_idx];
+        int minutes = 0, inc_sec = 0, rating = -1, bad = 0;
+        char *save = NULL;
+        char *tok = strtok_r(strstr(buffer, cmd) + strlen(cmd), " \t\r\n", &save);
+        if (tok && strcasecmp(tok, "CANCEL") == 0)
+        {
+            if (c->state != STATE_QUEUED)
+            {
+                send_client(client_idx, "Error: Not in queue.\n");
+                return;
             }
+            qm_leave(client_idx);
+            c->state = STATE_LOBBY;
+            send_client(client_idx, "Left the queue.\n");
+            return;
+        }
+        for (; tok; tok = strtok_r(NULL, " \t\r\n", &save))
+        {
+            if (strchr(tok, '+'))
+                bad |= (sscanf(tok, "%d+%d", &minutes, &inc_sec) != 2);
             else
+                bad |= (sscanf(tok, "%d", &rating) != 1 || rating < 0);
+        }
+        if (bad || minutes < 0 || inc_sec < 0 || minutes > 24 * 60 || inc_sec > 3600 || rating > 4000)
+        {
+            send_client(client_idx, "Error: Use 'QUICKMATCH [<min>+<inc_sec>] [<rating 0-4000>]'.\n");
+            return;
+        }
+        int base_ms = minutes * 60 * 1000;
+        int inc_ms = (minutes > 0) ? inc_sec * 1000 : 0;
+
+        /* 部屋が足りないときは並ばせない (相手を行列から外した後で失敗しないように) */
+        Room *room = get_free_room();
+        if (room == NULL)
+        {
+            send_client(client_idx, "Error: Server room capacity full.\n");
+            return;
+        }
+        qm_leave(client_idx);
+        dir_remove_waiting(client_idx);
+        c->state = STATE_LOBBY;
+        c->room_id = -1;
+
+        int partner = qm_pair_or_enqueue(client_idx, base_ms, inc_ms, rating);
+        if (partner >= 0)
+        {
+            static int next_qm_room = QM_ROOM_ID_BASE;
+            /* QUICKMATCH は標準の 5x5 のみ */
+            start_match(room, next_auto_room_id(&next_qm_room, QM_ROOM_ID_BASE), partner, client_idx, base_ms, inc_ms,
+                        BOARD_W);
+        }
+        else if (partner == -1)
+        {
+            char msg[96];
+            c->state = STATE_QUEUED;
+            sprintf(msg, "Queued for a match (%d waiting). 'QUICKMATCH CANCEL' to leave.\n", qm_queued());
+            send_client(client_idx, msg);
+        }
+        else
+        {
+            send_client(client_idx, "Error: Queue is full.\n");
+        }
+    }
+    else if (strcmp(cmd, "WATCH") == 0)
+    {
+        if (sscanf(buffer, "%*s %d", &room_id) == 1)
+        {
+            if (clients[client_idx].state != STATE_LOBBY)
+            {
+                send_client(client_idx, "Error: Leave your room first.\n");
+                return;
+            }
+            Room *room = get_room(room_id);
+            if (!room)
             {
-                send_msg(clients[client_idx].fd, "Error: Room not found.\n");
+                send_client(client_idx, "Error: Room not found.\n");
+                return;
             }
+            room_add_watcher(room, client_idx);
+            send_client(client_idx, "Watching. Use 'UNWATCH' to return to lobby.\n");
+            room_send_snapshot(room, client_idx);
         }
     }
     else
     {
-        send_msg(clients[client_idx].fd, "Unknown command.\n");
+        send_client(client_idx, "Unknown command.\n");
     }
 }
 
-void process_game_move(int client_idx, char *buffer)
+/* SYNC        : 今の部屋の局面・手数・ハッシュを送る (対局中か観戦中)
+ * SYNC ON|OFF : 自分の対局で1手ごとに CHECK を送るか */
+void process_sync_command(int client_idx, const char *buffer)
 {
-    Room *room = get_room(clients[client_idx].room_id);
-    if (!room)
+    Client *c = &clients[client_idx];
+    char arg[8] = {0};
+    if (sscanf(buffer, "%*s %7s", arg) == 1)
     {
-        send_msg(clients[client_idx].fd, "Error: Room error.\n");
+        if (strcasecmp(arg, "ON") == 0 || strcasecmp(arg, "OFF") == 0)
+        {
+            c->sync_check = (strcasecmp(arg, "ON") == 0);
+            send_client(client_idx, c->sync_check ? "Sync check on.\n" : "Sync check off.\n");
+        }
+        else
+        {
+            send_client(client_idx, "Error: Use 'SYNC [ON|OFF]'.\n");
+        }
         return;
     }
 
-    Player current_turn = game_state_current_player(&room->game_state);
-    if (current_turn != clients[client_idx].player_color)
+    Room *room = (c->state == STATE_PLAYING || c->state == STATE_WATCHING) ? get_room(c->room_id) : NULL;
+    if (!room)
     {
-        send_msg(clients[client_idx].fd, "Error: Not your turn.\n");
+        send_client(client_idx, "Error: Not in a room.\n");
         return;
     }
+    room_send_sync(room, client_idx, 1);
+}
 
+/* テキストの MOVE コマンドを解析する */
+void process_game_move(int client_idx, char *buffer)
+{
     char *args_ptr = strstr(buffer, " ");
     if (!args_ptr)
         return;
@@ -192,13 +502,13 @@ void process_game_move(int client_idx, char *buffer)
 
     if (count < 2)
     {
-        send_msg(clients[client_idx].fd, "Error: Invalid format. Use 'a1,a2' or 'a1,a2 b1g'\n");
+        send_client(client_idx, "Error: Invalid format. Use 'a1,a2' or 'a1,a2 b1g'\n");
         return;
     }
 
     if (!parse_coord(src_str, &sx, &sy) || !parse_coord(dst_str, &dx, &dy))
     {
-        send_msg(clients[client_idx].fd, "Error: Invalid coordinates.\n");
+        send_client(client_idx, "Error: Invalid coordinates.\n");
         return;
     }
 
@@ -209,7 +519,7 @@ void process_game_move(int client_idx, char *buffer)
 
         if (!parse_coord(t_coord, &tx, &ty))
         {
-            send_msg(clients[client_idx].fd, "Error: Invalid tile coordinates.\n");
+            send_client(client_idx, "Error: Invalid tile coordinates.\n");
             return;
         }
 
@@ -219,7 +529,7 @@ void process_game_move(int client_idx, char *buffer)
             tile_type = TILE_GRAY;
         else
         {
-            send_msg(clients[client_idx].fd, "Error: Invalid tile color (b/g).\n");
+            send_client(client_idx, "Error: Invalid tile color (b/g).\n");
             return;
         }
         place_tile = 1;
@@ -235,83 +545,244 @@ void process_game_move(int client_idx, char *buffer)
     req_move.ty = ty;
     req_move.tile = tile_type;
 
-    MoveList legals;
-    rules_legal_moves(&room->game_state, &legals);
+    process_move(client_idx, &req_move);
+}
 
-    int is_legal = 0;
-    for (size_t i = 0; i < legals.size; i++)
+/* 解析済みの指し手を検証・適用する (テキスト/バイナリ共通) */
+void process_move(int client_idx, const Move *req_move)
+{
+    Room *room = get_room(clients[client_idx].room_id);
+    if (!room)
     {
-        Move *m = &legals.moves[i];
-        if (m->sx == req_move.sx && m->sy == req_move.sy &&
-            m->dx == req_move.dx && m->dy == req_move.dy &&
-            m->place_tile == req_move.place_tile)
-        {
-
-            if (m->place_tile)
-            {
-                if (m->tx == req_move.tx && m->ty == req_move.ty && m->tile == req_move.tile)
-                {
-                    is_legal = 1;
-                }
-            }
-            else
-            {
-                is_legal = 1;
-            }
-        }
-        if (is_legal)
-            break;
+        send_client(client_idx, "Error: Room error.\n");
+        return;
     }
 
-    if (!is_legal)
+    Player current_turn = variant_to_move(&room->game);
+    if (current_turn != clients[client_idx].player_color)
     {
-        send_msg(clients[client_idx].fd, "Error: Illegal move.\n");
+        send_client(client_idx, "Error: Not your turn.\n");
         return;
     }
 
-    game_state_apply_move(&room->game_state, &req_move);
+    TRACE_BEGIN(TR_PROCESS_MOVE);
+    TRACE_BEGIN(TR_LEGAL_SET);
+    uint64_t started = metrics_now();
+    int legal = variant_legal_contains(room_legal_set(room), req_move);
+    metrics_record(MET_HIST_VALIDATE, metrics_now() - started);
+    TRACE_END(TR_LEGAL_SET);
+    if (!legal)
+    {
+        metrics_add(MET_MOVES_REJECTED, 1);
+        send_client(client_idx, "Error: Illegal move.\n");
+    }
+    else
+    {
+        commit_move(room, req_move);
+    }
+    TRACE_END(TR_PROCESS_MOVE);
+}
 
-    int opponent_idx = (client_idx == room->black_idx) ? room->white_idx : room->black_idx;
-    char move_msg[BUF_SIZE];
+/* 対局者をロビーへ戻す (AI 側は -1) */
+static void release_player(int client_idx)
+{
+    if (client_idx < 0)
+        return;
+    clients[client_idx].state = STATE_LOBBY;
+    clients[client_idx].room_id = -1;
+    clients[client_idx].player_color = PLAYER_NONE;
+    chat_enter(client_idx);
+}
 
-    sprintf(move_msg, "OPPONENT_MOVE %d %d %d %d %d %d %d %d\n",
-            sx, sy, dx, dy, place_tile, tx, ty, (int)tile_type);
-    send_msg(clients[opponent_idx].fd, move_msg);
+/* 勝敗を通知して部屋を閉じる */
+static void end_game(Room *room, Player winner, int result, const char *win_msg, const char *lose_msg,
+                     const char *reason)
+{
+    int win_idx = (winner == PLAYER_BLACK) ? room->black_idx : room->white_idx;
+    int lose_idx = (winner == PLAYER_BLACK) ? room->white_idx : room->black_idx;
+    char over_msg[64];
+
+    metrics_add(MET_GAMES_FINISHED, 1);
+    if (win_idx >= 0)
+        send_client(win_idx, win_msg);
+    if (lose_idx >= 0)
+        send_client(lose_idx, lose_msg);
+    sprintf(over_msg, "GAME_OVER %s%s\n", (winner == PLAYER_BLACK) ? "BLACK" : "WHITE", reason);
+    room_broadcast_text(room, over_msg);
+    journal_result(room, winner, result);
+    close_room(room);
+
+    release_player(win_idx);
+    release_player(lose_idx);
+}
 
-    sprintf(move_msg, "YOUR_MOVE %d %d %d %d %d %d %d %d\n",
-            sx, sy, dx, dy, place_tile, tx, ty, (int)tile_type);
-    send_msg(clients[client_idx].fd, move_msg);
+static Player opposite(Player p)
+{
+    return (p == PLAYER_BLACK) ? PLAYER_WHITE : PLAYER_BLACK;
+}
 
-    if (rules_is_win(&room->game_state, clients[client_idx].player_color))
-    {
-        send_msg(clients[client_idx].fd, "WIN\n");
-        send_msg(clients[opponent_idx].fd, "LOSE\n");
-        close_room(room);
+static void clock_setup(Room *room, int base_ms, int inc_ms)
+{
+    room->tc_base_ms = base_ms;
+    room->tc_inc_ms = inc_ms;
+    room->clock_ms[PLAYER_BLACK] = base_ms;
+    room->clock_ms[PLAYER_WHITE] = base_ms;
+}
+
+/* 手番側の時間切れ (タイマーホイールから呼ばれる) */
+static void clock_expired(void *arg)
+{
+    Room *room = arg;
+    if (!room->active)
+        return;
+    Player loser = variant_to_move(&room->game);
+    room->clock_ms[loser] = 0;
+    end_game(room, opposite(loser), RESULT_TIMEOUT, "WIN (Opponent Timeout)\n", "LOSE (Timeout)\n", " (Timeout)");
+}
+
+/* 手番側の残り時間でタイマーを付け直す */
+void clock_start(Room *room)
+{
+    if (room->tc_base_ms <= 0)
+        return;
+    Player p = variant_to_move(&room->game);
+    room->turn_started = timer_now_ms();
+    room->clock_running = 1;
+    timer_schedule(&room->clock_timer, room->clock_ms[p] > 0 ? (uint64_t)room->clock_ms[p] : 0,
+                   clock_expired, room);
+}
 
-        clients[client_idx].state = STATE_LOBBY;
-        clients[client_idx].room_id = -1;
-        clients[client_idx].player_color = PLAYER_NONE;
+/* 残り時間を対局者に知らせる */
+static void send_clock(Room *room)
+{
+    char msg[64];
+    sprintf(msg, "CLOCK %lld %lld\n", (long long)room->clock_ms[PLAYER_BLACK],
+            (long long)room->clock_ms[PLAYER_WHITE]);
+    if (room->black_idx >= 0)
+        send_client(room->black_idx, msg);
+    if (room->white_idx >= 0)
+        send_client(room->white_idx, msg);
+}
+
+/* 両方の席に対局者 (または AI) がいるか */
+static int room_seats_filled(const Room *room)
+{
+    return (room->black_idx >= 0 || room->ai_color == PLAYER_BLACK) &&
+           (room->white_idx >= 0 || room->ai_color == PLAYER_WHITE);
+}
+
+/* 復元した部屋で期限までに戻らなかった側の負けにする */
+static void resume_expired(void *arg)
+{
+    Room *room = arg;
+    if (!room->active || room_seats_filled(room))
+        return;
 
-        clients[opponent_idx].state = STATE_LOBBY;
-        clients[opponent_idx].room_id = -1;
-        clients[opponent_idx].player_color = PLAYER_NONE;
+    int black_here = room->black_idx >= 0 || room->ai_color == PLAYER_BLACK;
+    int white_here = room->white_idx >= 0 || room->ai_color == PLAYER_WHITE;
+    if (black_here || white_here)
+    {
+        end_game(room, black_here ? PLAYER_BLACK : PLAYER_WHITE, RESULT_ABANDONED,
+                 "WIN (Opponent did not return)\n", "LOSE (Abandoned)\n", " (Abandoned)");
+        return;
     }
-    else
+    printf("Room %d abandoned.\n", room->id);
+    room_broadcast_text(room, "GAME_OVER NONE (Abandoned)\n");
+    journal_result(room, PLAYER_NONE, RESULT_ABANDONED);
+    close_room(room);
+}
+
+/* 復元した部屋 (または全員が抜けた部屋) で RESUME を待つ。時計は止めておく */
+void room_await_resume(Room *room)
+{
+    if (room->clock_running)
     {
-        Player next_p = game_state_current_player(&room->game_state);
-        if (rules_is_loss(&room->game_state, next_p))
-        {
-            send_msg(clients[client_idx].fd, "WIN (Opponent No Moves)\n");
-            send_msg(clients[opponent_idx].fd, "LOSE (No Moves)\n");
-            close_room(room);
+        room->clock_ms[variant_to_move(&room->game)] -=
+            (int64_t)(timer_now_ms() - room->turn_started);
+        room->clock_running = 0;
+    }
+    timer_schedule(&room->clock_timer, RESUME_GRACE_MS, resume_expired, room);
+}
 
-            clients[client_idx].state = STATE_LOBBY;
-            clients[client_idx].room_id = -1;
-            clients[client_idx].player_color = PLAYER_NONE;
+/* AI が指せなくなった (探索の確保が続けて失敗した) ときに AI 側の負けにする */
+void ai_resign(Room *room)
+{
+    end_game(room, opposite(room->ai_color), RESULT_RESIGN, "WIN (Opponent Resigned)\n", "LOSE (Resigned)\n", " (Resigned)");
+}
+
+/* 検証済みの指し手を適用して対局者・観戦者へ通知する (人間/AI 共通) */
+void commit_move(Room *room, const Move *move)
+{
+    Player mover = variant_to_move(&room->game);
+    int mover_idx = (mover == PLAYER_BLACK) ? room->black_idx : room->white_idx;
+    int opponent_idx = (mover == PLAYER_BLACK) ? room->white_idx : room->black_idx;
 
-            clients[opponent_idx].state = STATE_LOBBY;
-            clients[opponent_idx].room_id = -1;
-            clients[opponent_idx].player_color = PLAYER_NONE;
+    /* 時計: 使った時間を引いてから加算する。同じ周回で時間切れと競合したら手より時間切れを優先 */
+    if (room->clock_running)
+    {
+        room->clock_ms[mover] -= (int64_t)(timer_now_ms() - room->turn_started);
+        if (room->clock_ms[mover] <= 0)
+        {
+            clock_expired(room);
+            return;
         }
+        room->clock_ms[mover] += room->tc_inc_ms;
+    }
+
+    TRACE_BEGIN(TR_COMMIT);
+    TRACE_BEGIN(TR_JOURNAL);
+    journal_move(room, move);
+    TRACE_END(TR_JOURNAL);
+    TRACE_BEGIN(TR_APPLY);
+    variant_apply_move(&room->game, move);
+    TRACE_END(TR_APPLY);
+    moves_accepted++;
+
+    TRACE_BEGIN(TR_NOTIFY);
+    if (opponent_idx >= 0)
+    {
+        send_move(opponent_idx, 1, move);
+        if (clients[opponent_idx].sync_check)
+            room_send_sync(room, opponent_idx, 0);
+    }
+    if (mover_idx >= 0)
+    {
+        send_move(mover_idx, 0, move);
+        if (clients[mover_idx].sync_check)
+            room_send_sync(room, mover_idx, 0);
+    }
+    room_broadcast_move(room, move);
+    TRACE_END(TR_NOTIFY);
+
+    TRACE_BEGIN(TR_IS_WIN);
+    int won = variant_is_win(&room->game, mover);
+    TRACE_END(TR_IS_WIN);
+    if (won)
+    {
+        end_game(room, mover, RESULT_GOAL, "WIN\n", "LOSE\n", "");
+        TRACE_END(TR_COMMIT);
+        return;
+    }
+
+    /* 次の手番の合法手集合はここで作り、次の MOVE の検証にも使い回す */
+    Player next_p = variant_to_move(&room->game);
+    TRACE_BEGIN(TR_IS_LOSS);
+    int no_moves = (variant_legal_size(room_legal_set(room)) == 0);
+    TRACE_END(TR_IS_LOSS);
+    TRACE_END(TR_COMMIT);
+    if (no_moves)
+    {
+        end_game(room, mover, RESULT_NO_MOVES, "WIN (Opponent No Moves)\n", "LOSE (No Moves)\n", " (No Moves)");
+        return;
     }
-}
\ No newline at end of file
+
+    if (room->clock_running)
+    {
+        clock_start(room);
+        send_clock(room);
+    }
+
+    /* 次が AI の手番なら思考を依頼する */
+    if (room->ai_level > 0 && next_p == room->ai_color)
+        ai_request_move(room);
+}
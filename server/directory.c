@@ -0,0 +1,233 @@
+#include "server.h"
+
+/* ルーム一覧 (LIST)
+ * 待機中の部屋 (CREATE した人がいるだけ) と対局中の部屋を、作成・参加・終了の
+ * たびに更新する詰めた配列で持つ。外すときは末尾と入れ替えるので追加も削除も O(1)、
+ * 各項目は表示用の1行を作成時に組み立てておく。
+ * LIST はページ分の行をつなぐだけで、同じページの応答は一覧が変わるまで
+ * 共有バッファを使い回す (組み立て直しもコピーもしない)。 */
+#define DIR_LINE_MAX 48
+#define DIR_PAGE_DEFAULT 20
+#define DIR_PAGE_MAX 20 /* 1ページが TEXT フレーム (1024バイト) に収まる数 */
+
+#define DIR_WAITING 0
+#define DIR_PLAYING 1
+
+#define DIR_FILTER_ALL 0
+#define DIR_FILTER_WAITING 1
+#define DIR_FILTER_PLAYING 2
+#define DIR_FILTER_COUNT 3
+
+typedef struct
+{
+    int owner; /* 待機中なら clients[] の添字、対局中なら rooms[] の添字 */
+    uint8_t len;
+    char line[DIR_LINE_MAX];
+} DirEntry;
+
+static DirEntry waiting[MAX_CLIENTS];
+static DirEntry playing[MAX_ROOMS];
+static int nwaiting = 0;
+static int nplaying = 0;
+
+/* 直近に返したページ (フィルタとプロトコルごとに1つ)。一覧が変わったら捨てる */
+typedef struct
+{
+    SharedBuf *buf;
+    int offset;
+    int count;
+} DirCache;
+
+static DirCache cache[DIR_FILTER_COUNT][2];
+
+static void cache_invalidate(void)
+{
+    for (int f = 0; f < DIR_FILTER_COUNT; f++)
+    {
+        for (int p = 0; p < 2; p++)
+        {
+            sbuf_unref(cache[f][p].buf);
+            cache[f][p].buf = NULL;
+        }
+    }
+}
+
+/* 項目を末尾に足して添字を返す */
+static int entry_add(DirEntry *list, int *n, int owner)
+{
+    DirEntry *e = &list[*n];
+    e->owner = owner;
+    cache_invalidate();
+    return (*n)++;
+}
+
+/* 末尾の項目を空いた位置に移し、移した項目の持ち主の添字を返す (なければ -1) */
+static int entry_remove(DirEntry *list, int *n, int slot)
+{
+    int last = --(*n);
+    cache_invalidate();
+    if (slot == last)
+        return -1;
+    list[slot] = list[last];
+    return list[slot].owner;
+}
+
+/* 5x5 以外の盤なら " 7x7" のように行に添える */
+static void size_tag(int board_size, char *out)
+{
+    if (board_size == BOARD_W)
+        out[0] = '\0';
+    else
+        sprintf(out, " %dx%d", board_size, board_size);
+}
+
+void dir_add_waiting(int client_idx)
+{
+    Client *c = &clients[client_idx];
+    if (c->dir_slot != -1)
+        dir_remove_waiting(client_idx);
+    int slot = entry_add(waiting, &nwaiting, client_idx);
+    DirEntry *e = &waiting[slot];
+    char size[8];
+    size_tag(c->board_size, size);
+    int n;
+    if (c->tc_base_ms > 0)
+        n = snprintf(e->line, sizeof(e->line), "- Room %d (Waiting %d+%d%s)\n", c->room_id,
+                     c->tc_base_ms / 60000, c->tc_inc_ms / 1000, size);
+    else
+        n = snprintf(e->line, sizeof(e->line), "- Room %d (Waiting%s)\n", c->room_id, size);
+    e->len = (uint8_t)n;
+    c->dir_slot = slot;
+}
+
+void dir_remove_waiting(int client_idx)
+{
+    Client *c = &clients[client_idx];
+    if (c->dir_slot == -1)
+        return;
+    int moved = entry_remove(waiting, &nwaiting, c->dir_slot);
+    if (moved != -1)
+        clients[moved].dir_slot = c->dir_slot;
+    c->dir_slot = -1;
+}
+
+void dir_add_room(Room *room)
+{
+    if (room->dir_slot != -1)
+        return;
+    int slot = entry_add(playing, &nplaying, (int)(room - rooms));
+    DirEntry *e = &playing[slot];
+    char size[8];
+    size_tag(room->game.size, size);
+    int n;
+    if (room->ai_level > 0)
+        n = snprintf(e->line, sizeof(e->line), "- Room %d (Playing vs AI %d%s)\n", room->id, room->ai_level, size);
+    else
+        n = snprintf(e->line, sizeof(e->line), "- Room %d (Playing%s)\n", room->id, size);
+    e->len = (uint8_t)n;
+    room->dir_slot = slot;
+}
+
+void dir_remove_room(Room *room)
+{
+    if (room->dir_slot == -1)
+        return;
+    int moved = entry_remove(playing, &nplaying, room->dir_slot);
+    if (moved != -1)
+        rooms[moved].dir_slot = room->dir_slot;
+    room->dir_slot = -1;
+}
+
+/* フィルタを通した一覧の i 番目 (待機中の後に対局中を並べる) */
+static const DirEntry *entry_at(int filter, int i)
+{
+    if (filter == DIR_FILTER_PLAYING)
+        return &playing[i];
+    if (i < nwaiting)
+        return &waiting[i];
+    return &playing[i - nwaiting];
+}
+
+static int filter_total(int filter)
+{
+    if (filter == DIR_FILTER_WAITING)
+        return nwaiting;
+    if (filter == DIR_FILTER_PLAYING)
+        return nplaying;
+    return nwaiting + nplaying;
+}
+
+/* ページを組み立てる (行をつなぐだけなので count に比例し、全体の件数によらない) */
+static SharedBuf *render_page(int proto, int filter, int offset, int count)
+{
+    char page[WIRE_MAX_FRAME];
+    int total = filter_total(filter);
+    int end = offset + count;
+    if (end > total)
+        end = total;
+
+    size_t len;
+    if (offset == 0 && end == total)
+        len = (size_t)snprintf(page, sizeof(page), "Active Rooms:\n");
+    else if (offset < end)
+        len = (size_t)snprintf(page, sizeof(page), "Active Rooms (%d-%d of %d):\n", offset + 1, end, total);
+    else
+        len = (size_t)snprintf(page, sizeof(page), "Active Rooms (0 of %d):\n", total);
+
+    for (int i = offset; i < end; i++)
+    {
+        const DirEntry *e = entry_at(filter, i);
+        memcpy(page + len, e->line, e->len);
+        len += e->len;
+    }
+    if (total == 0)
+        len += (size_t)snprintf(page + len, sizeof(page) - len, "(None)\n");
+    else if (end < total)
+        len += (size_t)snprintf(page + len, sizeof(page) - len, "(More: LIST %s%d %d)\n",
+                                filter == DIR_FILTER_WAITING   ? "WAITING "
+                                : filter == DIR_FILTER_PLAYING ? "PLAYING "
+                                                               : "",
+                                end, count);
+    page[len] = '\0';
+    return sbuf_text(proto, page);
+}
+
+/* LIST [WAITING|PLAYING] [<offset> [<count>]] */
+void dir_send_list(int client_idx, const char *args)
+{
+    int filter = DIR_FILTER_ALL;
+    char word[16] = {0};
+    if (sscanf(args, "%15s", word) == 1)
+    {
+        if (strcasecmp(word, "WAITING") == 0)
+            filter = DIR_FILTER_WAITING;
+        else if (strcasecmp(word, "PLAYING") == 0)
+            filter = DIR_FILTER_PLAYING;
+        if (filter != DIR_FILTER_ALL)
+            args = strstr(args, word) + strlen(word);
+    }
+
+    int offset = 0, count = DIR_PAGE_DEFAULT;
+    int n = sscanf(args, "%d %d", &offset, &count);
+    if ((n < 1 && word[0] && filter == DIR_FILTER_ALL) || offset < 0 || count <= 0)
+    {
+        send_client(client_idx, "Error: Use 'LIST [WAITING|PLAYING] [<offset> [<count>]]'.\n");
+        return;
+    }
+    if (count > DIR_PAGE_MAX)
+        count = DIR_PAGE_MAX;
+    int total = filter_total(filter);
+    if (offset > total)
+        offset = total;
+
+    Client *c = &clients[client_idx];
+    DirCache *dc = &cache[filter][c->proto == PROTO_BINARY];
+    if (!dc->buf || dc->offset != offset || dc->count != count)
+    {
+        sbuf_unref(dc->buf);
+        dc->buf = render_page(c->proto, filter, offset, count);
+        dc->offset = offset;
+        dc->count = count;
+    }
+    send_shared(c->fd, dc->buf);
+}
@@ -0,0 +1,691 @@
+#include "server.h"
+
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/* 無停止再起動 (--handoff=PATH と --takeover)
+ * 動いているサーバーは PATH の UNIX ソケットで引き継ぎ要求を待つ。新しいバイナリを
+ * --takeover 付きで起動すると PATH に接続し、古いプロセスは
+ *   1. 新しい接続の受け付けと受信をやめ、送信待ちを流しきる (最大 HANDOFF_DRAIN_MS)
+ *   2. ジャーナルを閉じる (新しいプロセスは再生せずに末尾へ追記する)
+ *   3. クライアント表と部屋 (盤面・時計・トークン) を直列化して送り、
+ *      listen ソケットとクライアントの fd を SCM_RIGHTS で渡す
+ *   4. 新しいプロセスの ACK を待って終了する。ACK の前に切れたら引き継ぎをやめて続ける
+ * 新しいプロセスはクライアントと部屋を元の添字のまま戻し、タイマーと AI の思考を
+ * 掛け直してから ACK を返す。TCP 接続はカーネルの中でそのまま残るので、クライアントからは
+ * 止めていた間に送った行の応答が少し遅れるだけに見える。
+ * 期限までに送信を流しきれなかった接続は引き継がずに切る (対局者の席は空けておくので
+ * RESUME で戻れる)。
+ *
+ * 形式 (数値はビッグエンディアン。プロセスごとに構造体の並びが違ってよいように項目ごとに書く)
+ *   最初のメッセージ: 状態の長さ u32 (listen ソケットの fd を付ける)
+ *   状態: "CTH1", 止めた時刻 (CLOCK_MONOTONIC, us) u64, 切った接続数 u32,
+ *         クライアント数 u32, 部屋数 u32, クライアントのレコード, 部屋のレコード
+ *   続くメッセージ: 1バイトごとにクライアントの fd をレコードの順に HANDOFF_FD_BATCH 個まで付ける
+ * レコードは [u16 長さ][内容] で、内容の並びは put_client / put_room のとおり。 */
+#define HANDOFF_MAGIC "CTH1"
+#define HANDOFF_MAGIC_LEN 4
+#define HANDOFF_HEADER_SIZE (HANDOFF_MAGIC_LEN + 8 + 4 + 4 + 4)
+#define HANDOFF_DRAIN_MS 1000
+#define HANDOFF_FD_BATCH 64 /* 1メッセージの fd の数 (カーネルの上限 SCM_MAX_FD より小さく) */
+#define HANDOFF_ACK 'K'
+
+#define CLIENT_REC_FIXED 39
+#define CLIENT_REC_MAX (2 + CLIENT_REC_FIXED + 255 + 2 + WIRE_MAX_FRAME)
+#define ROOM_REC_FIXED 62
+#define ROOM_REC_MAX (2 + ROOM_REC_FIXED + VARIANT_PACKED_MAX)
+#define HANDOFF_MAX_STATE (HANDOFF_HEADER_SIZE + (size_t)MAX_CLIENTS * CLIENT_REC_MAX + (size_t)MAX_ROOMS * ROOM_REC_MAX)
+#define QM_NOT_QUEUED 0xFFFF
+
+int handoff_listen_fd = -1;
+int handoff_requested = 0;
+
+static char listen_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+static int handoff_conn = -1; /* 引き継ぎ相手との接続 */
+static uint64_t paused_at_us;  /* 受信を止めた時刻 */
+static Timer drain_timer;
+static int drain_expired = 0;
+static unsigned char straggler[MAX_CLIENTS]; /* 期限までに送信を流しきれず引き継がない接続 */
+static int dropped = 0;
+
+/* 受け取った状態と fd (handoff_receive から handoff_restore まで持つ) */
+static uint8_t *state_buf = NULL;
+static size_t state_len = 0;
+static int *client_fds = NULL;
+static int client_nfds = 0;
+
+/* QUICKMATCH の列は並んでいた順に戻す */
+typedef struct
+{
+    int slot;
+    int pos;
+    int base_ms;
+    int inc_ms;
+    int band;
+} QmRestore;
+
+static size_t put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+    return 2;
+}
+
+static size_t put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+    return 4;
+}
+
+static size_t put_u64(uint8_t *p, uint64_t v)
+{
+    put_u32(p, (uint32_t)(v >> 32));
+    put_u32(p + 4, (uint32_t)v);
+    return 8;
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t get_u64(const uint8_t *p)
+{
+    return ((uint64_t)get_u32(p) << 32) | get_u32(p + 4);
+}
+
+static int write_full(int fd, const void *data, size_t len)
+{
+    const char *p = data;
+    while (len > 0)
+    {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int read_full(int fd, void *data, size_t len)
+{
+    char *p = data;
+    while (len > 0)
+    {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* data と一緒に fd を渡す */
+static int send_fds(int sock, const void *data, size_t len, const int *fds, int nfds)
+{
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(int) * HANDOFF_FD_BATCH)];
+        struct cmsghdr align;
+    } ctrl;
+    struct iovec iov = {(void *)data, len};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    memset(&ctrl, 0, sizeof(ctrl));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+    memcpy(CMSG_DATA(cm), fds, sizeof(int) * nfds);
+
+    ssize_t n;
+    do
+        n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    while (n < 0 && errno == EINTR);
+    if (n < 0)
+        return -1;
+    return write_full(sock, (const char *)data + n, len - (size_t)n);
+}
+
+/* len バイトと、それに付いてきた fd (HANDOFF_FD_BATCH 個まで) を受け取って fd の数を返す */
+static int recv_fds(int sock, void *data, size_t len, int *fds)
+{
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(int) * HANDOFF_FD_BATCH)];
+        struct cmsghdr align;
+    } ctrl;
+    struct iovec iov = {data, len};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    ssize_t n;
+    do
+        n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    while (n < 0 && errno == EINTR);
+    if (n <= 0 || (msg.msg_flags & MSG_CTRUNC))
+        return -1;
+
+    int nfds = 0;
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+    {
+        if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS)
+            continue;
+        int k = (int)((cm->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        memcpy(fds + nfds, CMSG_DATA(cm), sizeof(int) * k);
+        nfds += k;
+    }
+    if (read_full(sock, (char *)data + n, len - (size_t)n) < 0)
+        return -1;
+    return nfds;
+}
+
+/* 引き継ぎ要求を待つ UNIX ソケットを作る (前のプロセスが残したファイルは消す) */
+int handoff_listen(const char *path)
+{
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Handoff socket path too long: %s\n", path);
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        perror("handoff socket");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || chmod(path, 0600) < 0 || listen(fd, 1) < 0)
+    {
+        perror("handoff bind");
+        close(fd);
+        return -1;
+    }
+    if (path != listen_path)
+        strcpy(listen_path, path);
+    handoff_listen_fd = fd;
+    printf("Handoff: waiting for takeover on %s\n", path);
+    return 0;
+}
+
+/* select ループから: 引き継ぎ要求を受け付ける */
+void handoff_accept(void)
+{
+    int fd = accept4(handoff_listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0)
+    {
+        perror("handoff accept");
+        return;
+    }
+    handoff_begin(fd);
+}
+
+static void drain_timer_expired(void *arg)
+{
+    (void)arg;
+    drain_expired = 1;
+}
+
+/* 引き継ぎ要求を受けた。以後イベントループは受信をやめ、送信待ちを流しきったら抜ける */
+void handoff_begin(int conn_fd)
+{
+    printf("Handoff requested, draining...\n");
+    handoff_conn = conn_fd;
+    handoff_requested = 1;
+    paused_at_us = metrics_now() / 1000;
+
+    /* 新しいプロセスが同じパスで待てるように外しておく (失敗したら戻す) */
+    close(handoff_listen_fd);
+    handoff_listen_fd = -1;
+    unlink(listen_path);
+
+    drain_expired = 0;
+    dropped = 0;
+    memset(straggler, 0, sizeof(straggler));
+    chat_flush_all();
+    timer_schedule(&drain_timer, HANDOFF_DRAIN_MS, drain_timer_expired, NULL);
+}
+
+/* 送信待ちがなくなったら 1。期限を過ぎたら残っている接続を引き継がないことにして 1 */
+int handoff_drained(void)
+{
+    int pending = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (clients[i].fd == -1 || !out_pending(clients[i].fd))
+            continue;
+        if (!drain_expired)
+            return 0;
+        straggler[i] = 1;
+        pending++;
+    }
+    dropped = pending;
+    return 1;
+}
+
+/* 引き継がない接続の席は空席にする */
+static int seat(int client_idx)
+{
+    return (client_idx >= 0 && straggler[client_idx]) ? -1 : client_idx;
+}
+
+/*  0 添字 u16, 2 state, 3 proto, 4 player_color, 5 admin, 6 sync_check, 7 board_size (各 u8),
+ *  8 room_id, 12 tc_base_ms, 16 tc_inc_ms, 20 無操作の経過 ms (各 u32),
+ * 24 QUICKMATCH の base_ms, 28 inc_ms, 32 band (各 u32), 36 列での位置 u16 (並んでいなければ QM_NOT_QUEUED),
+ * 38 チャンネル名の長さ u8 (いなければ 0) と名前, 受信途中のデータの長さ u16 とデータ */
+static size_t put_client(uint8_t *p, int i)
+{
+    Client *c = &clients[i];
+    size_t n = 2;
+    n += put_u16(p + n, (uint16_t)i);
+    p[n++] = (uint8_t)c->state;
+    p[n++] = (uint8_t)c->proto;
+    p[n++] = (uint8_t)c->player_color;
+    p[n++] = (uint8_t)c->admin;
+    p[n++] = (uint8_t)c->sync_check;
+    p[n++] = (uint8_t)c->board_size;
+    n += put_u32(p + n, (uint32_t)c->room_id);
+    n += put_u32(p + n, (uint32_t)c->tc_base_ms);
+    n += put_u32(p + n, (uint32_t)c->tc_inc_ms);
+    n += put_u32(p + n, (uint32_t)(timer_now_ms() - c->last_active));
+
+    int base_ms = 0, inc_ms = 0, band = 0, pos = 0;
+    int queued = qm_entry(i, &base_ms, &inc_ms, &band);
+    for (int j = c->qm_prev; queued && j != -1; j = clients[j].qm_prev)
+        pos++;
+    n += put_u32(p + n, (uint32_t)base_ms);
+    n += put_u32(p + n, (uint32_t)inc_ms);
+    n += put_u32(p + n, (uint32_t)band);
+    n += put_u16(p + n, queued ? (uint16_t)pos : QM_NOT_QUEUED);
+
+    const char *channel = chat_channel_name(i);
+    size_t chlen = channel ? strlen(channel) : 0;
+    p[n++] = (uint8_t)chlen;
+    if (channel)
+        memcpy(p + n, channel, chlen);
+    n += chlen;
+    n += put_u16(p + n, (uint16_t)c->inlen);
+    memcpy(p + n, c->inbuf, (size_t)c->inlen);
+    n += (size_t)c->inlen;
+
+    put_u16(p, (uint16_t)(n - 2));
+    return n;
+}
+
+/*  0 添字 u16, 2 id, 6 black_idx, 10 white_idx (各 u32), 14 ai_level, 15 ai_color (各 u8),
+ * 16 黒のトークン, 24 白のトークン (各 u64), 32 tc_base_ms, 36 tc_inc_ms (各 u32),
+ * 40 黒の残り時間, 48 白の残り時間 (各 i64), 56 時計が動いているか, 57 盤の大きさ (各 u8),
+ * 58 手数 u32, 62 パック済みの局面 */
+static size_t put_room(uint8_t *p, int i)
+{
+    Room *room = &rooms[i];
+    size_t n = 2;
+    n += put_u16(p + n, (uint16_t)i);
+    n += put_u32(p + n, (uint32_t)room->id);
+    n += put_u32(p + n, (uint32_t)seat(room->black_idx));
+    n += put_u32(p + n, (uint32_t)seat(room->white_idx));
+    p[n++] = (uint8_t)room->ai_level;
+    p[n++] = (uint8_t)room->ai_color;
+    n += put_u64(p + n, room->token[PLAYER_BLACK]);
+    n += put_u64(p + n, room->token[PLAYER_WHITE]);
+    n += put_u32(p + n, (uint32_t)room->tc_base_ms);
+    n += put_u32(p + n, (uint32_t)room->tc_inc_ms);
+
+    /* 今の手番で使った分は引いておき、新しいプロセスで測り直す */
+    int64_t clock_ms[3] = {0, room->clock_ms[PLAYER_BLACK], room->clock_ms[PLAYER_WHITE]};
+    if (room->clock_running)
+        clock_ms[variant_to_move(&room->game)] -= (int64_t)(timer_now_ms() - room->turn_started);
+    n += put_u64(p + n, (uint64_t)clock_ms[PLAYER_BLACK]);
+    n += put_u64(p + n, (uint64_t)clock_ms[PLAYER_WHITE]);
+    p[n++] = (uint8_t)room->clock_running;
+    p[n++] = (uint8_t)room->game.size;
+    n += put_u32(p + n, variant_ply(&room->game));
+    n += variant_pack(&room->game, p + n);
+
+    put_u16(p, (uint16_t)(n - 2));
+    return n;
+}
+
+/* 状態と fd を新しいプロセスに渡す。0 なら引き継ぎ完了で、このプロセスは終了してよい。
+ * 失敗したら (新しいプロセスが ACK の前に落ちた) -1 で、呼び出し側はジャーナルを開き直して続ける */
+int handoff_send(int listen_fd)
+{
+    timer_cancel(&drain_timer);
+    journal_close();
+
+    uint8_t *buf = malloc(HANDOFF_MAX_STATE);
+    int *fds = malloc(sizeof(int) * MAX_CLIENTS);
+    int ok = (buf && fds);
+    int nclients = 0, nrooms = 0;
+    size_t n = HANDOFF_HEADER_SIZE;
+    for (int i = 0; ok && i < MAX_CLIENTS; i++)
+    {
+        if (clients[i].fd == -1 || straggler[i])
+            continue;
+        n += put_client(buf + n, i);
+        fds[nclients++] = clients[i].fd;
+    }
+    for (int i = 0; ok && i < MAX_ROOMS; i++)
+    {
+        if (!rooms[i].active)
+            continue;
+        n += put_room(buf + n, i);
+        nrooms++;
+    }
+
+    if (ok)
+    {
+        memcpy(buf, HANDOFF_MAGIC, HANDOFF_MAGIC_LEN);
+        put_u64(buf + 4, paused_at_us);
+        put_u32(buf + 12, (uint32_t)dropped);
+        put_u32(buf + 16, (uint32_t)nclients);
+        put_u32(buf + 20, (uint32_t)nrooms);
+
+        uint8_t len[4];
+        put_u32(len, (uint32_t)n);
+        ok = send_fds(handoff_conn, len, sizeof(len), &listen_fd, 1) == 0 && write_full(handoff_conn, buf, n) == 0;
+    }
+    for (int k = 0; ok && k < nclients; k += HANDOFF_FD_BATCH)
+    {
+        int count = (nclients - k < HANDOFF_FD_BATCH) ? nclients - k : HANDOFF_FD_BATCH;
+        uint8_t b = (uint8_t)count;
+        ok = send_fds(handoff_conn, &b, 1, fds + k, count) == 0;
+    }
+
+    /* 新しいプロセスが復元し終えるまで待つ。時間では打ち切らない
+     * (打ち切った後で ACK が来ると2つのプロセスが同じ接続を読むことになる) */
+    char ack = 0;
+    ok = ok && read_full(handoff_conn, &ack, 1) == 0 && ack == HANDOFF_ACK;
+    free(buf);
+    free(fds);
+    close(handoff_conn);
+    handoff_conn = -1;
+
+    if (!ok)
+    {
+        fprintf(stderr, "Handoff failed, resuming service.\n");
+        handoff_requested = 0;
+        handoff_listen(listen_path);
+        return -1;
+    }
+    printf("Handoff: %d clients and %d rooms handed over (%d dropped) after %.1f ms.\n", nclients, nrooms, dropped,
+           (double)(metrics_now() / 1000 - paused_at_us) / 1000.0);
+    return 0;
+}
+
+/* 動いているサーバーから状態と fd を受け取る (復元は各モジュールの初期化後に handoff_restore で) */
+int handoff_receive(const char *path, int *listen_fd)
+{
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Handoff socket path too long: %s\n", path);
+        return -1;
+    }
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0)
+    {
+        perror("handoff socket");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        fprintf(stderr, "Handoff: cannot connect to %s: %s\n", path, strerror(errno));
+        close(sock);
+        return -1;
+    }
+    printf("Taking over from the server on %s...\n", path);
+
+    uint8_t len[4];
+    int fd = -1;
+    if (recv_fds(sock, len, sizeof(len), &fd) != 1)
+        goto fail;
+    state_len = get_u32(len);
+    if (state_len < HANDOFF_HEADER_SIZE || state_len > HANDOFF_MAX_STATE)
+        goto fail;
+    state_buf = malloc(state_len);
+    if (!state_buf || read_full(sock, state_buf, state_len) < 0 ||
+        memcmp(state_buf, HANDOFF_MAGIC, HANDOFF_MAGIC_LEN) != 0)
+        goto fail;
+
+    int nclients = (int)get_u32(state_buf + 16);
+    if (nclients > MAX_CLIENTS)
+        goto fail;
+    client_fds = malloc(sizeof(int) * (MAX_CLIENTS + HANDOFF_FD_BATCH));
+    if (!client_fds)
+        goto fail;
+    while (client_nfds < nclients)
+    {
+        uint8_t b;
+        int got = recv_fds(sock, &b, 1, client_fds + client_nfds);
+        if (got <= 0)
+            goto fail;
+        client_nfds += got;
+    }
+    if (client_nfds != nclients)
+        goto fail;
+
+    handoff_conn = sock;
+    *listen_fd = fd;
+    return 0;
+
+fail:
+    fprintf(stderr, "Handoff: bad state from %s.\n", path);
+    close(sock);
+    return -1;
+}
+
+static void set_ply(VariantGame *g, uint32_t ply)
+{
+    switch (g->size)
+    {
+    case 6:
+        g->u.s6.ply = ply;
+        break;
+    case 7:
+        g->u.s7.ply = ply;
+        break;
+    default:
+        g->u.s5.ply = ply;
+        break;
+    }
+}
+
+static int qm_pos_cmp(const void *a, const void *b)
+{
+    return ((const QmRestore *)a)->pos - ((const QmRestore *)b)->pos;
+}
+
+/* 受け取った状態をクライアント表と部屋に戻し、タイマーと AI を掛け直して ACK を返す */
+int handoff_restore(void)
+{
+    const uint8_t *data = state_buf;
+    uint64_t paused = get_u64(data + 4);
+    int old_dropped = (int)get_u32(data + 12);
+    int nclients = (int)get_u32(data + 16);
+    int nrooms = (int)get_u32(data + 20);
+    size_t off = HANDOFF_HEADER_SIZE;
+    uint64_t now = timer_now_ms();
+    static QmRestore queue[MAX_CLIENTS];
+    int nqueued = 0;
+
+    for (int r = 0; r < nclients; r++)
+    {
+        if (off + 2 > state_len)
+            return -1;
+        size_t len = get_u16(data + off);
+        const uint8_t *p = data + off + 2;
+        off += 2 + len;
+        if (off > state_len || len < CLIENT_REC_FIXED)
+            return -1;
+        int i = get_u16(p);
+        size_t chlen = p[38];
+        if (i >= MAX_CLIENTS || clients[i].fd != -1 || CLIENT_REC_FIXED + chlen + 2 > len)
+            return -1;
+        size_t inlen = get_u16(p + CLIENT_REC_FIXED + chlen);
+        if (inlen > sizeof(clients[i].inbuf) || CLIENT_REC_FIXED + chlen + 2 + inlen > len)
+            return -1;
+
+        Client *c = &clients[i];
+        c->fd = client_fds[r];
+        c->state = p[2];
+        c->proto = p[3];
+        c->player_color = (Player)p[4];
+        c->admin = p[5];
+        c->sync_check = p[6];
+        c->board_size = p[7];
+        c->room_id = (int32_t)get_u32(p + 8);
+        c->tc_base_ms = (int)get_u32(p + 12);
+        c->tc_inc_ms = (int)get_u32(p + 16);
+        c->last_active = now - get_u32(p + 20);
+        c->inlen = (int)inlen;
+        memcpy(c->inbuf, p + CLIENT_REC_FIXED + chlen + 2, inlen);
+        if (get_u16(p + 36) != QM_NOT_QUEUED)
+        {
+            queue[nqueued].slot = i;
+            queue[nqueued].pos = get_u16(p + 36);
+            queue[nqueued].base_ms = (int)get_u32(p + 24);
+            queue[nqueued].inc_ms = (int)get_u32(p + 28);
+            queue[nqueued].band = (int32_t)get_u32(p + 32);
+            nqueued++;
+        }
+
+        chat_reset_rate(i);
+        if (chlen > 0)
+        {
+            char name[256];
+            memcpy(name, p + CLIENT_REC_FIXED, chlen);
+            name[chlen] = '\0';
+            chat_restore(i, name);
+        }
+        if (c->state == STATE_WAITING)
+            dir_add_waiting(i);
+        client_resume_idle(i);
+        capture_conn_open(i);
+    }
+
+    /* 列の中の順番は位置の小さい順に並べ直せば戻る */
+    qsort(queue, (size_t)nqueued, sizeof(QmRestore), qm_pos_cmp);
+    for (int q = 0; q < nqueued; q++)
+    {
+        if (qm_restore(queue[q].slot, queue[q].base_ms, queue[q].inc_ms, queue[q].band) < 0)
+            clients[queue[q].slot].state = STATE_LOBBY;
+    }
+
+    static unsigned char clock_was_running[MAX_ROOMS];
+    for (int r = 0; r < nrooms; r++)
+    {
+        if (off + 2 > state_len)
+            return -1;
+        size_t len = get_u16(data + off);
+        const uint8_t *p = data + off + 2;
+        off += 2 + len;
+        if (off > state_len || len < ROOM_REC_FIXED)
+            return -1;
+        int i = get_u16(p);
+        int size = p[57];
+        if (i >= MAX_ROOMS || rooms[i].active || !variant_size_valid(size) ||
+            len < ROOM_REC_FIXED + (size_t)VARIANT_PACKED_SIZE(size))
+            return -1;
+
+        int seats[2] = {(int32_t)get_u32(p + 6), (int32_t)get_u32(p + 10)};
+        for (int s = 0; s < 2; s++)
+        {
+            if (seats[s] < 0 || seats[s] >= MAX_CLIENTS || clients[seats[s]].fd == -1)
+                seats[s] = -1;
+        }
+        Room *room = &rooms[i];
+        room_open(room, (int32_t)get_u32(p + 2), seats[0], seats[1], p[14], (Player)p[15], size);
+        if (!variant_unpack(p + ROOM_REC_FIXED, VARIANT_PACKED_SIZE(size), &room->game))
+            return -1;
+        set_ply(&room->game, get_u32(p + 58));
+        room->token[PLAYER_BLACK] = get_u64(p + 16);
+        room->token[PLAYER_WHITE] = get_u64(p + 24);
+        room->tc_base_ms = (int)get_u32(p + 32);
+        room->tc_inc_ms = (int)get_u32(p + 36);
+        room->clock_ms[PLAYER_BLACK] = (int64_t)get_u64(p + 40);
+        room->clock_ms[PLAYER_WHITE] = (int64_t)get_u64(p + 48);
+        clock_was_running[i] = p[56];
+    }
+
+    /* 観戦者は部屋のリストにつなぎ直す。部屋がなくなっていたらロビーに戻す */
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        Client *c = &clients[i];
+        if (c->fd == -1 || (c->state != STATE_WATCHING && c->state != STATE_PLAYING))
+            continue;
+        Room *room = get_room(c->room_id);
+        if (room && c->state == STATE_WATCHING)
+        {
+            room_add_watcher(room, i);
+        }
+        else if (!room)
+        {
+            c->state = STATE_LOBBY;
+            c->room_id = -1;
+            c->player_color = PLAYER_NONE;
+            chat_enter(i);
+        }
+    }
+
+    /* 時計は手番の始まりから測り直す。空席のある部屋 (復元待ちや、引き継げなかった対局者) は
+     * RESUME を待つ (待つ時間はここから数え直す) */
+    for (int i = 0; i < MAX_ROOMS; i++)
+    {
+        Room *room = &rooms[i];
+        if (!room->active)
+            continue;
+        int black_here = room->black_idx >= 0 || room->ai_color == PLAYER_BLACK;
+        int white_here = room->white_idx >= 0 || room->ai_color == PLAYER_WHITE;
+        if (!black_here || !white_here)
+            room_await_resume(room);
+        else if (clock_was_running[i])
+            clock_start(room);
+        if (room->ai_level > 0 && ai_available() && variant_to_move(&room->game) == room->ai_color)
+            ai_request_move(room);
+    }
+
+    double pause_ms = (double)(metrics_now() / 1000 - paused) / 1000.0;
+    metrics_set_handoff(pause_ms, nclients, nrooms, old_dropped);
+    char ack = HANDOFF_ACK;
+    if (write_full(handoff_conn, &ack, 1) < 0)
+        perror("handoff ack");
+    close(handoff_conn);
+    handoff_conn = -1;
+    free(state_buf);
+    state_buf = NULL;
+    free(client_fds);
+    client_fds = NULL;
+    printf("Takeover: %d clients and %d rooms restored (%d dropped), paused %.1f ms.\n", nclients, nrooms,
+           old_dropped, pause_ms);
+    return 0;
+}
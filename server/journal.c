@@ -0,0 +1,472 @@
+#include "server.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+
+/* ジャーナルファイルの形式
+ *   先頭: マジック "CTJ1"
+ *   レコード: [u8 種別][u8 ペイロード長][ペイロード][u32 チェックサム]
+ * 数値はすべてビッグエンディアン。チェックサムは種別〜ペイロードの FNV-1a (32bit) で、
+ * 不一致や途中で切れたレコード以降は書き込み途中のクラッシュとみなして切り詰める。 */
+#define JOURNAL_MAGIC "CTJ1"
+#define JOURNAL_MAGIC_LEN 4
+
+#define JREC_ROOM_OPEN 1 /* room_id, ai_level, ai_color, token_black, token_white, time_ms, tc_base_ms, tc_inc_ms, board_size */
+#define JREC_MOVE 2      /* room_id, ply, packed move, 指した側の残り時間 (ms) */
+#define JREC_RESULT 3    /* room_id, winner, reason, time_ms */
+
+#define JREC_MAX_PAYLOAD 64
+#define JREC_MAX_SIZE (2 + JREC_MAX_PAYLOAD + 4)
+
+/* 復元時の読み込みバッファ (ジャーナルの大きさによらず一定) */
+#define JOURNAL_READ_BUF (64 * 1024)
+
+/* グループコミット: この時間か量のどちらかに達したらまとめて fdatasync */
+#define JOURNAL_COMMIT_MS 10
+#define JOURNAL_COMMIT_BYTES (64 * 1024)
+
+static int journal_fd = -1;
+static pthread_t writer;
+static int writer_started = 0;
+
+/* イベントループが積むバッファと、書き込みスレッドが書き出し中のバッファを入れ替えて使う */
+static pthread_mutex_t journal_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t journal_cond = PTHREAD_COND_INITIALIZER;
+static char *pending_buf = NULL;
+static size_t pending_len = 0;
+static size_t pending_cap = 0;
+static int journal_stopping = 0;
+
+/* 統計 (records はイベントループ、残りは書き込みスレッドが更新し、終了時に表示) */
+static unsigned long journal_records = 0;
+static unsigned long journal_syncs = 0;
+static unsigned long journal_bytes = 0;
+
+static uint32_t journal_checksum(const uint8_t *p, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static size_t put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+    return 4;
+}
+
+static size_t put_u64(uint8_t *p, uint64_t v)
+{
+    put_u32(p, (uint32_t)(v >> 32));
+    put_u32(p + 4, (uint32_t)v);
+    return 8;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t get_u64(const uint8_t *p)
+{
+    return ((uint64_t)get_u32(p) << 32) | get_u32(p + 4);
+}
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/* レコードを保留バッファに積む (イベントループから呼ぶ。ディスクは待たない) */
+static void journal_append(uint8_t type, const uint8_t *payload, size_t len)
+{
+    if (journal_fd < 0)
+        return;
+
+    uint8_t rec[JREC_MAX_SIZE];
+    rec[0] = type;
+    rec[1] = (uint8_t)len;
+    memcpy(rec + 2, payload, len);
+    put_u32(rec + 2 + len, journal_checksum(rec, 2 + len));
+    size_t size = 2 + len + 4;
+    journal_records++;
+
+    pthread_mutex_lock(&journal_lock);
+    if (pending_len + size > pending_cap)
+    {
+        size_t cap = pending_cap ? pending_cap * 2 : JOURNAL_COMMIT_BYTES * 2;
+        while (cap < pending_len + size)
+            cap *= 2;
+        char *p = realloc(pending_buf, cap);
+        if (!p)
+        {
+            pthread_mutex_unlock(&journal_lock);
+            perror("journal realloc");
+            return;
+        }
+        pending_buf = p;
+        pending_cap = cap;
+    }
+    int was_empty = (pending_len == 0);
+    memcpy(pending_buf + pending_len, rec, size);
+    pending_len += size;
+    if (was_empty || pending_len >= JOURNAL_COMMIT_BYTES)
+        pthread_cond_signal(&journal_cond);
+    pthread_mutex_unlock(&journal_lock);
+}
+
+static void *writer_main(void *arg)
+{
+    (void)arg;
+    char *buf = NULL;
+    size_t cap = 0;
+    trace_thread_name("journal");
+
+    pthread_mutex_lock(&journal_lock);
+    for (;;)
+    {
+        while (pending_len == 0 && !journal_stopping)
+            pthread_cond_wait(&journal_cond, &journal_lock);
+        if (pending_len == 0 && journal_stopping)
+            break;
+
+        /* 最初のレコードから一定時間は後続を待ってまとめる */
+        if (pending_len < JOURNAL_COMMIT_BYTES && !journal_stopping)
+        {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += JOURNAL_COMMIT_MS * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L)
+            {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            while (pending_len < JOURNAL_COMMIT_BYTES && !journal_stopping)
+            {
+                if (pthread_cond_timedwait(&journal_cond, &journal_lock, &deadline) != 0)
+                    break;
+            }
+        }
+
+        /* バッファを入れ替えてロックの外で書き出す */
+        char *out = pending_buf;
+        size_t out_cap = pending_cap;
+        size_t len = pending_len;
+        pending_buf = buf;
+        pending_cap = cap;
+        pending_len = 0;
+        buf = out;
+        cap = out_cap;
+        pthread_mutex_unlock(&journal_lock);
+
+        size_t off = 0;
+        while (off < len)
+        {
+            ssize_t n = write(journal_fd, out + off, len - off);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                perror("journal write");
+                break;
+            }
+            off += (size_t)n;
+        }
+        TRACE_BEGIN(TR_JOURNAL_SYNC);
+        if (fdatasync(journal_fd) < 0)
+            perror("journal fdatasync");
+        TRACE_END(TR_JOURNAL_SYNC);
+        journal_syncs++;
+        journal_bytes += off;
+
+        pthread_mutex_lock(&journal_lock);
+    }
+    pthread_mutex_unlock(&journal_lock);
+
+    free(buf);
+    return NULL;
+}
+
+/* 復元で1レコードを反映する */
+static void journal_apply(uint8_t type, const uint8_t *p, size_t len, unsigned long *games, unsigned long *moves)
+{
+    if (type == JREC_ROOM_OPEN && len >= 30)
+    {
+        int room_id = (int32_t)get_u32(p);
+        Room *room = get_free_room();
+        if (room && !get_room(room_id))
+        {
+            /* 盤の大きさがない古いレコードは 5x5 */
+            room_open(room, room_id, -1, -1, p[4], (Player)p[5], len >= 39 ? p[38] : BOARD_W);
+            room->token[PLAYER_BLACK] = get_u64(p + 6);
+            room->token[PLAYER_WHITE] = get_u64(p + 14);
+            if (len >= 38)
+            {
+                room->tc_base_ms = (int)get_u32(p + 30);
+                room->tc_inc_ms = (int)get_u32(p + 34);
+                room->clock_ms[PLAYER_BLACK] = room->clock_ms[PLAYER_WHITE] = room->tc_base_ms;
+            }
+            (*games)++;
+        }
+    }
+    else if (type == JREC_MOVE && len >= 8 + MOVE_PACKED_SIZE)
+    {
+        Room *room = get_room((int32_t)get_u32(p));
+        Move m;
+        if (room && get_u32(p + 4) == variant_ply(&room->game) &&
+            wire_decode_move(p + 8, MOVE_PACKED_SIZE, &m))
+        {
+            if (variant_legal_contains(room_legal_set(room), &m))
+            {
+                Player mover = variant_to_move(&room->game);
+                if (len >= 8 + MOVE_PACKED_SIZE + 4 && room->tc_base_ms > 0)
+                    room->clock_ms[mover] = get_u32(p + 8 + MOVE_PACKED_SIZE);
+                variant_apply_move(&room->game, &m);
+                (*moves)++;
+            }
+        }
+    }
+    else if (type == JREC_RESULT && len >= 4)
+    {
+        /* 終局済み。観戦者も AI もいないので部屋を空けるだけでよい */
+        Room *room = get_room((int32_t)get_u32(p));
+        if (room)
+        {
+            dir_remove_room(room);
+            room->active = 0;
+            room->id = -1;
+        }
+    }
+}
+
+/* ジャーナルを先頭から読み、終局していない部屋を復元する。
+ * ファイル全体は読み込まず、固定長のバッファで先頭から順に流す。
+ * 正しく読めた末尾のオフセットを返す (それ以降は切り詰める)。読み込みエラーなら -1 */
+static off_t journal_replay(int fd, off_t size, int *restored)
+{
+    static uint8_t buf[JOURNAL_READ_BUF];
+    off_t base = JOURNAL_MAGIC_LEN; /* buf[0] のファイル上の位置 */
+    size_t have = 0, pos = 0;
+    unsigned long moves = 0, games = 0;
+
+    for (;;)
+    {
+        /* 残りが最大レコード長を切ったら詰めて読み足す */
+        if (have - pos < JREC_MAX_SIZE && base + (off_t)have < size)
+        {
+            memmove(buf, buf + pos, have - pos);
+            base += (off_t)pos;
+            have -= pos;
+            pos = 0;
+            ssize_t n = pread(fd, buf + have, sizeof(buf) - have, base + (off_t)have);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                perror("journal read");
+                return -1;
+            }
+            if (n == 0)
+                size = base + (off_t)have; /* 途中で短くなった */
+            have += (size_t)n;
+        }
+
+        if (pos + 2 > have)
+            break;
+        const uint8_t *rec = buf + pos;
+        size_t len = rec[1];
+        if (len > JREC_MAX_PAYLOAD || pos + 2 + len + 4 > have)
+            break;
+        if (get_u32(rec + 2 + len) != journal_checksum(rec, 2 + len))
+            break;
+        journal_apply(rec[0], rec + 2, len, &games, &moves);
+        pos += 2 + len + 4;
+    }
+
+    int count = 0;
+    for (int i = 0; i < MAX_ROOMS; i++)
+    {
+        if (rooms[i].active)
+            count++;
+    }
+    printf("Journal: %lu games, %lu moves replayed, %d rooms restored.\n", games, moves, count);
+    *restored = count;
+    return base + (off_t)pos;
+}
+
+/* ジャーナルを開いて復元し、書き込みスレッドを起動する。
+ * restore=0 (引き継ぎ) では部屋は前のプロセスから受け取るので、再生せずに末尾へ追記する
+ * (前のプロセスが閉じてから開くので、書きかけのレコードはない) */
+int journal_open(const char *path, int restore)
+{
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        perror("journal open");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        perror("journal fstat");
+        close(fd);
+        return -1;
+    }
+
+    off_t good = JOURNAL_MAGIC_LEN;
+    if (st.st_size >= JOURNAL_MAGIC_LEN)
+    {
+        char magic[JOURNAL_MAGIC_LEN];
+        if (pread(fd, magic, JOURNAL_MAGIC_LEN, 0) != JOURNAL_MAGIC_LEN)
+        {
+            perror("journal read");
+            close(fd);
+            return -1;
+        }
+        if (memcmp(magic, JOURNAL_MAGIC, JOURNAL_MAGIC_LEN) != 0)
+        {
+            fprintf(stderr, "%s is not a game journal.\n", path);
+            close(fd);
+            return -1;
+        }
+        int restored = 0;
+        good = restore ? journal_replay(fd, st.st_size, &restored) : st.st_size;
+        if (good < 0)
+        {
+            close(fd);
+            return -1;
+        }
+        if (good < st.st_size)
+        {
+            printf("Journal: dropping %ld bytes of torn records.\n", (long)(st.st_size - good));
+            if (ftruncate(fd, good) < 0)
+                perror("journal ftruncate");
+        }
+    }
+    else
+    {
+        if (ftruncate(fd, 0) < 0 || pwrite(fd, JOURNAL_MAGIC, JOURNAL_MAGIC_LEN, 0) != JOURNAL_MAGIC_LEN)
+        {
+            perror("journal init");
+            close(fd);
+            return -1;
+        }
+        fdatasync(fd);
+    }
+    lseek(fd, good, SEEK_SET);
+    journal_fd = fd;
+
+    /* 引き継ぎに失敗して開き直す場合もあるので、前回の停止要求と保留バッファを捨てておく */
+    pthread_mutex_lock(&journal_lock);
+    journal_stopping = 0;
+    free(pending_buf);
+    pending_buf = NULL;
+    pending_len = pending_cap = 0;
+    pthread_mutex_unlock(&journal_lock);
+
+    /* シグナルはイベントループのスレッドで受ける */
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    sigaddset(&block, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+    int rc = pthread_create(&writer, NULL, writer_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (rc != 0)
+    {
+        fprintf(stderr, "journal: cannot start writer thread.\n");
+        close(fd);
+        journal_fd = -1;
+        return -1;
+    }
+    writer_started = 1;
+    printf("Journal: %s\n", path);
+
+    /* 復元した部屋は対局者の RESUME を待つ。AI 対局で AI の手番なら思考を再開する */
+    for (int i = 0; restore && i < MAX_ROOMS; i++)
+    {
+        Room *room = &rooms[i];
+        if (!room->active)
+            continue;
+        room_await_resume(room);
+        if (room->ai_level > 0 && ai_available() &&
+            variant_to_move(&room->game) == room->ai_color)
+            ai_request_move(room);
+    }
+    return 0;
+}
+
+/* 残りを書き出してから閉じる */
+void journal_close(void)
+{
+    if (journal_fd < 0)
+        return;
+    if (writer_started)
+    {
+        pthread_mutex_lock(&journal_lock);
+        journal_stopping = 1;
+        pthread_cond_signal(&journal_cond);
+        pthread_mutex_unlock(&journal_lock);
+        pthread_join(writer, NULL);
+        writer_started = 0;
+    }
+    printf("journal: %lu records, %lu bytes, %lu fdatasync\n", journal_records, journal_bytes, journal_syncs);
+    close(journal_fd);
+    journal_fd = -1;
+    free(pending_buf);
+    pending_buf = NULL;
+    pending_len = pending_cap = 0;
+}
+
+void journal_room_open(const Room *room)
+{
+    uint8_t p[39];
+    size_t n = put_u32(p, (uint32_t)room->id);
+    p[n++] = (uint8_t)room->ai_level;
+    p[n++] = (uint8_t)room->ai_color;
+    n += put_u64(p + n, room->token[PLAYER_BLACK]);
+    n += put_u64(p + n, room->token[PLAYER_WHITE]);
+    n += put_u64(p + n, now_ms());
+    n += put_u32(p + n, (uint32_t)room->tc_base_ms);
+    n += put_u32(p + n, (uint32_t)room->tc_inc_ms);
+    p[n++] = (uint8_t)room->game.size;
+    journal_append(JREC_ROOM_OPEN, p, n);
+}
+
+/* 適用前の手数と一緒に記録する (復元時の整合性確認用) */
+void journal_move(const Room *room, const Move *move)
+{
+    uint8_t p[8 + MOVE_PACKED_SIZE + 4];
+    size_t n = put_u32(p, (uint32_t)room->id);
+    n += put_u32(p + n, variant_ply(&room->game));
+    uint32_t packed = move_pack(move);
+    p[n++] = (uint8_t)(packed >> 16);
+    p[n++] = (uint8_t)(packed >> 8);
+    p[n++] = (uint8_t)packed;
+    int64_t left = room->clock_ms[variant_to_move(&room->game)];
+    n += put_u32(p + n, (uint32_t)(left > 0 ? left : 0));
+    journal_append(JREC_MOVE, p, n);
+}
+
+void journal_result(const Room *room, Player winner, int reason)
+{
+    uint8_t p[14];
+    size_t n = put_u32(p, (uint32_t)room->id);
+    p[n++] = (uint8_t)winner;
+    p[n++] = (uint8_t)reason;
+    n += put_u64(p + n, now_ms());
+    journal_append(JREC_RESULT, p, n);
+}
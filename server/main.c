@@ -1,7 +1,15 @@
 #include "server.h"
 
+#include <fcntl.h>
+
 Client clients[MAX_CLIENTS];
 Room rooms[MAX_ROOMS];
+int io_backend = IO_BACKEND_SELECT;
+unsigned long io_syscalls = 0;
+unsigned long moves_accepted = 0;
+
+volatile sig_atomic_t server_running = 1;
+int idle_timeout_ms = 5 * 60 * 1000;
 
 void init_clients()
 {
@@ -11,116 +19,475 @@ void init_clients()
         clients[i].state = STATE_NONE;
         clients[i].room_id = -1;
         clients[i].player_color = PLAYER_NONE;
+        clients[i].proto = PROTO_PENDING;
+        clients[i].inlen = 0;
+        clients[i].watch_prev = -1;
+        clients[i].watch_next = -1;
+        clients[i].dir_slot = -1;
+        clients[i].chat_channel = -1;
+        clients[i].chat_prev = -1;
+        clients[i].chat_next = -1;
+        clients[i].qm_bucket = -1;
+        clients[i].qm_prev = -1;
+        clients[i].qm_next = -1;
+    }
+}
+
+/* 無操作の接続を切る。対局中は相手を待っているだけのことがあるので延長する */
+static void client_idle_expired(void *arg)
+{
+    Client *c = arg;
+    int idx = (int)(c - clients);
+    if (c->fd == -1)
+        return;
+
+    uint64_t idle = timer_now_ms() - c->last_active;
+    if (c->state == STATE_PLAYING)
+    {
+        timer_schedule(&c->idle_timer, (uint64_t)idle_timeout_ms, client_idle_expired, c);
+    }
+    else if (idle < (uint64_t)idle_timeout_ms)
+    {
+        /* 途中で受信があった: 残り時間で付け直す */
+        timer_schedule(&c->idle_timer, (uint64_t)idle_timeout_ms - idle, client_idle_expired, c);
+    }
+    else
+    {
+        send_client(idx, "Idle timeout.\n");
+        handle_disconnect(idx);
     }
 }
 
-void handle_disconnect(int client_idx, fd_set *read_fds)
+void handle_disconnect(int client_idx)
 {
     printf("Client %d disconnected.\n", clients[client_idx].fd);
+    timer_cancel(&clients[client_idx].idle_timer);
 
     if (clients[client_idx].state == STATE_PLAYING)
     {
         Room *room = get_room(clients[client_idx].room_id);
+        int opponent_idx = -1;
         if (room)
+            opponent_idx = (client_idx == room->black_idx) ? room->white_idx : room->black_idx;
+        if (room && opponent_idx < 0 && room->ai_level == 0)
         {
-            int opponent_idx = (client_idx == room->black_idx) ? room->white_idx : room->black_idx;
-            send_msg(clients[opponent_idx].fd, "Opponent disconnected. You Win!\n");
+            /* 復元した部屋で相手がまだ戻っていない: 席を空けるだけにして再開を待つ */
+            if (client_idx == room->black_idx)
+                room->black_idx = -1;
+            else
+                room->white_idx = -1;
+            room_await_resume(room);
+        }
+        else if (room)
+        {
+            if (opponent_idx >= 0)
+                send_client(opponent_idx, "Opponent disconnected. You Win!\n");
+            room_broadcast_text(room, (clients[client_idx].player_color == PLAYER_BLACK)
+                                          ? "GAME_OVER WHITE (Opponent disconnected)\n"
+                                          : "GAME_OVER BLACK (Opponent disconnected)\n");
+            journal_result(room, (clients[client_idx].player_color == PLAYER_BLACK) ? PLAYER_WHITE : PLAYER_BLACK,
+                           RESULT_DISCONNECT);
 
-            clients[opponent_idx].state = STATE_LOBBY;
-            clients[opponent_idx].room_id = -1;
-            clients[opponent_idx].player_color = PLAYER_NONE;
+            if (opponent_idx >= 0)
+            {
+                clients[opponent_idx].state = STATE_LOBBY;
+                clients[opponent_idx].room_id = -1;
+                clients[opponent_idx].player_color = PLAYER_NONE;
+                chat_enter(opponent_idx);
+            }
 
             close_room(room);
         }
     }
+    else if (clients[client_idx].state == STATE_WATCHING)
+    {
+        room_remove_watcher(get_room(clients[client_idx].room_id), client_idx);
+    }
 
-    close(clients[client_idx].fd);
-    FD_CLR(clients[client_idx].fd, read_fds);
+    dir_remove_waiting(client_idx);
+    chat_leave(client_idx);
+    qm_leave(client_idx);
+    capture_conn_close(client_idx);
+    close_conn(clients[client_idx].fd);
     clients[client_idx].fd = -1;
     clients[client_idx].state = STATE_NONE;
     clients[client_idx].room_id = -1;
     clients[client_idx].player_color = PLAYER_NONE;
 }
 
-void handle_new_connection(int listen_fd, fd_set *read_fds, int *max_fd)
+/* 引き継いだ接続の無操作タイマーを掛け直す (last_active は前のプロセスの値) */
+void client_resume_idle(int client_idx)
+{
+    if (idle_timeout_ms > 0)
+        timer_schedule(&clients[client_idx].idle_timer, (uint64_t)idle_timeout_ms, client_idle_expired,
+                       &clients[client_idx]);
+}
+
+/* 受け付けた接続をクライアントテーブルに登録する。満員なら -1 */
+int accept_client(int new_fd, const char *addr)
+{
+    printf("New connection from %s\n", addr);
+    if (io_backend == IO_BACKEND_SELECT && new_fd >= FD_SETSIZE)
+    {
+        /* select() で監視できない fd */
+        send_msg(new_fd, "Server full.\n");
+        close_conn(new_fd);
+        return -1;
+    }
+    /* 応答は1行ずつ小さく書くので Nagle で遅延 ACK 待ち (最大 40ms) にならないようにする */
+    int one = 1;
+    setsockopt(new_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (clients[i].fd == -1)
+        {
+            clients[i].fd = new_fd;
+            clients[i].state = STATE_LOBBY;
+            clients[i].room_id = -1;
+            clients[i].player_color = PLAYER_NONE;
+            clients[i].proto = PROTO_PENDING;
+            clients[i].inlen = 0;
+            clients[i].watch_prev = -1;
+            clients[i].watch_next = -1;
+            clients[i].dir_slot = -1;
+            clients[i].qm_bucket = -1;
+            clients[i].sync_check = 0;
+            clients[i].tc_base_ms = 0;
+            clients[i].tc_inc_ms = 0;
+            clients[i].board_size = BOARD_W;
+            clients[i].admin = (strcmp(addr, "127.0.0.1") == 0);
+            clients[i].last_active = timer_now_ms();
+            if (idle_timeout_ms > 0)
+                timer_schedule(&clients[i].idle_timer, (uint64_t)idle_timeout_ms, client_idle_expired, &clients[i]);
+            chat_reset_rate(i);
+            chat_enter(i);
+            metrics_add(MET_CONNECTIONS, 1);
+            capture_conn_open(i);
+            send_msg(new_fd, "Welcome! Cmds: LIST, CREATE <id>, JOIN <id>, QUICKMATCH, WATCH <id>, PLAY_AI <1-5> [WHITE], EXIT\n");
+            return i;
+        }
+    }
+    send_msg(new_fd, "Server full.\n");
+    close_conn(new_fd);
+    return -1;
+}
+
+void handle_new_connection(int listen_fd)
 {
     struct sockaddr_in cli_addr;
     socklen_t clilen = sizeof(cli_addr);
     int new_fd;
 
-    if ((new_fd = accept(listen_fd, (struct sockaddr *)&cli_addr, &clilen)) < 0)
+    /* 遅い受信者でループが止まらないよう、select 側のソケットは非ブロッキングにする */
+    io_syscalls++;
+    if ((new_fd = accept4(listen_fd, (struct sockaddr *)&cli_addr, &clilen, SOCK_NONBLOCK)) < 0)
     {
         perror("accept");
     }
     else
     {
-        printf("New connection from %s\n", inet_ntoa(cli_addr.sin_addr));
-        int added = 0;
-        for (int i = 0; i < MAX_CLIENTS; i++)
+        accept_client(new_fd, inet_ntoa(cli_addr.sin_addr));
+    }
+}
+
+/* テキスト1行分のコマンドを処理する */
+void dispatch_text(int client_idx, char *line)
+{
+    TRACE_BEGIN(TR_DISPATCH_TEXT);
+    uint64_t started = metrics_now();
+    if (strncmp(line, "SYNC", 4) == 0)
+    {
+        /* 対局中・観戦中・ロビーのどこからでも使える */
+        process_sync_command(client_idx, line);
+        metrics_record(MET_HIST_OTHER, metrics_now() - started);
+    }
+    else if (clients[client_idx].state == STATE_PLAYING)
+    {
+        if (strncmp(line, "MOVE", 4) == 0)
         {
-            if (clients[i].fd == -1)
-            {
-                clients[i].fd = new_fd;
-                clients[i].state = STATE_LOBBY;
-                clients[i].room_id = -1;
-                clients[i].player_color = PLAYER_NONE;
-                FD_SET(new_fd, read_fds);
-                if (new_fd > *max_fd)
-                    *max_fd = new_fd;
-                send_msg(new_fd, "Welcome! Cmds: LIST, CREATE <id>, JOIN <id>, EXIT\n");
-                added = 1;
-                break;
-            }
+            TRACE_BEGIN(TR_GAME_MOVE);
+            process_game_move(client_idx, line);
+            TRACE_END(TR_GAME_MOVE);
+            metrics_record(MET_HIST_MOVE, metrics_now() - started);
         }
-        if (!added)
+        else
         {
-            send_msg(new_fd, "Server full.\n");
-            close(new_fd);
+            send_client(client_idx, "Unknown command in game. Use 'MOVE ...'\n");
         }
     }
+    else if (clients[client_idx].state == STATE_WATCHING)
+    {
+        if (strncmp(line, "UNWATCH", 7) == 0)
+        {
+            room_remove_watcher(get_room(clients[client_idx].room_id), client_idx);
+            send_client(client_idx, "Stopped watching.\n");
+        }
+        else
+        {
+            send_client(client_idx, "Watching. Use 'UNWATCH' to return to lobby.\n");
+        }
+    }
+    else
+    {
+        TRACE_BEGIN(TR_LOBBY_COMMAND);
+        process_lobby_command(client_idx, line);
+        TRACE_END(TR_LOBBY_COMMAND);
+        metrics_record(metrics_command_hist(line), metrics_now() - started);
+    }
+    TRACE_END(TR_DISPATCH_TEXT);
 }
 
-void handle_client_data(int client_idx, fd_set *read_fds)
+/* バイナリフレーム1つを処理する */
+void dispatch_frame(int client_idx, const uint8_t *frame, size_t size)
 {
-    char buffer[BUF_SIZE];
-    int nbytes;
+    uint8_t opcode = frame[2];
+    const uint8_t *payload = frame + WIRE_HEADER_SIZE;
+    size_t len = size - WIRE_HEADER_SIZE;
+    TRACE_BEGIN(TR_DISPATCH_FRAME);
 
-    memset(buffer, 0, BUF_SIZE);
-    nbytes = read(clients[client_idx].fd, buffer, BUF_SIZE - 1);
+    if (opcode == WIRE_OP_MOVE)
+    {
+        Move move;
+        uint64_t started = metrics_now();
+        if (clients[client_idx].state != STATE_PLAYING)
+            send_client(client_idx, "Error: Not in game.\n");
+        else if (!wire_decode_move(payload, len, &move))
+            send_client(client_idx, "Error: Invalid format.\n");
+        else
+            process_move(client_idx, &move);
+        metrics_record(MET_HIST_MOVE, metrics_now() - started);
+    }
+    else if (opcode == WIRE_OP_TEXT)
+    {
+        /* テキストコマンドは改行付きの文字列にしてテキスト経路へ流す */
+        char line[WIRE_MAX_FRAME + 2];
+        memcpy(line, payload, len);
+        line[len] = '\n';
+        line[len + 1] = '\0';
+        dispatch_text(client_idx, line);
+    }
+    else
+    {
+        send_client(client_idx, "Error: Unknown opcode.\n");
+    }
+    TRACE_END(TR_DISPATCH_FRAME);
+}
 
+/* 受信データを処理する。nbytes <= 0 は切断を意味する */
+void handle_client_data(int client_idx, char *buffer, int nbytes)
+{
     if (nbytes <= 0)
     {
-        handle_disconnect(client_idx, read_fds);
+        handle_disconnect(client_idx);
+        return;
     }
-    else
+
+    Client *c = &clients[client_idx];
+    int fd = c->fd;
+    metrics_add(MET_BYTES_IN, (unsigned long)nbytes);
+    TRACE_BEGIN(TR_CLIENT_DATA);
+    c->last_active = timer_now_ms(); /* 無操作タイマーは発火時に見るだけ (受信ごとに付け直さない) */
+
+    /* 最初の1バイトでプロトコルを決める */
+    if (c->proto == PROTO_PENDING)
     {
-        buffer[nbytes] = '\0';
+        if ((uint8_t)buffer[0] == WIRE_HANDSHAKE)
+        {
+            uint8_t ack = WIRE_HANDSHAKE;
+            c->proto = PROTO_BINARY;
+            capture_inbound(client_idx, buffer, 1);
+            send_data(fd, &ack, 1);
+            buffer++;
+            nbytes--;
+        }
+        else
+        {
+            c->proto = PROTO_TEXT;
+        }
+    }
 
-        if (clients[client_idx].state == STATE_PLAYING)
+    if (c->inlen + nbytes > (int)sizeof(c->inbuf))
+    {
+        /* 行/フレームが長すぎる: 溜まっている分を捨てる */
+        c->inlen = 0;
+        send_client(client_idx, "Error: Message too long.\n");
+        if (nbytes > (int)sizeof(c->inbuf))
         {
-            if (strncmp(buffer, "MOVE", 4) == 0)
+            TRACE_END(TR_CLIENT_DATA);
+            return;
+        }
+    }
+    memcpy(c->inbuf + c->inlen, buffer, nbytes);
+    c->inlen += nbytes;
+
+    int pos = 0;
+    while (c->fd == fd && pos < c->inlen)
+    {
+        if (c->proto == PROTO_BINARY)
+        {
+            size_t size = wire_frame_size((uint8_t *)c->inbuf + pos, c->inlen - pos);
+            if (size == 0)
+                break;
+            if (size == (size_t)-1)
             {
-                process_game_move(client_idx, buffer);
+                send_client(client_idx, "Error: Bad frame.\n");
+                pos = c->inlen;
+                break;
             }
-            else
+            capture_inbound(client_idx, c->inbuf + pos, size);
+            dispatch_frame(client_idx, (uint8_t *)c->inbuf + pos, size);
+            pos += (int)size;
+        }
+        else
+        {
+            char *nl = memchr(c->inbuf + pos, '\n', c->inlen - pos);
+            if (!nl)
+                break;
+            int len = (int)(nl - (c->inbuf + pos)) + 1;
+            char line[WIRE_MAX_FRAME + 1];
+            memcpy(line, c->inbuf + pos, len);
+            line[len] = '\0';
+            pos += len;
+            capture_inbound(client_idx, line, (size_t)len);
+            dispatch_text(client_idx, line);
+        }
+    }
+
+    /* 切断されていなければ未処理分を先頭に詰める */
+    if (c->fd == fd && pos > 0)
+    {
+        memmove(c->inbuf, c->inbuf + pos, c->inlen - pos);
+        c->inlen -= pos;
+    }
+    TRACE_END(TR_CLIENT_DATA);
+}
+
+/* select() によるイベントループ (io_uring が使えない場合のフォールバック) */
+void run_select_loop(int listen_fd)
+{
+    fd_set read_fds, write_fds;
+    char buffer[BUF_SIZE];
+
+    /* 引き継いだ接続 (io_uring で受け付けたものはブロッキング) も非ブロッキングにそろえる */
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (clients[i].fd != -1)
+            fcntl(clients[i].fd, F_SETFL, fcntl(clients[i].fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    while (server_running)
+    {
+        /* 引き継ぎ要求後は受け付けも受信もせず、送信を流しきったら抜ける */
+        if (handoff_requested && handoff_drained())
+            break;
+        trace_poll();
+        drop_slow_clients();
+        /* 監視対象は毎回クライアントテーブルから組み立てる。送信待ちがあれば書き込みも監視 */
+        FD_ZERO(&read_fds);
+        FD_ZERO(&write_fds);
+        int max_fd = listen_fd;
+        if (!handoff_requested)
+            FD_SET(listen_fd, &read_fds);
+        if (handoff_listen_fd >= 0)
+        {
+            FD_SET(handoff_listen_fd, &read_fds);
+            if (handoff_listen_fd > max_fd)
+                max_fd = handoff_listen_fd;
+        }
+        if (ai_event_fd >= 0)
+        {
+            FD_SET(ai_event_fd, &read_fds);
+            if (ai_event_fd > max_fd)
+                max_fd = ai_event_fd;
+        }
+        if (timer_fd >= 0)
+        {
+            FD_SET(timer_fd, &read_fds);
+            if (timer_fd > max_fd)
+                max_fd = timer_fd;
+        }
+        timer_sync();
+        for (int i = 0; i < MAX_CLIENTS; i++)
+        {
+            if (clients[i].fd != -1)
             {
-                send_msg(clients[client_idx].fd, "Unknown command in game. Use 'MOVE ...'\n");
+                if (!handoff_requested)
+                    FD_SET(clients[i].fd, &read_fds);
+                if (out_pending(clients[i].fd))
+                    FD_SET(clients[i].fd, &write_fds);
+                if (clients[i].fd > max_fd)
+                    max_fd = clients[i].fd;
             }
         }
-        else
+
+        io_syscalls++;
+        TRACE_BEGIN(TR_IO_WAIT);
+        int ready = select(max_fd + 1, &read_fds, &write_fds, NULL, NULL);
+        TRACE_END(TR_IO_WAIT);
+        if (ready < 0)
         {
-            process_lobby_command(client_idx, buffer);
+            if (errno == EINTR)
+                continue;
+            perror("select");
+            break;
+        }
+
+        if (FD_ISSET(listen_fd, &read_fds))
+        {
+            handle_new_connection(listen_fd);
+        }
+        if (handoff_listen_fd >= 0 && FD_ISSET(handoff_listen_fd, &read_fds))
+        {
+            handoff_accept();
+        }
+        if (ai_event_fd >= 0 && FD_ISSET(ai_event_fd, &read_fds))
+        {
+            ai_handle_event();
+        }
+        if (timer_fd >= 0 && FD_ISSET(timer_fd, &read_fds))
+        {
+            timer_handle_event(0);
+        }
+
+        for (int i = 0; i < MAX_CLIENTS; i++)
+        {
+            if (clients[i].fd != -1 && FD_ISSET(clients[i].fd, &write_fds))
+            {
+                flush_out(clients[i].fd);
+            }
+            if (clients[i].fd != -1 && FD_ISSET(clients[i].fd, &read_fds))
+            {
+                io_syscalls++;
+                int nbytes = read(clients[i].fd, buffer, BUF_SIZE - 1);
+                if (nbytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                    continue;
+                handle_client_data(i, buffer, nbytes);
+            }
         }
     }
 }
 
-int main()
+void handle_shutdown_signal(int sig)
 {
-    signal(SIGPIPE, SIG_IGN);
+    (void)sig;
+    server_running = 0;
+}
 
-    int listen_fd, max_fd;
+/* 終了時に syscall 数と手数を表示する (バックエンド比較用) */
+void print_io_stats()
+{
+    printf("I/O backend: %s\n", (io_backend == IO_BACKEND_URING) ? "io_uring" : "select");
+    printf("syscalls: %lu, moves: %lu", io_syscalls, moves_accepted);
+    if (moves_accepted > 0)
+        printf(", syscalls/move: %.2f", (double)io_syscalls / (double)moves_accepted);
+    printf("\n");
+}
+
+/* ゲーム用の listen ソケットを作る */
+static int open_listen_socket(void)
+{
+    int listen_fd;
     struct sockaddr_in serv_addr;
-    fd_set read_fds, temp_fds;
 
     if ((listen_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
     {
@@ -141,42 +508,183 @@ int main()
         perror("bind");
         exit(1);
     }
-    if (listen(listen_fd, 5) < 0)
+    if (listen(listen_fd, SOMAXCONN) < 0)
     {
         perror("listen");
         exit(1);
     }
+    return listen_fd;
+}
 
-    init_clients();
-    init_rooms();
-
-    FD_ZERO(&read_fds);
-    FD_SET(listen_fd, &read_fds);
-    max_fd = listen_fd;
+/* イベントループを回す (server_running が落ちるか引き継ぎ要求で戻る) */
+static void run_event_loop(int listen_fd, const char *io_mode)
+{
+    if (strcmp(io_mode, "select") != 0)
+    {
+        if (uring_run(listen_fd) == 0)
+            return;
+        if (strcmp(io_mode, "uring") == 0)
+        {
+            fprintf(stderr, "io_uring backend unavailable.\n");
+            exit(1);
+        }
+        printf("io_uring unavailable, falling back to select().\n");
+    }
+    io_backend = IO_BACKEND_SELECT;
+    run_select_loop(listen_fd);
+}
 
-    printf("Game Server started on port %d...\n", PORT);
+int main(int argc, char *argv[])
+{
+    signal(SIGPIPE, SIG_IGN);
 
-    while (1)
+    /* --io=auto|select|uring (auto は io_uring を試し、失敗したら select) */
+    /* --ai-workers=N で AI の思考スレッド数 (0 はコア数から決める) */
+    /* --journal=PATH で対局ジャーナル (空文字なら無効) */
+    /* --idle-timeout=SEC で無操作の接続を切る (0 で無効) */
+    /* --trace[=PATH] でホットパスのトレースを有効にする (TRACE DUMP か SIGUSR1 で書き出す) */
+    /* --capture=PATH で受信コマンドと送信データを記録する (client/replay で再生) */
+    /* --metrics=PATH で Prometheus 形式のメトリクスを定期的に書き出す (--metrics-interval=SEC) */
+    /* --weights=PATH で AI の評価の重みを読む (client/tune の出力) */
+    /* --handoff=PATH で引き継ぎ要求を待つ。--takeover を付けると PATH で待っているサーバーから引き継ぐ */
+    const char *io_mode = "auto";
+    const char *journal_path = "contrast.journal";
+    const char *metrics_path = NULL;
+    const char *capture_path = NULL;
+    const char *trace_path = NULL;
+    const char *weights_path = NULL;
+    const char *handoff_path = NULL;
+    int takeover = 0;
+    int metrics_interval = 10;
+    int ai_workers = 0;
+    for (int i = 1; i < argc; i++)
     {
-        temp_fds = read_fds;
-        if (select(max_fd + 1, &temp_fds, NULL, NULL, NULL) < 0)
+        if (strncmp(argv[i], "--io=", 5) == 0)
         {
-            perror("select");
-            break;
+            io_mode = argv[i] + 5;
         }
-
-        if (FD_ISSET(listen_fd, &temp_fds))
+        else if (strncmp(argv[i], "--ai-workers=", 13) == 0)
         {
-            handle_new_connection(listen_fd, &read_fds, &max_fd);
+            ai_workers = atoi(argv[i] + 13);
         }
-
-        for (int i = 0; i < MAX_CLIENTS; i++)
+        else if (strncmp(argv[i], "--idle-timeout=", 15) == 0)
         {
-            if (clients[i].fd != -1 && FD_ISSET(clients[i].fd, &temp_fds))
-            {
-                handle_client_data(i, &read_fds);
-            }
+            idle_timeout_ms = atoi(argv[i] + 15) * 1000;
         }
+        else if (strncmp(argv[i], "--journal=", 10) == 0)
+        {
+            journal_path = argv[i] + 10;
+        }
+        else if (strcmp(argv[i], "--trace") == 0 || strncmp(argv[i], "--trace=", 8) == 0)
+        {
+            trace_path = (argv[i][7] == '=') ? argv[i] + 8 : "";
+        }
+        else if (strncmp(argv[i], "--capture=", 10) == 0)
+        {
+            capture_path = argv[i] + 10;
+        }
+        else if (strncmp(argv[i], "--metrics=", 10) == 0)
+        {
+            metrics_path = argv[i] + 10;
+        }
+        else if (strncmp(argv[i], "--metrics-interval=", 19) == 0)
+        {
+            metrics_interval = atoi(argv[i] + 19);
+        }
+        else if (strncmp(argv[i], "--weights=", 10) == 0)
+        {
+            weights_path = argv[i] + 10;
+        }
+        else if (strncmp(argv[i], "--handoff=", 10) == 0)
+        {
+            handoff_path = argv[i] + 10;
+        }
+        else if (strcmp(argv[i], "--takeover") == 0)
+        {
+            takeover = 1;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--io=auto|select|uring] [--ai-workers=N] [--journal=PATH] [--idle-timeout=SEC] [--metrics=PATH] [--metrics-interval=SEC] [--capture=PATH] [--trace[=PATH]] [--weights=PATH] [--handoff=PATH [--takeover]]\n", argv[0]);
+            exit(1);
+        }
+    }
+    if (takeover && (!handoff_path || !handoff_path[0]))
+    {
+        fprintf(stderr, "--takeover needs --handoff=PATH.\n");
+        exit(1);
+    }
+    if (strcmp(io_mode, "auto") != 0 && strcmp(io_mode, "select") != 0 && strcmp(io_mode, "uring") != 0)
+    {
+        fprintf(stderr, "Unknown I/O backend: %s\n", io_mode);
+        exit(1);
+    }
+
+    /* SIGINT/SIGTERM でループを抜けて統計を表示する */
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_shutdown_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    /* SIGUSR1 でトレースを書き出す (実際の書き出しはループ側) */
+    sa.sa_handler = handle_trace_signal;
+    sigaction(SIGUSR1, &sa, NULL);
+
+    /* 引き継ぐときは listen ソケットも前のプロセスから受け取る */
+    int listen_fd;
+    if (takeover)
+    {
+        if (handoff_receive(handoff_path, &listen_fd) < 0)
+            exit(1);
+    }
+    else
+    {
+        listen_fd = open_listen_socket();
+    }
+
+    init_clients();
+    init_rooms();
+    chat_init();
+    qm_init();
+    trace_init(trace_path);
+    if (timer_init() < 0)
+        exit(1);
+    if (weights_path && ai_load_weights(weights_path) < 0)
+        exit(1);
+    if (ai_init(ai_workers) < 0)
+        printf("AI workers unavailable, PLAY_AI disabled.\n");
+    if (journal_path[0] && journal_open(journal_path, !takeover) < 0)
+        exit(1);
+    metrics_init(metrics_path, metrics_interval);
+    if (capture_path && capture_open(capture_path) < 0)
+        exit(1);
+    if (takeover && handoff_restore() < 0)
+    {
+        fprintf(stderr, "Handoff: cannot restore the received state.\n");
+        exit(1);
     }
+    if (handoff_path && handoff_path[0] && handoff_listen(handoff_path) < 0)
+        exit(1);
+
+    printf("Game Server started on port %d...\n", PORT);
+
+    for (;;)
+    {
+        run_event_loop(listen_fd, io_mode);
+        if (!handoff_requested || !server_running)
+            break;
+        if (handoff_send(listen_fd) == 0)
+            break;
+        /* 引き継げなかった: ジャーナルを開き直してそのまま続ける */
+        if (journal_path[0] && journal_open(journal_path, 0) < 0)
+            exit(1);
+    }
+
+    ai_shutdown();
+    journal_close();
+    metrics_dump();
+    capture_close();
+    print_io_stats();
+    close(listen_fd);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,171 @@
+#include "server.h"
+
+/* QUICKMATCH の待ち行列
+ * 持ち時間とレーティング帯 (200刻み、指定なしは別扱い) の組ごとにバケットを作り、
+ * バケットの中は来た順の双方向リストにする。相手探しは自分のバケット
+ * (レーティングありなら隣の帯も) の先頭を見るだけなので待っている人数によらない。
+ * バケットは待っている人がいる間だけ存在し、ハッシュ表 (チェイン) で引く。 */
+#define QM_HASH 256
+#define QM_BAND 200
+#define QM_NO_BAND (-1)
+
+typedef struct
+{
+    int base_ms;
+    int inc_ms;
+    int band;
+    int head; /* 一番長く待っている人 (clients[] の添字) */
+    int tail;
+    int next; /* ハッシュのチェイン / 空きリスト */
+} QmBucket;
+
+/* 1人が使うバケットは高々1つなので MAX_CLIENTS 個あれば足りる */
+static QmBucket buckets[MAX_CLIENTS];
+static int hash_head[QM_HASH];
+static int free_head = -1;
+static int queued = 0;
+
+void qm_init(void)
+{
+    for (int i = 0; i < QM_HASH; i++)
+        hash_head[i] = -1;
+    for (int i = 0; i < MAX_CLIENTS; i++)
+        buckets[i].next = (i + 1 < MAX_CLIENTS) ? i + 1 : -1;
+    free_head = 0;
+}
+
+static unsigned bucket_hash(int base_ms, int inc_ms, int band)
+{
+    unsigned h = (unsigned)base_ms * 2654435761u;
+    h ^= (unsigned)inc_ms * 40503u;
+    h ^= (unsigned)(band + 1) * 2246822519u;
+    return (h >> 8) % QM_HASH;
+}
+
+static int bucket_find(int base_ms, int inc_ms, int band)
+{
+    for (int b = hash_head[bucket_hash(base_ms, inc_ms, band)]; b != -1; b = buckets[b].next)
+    {
+        if (buckets[b].base_ms == base_ms && buckets[b].inc_ms == inc_ms && buckets[b].band == band)
+            return b;
+    }
+    return -1;
+}
+
+static int bucket_get(int base_ms, int inc_ms, int band)
+{
+    int b = bucket_find(base_ms, inc_ms, band);
+    if (b != -1 || free_head == -1)
+        return b;
+    b = free_head;
+    free_head = buckets[b].next;
+    unsigned h = bucket_hash(base_ms, inc_ms, band);
+    buckets[b].base_ms = base_ms;
+    buckets[b].inc_ms = inc_ms;
+    buckets[b].band = band;
+    buckets[b].head = buckets[b].tail = -1;
+    buckets[b].next = hash_head[h];
+    hash_head[h] = b;
+    return b;
+}
+
+/* 空になったバケットをハッシュから外して空きリストに戻す */
+static void bucket_release(int b)
+{
+    unsigned h = bucket_hash(buckets[b].base_ms, buckets[b].inc_ms, buckets[b].band);
+    int *pp = &hash_head[h];
+    while (*pp != b)
+        pp = &buckets[*pp].next;
+    *pp = buckets[b].next;
+    buckets[b].next = free_head;
+    free_head = b;
+}
+
+/* 列の末尾に並ぶ (バケットが作れなければ -1) */
+static int bucket_append(int client_idx, int base_ms, int inc_ms, int band)
+{
+    int b = bucket_get(base_ms, inc_ms, band);
+    if (b == -1)
+        return -1;
+    Client *c = &clients[client_idx];
+    c->qm_bucket = b;
+    c->qm_next = -1;
+    c->qm_prev = buckets[b].tail;
+    if (buckets[b].tail != -1)
+        clients[buckets[b].tail].qm_next = client_idx;
+    else
+        buckets[b].head = client_idx;
+    buckets[b].tail = client_idx;
+    queued++;
+    return 0;
+}
+
+void qm_leave(int client_idx)
+{
+    Client *c = &clients[client_idx];
+    int b = c->qm_bucket;
+    if (b == -1)
+        return;
+    QmBucket *q = &buckets[b];
+    if (c->qm_prev != -1)
+        clients[c->qm_prev].qm_next = c->qm_next;
+    else
+        q->head = c->qm_next;
+    if (c->qm_next != -1)
+        clients[c->qm_next].qm_prev = c->qm_prev;
+    else
+        q->tail = c->qm_prev;
+    c->qm_bucket = -1;
+    c->qm_prev = c->qm_next = -1;
+    queued--;
+    if (q->head == -1)
+        bucket_release(b);
+}
+
+/* 同じ条件で待っている人がいればその人を行列から外して返す。
+ * いなければ自分が並んで -1 (並べなければ -2) */
+int qm_pair_or_enqueue(int client_idx, int base_ms, int inc_ms, int rating)
+{
+    int band = (rating >= 0) ? rating / QM_BAND : QM_NO_BAND;
+
+    /* 同じ帯を優先し、レーティングがあれば上下の帯も見る */
+    int tries[3] = {band, band - 1, band + 1};
+    int ntries = (band == QM_NO_BAND) ? 1 : 3;
+    for (int t = 0; t < ntries; t++)
+    {
+        if (tries[t] < 0 && band != QM_NO_BAND)
+            continue;
+        int b = bucket_find(base_ms, inc_ms, tries[t]);
+        if (b != -1)
+        {
+            int partner = buckets[b].head;
+            qm_leave(partner);
+            return partner;
+        }
+    }
+
+    return bucket_append(client_idx, base_ms, inc_ms, band) == 0 ? -1 : -2;
+}
+
+/* 並んでいる条件 (レーティング帯は QM_NO_BAND なら指定なし)。並んでいなければ 0 */
+int qm_entry(int client_idx, int *base_ms, int *inc_ms, int *band)
+{
+    int b = clients[client_idx].qm_bucket;
+    if (b == -1)
+        return 0;
+    *base_ms = buckets[b].base_ms;
+    *inc_ms = buckets[b].inc_ms;
+    *band = buckets[b].band;
+    return 1;
+}
+
+/* 引き継いだクライアントを同じ条件の列の末尾に並べ直す (相手探しはしない) */
+int qm_restore(int client_idx, int base_ms, int inc_ms, int band)
+{
+    return bucket_append(client_idx, base_ms, inc_ms, band);
+}
+
+int qm_queued(void)
+{
+    return queued;
+}
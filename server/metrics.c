@@ -0,0 +1,314 @@
+#include "server.h"
+
+#include <stdatomic.h>
+#include <time.h>
+
+/* 組み込みメトリクス
+ * カウンタとヒストグラムはすべて relaxed な atomic 加算だけで記録する
+ * (AI ワーカーからも書くので lock-free にしておく)。
+ * ヒストグラムは HDR 風の対数線形バケット: 2 の冪ごとに 16 分割するので
+ * 相対誤差は 1/16 以内、添字計算は clz 1回で済む。 */
+#define MET_SUB_BITS 4
+#define MET_SUB (1 << MET_SUB_BITS)
+#define MET_MAX_BITS 40 /* 2^40 ns (約18分) 以上は最後のバケットに入れる */
+#define MET_BUCKETS ((MET_MAX_BITS - MET_SUB_BITS + 1) * MET_SUB)
+
+typedef struct
+{
+    _Alignas(64) atomic_ulong count;
+    atomic_ulong sum_ns;
+    atomic_ulong max_ns;
+    atomic_ulong buckets[MET_BUCKETS];
+} Histogram;
+
+static Histogram hists[MET_HIST_COUNT];
+static _Alignas(64) atomic_ulong counters[MET_COUNTER_COUNT];
+
+/* Prometheus の名前とラベル */
+static const struct
+{
+    const char *family;
+    const char *label; /* NULL ならラベルなし */
+    const char *stats; /* STATS での表示名 */
+} HIST_NAMES[MET_HIST_COUNT] = {
+    {"contrast_command_duration_seconds", "SAY", "SAY"},
+    {"contrast_command_duration_seconds", "LIST", "LIST"},
+    {"contrast_command_duration_seconds", "CREATE", "CREATE"},
+    {"contrast_command_duration_seconds", "JOIN", "JOIN"},
+    {"contrast_command_duration_seconds", "MOVE", "MOVE"},
+    {"contrast_command_duration_seconds", "OTHER", "OTHER"},
+    {"contrast_move_validation_seconds", NULL, "validate"},
+    {"contrast_ai_think_seconds", NULL, "ai_think"},
+};
+
+static const char *COUNTER_NAMES[MET_COUNTER_COUNT] = {
+    "contrast_bytes_in_total",
+    "contrast_bytes_out_total",
+    "contrast_connections_total",
+    "contrast_games_started_total",
+    "contrast_games_finished_total",
+    "contrast_moves_rejected_total",
+};
+
+static uint64_t started_ms = 0;
+static const char *dump_path = NULL;
+static int dump_interval_ms = 0;
+static Timer dump_timer;
+
+/* 引き継いで起動したときの記録 (STATS と Prometheus に出す) */
+static int handoff_done = 0;
+static double handoff_pause_ms = 0;
+static int handoff_clients = 0;
+static int handoff_rooms = 0;
+static int handoff_dropped = 0;
+
+uint64_t metrics_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int bucket_index(uint64_t ns)
+{
+    if (ns < MET_SUB)
+        return (int)ns;
+    int msb = 63 - __builtin_clzll(ns);
+    if (msb >= MET_MAX_BITS)
+        return MET_BUCKETS - 1;
+    int shift = msb - MET_SUB_BITS;
+    return (shift + 1) * MET_SUB + (int)((ns >> shift) & (MET_SUB - 1));
+}
+
+/* バケットに入る最大値 (パーセンタイルはこれで報告する) */
+static uint64_t bucket_upper(int idx)
+{
+    if (idx < MET_SUB)
+        return (uint64_t)idx;
+    int shift = idx / MET_SUB - 1;
+    uint64_t lower = (uint64_t)(MET_SUB + idx % MET_SUB) << shift;
+    return lower + ((uint64_t)1 << shift) - 1;
+}
+
+void metrics_add(int counter, unsigned long n)
+{
+    atomic_fetch_add_explicit(&counters[counter], n, memory_order_relaxed);
+}
+
+void metrics_record(int hist, uint64_t ns)
+{
+    Histogram *h = &hists[hist];
+    atomic_fetch_add_explicit(&h->buckets[bucket_index(ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum_ns, ns, memory_order_relaxed);
+    /* 最大値は更新が必要なときだけ CAS する */
+    unsigned long max = atomic_load_explicit(&h->max_ns, memory_order_relaxed);
+    while (ns > max &&
+           !atomic_compare_exchange_weak_explicit(&h->max_ns, &max, ns,
+                                                  memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+/* ロビーのコマンド行をヒストグラムに振り分ける */
+int metrics_command_hist(const char *line)
+{
+    if (strncmp(line, "SAY", 3) == 0)
+        return MET_HIST_SAY;
+    if (strncmp(line, "LIST", 4) == 0)
+        return MET_HIST_LIST;
+    if (strncmp(line, "CREATE", 6) == 0)
+        return MET_HIST_CREATE;
+    if (strncmp(line, "JOIN", 4) == 0)
+        return MET_HIST_JOIN;
+    return MET_HIST_OTHER;
+}
+
+/* 記録中の値を読むので合計とバケットは多少ずれうる (集計には十分) */
+static uint64_t hist_percentile(const unsigned long *snap, unsigned long total, double q)
+{
+    if (total == 0)
+        return 0;
+    unsigned long rank = (unsigned long)(q * (double)total);
+    if (rank >= total)
+        rank = total - 1;
+    unsigned long seen = 0;
+    for (int i = 0; i < MET_BUCKETS; i++)
+    {
+        seen += snap[i];
+        if (seen > rank)
+            return bucket_upper(i);
+    }
+    return bucket_upper(MET_BUCKETS - 1);
+}
+
+static unsigned long hist_snapshot(int hist, unsigned long *snap)
+{
+    unsigned long total = 0;
+    for (int i = 0; i < MET_BUCKETS; i++)
+    {
+        snap[i] = atomic_load_explicit(&hists[hist].buckets[i], memory_order_relaxed);
+        total += snap[i];
+    }
+    return total;
+}
+
+static void gauge_counts(int *nclients, int *nrooms)
+{
+    *nclients = 0;
+    *nrooms = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (clients[i].fd != -1)
+            (*nclients)++;
+    }
+    for (int i = 0; i < MAX_ROOMS; i++)
+    {
+        if (rooms[i].active)
+            (*nrooms)++;
+    }
+}
+
+/* 管理者向けの STATS 応答 (1行ずつ送るのでバイナリでもフレームに収まる) */
+void metrics_send_stats(int client_idx)
+{
+    static unsigned long snap[MET_BUCKETS];
+    char line[160];
+    int nclients, nrooms;
+    gauge_counts(&nclients, &nrooms);
+
+    snprintf(line, sizeof(line), "STATS uptime=%lus clients=%d rooms=%d moves=%lu\n",
+             (unsigned long)((timer_now_ms() - started_ms) / 1000), nclients, nrooms, moves_accepted);
+    send_client(client_idx, line);
+    snprintf(line, sizeof(line), "bytes_in=%lu bytes_out=%lu connections=%lu games=%lu/%lu rejected=%lu\n",
+             atomic_load(&counters[MET_BYTES_IN]), atomic_load(&counters[MET_BYTES_OUT]),
+             atomic_load(&counters[MET_CONNECTIONS]), atomic_load(&counters[MET_GAMES_FINISHED]),
+             atomic_load(&counters[MET_GAMES_STARTED]), atomic_load(&counters[MET_MOVES_REJECTED]));
+    send_client(client_idx, line);
+    if (handoff_done)
+    {
+        snprintf(line, sizeof(line), "handoff pause=%.1fms clients=%d rooms=%d dropped=%d\n", handoff_pause_ms,
+                 handoff_clients, handoff_rooms, handoff_dropped);
+        send_client(client_idx, line);
+    }
+
+    for (int h = 0; h < MET_HIST_COUNT; h++)
+    {
+        unsigned long total = hist_snapshot(h, snap);
+        if (total == 0)
+            continue;
+        /* バケットの上端は実測の最大値を超えうるので揃える */
+        uint64_t max = atomic_load(&hists[h].max_ns);
+        uint64_t p[3] = {hist_percentile(snap, total, 0.50), hist_percentile(snap, total, 0.99),
+                         hist_percentile(snap, total, 0.999)};
+        for (int k = 0; k < 3; k++)
+        {
+            if (p[k] > max)
+                p[k] = max;
+        }
+        snprintf(line, sizeof(line), "%-8s n=%lu p50=%.1fus p99=%.1fus p999=%.1fus max=%.1fus\n",
+                 HIST_NAMES[h].stats, total, p[0] / 1000.0, p[1] / 1000.0, p[2] / 1000.0, max / 1000.0);
+        send_client(client_idx, line);
+    }
+    send_client(client_idx, "END\n");
+}
+
+static void write_prometheus(FILE *fp)
+{
+    static unsigned long snap[MET_BUCKETS];
+    int nclients, nrooms;
+    gauge_counts(&nclients, &nrooms);
+
+    fprintf(fp, "# TYPE contrast_clients gauge\ncontrast_clients %d\n", nclients);
+    fprintf(fp, "# TYPE contrast_rooms_active gauge\ncontrast_rooms_active %d\n", nrooms);
+    fprintf(fp, "# TYPE contrast_moves_accepted_total counter\ncontrast_moves_accepted_total %lu\n", moves_accepted);
+    if (handoff_done)
+    {
+        fprintf(fp, "# TYPE contrast_handoff_pause_seconds gauge\ncontrast_handoff_pause_seconds %.6f\n",
+                handoff_pause_ms / 1000.0);
+        fprintf(fp, "# TYPE contrast_handoff_dropped_connections gauge\ncontrast_handoff_dropped_connections %d\n",
+                handoff_dropped);
+    }
+    for (int c = 0; c < MET_COUNTER_COUNT; c++)
+    {
+        fprintf(fp, "# TYPE %s counter\n%s %lu\n", COUNTER_NAMES[c], COUNTER_NAMES[c],
+                atomic_load_explicit(&counters[c], memory_order_relaxed));
+    }
+
+    /* Prometheus の le は 4 倍刻み (1.024us 〜 17s)。どれもバケットの境界に一致する */
+    for (int h = 0; h < MET_HIST_COUNT; h++)
+    {
+        const char *family = HIST_NAMES[h].family;
+        if (h == 0 || strcmp(family, HIST_NAMES[h - 1].family) != 0)
+            fprintf(fp, "# TYPE %s histogram\n", family);
+
+        char label[32] = "";
+        char sep[4] = "";
+        if (HIST_NAMES[h].label)
+        {
+            snprintf(label, sizeof(label), "cmd=\"%s\"", HIST_NAMES[h].label);
+            strcpy(sep, ",");
+        }
+
+        unsigned long total = hist_snapshot(h, snap);
+        unsigned long cum = 0;
+        int i = 0;
+        for (int bits = 10; bits <= 34; bits += 2)
+        {
+            uint64_t bound = (uint64_t)1 << bits;
+            while (i < MET_BUCKETS && bucket_upper(i) < bound)
+                cum += snap[i++];
+            fprintf(fp, "%s_bucket{%s%sle=\"%.9g\"} %lu\n", family, label, sep, bound / 1e9, cum);
+        }
+        fprintf(fp, "%s_bucket{%s%sle=\"+Inf\"} %lu\n", family, label, sep, total);
+        fprintf(fp, "%s_sum%s%s%s %.9f\n", family, label[0] ? "{" : "", label, label[0] ? "}" : "",
+                atomic_load_explicit(&hists[h].sum_ns, memory_order_relaxed) / 1e9);
+        fprintf(fp, "%s_count%s%s%s %lu\n", family, label[0] ? "{" : "", label, label[0] ? "}" : "", total);
+    }
+}
+
+/* 一時ファイルに書いてから rename するので、読み手が書きかけを見ることはない */
+void metrics_dump(void)
+{
+    if (!dump_path)
+        return;
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", dump_path);
+    FILE *fp = fopen(tmp, "w");
+    if (!fp)
+    {
+        perror("metrics dump");
+        return;
+    }
+    write_prometheus(fp);
+    if (fclose(fp) != 0 || rename(tmp, dump_path) < 0)
+        perror("metrics dump");
+}
+
+static void dump_timer_expired(void *arg)
+{
+    (void)arg;
+    metrics_dump();
+    timer_schedule(&dump_timer, (uint64_t)dump_interval_ms, dump_timer_expired, NULL);
+}
+
+/* 前のプロセスから引き継いだときの停止時間と、引き継げなかった接続の数 */
+void metrics_set_handoff(double pause_ms, int nclients, int nrooms, int dropped)
+{
+    handoff_done = 1;
+    handoff_pause_ms = pause_ms;
+    handoff_clients = nclients;
+    handoff_rooms = nrooms;
+    handoff_dropped = dropped;
+}
+
+/* path が NULL なら定期出力はしない (STATS は常に使える) */
+void metrics_init(const char *path, int interval_sec)
+{
+    started_ms = timer_now_ms();
+    if (!path || !path[0])
+        return;
+    dump_path = path;
+    dump_interval_ms = (interval_sec > 0 ? interval_sec : 10) * 1000;
+    timer_schedule(&dump_timer, (uint64_t)dump_interval_ms, dump_timer_expired, NULL);
+    printf("Metrics: %s every %d s\n", dump_path, dump_interval_ms / 1000);
+}
@@ -1,25 +1,313 @@
 #include "server.h"
 
-void send_msg(int fd, const char *msg)
+/* select() 用の fd ごとの送信キュー (書き込みきれなかった分を保持する) */
+typedef struct OutChunk
 {
-    if (fd > 0)
+    struct OutChunk *next;
+    SharedBuf *buf;
+    size_t off;
+} OutChunk;
+
+typedef struct
+{
+    OutChunk *head;
+    OutChunk *tail;
+    size_t bytes; /* 未送信のバイト数 (select のみ。io_uring は uring.c で数える) */
+    int slow;     /* 送信待ちが上限を超えた。切断するまで以後の送信は捨てる */
+} OutQueue;
+
+static OutQueue *outq = NULL;
+static int outq_cap = 0;
+
+/* slow にした fd (ループの先頭でまとめて切断する) */
+static int *slow_fds = NULL;
+static int slow_count = 0;
+static int slow_cap = 0;
+
+SharedBuf *sbuf_new(const void *data, size_t len)
+{
+    SharedBuf *buf = malloc(sizeof(SharedBuf) + len);
+    if (!buf)
+        return NULL;
+    buf->refcnt = 1;
+    buf->len = len;
+    memcpy(buf->data, data, len);
+    return buf;
+}
+
+void sbuf_ref(SharedBuf *buf)
+{
+    buf->refcnt++;
+}
+
+void sbuf_unref(SharedBuf *buf)
+{
+    if (buf && --buf->refcnt == 0)
+        free(buf);
+}
+
+/* テキストメッセージをプロトコルに合わせて組み立てる */
+SharedBuf *sbuf_text(int proto, const char *msg)
+{
+    size_t len = strlen(msg);
+    if (proto != PROTO_BINARY)
+        return sbuf_new(msg, len);
+
+    /* バイナリでは末尾の改行を落として TEXT フレームに包む */
+    if (len > 0 && msg[len - 1] == '\n')
+        len--;
+    if (len > WIRE_MAX_FRAME - WIRE_HEADER_SIZE)
+        len = WIRE_MAX_FRAME - WIRE_HEADER_SIZE;
+    uint8_t frame[WIRE_MAX_FRAME];
+    size_t n = wire_encode(frame, WIRE_OP_TEXT, msg, len);
+    return sbuf_new(frame, n);
+}
+
+static OutQueue *out_queue(int fd)
+{
+    if (fd >= outq_cap)
     {
-        if (write(fd, msg, strlen(msg)) < 0)
+        int cap = outq_cap ? outq_cap : 64;
+        while (cap <= fd)
+            cap *= 2;
+        OutQueue *p = realloc(outq, sizeof(OutQueue) * cap);
+        if (!p)
+            return NULL;
+        memset(p + outq_cap, 0, sizeof(OutQueue) * (cap - outq_cap));
+        outq = p;
+        outq_cap = cap;
+    }
+    return &outq[fd];
+}
+
+static void out_discard(int fd)
+{
+    if (fd >= outq_cap)
+        return;
+    OutChunk *c = outq[fd].head;
+    while (c)
+    {
+        OutChunk *next = c->next;
+        sbuf_unref(c->buf);
+        free(c);
+        c = next;
+    }
+    outq[fd].head = outq[fd].tail = NULL;
+    outq[fd].bytes = 0;
+}
+
+/* 送信待ちが上限を超えた (または積めなかった) fd を切断予定にする。
+ * 配信の途中で呼ばれるので、ここでは閉じずに drop_slow_clients に任せる */
+static void out_overflow(int fd, OutQueue *q)
+{
+    if (q->slow)
+        return;
+    if (slow_count == slow_cap)
+    {
+        int cap = slow_cap ? slow_cap * 2 : 16;
+        int *p = realloc(slow_fds, sizeof(int) * cap);
+        if (!p)
+            return;
+        slow_fds = p;
+        slow_cap = cap;
+    }
+    slow_fds[slow_count++] = fd;
+    q->slow = 1;
+    out_discard(fd);
+}
+
+/* slow にした接続を通常の切断処理で閉じる */
+void drop_slow_clients(void)
+{
+    /* handle_disconnect の通知でさらに増えることがあるので count は毎回読む */
+    for (int n = 0; n < slow_count; n++)
+    {
+        int fd = slow_fds[n];
+        if (fd >= outq_cap || !outq[fd].slow)
+            continue; /* すでに閉じた */
+        int idx = -1;
+        for (int i = 0; i < MAX_CLIENTS; i++)
         {
-            perror("write error");
+            if (clients[i].fd == fd)
+            {
+                idx = i;
+                break;
+            }
+        }
+        if (idx < 0)
+        {
+            outq[fd].slow = 0;
+            continue;
         }
+        printf("Client %d is not reading (send queue over %d bytes), disconnecting.\n", fd, OUT_QUEUE_LIMIT);
+        /* io_uring で相手の受信待ちのまま止まっている送信も失敗させて、すぐ閉じられるようにする */
+        shutdown(fd, SHUT_RDWR);
+        handle_disconnect(idx);
     }
+    slow_count = 0;
 }
 
-void broadcast_lobby(int sender_idx, const char *msg)
+int out_pending(int fd)
 {
-    char buf[BUF_SIZE + 32];
-    sprintf(buf, "Client %d says: %s", clients[sender_idx].fd, msg);
-    for (int i = 0; i < MAX_CLIENTS; i++)
+    if (io_backend == IO_BACKEND_URING)
+        return uring_out_pending(fd);
+    return fd < outq_cap && outq[fd].head != NULL;
+}
+
+/* キューの先頭から書けるだけ書く (select ループで書き込み可能になったとき) */
+void flush_out(int fd)
+{
+    OutQueue *q = out_queue(fd);
+    while (q && q->head)
     {
-        if (i != sender_idx && clients[i].state == STATE_LOBBY)
+        OutChunk *c = q->head;
+        io_syscalls++;
+        ssize_t n = write(fd, c->buf->data + c->off, c->buf->len - c->off);
+        if (n < 0)
         {
-            send_msg(clients[i].fd, buf);
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return;
+            /* 相手が切断済み: 残りは捨てる (切断は read 側で検出する) */
+            out_discard(fd);
+            return;
         }
+        c->off += (size_t)n;
+        q->bytes -= (size_t)n;
+        if (c->off < c->buf->len)
+            return;
+        q->head = c->next;
+        if (!q->head)
+            q->tail = NULL;
+        sbuf_unref(c->buf);
+        free(c);
+    }
+}
+
+static void queue_shared(int fd, SharedBuf *buf)
+{
+    OutQueue *q = out_queue(fd);
+    if (!q || q->slow)
+        return;
+    if (io_backend == IO_BACKEND_URING)
+    {
+        /* io_uring では SQE を積むだけで、ループ末尾でまとめて submit する。
+         * 上限超えや確保失敗で積めなければ、以後の送信が欠けるので切断する */
+        if (uring_queue_send(fd, buf) < 0)
+            out_overflow(fd, q);
+        return;
+    }
+
+    if (q->bytes + buf->len > OUT_QUEUE_LIMIT)
+    {
+        out_overflow(fd, q);
+        return;
+    }
+    size_t off = 0;
+    if (!q->head)
+    {
+        /* キューが空ならその場で書く (ソケットは非ブロッキング) */
+        io_syscalls++;
+        ssize_t n = write(fd, buf->data, buf->len);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            perror("write error");
+            return;
+        }
+        if (n > 0)
+            off = (size_t)n;
+        if (off == buf->len)
+            return;
+    }
+
+    OutChunk *c = malloc(sizeof(OutChunk));
+    if (!c)
+    {
+        /* フレームの途中まで書いているかもしれないので、この接続は続けられない */
+        out_overflow(fd, q);
+        return;
+    }
+    q->bytes += buf->len - off;
+    sbuf_ref(buf);
+    c->next = NULL;
+    c->buf = buf;
+    c->off = off;
+    if (q->tail)
+        q->tail->next = c;
+    else
+        q->head = c;
+    q->tail = c;
+}
+
+/* 共有バッファを fd の送信キューに積む。バッファはコピーせず参照を持つ */
+void send_shared(int fd, SharedBuf *buf)
+{
+    if (fd <= 0 || !buf)
+        return;
+    metrics_add(MET_BYTES_OUT, (unsigned long)buf->len);
+    capture_outbound(fd, buf->data, buf->len);
+    TRACE_BEGIN(TR_SEND);
+    queue_shared(fd, buf);
+    TRACE_END(TR_SEND);
+}
+
+void send_data(int fd, const void *data, size_t len)
+{
+    if (fd > 0)
+    {
+        SharedBuf *buf = sbuf_new(data, len);
+        send_shared(fd, buf);
+        sbuf_unref(buf);
+    }
+}
+
+void send_msg(int fd, const char *msg)
+{
+    send_data(fd, msg, strlen(msg));
+}
+
+/* クライアントのプロトコルに合わせてテキストメッセージを送る */
+void send_client(int client_idx, const char *msg)
+{
+    Client *c = &clients[client_idx];
+    SharedBuf *buf = sbuf_text(c->proto, msg);
+    send_shared(c->fd, buf);
+    sbuf_unref(buf);
+}
+
+/* 指し手の通知 (opponent=1 なら OPPONENT_MOVE、0 なら YOUR_MOVE) */
+void send_move(int client_idx, int opponent, const Move *move)
+{
+    Client *c = &clients[client_idx];
+    if (c->proto == PROTO_BINARY)
+    {
+        uint8_t frame[WIRE_HEADER_SIZE + MOVE_PACKED_SIZE];
+        size_t n = wire_encode_move(frame, opponent ? WIRE_OP_OPPONENT_MOVE : WIRE_OP_YOUR_MOVE, move);
+        send_data(c->fd, frame, n);
+        return;
+    }
+
+    char move_msg[BUF_SIZE];
+    sprintf(move_msg, "%s %d %d %d %d %d %d %d %d\n", opponent ? "OPPONENT_MOVE" : "YOUR_MOVE",
+            move->sx, move->sy, move->dx, move->dy, move->place_tile, move->tx, move->ty, (int)move->tile);
+    send_msg(c->fd, move_msg);
+}
+
+void close_conn(int fd)
+{
+    if (fd < 0)
+        return;
+    if (fd < outq_cap)
+        outq[fd].slow = 0;
+    if (io_backend == IO_BACKEND_URING)
+    {
+        /* recv の取り消しと、積んである送信の完了を待ってから閉じる */
+        uring_close_fd(fd);
+        return;
     }
+    /* 最後の通知 ("Server full." など) が残っていれば、捨てる前に1回だけ書いてみる */
+    if (out_pending(fd))
+        flush_out(fd);
+    out_discard(fd);
+    io_syscalls++;
+    close(fd);
 }
\ No newline at end of file
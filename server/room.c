@@ -1,11 +1,20 @@
 #include "server.h"
 
+#include <sys/random.h>
+
 void init_rooms()
 {
     for (int i = 0; i < MAX_ROOMS; i++)
     {
         rooms[i].id = -1;
         rooms[i].active = 0;
+        rooms[i].watch_head = -1;
+        rooms[i].watcher_count = 0;
+        rooms[i].ai_level = 0;
+        rooms[i].ai_color = PLAYER_NONE;
+        rooms[i].gen = 0;
+        rooms[i].legal_valid = 0;
+        rooms[i].dir_slot = -1;
     }
 }
 
@@ -33,11 +42,237 @@ Room *get_free_room()
     return NULL;
 }
 
+static uint64_t new_token(void)
+{
+    uint64_t t = 0;
+    while (t == 0)
+    {
+        if (getrandom(&t, sizeof(t), 0) != sizeof(t))
+            t = ((uint64_t)rand() << 32) ^ (uint64_t)rand();
+    }
+    return t;
+}
+
+/* 対局を始める (対局者の添字は AI 側や復元直後の空席なら -1) */
+void room_open(Room *room, int room_id, int black_idx, int white_idx, int ai_level, Player ai_color,
+               int board_size)
+{
+    room->id = room_id;
+    room->active = 1;
+    metrics_add(MET_GAMES_STARTED, 1);
+    room->black_idx = black_idx;
+    room->white_idx = white_idx;
+    room->watch_head = -1;
+    room->watcher_count = 0;
+    room->ai_level = ai_level;
+    room->ai_color = ai_level > 0 ? ai_color : PLAYER_NONE;
+    room->legal_valid = 0;
+    room->token[PLAYER_NONE] = 0;
+    room->token[PLAYER_BLACK] = (room->ai_color == PLAYER_BLACK) ? 0 : new_token();
+    room->token[PLAYER_WHITE] = (room->ai_color == PLAYER_WHITE) ? 0 : new_token();
+    room->tc_base_ms = 0;
+    room->tc_inc_ms = 0;
+    room->clock_ms[PLAYER_BLACK] = room->clock_ms[PLAYER_WHITE] = 0;
+    room->clock_running = 0;
+    if (!variant_reset(&room->game, board_size))
+        variant_reset(&room->game, BOARD_W);
+    dir_add_room(room);
+}
+
+/* サーバー再起動後に RESUME で席に戻るためのトークンを知らせる */
+void room_send_resume_token(Room *room, int client_idx)
+{
+    char msg[64];
+    sprintf(msg, "RESUME_TOKEN %d %016llx\n", room->id,
+            (unsigned long long)room->token[clients[client_idx].player_color]);
+    send_client(client_idx, msg);
+}
+
 void close_room(Room *room)
 {
     if (!room || !room->active)
         return;
     printf("Closing room %d\n", room->id);
+
+    /* 残っている観戦者はロビーに戻す */
+    while (room->watch_head != -1)
+        room_remove_watcher(room, room->watch_head);
+
+    ai_cancel(room);
+    timer_cancel(&room->clock_timer);
+    room->clock_running = 0;
+    dir_remove_room(room);
     room->active = 0;
     room->id = -1;
+    room->ai_level = 0;
+    room->legal_valid = 0;
+    room->gen++; /* 思考中の AI の結果を無効にする */
+}
+
+/* 手番側の合法手集合。variant_apply_move で手数が進んだときだけ作り直し、
+ * 終局判定と次の MOVE の検証で同じものを使う */
+const VariantLegalSet *room_legal_set(Room *room)
+{
+    uint32_t ply = variant_ply(&room->game);
+    if (!room->legal_valid || room->legal_ply != ply)
+    {
+        variant_legal_set(&room->game, &room->legal);
+        room->legal_ply = ply;
+        room->legal_valid = 1;
+    }
+    return &room->legal;
+}
+
+/* 観戦者を部屋のリストに加える (O(1)) */
+void room_add_watcher(Room *room, int client_idx)
+{
+    Client *c = &clients[client_idx];
+    c->watch_prev = -1;
+    c->watch_next = room->watch_head;
+    if (room->watch_head != -1)
+        clients[room->watch_head].watch_prev = client_idx;
+    room->watch_head = client_idx;
+    room->watcher_count++;
+
+    chat_leave(client_idx);
+    c->state = STATE_WATCHING;
+    c->room_id = room->id;
+}
+
+/* 観戦者をリストから外してロビーに戻す (O(1)) */
+void room_remove_watcher(Room *room, int client_idx)
+{
+    Client *c = &clients[client_idx];
+    if (room)
+    {
+        if (c->watch_prev != -1)
+            clients[c->watch_prev].watch_next = c->watch_next;
+        else
+            room->watch_head = c->watch_next;
+        if (c->watch_next != -1)
+            clients[c->watch_next].watch_prev = c->watch_prev;
+        room->watcher_count--;
+    }
+    c->watch_prev = -1;
+    c->watch_next = -1;
+    c->state = STATE_LOBBY;
+    c->room_id = -1;
+    chat_enter(client_idx);
+}
+
+/* 5x5 以外の部屋なら盤の大きさを知らせる (対局開始・観戦開始・再接続の前に送る) */
+void room_send_board(Room *room, int client_idx)
+{
+    if (client_idx < 0 || room->game.size == BOARD_W)
+        return;
+    char msg[32];
+    sprintf(msg, "BOARD %dx%d\n", room->game.size, room->game.size);
+    send_client(client_idx, msg);
+}
+
+/* 現在の局面をパックして送る (観戦開始時)。長さは盤の大きさで変わる */
+void room_send_snapshot(Room *room, int client_idx)
+{
+    uint8_t packed[VARIANT_PACKED_MAX];
+    size_t size = variant_pack(&room->game, packed);
+
+    room_send_board(room, client_idx);
+    if (clients[client_idx].proto == PROTO_BINARY)
+    {
+        uint8_t frame[WIRE_HEADER_SIZE + VARIANT_PACKED_MAX];
+        size_t n = wire_encode(frame, WIRE_OP_SNAPSHOT, packed, size);
+        send_data(clients[client_idx].fd, frame, n);
+        return;
+    }
+
+    char msg[16 + VARIANT_PACKED_MAX * 2];
+    int len = sprintf(msg, "SNAPSHOT ");
+    for (size_t i = 0; i < size; i++)
+        len += sprintf(msg + len, "%02x", packed[i]);
+    sprintf(msg + len, "\n");
+    send_msg(clients[client_idx].fd, msg);
+}
+
+/* SYNC の応答 (full=1) か1手ごとの CHECK (full=0)。
+ * テキストは "SYNC <手数> <ハッシュ16桁> <パック済み状態 (5x5 は32桁)>" / "CHECK <手数> <ハッシュ16桁>" */
+void room_send_sync(Room *room, int client_idx, int full)
+{
+    const VariantGame *g = &room->game;
+    if (clients[client_idx].proto == PROTO_BINARY)
+    {
+        uint8_t frame[WIRE_HEADER_SIZE + WIRE_VARIANT_SYNC_MAX];
+        size_t n = wire_encode_variant_sync(frame, full ? WIRE_OP_SYNC : WIRE_OP_CHECK, g);
+        send_data(clients[client_idx].fd, frame, n);
+        return;
+    }
+
+    char msg[80 + VARIANT_PACKED_MAX * 2];
+    int len = sprintf(msg, "%s %u %016llx", full ? "SYNC" : "CHECK", (unsigned)variant_ply(g),
+                      (unsigned long long)variant_sync_hash(g));
+    if (full)
+    {
+        uint8_t packed[VARIANT_PACKED_MAX];
+        size_t size = variant_pack(g, packed);
+        len += sprintf(msg + len, " ");
+        for (size_t i = 0; i < size; i++)
+            len += sprintf(msg + len, "%02x", packed[i]);
+    }
+    sprintf(msg + len, "\n");
+    send_msg(clients[client_idx].fd, msg);
+}
+
+/*
+ * 指された手を全観戦者に送る。メッセージはプロトコルごとに1回だけ組み立て、
+ * 同じ共有バッファを各観戦者の送信キューに積む。
+ */
+void room_broadcast_move(Room *room, const Move *move)
+{
+    SharedBuf *text_buf = NULL;
+    SharedBuf *bin_buf = NULL;
+
+    for (int i = room->watch_head; i != -1; i = clients[i].watch_next)
+    {
+        if (clients[i].proto == PROTO_BINARY)
+        {
+            if (!bin_buf)
+            {
+                uint8_t frame[WIRE_HEADER_SIZE + MOVE_PACKED_SIZE];
+                size_t n = wire_encode_move(frame, WIRE_OP_MOVED, move);
+                bin_buf = sbuf_new(frame, n);
+            }
+            send_shared(clients[i].fd, bin_buf);
+        }
+        else
+        {
+            if (!text_buf)
+            {
+                char msg[BUF_SIZE];
+                int n = sprintf(msg, "MOVED %d %d %d %d %d %d %d %d\n",
+                                move->sx, move->sy, move->dx, move->dy,
+                                move->place_tile, move->tx, move->ty, (int)move->tile);
+                text_buf = sbuf_new(msg, n);
+            }
+            send_shared(clients[i].fd, text_buf);
+        }
+    }
+
+    sbuf_unref(text_buf);
+    sbuf_unref(bin_buf);
+}
+
+/* テキストメッセージを全観戦者に送る */
+void room_broadcast_text(Room *room, const char *msg)
+{
+    SharedBuf *bufs[3] = {NULL, NULL, NULL}; /* proto ごと */
+
+    for (int i = room->watch_head; i != -1; i = clients[i].watch_next)
+    {
+        int proto = clients[i].proto;
+        if (!bufs[proto])
+            bufs[proto] = sbuf_text(proto, msg);
+        send_shared(clients[i].fd, bufs[proto]);
+    }
+
+    for (int p = 0; p < 3; p++)
+        sbuf_unref(bufs[p]);
 }
\ No newline at end of file
@@ -1,31 +1,132 @@
 #ifndef SERVER_H
 #define SERVER_H
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <sys/select.h>
 #include <signal.h>
 #include <ctype.h>
+#include <errno.h>
 
 /* core_c のヘッダー */
 #include "contrast_c/game_state.h"
 #include "contrast_c/rules.h"
 #include "contrast_c/move.h"
 #include "contrast_c/types.h"
+#include "contrast_c/variant.h"
+#include "contrast_c/wire.h"
 
 #define PORT 10000
-#define MAX_CLIENTS 10
+#define MAX_CLIENTS 1000 /* select() の FD_SETSIZE (1024) に収まる数 */
 #define BUF_SIZE 256
+#define OUT_QUEUE_LIMIT (256 * 1024) /* 1接続の送信待ちの上限 (超えたら読まない相手として切断) */
 #define MAX_ROOMS (MAX_CLIENTS / 2)
 
 #define STATE_NONE 0
 #define STATE_LOBBY 1
 #define STATE_WAITING 2
 #define STATE_PLAYING 3
+#define STATE_WATCHING 4
+#define STATE_QUEUED 5 /* QUICKMATCH の相手待ち */
+
+/* 通信プロトコル (最初の1バイトで決まる) */
+#define PROTO_PENDING 0
+#define PROTO_TEXT 1
+#define PROTO_BINARY 2
+
+/* AI 対局のレベル (1..AI_MAX_LEVEL) と同時対局数の上限 */
+#define AI_MAX_LEVEL 5
+#define AI_MAX_GAMES (MAX_ROOMS / 2)
+#define AI_ROOM_ID_BASE 1000000 /* PLAY_AI の部屋番号は自動採番 */
+#define QM_ROOM_ID_BASE 2000000 /* QUICKMATCH も同様 */
+
+/* 終局理由 (ジャーナルに記録する) */
+#define RESULT_GOAL 0       /* 相手陣に到達 */
+#define RESULT_NO_MOVES 1   /* 相手の合法手なし */
+#define RESULT_DISCONNECT 2 /* 相手の切断 */
+#define RESULT_RESIGN 3     /* AI の投了 (探索が続けて失敗した) */
+#define RESULT_TIMEOUT 4    /* 相手の時間切れ */
+#define RESULT_ABANDONED 5  /* 復元後に相手が戻らなかった */
+
+/* 復元した部屋で対局者の RESUME を待つ時間 */
+#define RESUME_GRACE_MS (5 * 60 * 1000)
+
+/* I/O バックエンド */
+#define IO_BACKEND_SELECT 0
+#define IO_BACKEND_URING 1
+
+/* メトリクス: ヒストグラム (ns) とカウンタの番号 */
+#define MET_HIST_SAY 0
+#define MET_HIST_LIST 1
+#define MET_HIST_CREATE 2
+#define MET_HIST_JOIN 3
+#define MET_HIST_MOVE 4
+#define MET_HIST_OTHER 5    /* その他のロビーコマンド */
+#define MET_HIST_VALIDATE 6 /* 合法手の判定 */
+#define MET_HIST_AI_THINK 7 /* AI の依頼から結果まで (ワーカーで記録) */
+#define MET_HIST_COUNT 8
+
+#define MET_BYTES_IN 0
+#define MET_BYTES_OUT 1
+#define MET_CONNECTIONS 2
+#define MET_GAMES_STARTED 3
+#define MET_GAMES_FINISHED 4
+#define MET_MOVES_REJECTED 5
+#define MET_COUNTER_COUNT 6
+
+/* トレースの区間 (trace.c の TRACE_NAMES と同じ順) */
+#define TR_CLIENT_DATA 0
+#define TR_DISPATCH_TEXT 1
+#define TR_DISPATCH_FRAME 2
+#define TR_LOBBY_COMMAND 3
+#define TR_GAME_MOVE 4
+#define TR_PROCESS_MOVE 5
+#define TR_LEGAL_SET 6
+#define TR_COMMIT 7
+#define TR_JOURNAL 8
+#define TR_APPLY 9
+#define TR_NOTIFY 10
+#define TR_IS_WIN 11
+#define TR_IS_LOSS 12
+#define TR_SEND 13
+#define TR_IO_WAIT 14
+#define TR_TIMER_RUN 15
+#define TR_AI_DRAIN 16
+#define TR_AI_SEARCH 17
+#define TR_JOURNAL_SYNC 18
+#define TR_COUNT 19
+
+/* 無効時は1回の読み込みと分岐だけ */
+#define TRACE_BEGIN(id)                                                 \
+    do                                                                  \
+    {                                                                   \
+        if (__builtin_expect(__atomic_load_n(&trace_enabled, __ATOMIC_RELAXED), 0)) \
+            trace_event((id), 'B');                                     \
+    } while (0)
+#define TRACE_END(id)                                                   \
+    do                                                                  \
+    {                                                                   \
+        if (__builtin_expect(__atomic_load_n(&trace_enabled, __ATOMIC_RELAXED), 0)) \
+            trace_event((id), 'E');                                     \
+    } while (0)
+
+/* タイマーホイールに登録するタイマー (構造体に埋め込んで使う) */
+typedef struct Timer
+{
+    struct Timer *next;
+    struct Timer **pprev; /* 未登録なら NULL */
+    uint64_t expires;     /* tick */
+    int slot;             /* 段 * 64 + スロット */
+    void (*fn)(void *arg);
+    void *arg;
+} Timer;
 
 typedef struct
 {
@@ -33,6 +134,27 @@ typedef struct
     int state;
     int room_id;
     Player player_color;
+    int proto;
+    char inbuf[WIRE_MAX_FRAME]; /* 未処理の受信データ (行/フレーム単位に切り出す) */
+    int inlen;
+    int watch_prev; /* 観戦者リスト (Room.watch_head から辿る双方向リスト) */
+    int watch_next;
+    Timer idle_timer;     /* 無操作での切断 (対局中は対象外) */
+    uint64_t last_active; /* 最後に受信した時刻 (ms) */
+    int tc_base_ms;       /* CREATE で指定した持ち時間 (0 は無制限) */
+    int tc_inc_ms;
+    int board_size;       /* CREATE で指定した盤の大きさ (一辺) */
+    int admin; /* localhost からの接続 (STATS を許可) */
+    int dir_slot; /* ルーム一覧での位置 (待機中のみ、それ以外は -1) */
+    int chat_channel; /* ロビーチャットのチャンネル (ロビーにいなければ -1) */
+    int chat_prev;    /* チャンネルのメンバーリスト */
+    int chat_next;
+    int chat_tokens;         /* 発言できる残り回数 (トークンバケット) */
+    uint64_t chat_refill_at; /* 最後にトークンを補充した時刻 (ms) */
+    int qm_bucket; /* QUICKMATCH で並んでいるバケット (なければ -1) */
+    int qm_prev;   /* バケット内の待ち行列 */
+    int qm_next;
+    int sync_check; /* SYNC ON: 1手ごとに CHECK (手数とハッシュ) を送る */
 } Client;
 
 typedef struct
@@ -40,29 +162,195 @@ typedef struct
     int id;
     int black_idx;
     int white_idx;
-    GameState game_state;
+    VariantGame game;  /* 盤の大きさは部屋ごと (game.size) */
     int active;
+    int watch_head;    /* 観戦者リストの先頭 (clients[] の添字、なしは -1) */
+    int watcher_count;
+    int ai_level;      /* 0 なら人間同士。AI 側の対局者の添字は -1 */
+    Player ai_color;
+    unsigned gen;      /* close_room ごとに進める (古い AI の結果を捨てるため) */
+    VariantLegalSet legal; /* 手番側の合法手集合 (room_legal_set 経由で使う) */
+    int legal_valid;
+    uint32_t legal_ply; /* legal を作ったときの手数 */
+    uint64_t token[3]; /* 再接続用トークン (Player で引く。AI 側は 0) */
+    Timer clock_timer;  /* 手番側の時間切れ (復元直後は RESUME 待ち) */
+    int tc_base_ms;     /* 持ち時間 (0 は無制限) */
+    int tc_inc_ms;      /* 1手ごとの加算 */
+    int64_t clock_ms[3]; /* 残り時間 (Player で引く) */
+    uint64_t turn_started; /* 手番が始まった時刻 (ms) */
+    int clock_running;  /* clock_timer が時間切れを待っているか */
+    int dir_slot;       /* ルーム一覧での位置 (未登録は -1) */
 } Room;
 
+/* 参照カウント付き送信バッファ (1回だけ組み立てて複数の宛先のキューに積む) */
+typedef struct
+{
+    int refcnt;
+    size_t len;
+    char data[];
+} SharedBuf;
+
 /* グローバル変数 (実体は main.c) */
 extern Client clients[MAX_CLIENTS];
 extern Room rooms[MAX_ROOMS];
+extern int io_backend;
+extern volatile sig_atomic_t server_running;
+extern int ai_event_fd; /* AI の思考完了通知 (未初期化なら -1) */
+extern int timer_fd;    /* タイマーホイールの timerfd (未初期化なら -1) */
+extern int handoff_listen_fd; /* 引き継ぎ要求を待つ UNIX ソケット (--handoff なしなら -1) */
+extern int handoff_requested; /* 引き継ぎ要求を受けて、受信を止めて送信を流している */
+extern int idle_timeout_ms;
+extern int trace_enabled; /* TRACE_BEGIN/TRACE_END が見る (trace.c) */
+
+/* I/O 統計 (syscall 数 / 受理した手の数) */
+extern unsigned long io_syscalls;
+extern unsigned long moves_accepted;
 
 /* 関数プロトタイプ */
 
+/* main.c (I/O バックエンド共通のイベントハンドラ) */
+int accept_client(int new_fd, const char *addr);
+void client_resume_idle(int client_idx);
+void handle_client_data(int client_idx, char *buffer, int nbytes);
+void handle_disconnect(int client_idx);
+
 /* network.c */
+SharedBuf *sbuf_new(const void *data, size_t len);
+void sbuf_ref(SharedBuf *buf);
+void sbuf_unref(SharedBuf *buf);
+SharedBuf *sbuf_text(int proto, const char *msg);
+void send_shared(int fd, SharedBuf *buf);
+int out_pending(int fd);
+void flush_out(int fd);
+void drop_slow_clients(void);
+void send_data(int fd, const void *data, size_t len);
 void send_msg(int fd, const char *msg);
-void broadcast_lobby(int sender_idx, const char *msg);
+void send_client(int client_idx, const char *msg);
+void send_move(int client_idx, int opponent, const Move *move);
+void close_conn(int fd);
 
 /* room.c */
 void init_rooms(void);
 Room *get_room(int room_id);
 Room *get_free_room(void);
+void room_open(Room *room, int room_id, int black_idx, int white_idx, int ai_level, Player ai_color,
+               int board_size);
+void room_send_resume_token(Room *room, int client_idx);
 void close_room(Room *room);
+const VariantLegalSet *room_legal_set(Room *room);
+void room_add_watcher(Room *room, int client_idx);
+void room_remove_watcher(Room *room, int client_idx);
+void room_send_board(Room *room, int client_idx);
+void room_send_snapshot(Room *room, int client_idx);
+void room_send_sync(Room *room, int client_idx, int full);
+void room_broadcast_move(Room *room, const Move *move);
+void room_broadcast_text(Room *room, const char *msg);
+
+/* uring.c */
+int uring_run(int listen_fd);
+int uring_queue_send(int fd, SharedBuf *buf);
+int uring_out_pending(int fd);
+void uring_close_fd(int fd);
+
+/* ai.c */
+int ai_load_weights(const char *path);
+int ai_init(int nworkers);
+void ai_shutdown(void);
+int ai_available(void);
+int ai_level_valid(int level);
+void ai_request_move(Room *room);
+void ai_cancel(Room *room);
+void ai_drain_results(void);
+void ai_handle_event(void);
+
+/* timer.c */
+int timer_init(void);
+uint64_t timer_now_ms(void);
+int timer_pending(const Timer *t);
+void timer_schedule(Timer *t, uint64_t delay_ms, void (*fn)(void *), void *arg);
+void timer_cancel(Timer *t);
+void timer_run(void);
+void timer_sync(void);
+void timer_handle_event(int consumed);
+
+/* journal.c */
+int journal_open(const char *path, int restore);
+void journal_close(void);
+void journal_room_open(const Room *room);
+void journal_move(const Room *room, const Move *move);
+void journal_result(const Room *room, Player winner, int reason);
+
+/* metrics.c */
+void metrics_init(const char *path, int interval_sec);
+uint64_t metrics_now(void);
+void metrics_add(int counter, unsigned long n);
+void metrics_record(int hist, uint64_t ns);
+int metrics_command_hist(const char *line);
+void metrics_send_stats(int client_idx);
+void metrics_dump(void);
+void metrics_set_handoff(double pause_ms, int nclients, int nrooms, int dropped);
+
+/* capture.c */
+int capture_open(const char *path);
+void capture_close(void);
+void capture_conn_open(int client_idx);
+void capture_conn_close(int client_idx);
+void capture_inbound(int client_idx, const void *data, size_t len);
+void capture_outbound(int fd, const void *data, size_t len);
+
+/* trace.c */
+void trace_init(const char *path);
+void trace_thread_name(const char *name);
+void trace_set_enabled(int on);
+void trace_event(int id, int phase);
+int trace_dump(void);
+void trace_poll(void);
+void handle_trace_signal(int sig);
+
+/* directory.c */
+void dir_add_waiting(int client_idx);
+void dir_remove_waiting(int client_idx);
+void dir_add_room(Room *room);
+void dir_remove_room(Room *room);
+void dir_send_list(int client_idx, const char *args);
+
+/* chat.c */
+void chat_init(void);
+void chat_enter(int client_idx);
+void chat_leave(int client_idx);
+void chat_reset_rate(int client_idx);
+void chat_say(int client_idx, const char *msg);
+void chat_command(int client_idx, const char *args);
+const char *chat_channel_name(int client_idx);
+void chat_restore(int client_idx, const char *name);
+void chat_flush_all(void);
+
+/* match.c */
+void qm_init(void);
+int qm_pair_or_enqueue(int client_idx, int base_ms, int inc_ms, int rating);
+void qm_leave(int client_idx);
+int qm_queued(void);
+int qm_entry(int client_idx, int *base_ms, int *inc_ms, int *band);
+int qm_restore(int client_idx, int base_ms, int inc_ms, int band);
+
+/* handoff.c */
+int handoff_listen(const char *path);
+void handoff_accept(void);
+void handoff_begin(int conn_fd);
+int handoff_drained(void);
+int handoff_send(int listen_fd);
+int handoff_receive(const char *path, int *listen_fd);
+int handoff_restore(void);
 
 /* command.c */
 int parse_coord(const char *str, int *x, int *y);
 void process_lobby_command(int client_idx, char *buffer);
 void process_game_move(int client_idx, char *buffer);
+void process_sync_command(int client_idx, const char *buffer);
+void process_move(int client_idx, const Move *req_move);
+void commit_move(Room *room, const Move *move);
+void ai_resign(Room *room);
+void clock_start(Room *room);
+void room_await_resume(Room *room);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,189 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* 引き継ぎに失敗した後もジャーナルが書かれることを確かめる (make handoff-test)
+ * --handoff 付きでサーバーを起動し、引き継ぎソケットにつないで状態の先頭だけ受け取って
+ * ACK を返さずに切る (新しいプロセスが途中で落ちた場合と同じ)。サービスに戻ったサーバーで
+ * AI 対局を始め、その ROOM_OPEN レコードがディスクに届くのを待つ。 */
+
+#define PORT 10000
+#define JOURNAL_MAGIC_LEN 4
+#define JREC_ROOM_OPEN 1
+#define WAIT_MS 3000
+
+static void sleep_ms(int ms)
+{
+    struct timespec ts = {ms / 1000, (long)(ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+static int connect_tcp(void)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int connect_unix(const char *path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* text が届くまで読む (届かなければ 0) */
+static int wait_for(int fd, const char *text)
+{
+    char buf[4096];
+    size_t len = 0;
+    struct timeval tv = {WAIT_MS / 1000, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    while (len < sizeof(buf) - 1)
+    {
+        ssize_t n = read(fd, buf + len, sizeof(buf) - 1 - len);
+        if (n <= 0)
+            return 0;
+        len += (size_t)n;
+        buf[len] = '\0';
+        if (strstr(buf, text))
+            return 1;
+    }
+    return 0;
+}
+
+/* ジャーナルに ROOM_OPEN レコードがあれば 1 */
+static int journal_has_room_open(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return 0;
+    int found = 0;
+    unsigned char rec[2 + 255 + 4];
+    fseek(fp, JOURNAL_MAGIC_LEN, SEEK_SET);
+    while (fread(rec, 1, 2, fp) == 2)
+    {
+        if (fread(rec + 2, 1, (size_t)rec[1] + 4, fp) != (size_t)rec[1] + 4)
+            break;
+        if (rec[0] == JREC_ROOM_OPEN)
+            found = 1;
+    }
+    fclose(fp);
+    return found;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *server = (argc > 1) ? argv[1] : "./server/server";
+    char dir[] = "/tmp/handoff-test-XXXXXX";
+    if (!mkdtemp(dir))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    char journal[64], sock[64], journal_arg[80], handoff_arg[80];
+    snprintf(journal, sizeof(journal), "%s/journal", dir);
+    snprintf(sock, sizeof(sock), "%s/handoff.sock", dir);
+    snprintf(journal_arg, sizeof(journal_arg), "--journal=%s", journal);
+    snprintf(handoff_arg, sizeof(handoff_arg), "--handoff=%s", sock);
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        execl(server, server, "--io=select", "--ai-workers=1", journal_arg, handoff_arg, (char *)NULL);
+        _exit(127);
+    }
+
+    int ok = 0;
+    const char *stage = "server start";
+    int fd = -1;
+    for (int i = 0; i < WAIT_MS / 50 && fd < 0; i++)
+    {
+        sleep_ms(50);
+        fd = connect_unix(sock);
+    }
+    if (fd < 0)
+        goto done;
+
+    /* 状態の長さが届いたら ACK を返さずに切る */
+    stage = "handoff";
+    char len[4];
+    struct timeval tv = {WAIT_MS / 1000, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ssize_t n = read(fd, len, sizeof(len));
+    close(fd);
+    if (n <= 0)
+        goto done;
+
+    /* 失敗した引き継ぎの後に始めた対局がジャーナルに残ること */
+    stage = "service after failed handoff";
+    fd = -1;
+    for (int i = 0; i < WAIT_MS / 50 && fd < 0; i++)
+    {
+        sleep_ms(50);
+        fd = connect_tcp();
+    }
+    if (fd < 0)
+        goto done;
+    const char *cmd = "PLAY_AI 1\n";
+    if (write(fd, cmd, strlen(cmd)) != (ssize_t)strlen(cmd) || !wait_for(fd, "Start!"))
+    {
+        close(fd);
+        goto done;
+    }
+
+    stage = "journal write after failed handoff";
+    for (int i = 0; i < WAIT_MS / 50 && !ok; i++)
+    {
+        sleep_ms(50);
+        ok = journal_has_room_open(journal);
+    }
+    close(fd);
+
+done:
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    unlink(journal);
+    unlink(sock);
+    rmdir(dir);
+    if (!ok)
+    {
+        fprintf(stderr, "handoff-test: FAILED at %s\n", stage);
+        return 1;
+    }
+    printf("handoff-test: journal records reach disk after a failed handoff\n");
+    return 0;
+}
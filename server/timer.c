@@ -0,0 +1,217 @@
+#include "server.h"
+
+#include <time.h>
+#include <sys/timerfd.h>
+
+/* 階層タイマーホイール
+ * 10ms 刻みで 64 スロット x 4 段 (0.64s / 41s / 44分 / 47時間)。
+ * タイマーはスロットの双方向リストにつなぐだけなので登録・取り消しは O(1)。
+ * 上の段のスロットは下の段が一周するたびに展開 (cascade) して詰め直す。 */
+#define TW_TICK_MS 10
+#define TW_BITS 6
+#define TW_SIZE (1 << TW_BITS)
+#define TW_MASK (TW_SIZE - 1)
+#define TW_LEVELS 4
+
+static Timer *wheel[TW_LEVELS][TW_SIZE];
+static uint64_t occupied[TW_LEVELS]; /* 空でないスロットのビットマップ */
+static uint64_t now_tick = 0;        /* 処理済みの tick */
+static int timer_count = 0;
+
+int timer_fd = -1;
+static uint64_t armed_tick = 0; /* timerfd に設定済みの tick (0 は未設定) */
+
+uint64_t timer_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void wheel_insert(Timer *t)
+{
+    uint64_t delta = (t->expires > now_tick) ? t->expires - now_tick : 0;
+    int level = 0;
+    while (level < TW_LEVELS - 1 && delta >= ((uint64_t)1 << (TW_BITS * (level + 1))))
+        level++;
+
+    uint64_t expires = t->expires;
+    if (level == TW_LEVELS - 1 && delta >= ((uint64_t)1 << (TW_BITS * TW_LEVELS)))
+        expires = now_tick + ((uint64_t)1 << (TW_BITS * TW_LEVELS)) - 1; /* 上限で丸める */
+    if (expires <= now_tick)
+        expires = now_tick + 1;
+    int slot = (int)((expires >> (TW_BITS * level)) & TW_MASK);
+
+    t->next = wheel[level][slot];
+    if (t->next)
+        t->next->pprev = &t->next;
+    t->pprev = &wheel[level][slot];
+    wheel[level][slot] = t;
+    occupied[level] |= 1ULL << slot;
+    t->slot = level * TW_SIZE + slot;
+}
+
+static void wheel_unlink(Timer *t)
+{
+    *t->pprev = t->next;
+    if (t->next)
+        t->next->pprev = t->pprev;
+    t->next = NULL;
+    t->pprev = NULL;
+}
+
+int timer_init(void)
+{
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0)
+    {
+        perror("timerfd_create");
+        return -1;
+    }
+    now_tick = timer_now_ms() / TW_TICK_MS;
+    return 0;
+}
+
+int timer_pending(const Timer *t)
+{
+    return t->pprev != NULL;
+}
+
+/* delay_ms 後に fn(arg) を呼ぶ。登録済みなら付け直す */
+void timer_schedule(Timer *t, uint64_t delay_ms, void (*fn)(void *), void *arg)
+{
+    if (timer_pending(t))
+    {
+        timer_cancel(t);
+    }
+    t->fn = fn;
+    t->arg = arg;
+    /* 端数は切り上げて早すぎる発火を防ぐ */
+    t->expires = (timer_now_ms() + delay_ms + TW_TICK_MS - 1) / TW_TICK_MS;
+    wheel_insert(t);
+    timer_count++;
+}
+
+void timer_cancel(Timer *t)
+{
+    if (!timer_pending(t))
+        return;
+    wheel_unlink(t);
+    timer_count--;
+
+    /* スロットが空になったらビットマップを落とす */
+    int level = t->slot / TW_SIZE;
+    int slot = t->slot % TW_SIZE;
+    if (!wheel[level][slot])
+        occupied[level] &= ~(1ULL << slot);
+}
+
+/* 上の段のスロットを下の段へ詰め直す */
+static void wheel_cascade(int level)
+{
+    int slot = (int)((now_tick >> (TW_BITS * level)) & TW_MASK);
+    Timer *t = wheel[level][slot];
+    wheel[level][slot] = NULL;
+    occupied[level] &= ~(1ULL << slot);
+    while (t)
+    {
+        Timer *next = t->next;
+        t->next = NULL;
+        t->pprev = NULL;
+        wheel_insert(t);
+        t = next;
+    }
+}
+
+/* 現在時刻までの tick を進め、期限の来たタイマーを呼ぶ */
+void timer_run(void)
+{
+    uint64_t target = timer_now_ms() / TW_TICK_MS;
+    TRACE_BEGIN(TR_TIMER_RUN);
+
+    while (now_tick < target)
+    {
+        if (timer_count == 0)
+        {
+            now_tick = target;
+            break;
+        }
+        now_tick++;
+
+        /* 下の段が一周したら上の段を展開する */
+        for (int level = 1; level < TW_LEVELS; level++)
+        {
+            if ((now_tick & (((uint64_t)1 << (TW_BITS * level)) - 1)) != 0)
+                break;
+            wheel_cascade(level);
+        }
+
+        int slot = (int)(now_tick & TW_MASK);
+        while (wheel[0][slot])
+        {
+            Timer *t = wheel[0][slot];
+            wheel_unlink(t);
+            timer_count--;
+            t->fn(t->arg); /* コールバック内での再登録・取り消しは可 */
+        }
+        occupied[0] &= ~(1ULL << slot);
+    }
+    TRACE_END(TR_TIMER_RUN);
+}
+
+/* 次に見る必要のある tick (最初の空でない 0 段スロットか、次の展開) */
+static uint64_t wheel_next_tick(void)
+{
+    uint64_t base = now_tick + 1;
+    int start = (int)(base & TW_MASK);
+    /* 0 段は一周分だけ見る */
+    uint64_t rot = (occupied[0] >> start) | (start ? (occupied[0] << (TW_SIZE - start)) : 0);
+    /* 展開は 64 の倍数の tick で起きる (base 自身が境界なら 0) */
+    uint64_t to_boundary = (TW_SIZE - (base & TW_MASK)) & TW_MASK;
+    if (rot)
+    {
+        uint64_t off = (uint64_t)__builtin_ctzll(rot);
+        if (off < to_boundary || (occupied[1] | occupied[2] | occupied[3]) == 0)
+            return base + off;
+    }
+    /* 0 段の残りが空なら次の展開で起きる */
+    return base + to_boundary;
+}
+
+/* timerfd を次の期限に合わせる (変わったときだけ syscall) */
+void timer_sync(void)
+{
+    if (timer_fd < 0)
+        return;
+
+    uint64_t next = (timer_count > 0) ? wheel_next_tick() : 0;
+    if (next == armed_tick)
+        return;
+    armed_tick = next;
+
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (next != 0)
+    {
+        uint64_t ms = next * TW_TICK_MS;
+        its.it_value.tv_sec = (time_t)(ms / 1000);
+        its.it_value.tv_nsec = (long)(ms % 1000) * 1000000L;
+    }
+    io_syscalls++;
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+        perror("timerfd_settime");
+}
+
+/* timerfd が読めるようになった (select 経路は自分で読む) */
+void timer_handle_event(int consumed)
+{
+    if (!consumed)
+    {
+        uint64_t expirations;
+        io_syscalls++;
+        if (read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+            perror("timerfd read");
+    }
+    armed_tick = 0;
+    timer_run();
+}
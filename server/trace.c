@@ -0,0 +1,182 @@
+#include "server.h"
+
+#include <stdatomic.h>
+
+/* ホットパスのトレース
+ * スレッドごとのリングバッファに [時刻, 区間, 開始/終了] を書くだけで、
+ * 書き手はそのスレッドだけなのでロックも CAS も要らない。
+ * 無効時のプローブは trace_enabled を読んで分岐するだけ (TRACE_BEGIN/TRACE_END)。
+ * TRACE DUMP か SIGUSR1 で Chrome の trace event 形式 (JSON) に書き出す
+ * (chrome://tracing や Perfetto で開ける)。 */
+#define TRACE_RING_BITS 16 /* スレッドあたり 65536 イベント (1MB) */
+#define TRACE_RING_SIZE (1u << TRACE_RING_BITS)
+#define TRACE_MAX_THREADS 32
+
+typedef struct
+{
+    uint64_t ts_ns;
+    uint32_t id;
+    uint32_t phase; /* 'B' / 'E' */
+} TraceEvent;
+
+typedef struct
+{
+    atomic_ulong head; /* 書いたイベントの総数 (書き手だけが進める) */
+    int tid;
+    char name[16];
+    TraceEvent events[TRACE_RING_SIZE];
+} TraceRing;
+
+int trace_enabled = 0;
+volatile sig_atomic_t trace_dump_requested = 0;
+
+static TraceRing *rings[TRACE_MAX_THREADS];
+static atomic_int ring_count = 0;
+static _Thread_local TraceRing *my_ring = NULL;
+static _Thread_local const char *my_name = NULL;
+static const char *dump_path = "contrast-trace.json";
+
+static const char *TRACE_NAMES[TR_COUNT] = {
+    "handle_client_data",
+    "dispatch_text",
+    "dispatch_frame",
+    "lobby_command",
+    "process_game_move",
+    "process_move",
+    "legal_set",
+    "commit_move",
+    "journal_move",
+    "apply_move",
+    "notify",
+    "is_win",
+    "is_loss",
+    "send",
+    "io_wait",
+    "timer_run",
+    "ai_drain",
+    "ai_search",
+    "journal_sync",
+};
+
+/* スレッドの表示名 (最初のイベントより前に呼ぶ) */
+void trace_thread_name(const char *name)
+{
+    my_name = name;
+}
+
+static TraceRing *ring_register(void)
+{
+    int slot = atomic_fetch_add(&ring_count, 1);
+    if (slot >= TRACE_MAX_THREADS)
+    {
+        atomic_fetch_sub(&ring_count, 1);
+        return NULL;
+    }
+    TraceRing *r = calloc(1, sizeof(TraceRing));
+    if (!r)
+        return NULL;
+    r->tid = slot + 1;
+    snprintf(r->name, sizeof(r->name), "%s", my_name ? my_name : "thread");
+    /* 読み手 (ダンプ) には登録順に見えればよい */
+    __atomic_store_n(&rings[slot], r, __ATOMIC_RELEASE);
+    return r;
+}
+
+void trace_event(int id, int phase)
+{
+    TraceRing *r = my_ring;
+    if (!r)
+    {
+        r = my_ring = ring_register();
+        if (!r)
+            return;
+    }
+    unsigned long h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    TraceEvent *e = &r->events[h & (TRACE_RING_SIZE - 1)];
+    e->ts_ns = metrics_now();
+    e->id = (uint32_t)id;
+    e->phase = (uint32_t)phase;
+    atomic_store_explicit(&r->head, h + 1, memory_order_release);
+}
+
+void trace_set_enabled(int on)
+{
+    __atomic_store_n(&trace_enabled, on, __ATOMIC_RELAXED);
+}
+
+/* path が NULL なら無効のまま始める (TRACE ON で有効にできる) */
+void trace_init(const char *path)
+{
+    trace_thread_name("event-loop");
+    if (!path)
+        return;
+    if (path[0])
+        dump_path = path;
+    trace_set_enabled(1);
+    printf("Trace: enabled, dump to %s (TRACE DUMP or SIGUSR1)\n", dump_path);
+}
+
+/* 書き込み中のリングも読むので、追い越されうる古い端は少し捨てる */
+int trace_dump(void)
+{
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", dump_path);
+    FILE *fp = fopen(tmp, "w");
+    if (!fp)
+    {
+        perror("trace dump");
+        return -1;
+    }
+
+    fprintf(fp, "{\"traceEvents\":[\n");
+    int first = 1;
+    int n = atomic_load(&ring_count);
+    if (n > TRACE_MAX_THREADS)
+        n = TRACE_MAX_THREADS;
+    unsigned long written = 0;
+    for (int i = 0; i < n; i++)
+    {
+        TraceRing *r = __atomic_load_n(&rings[i], __ATOMIC_ACQUIRE);
+        if (!r)
+            continue;
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", r->tid, r->name);
+        first = 0;
+
+        unsigned long head = atomic_load_explicit(&r->head, memory_order_acquire);
+        unsigned long start = (head > TRACE_RING_SIZE - 1024) ? head - (TRACE_RING_SIZE - 1024) : 0;
+        for (unsigned long k = start; k < head; k++)
+        {
+            const TraceEvent *e = &r->events[k & (TRACE_RING_SIZE - 1)];
+            if (e->id >= TR_COUNT)
+                continue;
+            fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                    TRACE_NAMES[e->id], (char)e->phase, e->ts_ns / 1000.0, r->tid);
+            written++;
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    if (fclose(fp) != 0 || rename(tmp, dump_path) < 0)
+    {
+        perror("trace dump");
+        return -1;
+    }
+    printf("Trace: %lu events written to %s\n", written, dump_path);
+    return 0;
+}
+
+/* イベントループの周回ごとに呼ぶ (シグナルハンドラではフラグを立てるだけ) */
+void trace_poll(void)
+{
+    if (trace_dump_requested)
+    {
+        trace_dump_requested = 0;
+        trace_dump();
+    }
+}
+
+void handle_trace_signal(int sig)
+{
+    (void)sig;
+    trace_dump_requested = 1;
+}
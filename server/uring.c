@@ -0,0 +1,881 @@
+#include "server.h"
+
+/*
+ * io_uring バックエンド
+ *  - listen ソケットは multishot accept で受け付ける
+ *  - 受信は provided buffer ring + multishot recv (1接続あたり SQE 1つ)
+ *  - 送信は fd ごとのキューに積み、ループ1周分をまとめて1回の io_uring_enter で submit する
+ *    同じ fd への送信は連続した SQE をリンク (IOSQE_IO_LINK) して順序を保証する
+ * liburing には依存せず、システムコールを直接呼ぶ。
+ */
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define URING_ENTRIES 256
+#define URING_BUF_GROUP 0
+#define URING_BUF_COUNT 256 /* 2のべき乗 */
+
+/* user_data の下位2ビットで操作種別を区別する */
+#define OP_ACCEPT 0
+#define OP_RECV 1
+#define OP_SEND 2
+#define OP_CANCEL 3
+#define OP_MASK 3ULL
+/* eventfd の読み込み (ポインタを持たないので OP_CANCEL の種別に相乗りする) */
+#define OP_EVENT (4ULL | OP_CANCEL)
+#define OP_TIMER (8ULL | OP_CANCEL)
+#define OP_HANDOFF (12ULL | OP_CANCEL) /* 引き継ぎ要求の accept */
+
+/* 送信待ち/送信中の要求 (共有バッファの参照を完了まで保持する) */
+typedef struct UringSend
+{
+    struct UringSend *next;
+    int fd;
+    SharedBuf *buf;
+    size_t off;
+} UringSend;
+
+/* fd ごとの状態 */
+typedef struct
+{
+    uint32_t gen;          /* recv の世代 (古い CQE を捨てるため) */
+    int slot;              /* clients[] の添字。recv 未登録なら -1 */
+    int recv_armed;        /* recv が登録されたまま (引き継ぎ前に止まるのを待つ) */
+    UringSend *head;       /* 未送信キュー */
+    UringSend *tail;
+    UringSend *retry_head; /* 途中で切れたリンクの再送分 */
+    UringSend *retry_tail;
+    int inflight;          /* submit 済みで未完了の送信数 */
+    size_t queued;         /* 送信し終わっていないバイト数 (OUT_QUEUE_LIMIT と比べる) */
+    int dirty;             /* dirty_fds に登録済みか */
+    int closing;           /* 送信完了後に close する */
+    int failed;            /* 送信エラー済み (残りは捨てる) */
+} UringFd;
+
+static struct
+{
+    int ring_fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr;
+    size_t sq_size;
+    void *cq_ptr;
+    size_t cq_size;
+    size_t sqes_size;
+
+    unsigned local_tail; /* まだカーネルに見せていない SQ tail */
+    unsigned to_submit;
+
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_size;
+    char *buf_base;
+    unsigned short buf_tail;
+
+    int listen_fd;
+    int multishot_accept;
+    int multishot_recv;
+    int accept_armed;
+    int quiescing; /* 引き継ぎ要求後: accept と recv を止めて送信だけ続ける */
+
+    UringFd *fds;
+    int fd_cap;
+    int *dirty_fds; /* このループで送信キューが増えた fd */
+    int dirty_count;
+    int dirty_cap;
+
+    uint64_t event_count; /* eventfd の読み込み先 */
+    uint64_t timer_expirations; /* timerfd の読み込み先 */
+} ring;
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static UringFd *fd_state(int fd)
+{
+    if (fd >= ring.fd_cap)
+    {
+        int cap = ring.fd_cap ? ring.fd_cap : 64;
+        while (cap <= fd)
+            cap *= 2;
+        UringFd *p = realloc(ring.fds, sizeof(UringFd) * cap);
+        if (!p)
+            return NULL;
+        memset(p + ring.fd_cap, 0, sizeof(UringFd) * (cap - ring.fd_cap));
+        for (int i = ring.fd_cap; i < cap; i++)
+            p[i].slot = -1;
+        ring.fds = p;
+        ring.fd_cap = cap;
+    }
+    return &ring.fds[fd];
+}
+
+/* 積んである SQE を submit し、min_complete 個の完了を待つ */
+static int uring_submit(unsigned min_complete)
+{
+    __atomic_store_n(ring.sq_tail, ring.local_tail, __ATOMIC_RELEASE);
+    unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+    io_syscalls++;
+    int ret = sys_io_uring_enter(ring.ring_fd, ring.to_submit, min_complete, flags);
+    if (ret >= 0)
+        ring.to_submit = 0;
+    return ret;
+}
+
+static struct io_uring_sqe *uring_get_sqe()
+{
+    unsigned head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+    if (ring.local_tail - head >= ring.sq_entries)
+    {
+        /* SQ が満杯なら先に submit しておく */
+        if (uring_submit(0) < 0)
+            return NULL;
+        head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+        if (ring.local_tail - head >= ring.sq_entries)
+            return NULL;
+    }
+    unsigned idx = ring.local_tail & ring.sq_mask;
+    struct io_uring_sqe *sqe = &ring.sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    ring.sq_array[idx] = idx;
+    ring.local_tail++;
+    ring.to_submit++;
+    return sqe;
+}
+
+static void uring_return_buffer(unsigned short bid)
+{
+    struct io_uring_buf *buf = &ring.buf_ring->bufs[ring.buf_tail & (URING_BUF_COUNT - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(ring.buf_base + (size_t)bid * BUF_SIZE);
+    buf->len = BUF_SIZE - 1; /* 末尾に '\0' を書けるよう1バイト残す */
+    buf->bid = bid;
+    ring.buf_tail++;
+    __atomic_store_n(&ring.buf_ring->tail, ring.buf_tail, __ATOMIC_RELEASE);
+}
+
+static void uring_arm_accept()
+{
+    struct io_uring_sqe *sqe = uring_get_sqe();
+    if (!sqe)
+        return;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = ring.listen_fd;
+    if (ring.multishot_accept)
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = OP_ACCEPT;
+    ring.accept_armed = 1;
+}
+
+/* 引き継ぎ要求 (UNIX ソケット) を1つ受け付ける */
+static void uring_arm_handoff()
+{
+    if (handoff_listen_fd < 0)
+        return;
+    struct io_uring_sqe *sqe = uring_get_sqe();
+    if (!sqe)
+        return;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = handoff_listen_fd;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = OP_HANDOFF;
+}
+
+/* AI スレッドからの完了通知 (eventfd) を読む */
+static void uring_arm_event()
+{
+    if (ai_event_fd < 0)
+        return;
+    struct io_uring_sqe *sqe = uring_get_sqe();
+    if (!sqe)
+        return;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = ai_event_fd;
+    sqe->addr = (uint64_t)(uintptr_t)&ring.event_count;
+    sqe->len = sizeof(ring.event_count);
+    sqe->user_data = OP_EVENT;
+}
+
+/* タイマーホイールの timerfd を読む */
+static void uring_arm_timer()
+{
+    if (timer_fd < 0)
+        return;
+    struct io_uring_sqe *sqe = uring_get_sqe();
+    if (!sqe)
+        return;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = timer_fd;
+    sqe->addr = (uint64_t)(uintptr_t)&ring.timer_expirations;
+    sqe->len = sizeof(ring.timer_expirations);
+    sqe->user_data = OP_TIMER;
+}
+
+static void uring_arm_recv(int fd)
+{
+    if (ring.quiescing)
+        return;
+    UringFd *st = fd_state(fd);
+    struct io_uring_sqe *sqe = uring_get_sqe();
+    if (!st || !sqe)
+        return;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUF_GROUP;
+    if (ring.multishot_recv)
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->user_data = ((uint64_t)st->gen << 32) | ((uint64_t)fd << 2) | OP_RECV;
+    st->recv_armed = 1;
+}
+
+static void uring_mark_dirty(int fd, UringFd *st)
+{
+    if (st->dirty)
+        return;
+    if (ring.dirty_count == ring.dirty_cap)
+    {
+        int cap = ring.dirty_cap ? ring.dirty_cap * 2 : 64;
+        int *p = realloc(ring.dirty_fds, sizeof(int) * cap);
+        if (!p)
+            return;
+        ring.dirty_fds = p;
+        ring.dirty_cap = cap;
+    }
+    ring.dirty_fds[ring.dirty_count++] = fd;
+    st->dirty = 1;
+}
+
+static void uring_free_send(UringFd *st, UringSend *s)
+{
+    st->queued -= s->buf->len;
+    sbuf_unref(s->buf);
+    free(s);
+}
+
+static void uring_free_list(UringFd *st, UringSend *s)
+{
+    while (s)
+    {
+        UringSend *next = s->next;
+        uring_free_send(st, s);
+        s = next;
+    }
+}
+
+/* 送信が全て終わった closing 状態の fd を実際に閉じる */
+static void uring_maybe_close(int fd, UringFd *st)
+{
+    if (st->closing && st->inflight == 0 && !st->head)
+    {
+        st->closing = 0;
+        st->failed = 0;
+        io_syscalls++;
+        close(fd);
+    }
+}
+
+/*
+ * fd の未送信キューを SQE に変換する。1つの fd の送信は SQ 上で連続させ
+ * IOSQE_IO_LINK でつなぐので、カーネル内で順序どおりに処理される。
+ * 前のチェーンが完了するまで次のチェーンは出さない。
+ */
+static void uring_flush_fd(int fd, UringFd *st)
+{
+    if (st->inflight > 0)
+        return;
+    if (st->failed)
+    {
+        uring_free_list(st, st->head);
+        st->head = st->tail = NULL;
+    }
+
+    unsigned max_chain = ring.sq_entries / 2;
+    unsigned head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+    unsigned chain = 0;
+    for (UringSend *s = st->head; s && chain < max_chain; s = s->next)
+        chain++;
+    if (chain > 0 && ring.sq_entries - (ring.local_tail - head) < chain)
+    {
+        /* チェーンが submit をまたがないよう先に空ける */
+        if (uring_submit(0) < 0)
+            return;
+    }
+
+    struct io_uring_sqe *prev = NULL;
+    while (st->head && st->inflight < (int)max_chain)
+    {
+        UringSend *s = st->head;
+        struct io_uring_sqe *sqe = uring_get_sqe();
+        if (!sqe)
+            break;
+        st->head = s->next;
+        if (!st->head)
+            st->tail = NULL;
+        s->next = NULL;
+
+        if (prev)
+            prev->flags |= IOSQE_IO_LINK;
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)(uintptr_t)(s->buf->data + s->off);
+        sqe->len = (uint32_t)(s->buf->len - s->off);
+        sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+        sqe->user_data = (uint64_t)(uintptr_t)s | OP_SEND;
+        st->inflight++;
+        prev = sqe;
+    }
+
+    uring_maybe_close(fd, st);
+}
+
+/* ループ1周分に積んだ送信をまとめて SQE にする */
+static void uring_flush()
+{
+    for (int i = 0; i < ring.dirty_count; i++)
+    {
+        int fd = ring.dirty_fds[i];
+        UringFd *st = &ring.fds[fd];
+        st->dirty = 0;
+        uring_flush_fd(fd, st);
+    }
+    ring.dirty_count = 0;
+}
+
+int uring_queue_send(int fd, SharedBuf *buf)
+{
+    UringFd *st = fd_state(fd);
+    if (!st || st->queued + buf->len > OUT_QUEUE_LIMIT)
+        return -1;
+    UringSend *s = malloc(sizeof(UringSend));
+    if (!s)
+        return -1;
+    st->queued += buf->len;
+    sbuf_ref(buf);
+    s->next = NULL;
+    s->fd = fd;
+    s->buf = buf;
+    s->off = 0;
+
+    if (st->tail)
+        st->tail->next = s;
+    else
+        st->head = s;
+    st->tail = s;
+    uring_mark_dirty(fd, st);
+    return 0;
+}
+
+void uring_close_fd(int fd)
+{
+    UringFd *st = fd_state(fd);
+    if (!st)
+    {
+        io_syscalls++;
+        close(fd);
+        return;
+    }
+    if (st->slot >= 0)
+    {
+        struct io_uring_sqe *sqe = uring_get_sqe();
+        if (sqe)
+        {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = ((uint64_t)st->gen << 32) | ((uint64_t)fd << 2) | OP_RECV;
+            sqe->user_data = OP_CANCEL;
+        }
+        /* 以後この接続の recv CQE は世代違いとして捨てる */
+        st->gen++;
+        st->slot = -1;
+        st->recv_armed = 0;
+    }
+    /* 積んである送信 (例: "Server full.") を送り終えてから閉じる */
+    st->closing = 1;
+    if (st->head)
+        uring_mark_dirty(fd, st);
+    else
+        uring_maybe_close(fd, st);
+}
+
+int uring_out_pending(int fd)
+{
+    if (fd >= ring.fd_cap)
+        return 0;
+    UringFd *st = &ring.fds[fd];
+    return st->head || st->retry_head || st->inflight > 0;
+}
+
+static void uring_cancel(uint64_t user_data)
+{
+    struct io_uring_sqe *sqe = uring_get_sqe();
+    if (!sqe)
+        return;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = user_data;
+    sqe->user_data = OP_CANCEL;
+}
+
+/* 引き継ぎに備えて accept と全接続の recv を取り消す。受信済みのデータは
+ * 取り消しの CQE が届くまでいつもどおり処理し、以後は送信だけを流す */
+static void uring_quiesce()
+{
+    ring.quiescing = 1;
+    if (ring.accept_armed)
+        uring_cancel(OP_ACCEPT);
+    for (int fd = 0; fd < ring.fd_cap; fd++)
+    {
+        UringFd *st = &ring.fds[fd];
+        if (st->slot >= 0 && st->recv_armed)
+            uring_cancel(((uint64_t)st->gen << 32) | ((uint64_t)fd << 2) | OP_RECV);
+    }
+}
+
+/* 取り消した accept と recv がすべて終わったか */
+static int uring_quiet()
+{
+    if (ring.accept_armed)
+        return 0;
+    for (int fd = 0; fd < ring.fd_cap; fd++)
+    {
+        if (ring.fds[fd].slot >= 0 && ring.fds[fd].recv_armed)
+            return 0;
+    }
+    return 1;
+}
+
+static void uring_handle_handoff(struct io_uring_cqe *cqe)
+{
+    if (cqe->res >= 0)
+    {
+        handoff_begin(cqe->res);
+        uring_quiesce();
+    }
+    else if (cqe->res != -ECANCELED)
+    {
+        fprintf(stderr, "handoff accept: %s\n", strerror(-cqe->res));
+        if (server_running)
+            uring_arm_handoff();
+    }
+}
+
+static void uring_handle_accept(struct io_uring_cqe *cqe)
+{
+    if (cqe->res >= 0)
+    {
+        int new_fd = cqe->res;
+        struct sockaddr_in cli_addr;
+        socklen_t clilen = sizeof(cli_addr);
+        const char *addr = "unknown";
+        io_syscalls++;
+        if (getpeername(new_fd, (struct sockaddr *)&cli_addr, &clilen) == 0)
+            addr = inet_ntoa(cli_addr.sin_addr);
+
+        int idx = accept_client(new_fd, addr);
+        if (idx >= 0)
+        {
+            UringFd *st = fd_state(new_fd);
+            if (st)
+            {
+                st->slot = idx;
+                uring_arm_recv(new_fd);
+            }
+        }
+    }
+    else if (cqe->res == -EINVAL && ring.multishot_accept)
+    {
+        /* 古いカーネルでは単発 accept に切り替える */
+        ring.multishot_accept = 0;
+    }
+    else if (!(cqe->res == -ECANCELED && ring.quiescing))
+    {
+        fprintf(stderr, "accept: %s\n", strerror(-cqe->res));
+    }
+
+    if (!(cqe->flags & IORING_CQE_F_MORE))
+    {
+        ring.accept_armed = 0;
+        if (!ring.quiescing)
+            uring_arm_accept();
+    }
+}
+
+static void uring_handle_recv(struct io_uring_cqe *cqe)
+{
+    int fd = (int)((cqe->user_data >> 2) & 0x3fffffff);
+    uint32_t gen = (uint32_t)(cqe->user_data >> 32);
+    int has_buf = (cqe->flags & IORING_CQE_F_BUFFER) != 0;
+    unsigned short bid = (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+
+    UringFd *st = (fd < ring.fd_cap) ? &ring.fds[fd] : NULL;
+    if (!st || st->gen != gen || st->slot < 0 || clients[st->slot].fd != fd)
+    {
+        /* 取り消し済み接続の CQE */
+        if (has_buf)
+            uring_return_buffer(bid);
+        return;
+    }
+
+    int slot = st->slot;
+    if (!(cqe->flags & IORING_CQE_F_MORE))
+        st->recv_armed = 0;
+    if (cqe->res == -ECANCELED && ring.quiescing)
+        return; /* 引き継ぎのために止めた recv */
+    if (cqe->res == -ENOBUFS)
+    {
+        /* バッファ枯渇: 再登録して続行 */
+        if (!(cqe->flags & IORING_CQE_F_MORE))
+            uring_arm_recv(fd);
+        return;
+    }
+    if (cqe->res == -EINVAL && ring.multishot_recv)
+    {
+        ring.multishot_recv = 0;
+        uring_arm_recv(fd);
+        return;
+    }
+
+    if (cqe->res <= 0 || !has_buf)
+    {
+        handle_client_data(slot, NULL, cqe->res <= 0 ? cqe->res : 0);
+    }
+    else
+    {
+        char *data = ring.buf_base + (size_t)bid * BUF_SIZE;
+        handle_client_data(slot, data, cqe->res);
+    }
+    if (has_buf)
+        uring_return_buffer(bid);
+
+    /* multishot が終了していて、まだ接続が生きていれば再登録 */
+    if (!(cqe->flags & IORING_CQE_F_MORE) && st->gen == gen && st->slot == slot && clients[slot].fd == fd)
+        uring_arm_recv(fd);
+}
+
+static void uring_handle_send(struct io_uring_cqe *cqe)
+{
+    UringSend *s = (UringSend *)(uintptr_t)(cqe->user_data & ~OP_MASK);
+    int fd = s->fd;
+    UringFd *st = &ring.fds[fd];
+    st->inflight--;
+
+    if (cqe->res < 0 && cqe->res != -ECANCELED)
+    {
+        /* 相手が切断済みなど。残りの送信は捨てる */
+        if (cqe->res != -EPIPE && cqe->res != -ECONNRESET)
+            fprintf(stderr, "send: %s\n", strerror(-cqe->res));
+        st->failed = 1;
+        uring_free_send(st, s);
+    }
+    else if (st->failed || (cqe->res >= 0 && s->off + (size_t)cqe->res >= s->buf->len))
+    {
+        uring_free_send(st, s);
+    }
+    else
+    {
+        /* 部分送信、またはその後ろでリンクが切れて取り消された分は再送する */
+        if (cqe->res > 0)
+            s->off += (size_t)cqe->res;
+        if (st->retry_tail)
+            st->retry_tail->next = s;
+        else
+            st->retry_head = s;
+        st->retry_tail = s;
+    }
+
+    if (st->inflight == 0)
+    {
+        if (st->retry_head)
+        {
+            st->retry_tail->next = st->head;
+            st->head = st->retry_head;
+            if (!st->tail)
+                st->tail = st->retry_tail;
+            st->retry_head = st->retry_tail = NULL;
+        }
+        if (st->head)
+            uring_mark_dirty(fd, st);
+        else
+            uring_maybe_close(fd, st);
+    }
+}
+
+static void uring_teardown()
+{
+    if (ring.buf_ring)
+        munmap(ring.buf_ring, ring.buf_ring_size);
+    free(ring.buf_base);
+    if (ring.sqes)
+        munmap(ring.sqes, ring.sqes_size);
+    if (ring.cq_ptr && ring.cq_ptr != ring.sq_ptr)
+        munmap(ring.cq_ptr, ring.cq_size);
+    if (ring.sq_ptr)
+        munmap(ring.sq_ptr, ring.sq_size);
+    if (ring.ring_fd >= 0)
+        close(ring.ring_fd);
+    free(ring.fds);
+    free(ring.dirty_fds);
+    memset(&ring, 0, sizeof(ring));
+    ring.ring_fd = -1;
+}
+
+static int uring_setup(int listen_fd)
+{
+    struct io_uring_params p;
+
+    memset(&ring, 0, sizeof(ring));
+    ring.ring_fd = -1;
+    ring.listen_fd = listen_fd;
+    ring.multishot_accept = 1;
+    ring.multishot_recv = 1;
+
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    ring.ring_fd = sys_io_uring_setup(URING_ENTRIES, &p);
+    if (ring.ring_fd < 0)
+    {
+        /* 追加フラグ非対応のカーネル向けに素の設定で再試行 */
+        memset(&p, 0, sizeof(p));
+        ring.ring_fd = sys_io_uring_setup(URING_ENTRIES, &p);
+    }
+    if (ring.ring_fd < 0)
+        return -1;
+
+    ring.sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring.cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (ring.cq_size > ring.sq_size)
+            ring.sq_size = ring.cq_size;
+        ring.cq_size = ring.sq_size;
+    }
+
+    ring.sq_ptr = mmap(NULL, ring.sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring.ring_fd, IORING_OFF_SQ_RING);
+    if (ring.sq_ptr == MAP_FAILED)
+    {
+        ring.sq_ptr = NULL;
+        return -1;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        ring.cq_ptr = ring.sq_ptr;
+    }
+    else
+    {
+        ring.cq_ptr = mmap(NULL, ring.cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ring.ring_fd, IORING_OFF_CQ_RING);
+        if (ring.cq_ptr == MAP_FAILED)
+        {
+            ring.cq_ptr = NULL;
+            return -1;
+        }
+    }
+    ring.sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring.sqes = mmap(NULL, ring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ring.ring_fd, IORING_OFF_SQES);
+    if (ring.sqes == MAP_FAILED)
+    {
+        ring.sqes = NULL;
+        return -1;
+    }
+
+    char *sq = ring.sq_ptr;
+    char *cq = ring.cq_ptr;
+    ring.sq_head = (unsigned *)(sq + p.sq_off.head);
+    ring.sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ring.sq_mask = *(unsigned *)(sq + p.sq_off.ring_mask);
+    ring.sq_entries = *(unsigned *)(sq + p.sq_off.ring_entries);
+    ring.sq_array = (unsigned *)(sq + p.sq_off.array);
+    ring.cq_head = (unsigned *)(cq + p.cq_off.head);
+    ring.cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ring.cq_mask = *(unsigned *)(cq + p.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    ring.local_tail = *ring.sq_tail;
+
+    /* provided buffer ring の登録 */
+    ring.buf_ring_size = URING_BUF_COUNT * sizeof(struct io_uring_buf);
+    ring.buf_ring = mmap(NULL, ring.buf_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ring.buf_ring == MAP_FAILED)
+    {
+        ring.buf_ring = NULL;
+        return -1;
+    }
+    ring.buf_base = malloc((size_t)URING_BUF_COUNT * BUF_SIZE);
+    if (!ring.buf_base)
+        return -1;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring.buf_ring;
+    reg.ring_entries = URING_BUF_COUNT;
+    reg.bgid = URING_BUF_GROUP;
+    if (sys_io_uring_register(ring.ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+        return -1;
+
+    ring.buf_tail = 0;
+    for (unsigned i = 0; i < URING_BUF_COUNT; i++)
+        uring_return_buffer((unsigned short)i);
+
+    return 0;
+}
+
+int uring_run(int listen_fd)
+{
+    if (uring_setup(listen_fd) < 0)
+    {
+        uring_teardown();
+        return -1;
+    }
+
+    io_backend = IO_BACKEND_URING;
+    printf("Using io_uring backend.\n");
+    uring_arm_accept();
+    uring_arm_event();
+    uring_arm_timer();
+    uring_arm_handoff();
+
+    /* 引き継いだ接続 (または引き継ぎをやめて戻ってきた接続) の受信を登録し直す。
+     * io_uring で受け付けた接続と同じくブロッキングにしておく */
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        int fd = clients[i].fd;
+        UringFd *st = (fd >= 0) ? fd_state(fd) : NULL;
+        if (!st)
+            continue;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+        st->slot = i;
+        uring_arm_recv(fd);
+    }
+
+    while (server_running)
+    {
+        /* 引き継ぎ要求後は受信が止まり、送信を流しきったら抜ける */
+        if (ring.quiescing && uring_quiet() && handoff_drained())
+            break;
+        trace_poll();
+        drop_slow_clients();
+        /* ループ1周分に積んだ送信・受信登録をまとめて submit し、完了を待つ */
+        uring_flush();
+        timer_sync();
+        TRACE_BEGIN(TR_IO_WAIT);
+        int submitted = uring_submit(1);
+        TRACE_END(TR_IO_WAIT);
+        if (submitted < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("io_uring_enter");
+            break;
+        }
+
+        unsigned head = *ring.cq_head;
+        unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail)
+        {
+            struct io_uring_cqe cqe = ring.cqes[head & ring.cq_mask];
+            head++;
+            /* CQE はコピー済みなので先に解放して CQ あふれを防ぐ */
+            __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+
+            switch (cqe.user_data & OP_MASK)
+            {
+            case OP_ACCEPT:
+                uring_handle_accept(&cqe);
+                break;
+            case OP_RECV:
+                uring_handle_recv(&cqe);
+                break;
+            case OP_SEND:
+                uring_handle_send(&cqe);
+                break;
+            case OP_CANCEL:
+                if (cqe.user_data == OP_EVENT)
+                {
+                    if (cqe.res > 0)
+                        ai_drain_results();
+                    if (server_running)
+                        uring_arm_event();
+                }
+                else if (cqe.user_data == OP_TIMER)
+                {
+                    if (cqe.res > 0)
+                        timer_handle_event(1);
+                    if (server_running)
+                        uring_arm_timer();
+                }
+                else if (cqe.user_data == OP_HANDOFF)
+                {
+                    uring_handle_handoff(&cqe);
+                }
+                break;
+            default:
+                break;
+            }
+            if (head == tail)
+                tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        }
+    }
+
+    uring_teardown();
+    return 0;
+}
+
+#else /* !HAVE_IO_URING */
+
+int uring_run(int listen_fd)
+{
+    (void)listen_fd;
+    return -1;
+}
+
+int uring_queue_send(int fd, SharedBuf *buf)
+{
+    (void)fd;
+    (void)buf;
+    return -1;
+}
+
+int uring_out_pending(int fd)
+{
+    (void)fd;
+    return 0;
+}
+
+void uring_close_fd(int fd)
+{
+    close(fd);
+}
+
+#endif